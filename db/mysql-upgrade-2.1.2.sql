@@ -4,6 +4,19 @@ ALTER TABLE `nagios_scheduleddowntime` MODIFY COLUMN `duration` int NOT NULL def
 
 -- --------------------------------------------------------
 
+-- Content hashes of stored object definitions, for incremental_config_sync
+
+CREATE TABLE IF NOT EXISTS `nagios_objectconfighashes` (
+  `instance_id` smallint(6) NOT NULL default '0',
+  `object_id` int(11) NOT NULL default '0',
+  `objecttype_id` smallint(6) NOT NULL default '0',
+  `config_type` smallint(6) NOT NULL default '0',
+  `config_hash` bigint(20) unsigned NOT NULL default '0',
+  UNIQUE KEY `instance_id` (`instance_id`,`object_id`,`config_type`)
+) ENGINE=MyISAM COMMENT='Content hashes of stored object definitions';
+
+-- --------------------------------------------------------
+
 --
 
 -- END 2.1.2 MODS 
@@ -865,6 +865,21 @@ CREATE TABLE IF NOT EXISTS `nagios_notifications` (
 
 -- --------------------------------------------------------
 
+--
+-- Table structure for table `nagios_objectconfighashes`
+--
+
+CREATE TABLE IF NOT EXISTS `nagios_objectconfighashes` (
+  `instance_id` smallint(6) NOT NULL default '0',
+  `object_id` int(11) NOT NULL default '0',
+  `objecttype_id` smallint(6) NOT NULL default '0',
+  `config_type` smallint(6) NOT NULL default '0',
+  `config_hash` bigint(20) unsigned NOT NULL default '0',
+  UNIQUE KEY `instance_id` (`instance_id`,`object_id`,`config_type`)
+) ENGINE=MyISAM COMMENT='Content hashes of stored object definitions';
+
+-- --------------------------------------------------------
+
 --
 -- Table structure for table `nagios_objects`
 --
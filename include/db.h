@@ -46,6 +46,7 @@ typedef struct ndo2db_dbconfig_struct{
 	unsigned long max_contactnotificationmethods_age;
 	unsigned long max_logentries_age;
 	unsigned long max_acknowledgements_age;	
+	int incremental_config_sync;
         }ndo2db_dbconfig;
 
 /*************** DB server types ***************/
@@ -120,8 +121,9 @@ typedef struct ndo2db_dbconfig_struct{
 #define NDO2DB_DBTABLE_HOSTESCALATIONCONTACTGROUPS    66
 #define NDO2DB_DBTABLE_SERVICEESCALATIONCONTACTGROUPS 67
 #define NDO2DB_DBTABLE_SERVICEPARENTSERVICES          68
+#define NDO2DB_DBTABLE_OBJECTCONFIGHASHES             69
 
-#define NDO2DB_MAX_DBTABLES                           69
+#define NDO2DB_MAX_DBTABLES                           70
 
 
 /**************** Object types *****************/
@@ -146,12 +148,13 @@ int ndo2db_db_deinit(ndo2db_idi *);
 
 int ndo2db_db_connect(ndo2db_idi *);
 int ndo2db_db_disconnect(ndo2db_idi *);
+int ndo2db_db_close_shared(void);
 
 int ndo2db_db_hello(ndo2db_idi *);
 int ndo2db_db_goodbye(ndo2db_idi *);
 int ndo2db_db_checkin(ndo2db_idi *);
 
-char *ndo2db_db_escape_string(ndo2db_idi *,char *);
+char *ndo2db_db_escape_string(ndo2db_idi *,char *,int *);
 char *ndo2db_db_timet_to_sql(ndo2db_idi *,time_t);
 char *ndo2db_db_sql_to_timet(ndo2db_idi *,char *);
 int ndo2db_db_query(ndo2db_idi *,char *);
@@ -26,13 +26,30 @@
 #include "ndo2db.h"
 #define NAGIOS_SIZEOF_ARRAY(var)       (sizeof(var)/sizeof(var[0]))
 
+/* status column types used when applying delta updates */
+#define NDO2DB_COLUMN_INT               0
+#define NDO2DB_COLUMN_ULONG             1
+#define NDO2DB_COLUMN_DOUBLE            2
+#define NDO2DB_COLUMN_TIMET             3
+#define NDO2DB_COLUMN_STRING            4
+#define NDO2DB_COLUMN_TIMEPERIOD        5
+
+typedef struct ndo2db_status_column_struct{
+	int key;
+	int type;
+	char *name;
+        }ndo2db_status_column;
+
 int ndo2db_get_object_id(ndo2db_idi *,int,char *,char *,unsigned long *);
 int ndo2db_get_object_id_with_insert(ndo2db_idi *,int,char *,char *,unsigned long *);
+int ndo2db_get_object_id_with_key(ndo2db_idi *,int,char *,char *,unsigned long *);
 
 int ndo2db_get_cached_object_ids(ndo2db_idi *);
 int ndo2db_get_cached_object_id(ndo2db_idi *,int,char *,char *,unsigned long *);
 int ndo2db_add_cached_object_id(ndo2db_idi *,int,char *,char *,unsigned long);
 int ndo2db_free_cached_object_ids(ndo2db_idi *);
+int ndo2db_get_cached_object_key(ndo2db_idi *,unsigned long long,int,char *,char *,unsigned long *);
+int ndo2db_add_cached_object_key(ndo2db_idi *,unsigned long long,ndo2db_dbobject *);
 
 int ndo2db_object_hashfunc(const char *,const char *,int);
 int ndo2db_compare_object_hashdata(const char *,const char *,const char *,const char *);
@@ -40,6 +57,12 @@ int ndo2db_compare_object_hashdata(const char *,const char *,const char *,const
 int ndo2db_set_all_objects_as_inactive(ndo2db_idi *);
 int ndo2db_set_object_as_active(ndo2db_idi *,int,unsigned long);
 
+int ndo2db_load_config_hashes(ndo2db_idi *);
+int ndo2db_free_config_hashes(ndo2db_idi *);
+int ndo2db_config_unchanged(ndo2db_idi *,int,char *,char *);
+int ndo2db_delete_object_config(ndo2db_idi *,int,unsigned long,int);
+int ndo2db_save_config_hashes(ndo2db_idi *);
+
 int ndo2db_handle_logentry(ndo2db_idi *);
 int ndo2db_handle_processdata(ndo2db_idi *);
 int ndo2db_handle_timedeventdata(ndo2db_idi *);
@@ -54,9 +77,13 @@ int ndo2db_handle_hostcheckdata(ndo2db_idi *);
 int ndo2db_handle_commentdata(ndo2db_idi *);
 int ndo2db_handle_downtimedata(ndo2db_idi *);
 int ndo2db_handle_flappingdata(ndo2db_idi *);
+int ndo2db_save_status_row(ndo2db_idi *,int,char *,unsigned long,char *,char *);
 int ndo2db_handle_programstatusdata(ndo2db_idi *);
 int ndo2db_handle_hoststatusdata(ndo2db_idi *);
 int ndo2db_handle_servicestatusdata(ndo2db_idi *);
+int ndo2db_handle_statusdeltadata(ndo2db_idi *,int,int,char *,ndo2db_status_column *,int);
+int ndo2db_handle_hoststatusdeltadata(ndo2db_idi *);
+int ndo2db_handle_servicestatusdeltadata(ndo2db_idi *);
 int ndo2db_handle_contactstatusdata(ndo2db_idi *);
 int ndo2db_handle_adaptiveprogramdata(ndo2db_idi *);
 int ndo2db_handle_adaptivehostdata(ndo2db_idi *);
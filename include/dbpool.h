@@ -0,0 +1,61 @@
+/**
+ * @file dbpool.h Database writer threads for ndo2db daemon
+ */
+/*
+ * Copyright 2009-2014 Nagios Core Development Team and Community Contributors
+ *
+ * This file is part of NDOUtils.
+ *
+ * NDOUtils is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * NDOUtils is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with NDOUtils. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NDO2DB_DBPOOL_H_INCLUDED
+#define NDO2DB_DBPOOL_H_INCLUDED
+
+#include <pthread.h>
+#include "ndo2db.h"
+
+#define NDO2DB_DBPOOL_MAX_WRITERS       64
+#define NDO2DB_DBPOOL_MAX_QUEUED        1024	/* items waiting per writer before the reader waits */
+
+
+/* one parsed data item on its way to a writer */
+typedef struct ndo2db_dbjob_struct{
+	int input_data;
+	char **buffered_input;
+	ndo2db_input_value *input_values;
+	ndo2db_mbuf mbuf[NDO2DB_MAX_MBUF_ITEMS];
+	unsigned long instance_id;
+	time_t latest_realtime_data_time;
+	struct ndo2db_dbjob_struct *next;
+        }ndo2db_dbjob;
+
+
+/* a writer thread with its own database connection and object cache */
+typedef struct ndo2db_dbwriter_struct{
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	ndo2db_dbjob *head;
+	ndo2db_dbjob *tail;
+	unsigned long queued;
+	int stop;
+	ndo2db_idi idi;
+        }ndo2db_dbwriter;
+
+
+int ndo2db_dbpool_dispatch(ndo2db_idi *);
+int ndo2db_dbpool_drain(void);
+int ndo2db_dbpool_stop(void);
+
+#endif
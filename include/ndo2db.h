@@ -46,6 +46,30 @@
 
 #define NDO2DB_MAX_MBUF_ITEMS                           15
 
+#define NDO2DB_MAX_LINE_LENGTH                          (1024*64)	/* default limit - longer lines of input are truncated */
+#define NDO2DB_MIN_LINE_LENGTH                          1024
+#define NDO2DB_DEFAULT_READ_BUFFER_SIZE                 (1024*256)	/* most a client connection is read from in one go */
+#define NDO2DB_MIN_READ_BUFFER_SIZE                     4096
+#define NDO2DB_MAX_READ_BUFFER_SIZE                     (1024*1024*16)
+#define NDO2DB_READ_STATS_INTERVAL                      60	/* seconds between reports of how much each read takes */
+#define NDO2DB_DEFAULT_MAX_FRAME_SIZE                   (1024*1024)	/* largest message taken from a message socket */
+
+
+/********* connection stream states ************/
+#define NDO2DB_STREAM_HELLO                             0	/* looking for the end of the hello */
+#define NDO2DB_STREAM_TEXT                              1
+#define NDO2DB_STREAM_COMPRESSED                        2
+
+#define NDO2DB_STREAM_LINE_SIZE                         256
+
+
+/********* typed input value kinds ************/
+#define NDO2DB_VALUE_NONE                               0	/* the item is a string, if it is there at all */
+#define NDO2DB_VALUE_INT                                1
+#define NDO2DB_VALUE_UNSIGNED                           2
+#define NDO2DB_VALUE_DOUBLE                             3
+#define NDO2DB_VALUE_TIMEVAL                            4
+
 
 /***************** structures *****************/
 
@@ -56,6 +80,18 @@ typedef struct ndo2db_mbuf_struct{
         }ndo2db_mbuf;
 
 
+/* a value that came typed in a protocol 3 frame - kept as it is, so it is never printed and parsed again */
+typedef struct ndo2db_input_value_struct{
+	int type;
+	union{
+		long long integer;
+		unsigned long long unsigned_long;
+		double floating_point;
+		struct timeval timestamp;
+		}value;
+        }ndo2db_input_value;
+
+
 typedef struct ndo2db_dbobject_struct{
 	char *name1;
 	char *name2;
@@ -64,6 +100,25 @@ typedef struct ndo2db_dbobject_struct{
 	struct ndo2db_dbobject_struct *nexthash;
         }ndo2db_dbobject;
 
+/* object id cached under the key ndomod sends with events - the key is only a hash, so the names are kept to check hits against */
+typedef struct ndo2db_dbobjectkey_struct{
+	unsigned long long key;
+	ndo2db_dbobject *object;
+	struct ndo2db_dbobjectkey_struct *nexthash;
+        }ndo2db_dbobjectkey;
+
+
+/* content hash of an object definition we have stored */
+typedef struct ndo2db_confighash_struct{
+	unsigned long object_id;
+	int object_type;
+	int config_type;
+	unsigned long long hash;
+	int seen;
+	int dirty;
+	struct ndo2db_confighash_struct *nexthash;
+        }ndo2db_confighash;
+
 
 typedef struct ndo2db_dbconninfo_struct{
 	int server_type;
@@ -71,6 +126,8 @@ typedef struct ndo2db_dbconninfo_struct{
 	int error;
 #ifdef USE_MYSQL
 	MYSQL mysql_conn;
+	MYSQL *mysql_link;			/* mysql_conn, or the connection every client shares in event loop mode */
+	int pooled;				/* belongs to a writer thread, so never says hello */
 	MYSQL_RES *mysql_result;
 	MYSQL_ROW mysql_row;
 #endif
@@ -101,6 +158,11 @@ typedef struct ndo2db_dbconninfo_struct{
 	time_t last_logentry_time;
 	char *last_logentry_data;
 	ndo2db_dbobject **object_hashlist;
+	ndo2db_dbobjectkey **objectkey_hashlist;
+	int incremental_config_sync;
+	int config_sync_active;			/* definitions are only rewritten when their hash changes */
+	int config_sync_cleared;		/* the definition tables were emptied at startup anyway */
+	ndo2db_confighash **confighash_hashlist;
         }ndo2db_dbconninfo;
 
 
@@ -119,15 +181,54 @@ typedef struct ndo2db_input_data_info_struct{
 	unsigned long bytes_processed;
 	unsigned long lines_processed;
 	unsigned long entries_processed;
+	unsigned long frame_skip;		/* what is left of a frame over max_frame_size, thrown out as it arrives */
+	unsigned long events_shed;		/* dropped by ndomod's rate limits and sampling, as last reported */
+	unsigned long events_shed_logged;
+	int config_hashes;			/* client sends a content hash with object definitions */
 	unsigned long data_start_time;
 	unsigned long data_end_time;
 	int current_object_config_type;
 	char **buffered_input;
+	ndo2db_input_value *input_values;	/* typed items, by data type like buffered_input */
 	ndo2db_mbuf mbuf[NDO2DB_MAX_MBUF_ITEMS];
 	ndo2db_dbconninfo dbinfo;
         }ndo2db_idi;
 
 
+/* lets the connection reader find and inflate a compressed stream */
+typedef struct ndo2db_stream_struct{
+	int state;
+	int compression;
+	char line[NDO2DB_STREAM_LINE_SIZE];
+	unsigned long line_len;
+	ndo_dbuf zbuf;
+#ifdef HAVE_ZLIB
+	z_stream zs;
+	int zs_ready;
+#endif
+	unsigned long long raw_bytes;
+	unsigned long long compressed_bytes;
+	unsigned long blocks;
+	unsigned long long cpu_usec;
+	ndo_dbuf *carry;			/* set when the input is handled right here rather than queued for a writer */
+        }ndo2db_stream;
+
+
+/* a client connection in event loop mode - this is all it costs */
+typedef struct ndo2db_client_struct{
+	int sd;
+	int seqpacket;
+#ifdef HAVE_SSL
+	SSL *ssl;
+	int ssl_ready;
+#endif
+	ndo2db_idi idi;
+	ndo2db_stream stream;
+	ndo_dbuf carry;
+	struct ndo2db_client_struct *next;
+        }ndo2db_client;
+
+
 
 /*************** DB server types ***************/
 #define NDO2DB_DBSERVER_NONE                            0
@@ -137,6 +238,11 @@ typedef struct ndo2db_input_data_info_struct{
 /*************** misc definitions **************/
 #define NDO2DB_INPUT_BUFFER                             1024
 #define NDO2DB_OBJECT_HASHSLOTS                         1024
+#define NDO2DB_OBJECTKEY_HASHSLOTS                      16384
+#define NDO2DB_CONFIGHASH_HASHSLOTS                     16384
+#define NDO2DB_CONFIGHASH_BATCH                         500	/* hash rows saved per query */
+#define NDO2DB_EVENT_LOOP_MAX_EVENTS                    64
+#define NDO2DB_EVENT_LOOP_READ_SIZE                     65536
 
 
 /*********** types of input sections ***********/
@@ -180,6 +286,8 @@ typedef struct ndo2db_input_data_info_struct{
 #define NDO2DB_INPUT_DATA_STATECHANGEDATA               43
 #define NDO2DB_INPUT_DATA_CONTACTSTATUSDATA             44
 #define NDO2DB_INPUT_DATA_ADAPTIVECONTACTDATA           45
+#define NDO2DB_INPUT_DATA_HOSTSTATUSDELTADATA           46
+#define NDO2DB_INPUT_DATA_SERVICESTATUSDELTADATA        47
 
 #define NDO2DB_INPUT_DATA_MAINCONFIGFILEVARIABLES       50
 #define NDO2DB_INPUT_DATA_RESOURCECONFIGFILEVARIABLES   51
@@ -246,14 +354,28 @@ int ndo2db_free_connection_memory(ndo2db_idi *);
 
 int ndo2db_wait_for_connections(void);
 int ndo2db_handle_client_connection(int);
+int ndo2db_handle_shm_connection(void);
+int ndo2db_handle_seqpacket_connection(int);
+int ndo2db_run_event_loop(void);
 int ndo2db_idi_init(ndo2db_idi *);
-int ndo2db_check_for_client_input(ndo2db_idi *,ndo_dbuf *);
+int ndo2db_check_for_client_input(ndo2db_idi *,char *,unsigned long);
+int ndo2db_stream_init(ndo2db_stream *);
+int ndo2db_stream_deinit(ndo2db_stream *);
+int ndo2db_stream_input(ndo2db_stream *,ndo2db_idi *,char *,unsigned long);
+int ndo2db_queue_input(char *,unsigned long);
+int ndo2db_queue_finish(void);
 int ndo2db_handle_client_input(ndo2db_idi *,char *);
+int ndo2db_handle_input_type(ndo2db_idi *,int);
+int ndo2db_handle_client_frame(ndo2db_idi *,char *,unsigned long);
+unsigned long ndo2db_get_frame_size(const char *,unsigned long);
 
 int ndo2db_start_input_data(ndo2db_idi *);
 int ndo2db_end_input_data(ndo2db_idi *);
-int ndo2db_add_input_data_item(ndo2db_idi *,int,char *);
+int ndo2db_handle_input_data(ndo2db_idi *);
+int ndo2db_add_input_data_item(ndo2db_idi *,int,char *,int);
+int ndo2db_save_input_data_item(ndo2db_idi *,int,char *);
 int ndo2db_add_input_data_mbuf(ndo2db_idi *,int,int,char *);
+int ndo2db_add_input_data_value(ndo2db_idi *,int,ndo2db_input_value *);
 
 int ndo2db_convert_standard_data_elements(ndo2db_idi *,int *,int *,int *,struct timeval *);
 int ndo2db_convert_string_to_int(char *,int *);
@@ -263,8 +385,16 @@ int ndo2db_convert_string_to_long(char *,long *);
 int ndo2db_convert_string_to_unsignedlong(char *,unsigned long *);
 int ndo2db_convert_string_to_timeval(char *,struct timeval *);
 
+int ndo2db_has_input(ndo2db_idi *,int);
+int ndo2db_get_input_int(ndo2db_idi *,int,int *);
+int ndo2db_get_input_double(ndo2db_idi *,int,double *);
+int ndo2db_get_input_unsignedlong(ndo2db_idi *,int,unsigned long *);
+int ndo2db_get_input_unsignedlonglong(ndo2db_idi *,int,unsigned long long *);
+int ndo2db_get_input_timeval(ndo2db_idi *,int,struct timeval *);
+
 int ndo2db_open_debug_log(void);
 int ndo2db_close_debug_log(void);
 
 void ndo2db_async_client_handle();
+unsigned long ndo2db_process_client_data(ndo2db_idi *,char *,unsigned long,unsigned long *);
 #endif
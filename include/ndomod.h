@@ -27,18 +27,194 @@
 /* this is needed for access to daemon's internal data */
 #define NSCORE 1
 
+#include <regex.h>
+
+/* sink buffer is a single byte ring of length-prefixed, NUL-terminated records */
 typedef struct ndomod_sink_buffer_struct{
-	char **buffer;
+	char *buffer;
 	unsigned long size;
 	unsigned long head;
 	unsigned long tail;
+	unsigned long used;
 	unsigned long items;
 	unsigned long maxitems;
+	unsigned long sent;			/* bytes of the oldest item already written to the sink */
 	unsigned long overflow;
+	unsigned long high_items;
+	unsigned long high_bytes;
         }ndomod_sink_buffer;
 
+#define NDOMOD_SINK_BUFFER_BYTES        16777216
+#define NDOMOD_SINK_BUFFER_ALIGN        sizeof(uint32_t)
+#define NDOMOD_SINK_BUFFER_PAD          0xFFFFFFFFU
+
+/* on-disk overflow for the sink buffer - a sequence of length-prefixed segment files */
+typedef struct ndomod_spill_queue_struct{
+	unsigned long read_seq;
+	unsigned long next_seq;
+	unsigned long segments;
+	int write_fd;
+	unsigned long write_size;
+	char *map;
+	unsigned long map_size;
+	unsigned long read_offset;
+	unsigned long long disk_bytes;
+	unsigned long long spilled_bytes;
+	unsigned long long replayed_bytes;
+	unsigned long segments_deleted;
+	unsigned long dropped;
+        }ndomod_spill_queue;
+
+/* progress of sending buffered output after a reconnect */
+typedef struct ndomod_drain_state_struct{
+	int active;
+	unsigned long items;
+	unsigned long long bytes;
+	double rate;
+	time_t started;
+	time_t last_log;
+        }ndomod_drain_state;
+
+#define NDOMOD_DRAIN_LOG_INTERVAL       30
+
+#define NDOMOD_SINK_CONNECT_TIMEOUT     30	/* seconds before a non-blocking connect is given up on */
+#define NDOMOD_SINK_ADDRESS_TTL         300	/* seconds a resolved sink address is reused */
+#define NDOMOD_SINK_ADDRESS_RETRY       15	/* first wait after a failed lookup, doubled up to the ttl */
+
+#define NDOMOD_STATS_BUCKETS            24	/* the last one also holds anything slower than 4 sec */
+
+#define NDOMOD_SPILL_PREFIX             "ndomod-spill."
+#define NDOMOD_SPILL_SEGMENT_SIZE       16777216
+#define NDOMOD_SPILL_MAX_BYTES          1073741824
+
+/* single-producer/single-consumer byte ring used by the async writer thread - items are copied in back to back, each after its length */
+typedef struct ndomod_async_queue_struct{
+	char *buffer;
+	unsigned long size;
+	unsigned long head;			/* only written by the producer (core thread) - use __atomic builtins from the other side */
+	unsigned long tail;			/* only written by the consumer (writer thread) - likewise */
+	unsigned long high_water;		/* bytes */
+	unsigned long enqueued;
+	unsigned long dequeued;			/* written by the consumer, read by the producer */
+	unsigned long dropped;
+	unsigned long waits;
+	unsigned long long wait_usec;
+	unsigned long long max_wait_usec;
+        }ndomod_async_queue;
+
+/* a status update waiting out the conflation window */
+typedef struct ndomod_conflated_status_struct{
+	void *object;
+	char *data;
+	unsigned long size;
+	struct ndomod_conflated_status_struct *hash_next;
+	struct ndomod_conflated_status_struct *next;		/* in the order the objects were first seen */
+        }ndomod_conflated_status;
+
+/* what we last sent for a host or service, so status updates can leave out unchanged fields */
+typedef struct ndomod_delta_state_struct{
+	void *object;
+	unsigned long generation;		/* sink generation the fields were sent on */
+	unsigned long updates;
+	int send_full;				/* a full update hasn't gone out yet */
+	unsigned long long dirty;		/* fields changed since the last update was sent */
+	int customvars_dirty;
+	unsigned long long customvars;
+	size_t nfields;
+	unsigned long long *fields;
+	struct ndomod_delta_state_struct *next;
+        }ndomod_delta_state;
+
+/* key sent with events about a host or service, remembered so it is only hashed once */
+typedef struct ndomod_object_key_struct{
+	void *object;
+	const char *name1;			/* the object's own name pointers, in case the object is replaced */
+	const char *name2;
+	unsigned long long key;
+	int exported;				/* export filter verdict on Nagios 2 and 3, which have no object ids */
+	struct ndomod_object_key_struct *next;
+        }ndomod_object_key;
+
+/* a rule from the config file that picks hosts and services to export */
+typedef struct ndomod_export_rule_struct{
+	int type;
+	char *name;				/* group or custom variable name */
+	regex_t regex;				/* for name rules */
+	struct ndomod_export_rule_struct *next;
+        }ndomod_export_rule;
+
+/* rate limit and sampling for one callback type */
+typedef struct ndomod_event_limit_struct{
+	double rate;				/* events per second, 0 for no limit */
+	double burst;				/* most events let through at once */
+	double tokens;
+	unsigned long long last_refill;		/* monotonic nsec */
+	unsigned long sample;			/* keep 1 event in this many, 0 or 1 keeps them all */
+	unsigned long sample_count;
+	unsigned long rate_limited;		/* events dropped by the rate limit */
+	unsigned long sampled;			/* events dropped by sampling */
+        }ndomod_event_limit;
+
+/* stream compression counters */
+typedef struct ndomod_compression_stats_struct{
+	unsigned long long raw_bytes;
+	unsigned long long compressed_bytes;
+	unsigned long blocks;
+	unsigned long long cpu_usec;
+        }ndomod_compression_stats;
+
+/* log2 histogram of how long something took: bucket 0 is under 1 usec, bucket n is under 2^n usec */
+typedef struct ndomod_latency_histogram_struct{
+	unsigned long count;
+	unsigned long long total_nsec;
+	unsigned long long max_nsec;
+	unsigned long buckets[NDOMOD_STATS_BUCKETS];
+        }ndomod_latency_histogram;
+
+/* what ndomod_broker_data() has done with one callback type */
+typedef struct ndomod_event_stats_struct{
+	unsigned long events;			/* callbacks that produced output */
+	unsigned long filtered;			/* left out by the object export filters */
+	unsigned long long bytes;
+	ndomod_latency_histogram total;		/* every call, including filtered ones */
+	ndomod_latency_histogram serialize;
+	ndomod_latency_histogram escape;	/* part of serialize */
+	ndomod_latency_histogram write;
+        }ndomod_event_stats;
+
 
 #define NDOMOD_MAX_BUFLEN   16384
+#define NDOMOD_MAX_OUTBUF_KEEP        1048576	/* larger reusable output buffers are freed after use */
+
+#define NDOMOD_ASYNC_QUEUE_SIZE       8388608
+#define NDOMOD_ASYNC_QUEUE_MIN_SIZE   65536
+#define NDOMOD_ASYNC_SKIP             ((unsigned long)-1)	/* length that marks the unused end of the ring */
+#define NDOMOD_ASYNC_ITEM_SIZE(len)   ((sizeof(unsigned long)+(len)+1+7)&~7UL)	/* length, data and NUL, kept aligned */
+#define NDOMOD_ASYNC_IDLE_USEC        1000
+#define NDOMOD_ASYNC_MAX_LOG_MSGS     64
+
+#define NDOMOD_COMPRESSION_BLOCK_SIZE 65536
+
+#define NDOMOD_BATCH_IOV_MAX          64	/* most buffered items sent with one writev() */
+
+#define NDOMOD_STATS_QH_NAME          "ndomod"	/* query handler channel on Nagios 4 */
+
+#define NDOMOD_CONFLATION_HASHSLOTS   4096
+
+#define NDOMOD_DELTA_HASHSLOTS        4096
+#define NDOMOD_DELTA_MAX_FIELDS       64
+
+#define NDOMOD_OBJECT_KEY_HASHSLOTS   4096
+
+/* NEBTYPE values come in blocks of 100 per callback, so the remainder picks the bit */
+#define NDOMOD_SUBTYPE(t)               (1ULL<<(((t)%100)&63))
+#define NDOMOD_ALL_SUBTYPES             (~0ULL)
+
+#define NDOMOD_EXPORT_HOSTGROUP         1
+#define NDOMOD_EXPORT_SERVICEGROUP      2
+#define NDOMOD_EXPORT_HOST_NAME         3
+#define NDOMOD_EXPORT_SERVICE_NAME      4
+#define NDOMOD_EXPORT_CUSTOM_VARIABLE   5
 
 
 #define NDOMOD_PROCESS_PROCESS_DATA                   1
@@ -94,20 +270,92 @@ static void ndomod_free_config_memory(void);
 
 int ndomod_open_sink(void);
 int ndomod_close_sink(void);
+#ifdef BUILD_NAGIOS_4X
+int ndomod_open_sink_nonblocking(void);
+int ndomod_sink_connect_handler(int,int,void *);
+#endif
+int ndomod_abort_sink_connect(void);
+int ndomod_sink_connected(int);
+int ndomod_sink_connect_failed(int);
 int ndomod_write_to_sink(char *,int,int);
 int ndomod_rotate_sink_file(void *);
 int ndomod_hello_sink(int,int);
 int ndomod_goodbye_sink(void);
 
-int ndomod_sink_buffer_init(ndomod_sink_buffer *sbuf,unsigned long);
+int ndomod_sink_buffer_init(ndomod_sink_buffer *sbuf,unsigned long,unsigned long);
 int ndomod_sink_buffer_deinit(ndomod_sink_buffer *sbuf);
 int ndomod_sink_buffer_push(ndomod_sink_buffer *sbuf,char *);
-char *ndomod_sink_buffer_peek(ndomod_sink_buffer *sbuf);
-char *ndomod_sink_buffer_pop(ndomod_sink_buffer *sbuf);
+char *ndomod_sink_buffer_peek(ndomod_sink_buffer *sbuf,unsigned long *);
+int ndomod_sink_buffer_consume(ndomod_sink_buffer *,unsigned long);
+int ndomod_sink_buffer_pop(ndomod_sink_buffer *sbuf);
 int ndomod_sink_buffer_items(ndomod_sink_buffer *sbuf);
+unsigned long ndomod_sink_buffer_bytes(ndomod_sink_buffer *sbuf);
+int ndomod_sink_buffer_peek_iov(ndomod_sink_buffer *sbuf,struct iovec *,int,unsigned long);
+int ndomod_sink_buffer_get_highwater(ndomod_sink_buffer *sbuf,unsigned long *,unsigned long *);
 unsigned long ndomod_sink_buffer_get_overflow(ndomod_sink_buffer *sbuf);
 int ndomod_sink_buffer_set_overflow(ndomod_sink_buffer *sbuf,unsigned long);
 
+int ndomod_spill_init(void);
+int ndomod_spill_deinit(void);
+int ndomod_spill_pending(void);
+int ndomod_spill_push(char *,unsigned long);
+char *ndomod_spill_peek(unsigned long *);
+int ndomod_spill_pop(unsigned long);
+void ndomod_log_spill_stats(void);
+int ndomod_buffer_output(char *);
+
+int ndomod_async_queue_init(ndomod_async_queue *,unsigned long);
+int ndomod_async_queue_deinit(ndomod_async_queue *);
+int ndomod_async_queue_push(ndomod_async_queue *,char *,unsigned long);
+char *ndomod_async_queue_peek(ndomod_async_queue *);
+int ndomod_async_queue_release(ndomod_async_queue *);
+unsigned long ndomod_async_queue_depth(ndomod_async_queue *);
+
+int ndomod_start_async_writer(void);
+int ndomod_stop_async_writer(void);
+void *ndomod_async_writer_thread(void *);
+int ndomod_queue_for_sink(char *);
+void ndomod_log_async_stats(void);
+
+int ndomod_status_delta_sent(void *);
+void ndomod_free_delta_state(void);
+
+int ndomod_load_object_keys(void);
+void ndomod_free_object_keys(void);
+
+int ndomod_set_event_subtypes(char *);
+int ndomod_set_event_limit(char *,int);
+unsigned long ndomod_events_shed(void);
+
+int ndomod_add_export_rule(int,char *);
+int ndomod_load_export_filters(void);
+void ndomod_free_export_filters(void);
+
+int ndomod_conflate_status(void *,char *);
+int ndomod_flush_conflated_status(void);
+int ndomod_check_conflated_status(void *);
+
+int ndomod_flush_output_batch(void);
+int ndomod_check_output_batch(void *);
+
+int ndomod_init_compression(void);
+int ndomod_sink_send(char *,int,int);
+int ndomod_flush_compressed_sink(void *);
+void ndomod_log_compression_stats(void);
+
+int ndomod_event_type_id(const char *);
+void ndomod_reset_stats(void);
+int ndomod_format_stats(ndo_dbuf *);
+int ndomod_log_stats(void *);
+#ifdef BUILD_NAGIOS_4X
+int ndomod_stats_query_handler(int,char *,unsigned int);
+int ndomod_register_query_handler(void *);
+#endif
+
+int ndomod_backlog_pending(void);
+int ndomod_drain_backlog(void);
+int ndomod_check_backlog(void *);
+
 int ndomod_load_unprocessed_data(char *);
 int ndomod_save_unprocessed_data(char *);
 
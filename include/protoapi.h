@@ -27,6 +27,29 @@
 /****************** PROTOCOL VERSION ***************/
 
 #define NDO_API_PROTOVERSION                         2
+#define NDO_API_PROTOVERSION_BINARY                  3	/* framed binary data items */
+
+
+/****************** BINARY FRAMING (PROTOCOL 3) ****/
+
+/* frames are never NUL and carry their own length, see ndo_dbuf_append_varint() */
+#define NDO_API_FRAME_MARKER                         0x1e
+#define NDO_API_FRAME_LENGTH_SIZE                    5		/* fixed-size varint after the marker */
+#define NDO_API_FRAME_HEADER_SIZE                    (1+NDO_API_FRAME_LENGTH_SIZE)
+
+#define NDO_API_FIELD_INT                            1		/* zigzag varint */
+#define NDO_API_FIELD_UNSIGNED_LONG                  2		/* varint */
+#define NDO_API_FIELD_TIMEVAL                        3		/* zigzag varint seconds, varint microseconds */
+#define NDO_API_FIELD_DOUBLE                         4		/* varint of the IEEE 754 bit pattern */
+#define NDO_API_FIELD_STRING                         5		/* varint length, raw bytes */
+#define NDO_API_FIELD_ESCAPED_STRING                 6		/* as above, but escaped like protocol 2 */
+
+
+/****************** OBJECT KEYS ********************/
+
+/* object types hashed into NDO_DATA_OBJECTKEY by ndo_object_key() - the same as objecttype_id in the objects table */
+#define NDO_API_OBJECTTYPE_HOST                      1
+#define NDO_API_OBJECTTYPE_SERVICE                   2
 
 
 /****************** CONTROL STRINGS ****************/
@@ -48,6 +71,8 @@
 #define NDO_API_CONNECTION_FILE                      "FILE"
 #define NDO_API_CONNECTION_UNIXSOCKET                "UNIXSOCKET"
 #define NDO_API_CONNECTION_TCPSOCKET                 "TCPSOCKET"
+#define NDO_API_CONNECTION_SHM                       "SHAREDMEMORY"
+#define NDO_API_CONNECTION_UNIXSEQPACKET             "UNIXSEQPACKET"
 #define NDO_API_CONNECTTYPE_INITIAL                  "INITIAL"
 #define NDO_API_CONNECTTYPE_RECONNECT                "RECONNECT"
 
@@ -59,6 +84,14 @@
 #define NDO_API_CONFIGDUMP_RETAINED                  "RETAINED"
 
 #define NDO_API_INSTANCENAME                         "INSTANCENAME"
+#define NDO_API_COMPRESSION                          "COMPRESSION"	/* stream compression after the hello */
+#define NDO_API_EVENTSSHED                           "EVENTSSHED"	/* events dropped by rate limits and sampling so far */
+#define NDO_API_CONFIGHASHES                         "CONFIGHASHES"	/* object definitions carry a content hash */
+
+#define NDO_API_COMPRESSION_NONE                     "NONE"
+#define NDO_API_COMPRESSION_ZLIB                     "ZLIB"
+#define NDO_API_COMPRESSION_HEADER_SIZE              8		/* 32 bit compressed and raw block lengths, network order */
+#define NDO_API_COMPRESSION_MAX_BLOCK_SIZE           16777216	/* largest raw block - ndo2db drops clients that send more */
 
 #define NDO_API_STARTCONFIGDUMP                      900
 #define NDO_API_ENDCONFIGDUMP                        901
@@ -97,6 +130,8 @@
 #define NDO_API_STATECHANGEDATA                      223
 #define NDO_API_CONTACTSTATUSDATA                    224
 #define NDO_API_ADAPTIVECONTACTDATA                  225
+#define NDO_API_HOSTSTATUSDELTADATA                  226	/* only the fields that changed since the last host status */
+#define NDO_API_SERVICESTATUSDELTADATA               227	/* only the fields that changed since the last service status */
 
 #define NDO_API_MAINCONFIGFILEVARIABLES              300
 #define NDO_API_RESOURCECONFIGFILEVARIABLES          301
@@ -122,7 +157,7 @@
 
 /************** COMMON DATA ATTRIBUTES **************/
 
-#define NDO_MAX_DATA_TYPES                           270
+#define NDO_MAX_DATA_TYPES                           273
 
 #define NDO_DATA_NONE                                0
 
@@ -407,4 +442,13 @@
 #define NDO_DATA_PARENTSERVICE                       268
 #define NDO_DATA_ACTIVEOBJECTSTYPE                   269
 
+/* ndo_object_key() of the host or service an event is about */
+#define NDO_DATA_OBJECTKEY                           270
+
+/* events ndomod's rate limits and sampling have dropped since it started, sent with program status */
+#define NDO_DATA_EVENTSSHED                          271
+
+/* ndo_content_hash() of an object definition, leaving out its timestamp */
+#define NDO_DATA_CONFIGHASH                          272
+
 #endif
@@ -0,0 +1,65 @@
+/**
+ * @file serialize.h Serialization of ndomod broker data into the NDO protocols
+ */
+/*
+ * Copyright 2009-2014 Nagios Core Development Team and Community Contributors
+ * Copyright 2005-2009 Ethan Galstad
+ *
+ * This file is part of NDOUtils.
+ *
+ * NDOUtils is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * NDOUtils is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with NDOUtils. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NDO_SERIALIZE_H_INCLUDED
+#define NDO_SERIALIZE_H_INCLUDED
+
+#include "utils.h"
+
+#define BD_INT				0
+#define BD_TIMEVAL			1
+#define BD_STRING			2	/* escaped with ndomod_escape_string() */
+#define BD_UNSIGNED_LONG	3
+#define BD_FLOAT			4
+#define BD_STRING_ESCAPE	5	/* raw string, escaped while serializing */
+#define BD_UNSIGNED_LONGLONG	6
+
+struct ndo_broker_data {
+	int	key;
+	int datatype;
+	union {
+		int	integer;
+		struct timeval timestamp;
+		char *string;
+		unsigned long unsigned_long;
+		unsigned long long unsigned_longlong;
+		double floating_point;
+	} value;
+};
+
+extern int ndomod_protocol_version;
+extern int ndomod_collect_stats;
+extern unsigned long ndomod_config_hash_start;
+extern unsigned long long ndomod_escape_nsec;
+
+unsigned long long ndomod_stats_nsec(void);
+void ndomod_append_escaped(ndo_dbuf *,const char *);
+char *ndomod_escape_string(char *,int *);
+void ndomod_key_serialize(ndo_dbuf *,int,int);
+void ndomod_string_begin(ndo_dbuf *,int,unsigned long);
+void ndomod_string_append(ndo_dbuf *,const char *);
+void ndomod_string_serialize(ndo_dbuf *,int,const char *,char,const char *);
+unsigned long ndomod_frame_begin(ndo_dbuf *,int);
+void ndomod_enddata_serialize(ndo_dbuf *,unsigned long);
+unsigned long ndomod_broker_data_serialize(ndo_dbuf *,int,struct ndo_broker_data *,size_t,int);
+
+#endif
@@ -31,6 +31,11 @@
 #endif
 
 
+/* maps signed values onto unsigned ones so small negatives stay small varints */
+#define NDO_ZIGZAG(v)   ((((unsigned long long)(v))<<1)^(unsigned long long)(((long long)(v))>>63))
+#define NDO_UNZIGZAG(u) ((long long)((u)>>1)^-((long long)((u)&1)))
+
+
 typedef struct ndo_dbuf_struct{
 	char *buf;
 	unsigned long used_size;
@@ -39,9 +44,28 @@ typedef struct ndo_dbuf_struct{
         }ndo_dbuf;
 
 
+unsigned long ndo_escape_span(const char *,unsigned long);
+char *ndo_sql_escape_buffer(char *,int *);
+unsigned long ndo_escape_into(char *,const char *,unsigned long);
+
 int ndo_dbuf_init(ndo_dbuf *,int);
 int ndo_dbuf_free(ndo_dbuf *);
+int ndo_dbuf_reset(ndo_dbuf *);
+int ndo_dbuf_reserve(ndo_dbuf *,unsigned long);
 int ndo_dbuf_strcat(ndo_dbuf *,char *);
+int ndo_dbuf_strncat(ndo_dbuf *,const char *,unsigned long);
+int ndo_dbuf_addchar(ndo_dbuf *,char);
+int ndo_dbuf_append_ulong(ndo_dbuf *,unsigned long,int);
+int ndo_dbuf_append_long(ndo_dbuf *,long);
+int ndo_dbuf_append_double(ndo_dbuf *,double,int);
+int ndo_dbuf_append_escaped(ndo_dbuf *,const char *);
+int ndo_dbuf_append_varint(ndo_dbuf *,unsigned long long);
+
+int ndo_encode_varint_fixed(char *,unsigned long long,int);
+int ndo_decode_varint(const char **,const char *,unsigned long long *);
+
+unsigned long long ndo_object_key(int,const char *,const char *);
+unsigned long long ndo_content_hash(const char *,unsigned long);
 
 int my_rename(char *,char *);
 
@@ -0,0 +1,310 @@
+/**
+ * @file bench_escape.c Times the protocol and SQL escaping of plugin output, old and new
+ */
+/*
+ * Copyright 2009-2014 Nagios Core Development Team and Community Contributors
+ *
+ * This file is part of NDOUtils.
+ *
+ * NDOUtils is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * NDOUtils is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with NDOUtils. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Usage: bench_escape [file ...]
+ *
+ * Every line of the given files is one string of the corpus - a Nagios log,
+ * a perfdata file or an export of the servicestatus output column all make
+ * good ones.  Without files the built-in sample of plugin output is used.
+ *
+ * Linked with -Wl,--wrap=malloc so that every allocation io.c and utils.c
+ * make is counted.
+ */
+
+#include "../include/config.h"
+#include "../include/common.h"
+#include "../include/io.h"
+#include "../include/utils.h"
+
+#define BENCH_ESCAPE_BYTES              (64*1024*1024)	/* each case escapes at least this much */
+
+
+unsigned long bench_allocs=0L;
+
+void *__real_malloc(size_t);
+
+void *__wrap_malloc(size_t size){
+
+	bench_allocs++;
+	return __real_malloc(size);
+        }
+
+
+/* output of the plugins that run most often, as Nagios hands it to ndomod */
+static char *bench_corpus[]={
+	"PING OK - Packet loss = 0%, RTA = 0.48 ms",
+	"rta=0.480000ms;3000.000000;5000.000000;0.000000 pl=0%;80;100;0",
+	"HTTP OK: HTTP/1.1 200 OK - 10642 bytes in 0.112 second response time",
+	"time=0.112234s;;;0.000000 size=10642B;;;0",
+	"DISK OK - free space: / 3326 MB (56% inode=93%); /boot 84 MB (89% inode=99%);",
+	"'/'=2643MB;5948;6691;0;7435 '/boot'=10MB;88;99;0;110",
+	"OK - load average: 0.12, 0.08, 0.05",
+	"load1=0.120;15.000;30.000;0; load5=0.080;10.000;25.000;0; load15=0.050;5.000;20.000;0;",
+	"PROCS OK: 87 processes",
+	"USERS OK - 2 users currently logged in",
+	"SSH OK - OpenSSH_7.4 (protocol 2.0)",
+	"TCP OK - 0.001 second response time on 10.1.2.3 port 5666",
+	"SNMP OK - 1234567 bytes",
+	"SWAP OK - 100% free (2047 MB out of 2047 MB)",
+	"CRITICAL - Socket timeout after 10 seconds",
+	"NRPE: Unable to read output",
+	"OK: All 24 interfaces are up",
+	"MySQL OK - Uptime: 1234567  Threads: 5  Questions: 98765432  Slow queries: 0  Opens: 1234  Flush tables: 1  Open tables: 400  Queries per second avg: 79.987",
+	"WARNING - 2 of 3 nodes in cluster 'db-prod' are up",
+	"Interface eth0 (index 2) is up.\nIn: 12.3 Mbit/s, Out: 4.5 Mbit/s\nErrors: 0",
+	"Service \"Print Spooler\" is running",
+	"C:\\ - total: 99.90 Gb - used: 54.21 Gb (54%) - free 45.69 Gb (46%)",
+	"web-frontend-042.example.com",
+	"HTTP response time",
+	"check_nrpe!check_disk!-w 20% -c 10% -p /",
+	NULL
+	};
+
+
+/* the byte at a time protocol escaper, as it was before */
+static char *bench_old_escape_buffer(char *buffer){
+	char *newbuf=NULL;
+	int x=0;
+	int y=0;
+	int len=0;
+
+	if(buffer==NULL)
+		return NULL;
+
+	len=strlen(buffer);
+	if((newbuf=(char *)malloc((len*2)+1))==NULL)
+		return NULL;
+
+	for(x=0,y=0;x<len;x++){
+		if(buffer[x]=='\t'){
+			newbuf[y++]='\\';
+			newbuf[y++]='t';
+			}
+		else if(buffer[x]=='\r'){
+			newbuf[y++]='\\';
+			newbuf[y++]='r';
+			}
+		else if(buffer[x]=='\n'){
+			newbuf[y++]='\\';
+			newbuf[y++]='n';
+			}
+		else if(buffer[x]=='\\'){
+			newbuf[y++]='\\';
+			newbuf[y++]='\\';
+			}
+		else
+			newbuf[y++]=buffer[x];
+		}
+	newbuf[y]='\x0';
+
+	return newbuf;
+        }
+
+
+/* the SQL escaper, as it was before */
+static char *bench_old_sql_escape(char *buf){
+	static const char special[]="'\"*\\$?.^+[]()";
+	char *newbuf=NULL;
+	size_t span=0;
+	size_t x=0;
+	size_t y=0;
+	size_t z=0;
+
+	if(buf==NULL)
+		return NULL;
+
+	z=strlen(buf);
+	span=strcspn(buf,special);
+
+	if(span==z){
+		if((newbuf=(char *)malloc(z+1))==NULL)
+			return NULL;
+		memcpy(newbuf,buf,z+1);
+		return newbuf;
+		}
+
+	if((newbuf=(char *)malloc(span+((z-span)*2)+1))==NULL)
+		return NULL;
+
+	for(x=0,y=0;x<z;){
+		memcpy(newbuf+y,buf+x,span);
+		x+=span;
+		y+=span;
+		if(x>=z)
+			break;
+		newbuf[y++]='\\';
+		newbuf[y++]=buf[x++];
+		span=strcspn(buf+x,special);
+		}
+	newbuf[y]='\x0';
+
+	return newbuf;
+        }
+
+
+static double bench_now(void){
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return (double)ts.tv_sec+((double)ts.tv_nsec/1000000000.0);
+        }
+
+
+static void bench_report(const char *name, unsigned long rounds, unsigned long strings, unsigned long bytes, unsigned long allocs, double elapsed){
+
+	printf("%-24s %8.1f MB/s  %8.1f ns/string  %5.2f allocs/string\n"
+	       ,name
+	       ,((double)bytes*rounds)/elapsed/1048576.0
+	       ,elapsed*1000000000.0/((double)strings*rounds)
+	       ,(double)allocs/((double)strings*rounds)
+	      );
+
+	return;
+        }
+
+
+int main(int argc, char **argv){
+	char **corpus=bench_corpus;
+	ndo_mmapfile *thefile=NULL;
+	char *line=NULL;
+	char *old=NULL;
+	char *new=NULL;
+	unsigned long strings=0L;
+	unsigned long allocated_strings=0L;
+	unsigned long bytes=0L;
+	unsigned long rounds=0L;
+	unsigned long allocs=0L;
+	unsigned long proto_escaped=0L;
+	unsigned long sql_escaped=0L;
+	unsigned long x=0L;
+	unsigned long y=0L;
+	int allocated=NDO_FALSE;
+	int mismatches=0;
+	int i=0;
+	double start=0.0;
+
+	/* read the corpus */
+	if(argc>1){
+		corpus=NULL;
+		for(i=1;i<argc;i++){
+			if((thefile=ndo_mmap_fopen(argv[i]))==NULL){
+				printf("Could not open '%s'\n",argv[i]);
+				return 1;
+				}
+			while((line=ndo_mmap_fgets(thefile))!=NULL){
+				ndo_strip_buffer(line);
+				if(strings+1>=allocated_strings){
+					allocated_strings=(allocated_strings==0L)?1024:allocated_strings*2;
+					if((corpus=(char **)realloc(corpus,sizeof(char *)*allocated_strings))==NULL){
+						printf("Out of memory\n");
+						return 1;
+						}
+					}
+				corpus[strings++]=line;
+				}
+			ndo_mmap_fclose(thefile);
+			}
+		if(corpus==NULL){
+			printf("The corpus is empty\n");
+			return 1;
+			}
+		corpus[strings]=NULL;
+		}
+
+	for(strings=0L;corpus[strings]!=NULL;strings++)
+		bytes+=strlen(corpus[strings]);
+	if(bytes==0L){
+		printf("The corpus is empty\n");
+		return 1;
+		}
+	rounds=(BENCH_ESCAPE_BYTES/bytes)+1;
+
+	/* both versions have to agree before their speed means anything */
+	for(x=0;x<strings;x++){
+		old=bench_old_escape_buffer(corpus[x]);
+		new=ndo_escape_buffer(corpus[x],&allocated);
+		if(strcmp(old,new))
+			mismatches++;
+		if(allocated==NDO_TRUE){
+			proto_escaped++;
+			free(new);
+			}
+		free(old);
+
+		old=bench_old_sql_escape(corpus[x]);
+		new=ndo_sql_escape_buffer(corpus[x],&allocated);
+		if(strcmp(old,new))
+			mismatches++;
+		if(allocated==NDO_TRUE){
+			sql_escaped++;
+			free(new);
+			}
+		free(old);
+		}
+	if(mismatches>0){
+		printf("%d escaped strings differ between the old and new code\n",mismatches);
+		return 1;
+		}
+
+	printf("%lu strings, %lu bytes, %lu rounds\n",strings,bytes,rounds);
+	printf("%.1f%% need protocol escaping, %.1f%% need SQL escaping\n\n",100.0*proto_escaped/strings,100.0*sql_escaped/strings);
+
+	allocs=bench_allocs;
+	start=bench_now();
+	for(y=0;y<rounds;y++){
+		for(x=0;x<strings;x++)
+			free(bench_old_escape_buffer(corpus[x]));
+		}
+	bench_report("protocol escape, old",rounds,strings,bytes,bench_allocs-allocs,bench_now()-start);
+
+	allocs=bench_allocs;
+	start=bench_now();
+	for(y=0;y<rounds;y++){
+		for(x=0;x<strings;x++){
+			new=ndo_escape_buffer(corpus[x],&allocated);
+			if(allocated==NDO_TRUE)
+				free(new);
+			}
+		}
+	bench_report("protocol escape, new",rounds,strings,bytes,bench_allocs-allocs,bench_now()-start);
+
+	allocs=bench_allocs;
+	start=bench_now();
+	for(y=0;y<rounds;y++){
+		for(x=0;x<strings;x++)
+			free(bench_old_sql_escape(corpus[x]));
+		}
+	bench_report("SQL escape, old",rounds,strings,bytes,bench_allocs-allocs,bench_now()-start);
+
+	allocs=bench_allocs;
+	start=bench_now();
+	for(y=0;y<rounds;y++){
+		for(x=0;x<strings;x++){
+			new=ndo_sql_escape_buffer(corpus[x],&allocated);
+			if(allocated==NDO_TRUE)
+				free(new);
+			}
+		}
+	bench_report("SQL escape, new",rounds,strings,bytes,bench_allocs-allocs,bench_now()-start);
+
+	return 0;
+        }
@@ -0,0 +1,286 @@
+/**
+ * @file bench_serialize.c Times ndomod's event serialization, old and new
+ */
+/*
+ * Copyright 2009-2014 Nagios Core Development Team and Community Contributors
+ *
+ * This file is part of NDOUtils.
+ *
+ * NDOUtils is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * NDOUtils is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with NDOUtils. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Usage: bench_serialize [events]
+ *
+ * The new serializer is ndomod's own, linked in from serialize.o.  Linked
+ * with -Wl,--wrap=malloc -Wl,--wrap=realloc so that every allocation it
+ * and the buffer code in utils.c make is counted.
+ */
+
+#include "../include/config.h"
+#include "../include/common.h"
+#include "../include/io.h"
+#include "../include/utils.h"
+#include "../include/protoapi.h"
+#include "../include/serialize.h"
+
+#define BENCH_DEFAULT_EVENTS            200000
+
+
+unsigned long bench_allocs=0L;
+
+void *__real_malloc(size_t);
+void *__real_realloc(void *,size_t);
+
+void *__wrap_malloc(size_t size){
+
+	bench_allocs++;
+	return __real_malloc(size);
+        }
+
+void *__wrap_realloc(void *ptr, size_t size){
+
+	bench_allocs++;
+	return __real_realloc(ptr,size);
+        }
+
+
+/* a service check result, about as big as the events ndomod sends most of */
+static struct ndo_broker_data bench_event[]={
+	{ NDO_DATA_TYPE, BD_INT, { .integer = 701 }},
+	{ NDO_DATA_FLAGS, BD_INT, { .integer = 0 }},
+	{ NDO_DATA_ATTRIBUTES, BD_INT, { .integer = 0 }},
+	{ NDO_DATA_TIMESTAMP, BD_TIMEVAL, { .timestamp = { 1414141414, 123456 }}},
+	{ NDO_DATA_HOST, BD_STRING_ESCAPE, { .string = "web-frontend-042.example.com" }},
+	{ NDO_DATA_SERVICE, BD_STRING_ESCAPE, { .string = "HTTP response time" }},
+	{ NDO_DATA_CHECKTYPE, BD_INT, { .integer = 0 }},
+	{ NDO_DATA_CURRENTCHECKATTEMPT, BD_INT, { .integer = 1 }},
+	{ NDO_DATA_MAXCHECKATTEMPTS, BD_INT, { .integer = 3 }},
+	{ NDO_DATA_STATETYPE, BD_INT, { .integer = 1 }},
+	{ NDO_DATA_STATE, BD_INT, { .integer = 0 }},
+	{ NDO_DATA_TIMEOUT, BD_INT, { .integer = 60 }},
+	{ NDO_DATA_COMMANDNAME, BD_STRING_ESCAPE, { .string = "check_http" }},
+	{ NDO_DATA_COMMANDARGS, BD_STRING_ESCAPE, { .string = "-H web-frontend-042 -u /health -w 2 -c 5" }},
+	{ NDO_DATA_COMMANDLINE, BD_STRING_ESCAPE, { .string = "/usr/lib/nagios/plugins/check_http -H web-frontend-042 -u /health -w 2 -c 5" }},
+	{ NDO_DATA_STARTTIME, BD_TIMEVAL, { .timestamp = { 1414141413, 987654 }}},
+	{ NDO_DATA_ENDTIME, BD_TIMEVAL, { .timestamp = { 1414141414, 3210 }}},
+	{ NDO_DATA_EARLYTIMEOUT, BD_INT, { .integer = 0 }},
+	{ NDO_DATA_EXECUTIONTIME, BD_FLOAT, { .floating_point = 0.015555 }},
+	{ NDO_DATA_LATENCY, BD_FLOAT, { .floating_point = 0.101 }},
+	{ NDO_DATA_RETURNCODE, BD_INT, { .integer = 0 }},
+	{ NDO_DATA_OUTPUT, BD_STRING_ESCAPE, { .string = "HTTP OK: HTTP/1.1 200 OK - 1531 bytes in 0.015 second response time" }},
+	{ NDO_DATA_LONGOUTPUT, BD_STRING_ESCAPE, { .string = "backend pool: 4/4 up\nqueue depth: 0\\0 waiting\ncache: warm" }},
+	{ NDO_DATA_PERFDATA, BD_STRING_ESCAPE, { .string = "time=0.015419s;2.000000;5.000000;0.000000 size=1531B;;;0" }},
+	{ NDO_DATA_OBJECTKEY, BD_UNSIGNED_LONGLONG, { .unsigned_longlong = 11400714819323198485ULL }},
+        };
+
+#define BENCH_FIELDS (sizeof(bench_event)/sizeof(bench_event[0]))
+
+
+/* the old dynamic buffer append - strlen() and strcat() every time, as ndomod used to do */
+static int bench_legacy_strcat(ndo_dbuf *db, char *buf){
+	char *newbuf=NULL;
+	unsigned long buflen=0L;
+	unsigned long new_size=0L;
+	unsigned long memory_needed=0L;
+
+	buflen=strlen(buf);
+	new_size=db->used_size+buflen+1;
+
+	if(db->allocated_size<new_size){
+		memory_needed=((new_size/db->chunk_size)+1)*db->chunk_size;
+		if((newbuf=(char *)realloc((void *)db->buf,(size_t)memory_needed))==NULL)
+			return NDO_ERROR;
+		db->buf=newbuf;
+		db->allocated_size=memory_needed;
+		db->buf[db->used_size]='\x0';
+	        }
+
+	strcat(db->buf,buf);
+	db->used_size+=buflen;
+
+	return NDO_OK;
+        }
+
+
+/* the old string escaper - always an escaped copy, whether anything needed escaping or not */
+static char *bench_legacy_escape(char *str){
+	char *es=NULL;
+	unsigned long len=0L;
+
+	len=strlen(str);
+	if((es=(char *)malloc((len*2)+1))==NULL)
+		return NULL;
+	es[ndo_escape_into(es,str,len)]='\x0';
+
+	return es;
+        }
+
+
+/* the old serializer - snprintf() per field, an escaped copy of every string and a new buffer per event */
+static unsigned long bench_legacy_serialize(char *out, unsigned long outlen){
+	ndo_dbuf dbuf;
+	struct ndo_broker_data *bdp=NULL;
+	char temp[64];
+	char *es=NULL;
+	unsigned long len=0L;
+	size_t x;
+
+	ndo_dbuf_init(&dbuf,2048);
+
+	snprintf(temp,sizeof(temp)-1,"\n%d:",NDO_API_SERVICECHECKDATA);
+	temp[sizeof(temp)-1]='\x0';
+	bench_legacy_strcat(&dbuf,temp);
+
+	for(x=0,bdp=bench_event;x<BENCH_FIELDS;x++,bdp++){
+		switch(bdp->datatype){
+		case BD_INT:
+			snprintf(temp,sizeof(temp)-1,"\n%d=%d",bdp->key,bdp->value.integer);
+			break;
+		case BD_TIMEVAL:
+			snprintf(temp,sizeof(temp)-1,"\n%d=%ld.%06ld",bdp->key,(long)bdp->value.timestamp.tv_sec,(long)bdp->value.timestamp.tv_usec);
+			break;
+		case BD_UNSIGNED_LONG:
+			snprintf(temp,sizeof(temp)-1,"\n%d=%lu",bdp->key,bdp->value.unsigned_long);
+			break;
+		case BD_UNSIGNED_LONGLONG:
+			snprintf(temp,sizeof(temp)-1,"\n%d=%llu",bdp->key,bdp->value.unsigned_longlong);
+			break;
+		case BD_FLOAT:
+			snprintf(temp,sizeof(temp)-1,"\n%d=%.5lf",bdp->key,bdp->value.floating_point);
+			break;
+		default:
+			es=bench_legacy_escape(bdp->value.string);
+			snprintf(temp,sizeof(temp)-1,"\n%d=",bdp->key);
+			temp[sizeof(temp)-1]='\x0';
+			bench_legacy_strcat(&dbuf,temp);
+			bench_legacy_strcat(&dbuf,(es==NULL)?"":es);
+			free(es);
+			continue;
+			}
+		temp[sizeof(temp)-1]='\x0';
+		bench_legacy_strcat(&dbuf,temp);
+		}
+
+	snprintf(temp,sizeof(temp)-1,"\n%d\n\n",NDO_API_ENDDATA);
+	temp[sizeof(temp)-1]='\x0';
+	bench_legacy_strcat(&dbuf,temp);
+
+	/* keep a copy for comparing */
+	len=dbuf.used_size;
+	if(out!=NULL && len<outlen)
+		memcpy(out,dbuf.buf,len+1);
+
+	ndo_dbuf_free(&dbuf);
+
+	return len;
+        }
+
+
+/* ndomod's serializer - everything appended in place to one buffer that is kept between events */
+static unsigned long bench_direct_serialize(ndo_dbuf *dbufp, char *out, unsigned long outlen){
+
+	ndo_dbuf_reset(dbufp);
+
+	ndomod_broker_data_serialize(dbufp,NDO_API_SERVICECHECKDATA,bench_event,BENCH_FIELDS,NDO_TRUE);
+
+	if(out!=NULL && dbufp->used_size<outlen)
+		memcpy(out,dbufp->buf,dbufp->used_size+1);
+
+	return dbufp->used_size;
+        }
+
+
+static double bench_elapsed(struct timeval *start){
+	struct timeval now;
+
+	gettimeofday(&now,NULL);
+
+	return (double)(now.tv_sec-start->tv_sec)+(double)(now.tv_usec-start->tv_usec)/1000000.0;
+        }
+
+
+static void bench_report(const char *name, unsigned long events, unsigned long long bytes, unsigned long allocs, double secs){
+
+	if(secs<=0.0)
+		secs=0.000001;
+
+	printf("%-10s %10lu events %8.3f sec %12.0f events/sec %10.2f MB/sec %8.2f allocs/event\n",
+		name,events,secs,(double)events/secs,(double)bytes/secs/(1024.0*1024.0),(double)allocs/(double)events);
+        }
+
+
+int main(int argc, char **argv){
+	ndo_dbuf dbuf;
+	char legacy_out[4096];
+	char direct_out[4096];
+	unsigned long events=BENCH_DEFAULT_EVENTS;
+	unsigned long long bytes=0L;
+	unsigned long x;
+	struct timeval start;
+	double secs=0.0;
+
+	if(argc>1 && (events=strtoul(argv[1],NULL,0))==0L){
+		printf("Usage: %s [events]\n",argv[0]);
+		return 1;
+		}
+
+	/* the per event timing ndomod keeps would only add clock reads to what is measured */
+	ndomod_collect_stats=NDO_FALSE;
+	ndomod_protocol_version=NDO_API_PROTOVERSION;
+
+	ndo_dbuf_init(&dbuf,2048);
+
+	/* both have to produce the same bytes, or the comparison means nothing */
+	bench_legacy_serialize(legacy_out,sizeof(legacy_out));
+	bench_direct_serialize(&dbuf,direct_out,sizeof(direct_out));
+	if(strcmp(legacy_out,direct_out)){
+		printf("Old and new serializer output differ:\n--- old ---%s--- new ---%s",legacy_out,direct_out);
+		ndo_dbuf_free(&dbuf);
+		return 1;
+		}
+	printf("%lu byte event with %lu fields\n",(unsigned long)strlen(direct_out),(unsigned long)BENCH_FIELDS);
+
+	/* old serializer */
+	bench_allocs=0L;
+	bytes=0L;
+	gettimeofday(&start,NULL);
+	for(x=0;x<events;x++)
+		bytes+=bench_legacy_serialize(NULL,0L);
+	secs=bench_elapsed(&start);
+	bench_report("old",events,bytes,bench_allocs,secs);
+
+	/* current serializer, starting from a buffer that has already grown */
+	bench_allocs=0L;
+	bytes=0L;
+	gettimeofday(&start,NULL);
+	for(x=0;x<events;x++)
+		bytes+=bench_direct_serialize(&dbuf,NULL,0L);
+	secs=bench_elapsed(&start);
+	bench_report("new",events,bytes,bench_allocs,secs);
+
+	/* the same serializer writing binary frames */
+	ndomod_protocol_version=NDO_API_PROTOVERSION_BINARY;
+	bench_direct_serialize(&dbuf,NULL,0L);
+	bench_allocs=0L;
+	bytes=0L;
+	gettimeofday(&start,NULL);
+	for(x=0;x<events;x++)
+		bytes+=bench_direct_serialize(&dbuf,NULL,0L);
+	secs=bench_elapsed(&start);
+	bench_report("new, v3",events,bytes,bench_allocs,secs);
+
+	ndo_dbuf_free(&dbuf);
+
+	return 0;
+        }
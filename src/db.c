@@ -29,6 +29,7 @@
 #include "../include/ndo2db.h"
 #include "../include/dbhandlers.h"
 #include "../include/db.h"
+#include "../include/dbpool.h"
 
 extern int errno;
 
@@ -105,10 +106,17 @@ char *ndo2db_db_rawtablenames[NDO2DB_MAX_DBTABLES]={
 	"hostescalation_contactgroups",
 	"serviceescalation_contactgroups",
 	"service_parentservices",
+	"objectconfighashes",
         };
 
 
 char *ndo2db_db_tablenames[NDO2DB_MAX_DBTABLES];
+static int ndo2db_db_users=0;
+
+/* in event loop mode all clients go through one connection */
+int ndo2db_db_shared=NDO_FALSE;
+int ndo2db_db_shared_connected=NDO_FALSE;
+static MYSQL ndo2db_db_shared_conn;
 
 /*
 #define DEBUG_NDO2DB_QUERIES 1
@@ -128,8 +136,8 @@ int ndo2db_db_init(ndo2db_idi *idi){
 	/* initialize db server type */
 	idi->dbinfo.server_type=ndo2db_db_settings.server_type;
 
-	/* initialize table names */
-	for(x=0;x<NDO2DB_MAX_DBTABLES;x++){
+	/* initialize table names - they are shared by every client in the process */
+	for(x=0;ndo2db_db_users==0 && x<NDO2DB_MAX_DBTABLES;x++){
 		if((ndo2db_db_tablenames[x]=(char *)malloc(strlen(ndo2db_db_rawtablenames[x])+((ndo2db_db_settings.dbprefix==NULL)?0:strlen(ndo2db_db_settings.dbprefix))+1))==NULL)
 			return NDO_ERROR;
 		sprintf(ndo2db_db_tablenames[x],"%s%s",(ndo2db_db_settings.dbprefix==NULL)?"":ndo2db_db_settings.dbprefix,ndo2db_db_rawtablenames[x]);
@@ -160,13 +168,26 @@ int ndo2db_db_init(ndo2db_idi *idi){
 	idi->dbinfo.max_contactnotificationmethods_age=ndo2db_db_settings.max_contactnotificationmethods_age;
 	idi->dbinfo.max_logentries_age=ndo2db_db_settings.max_logentries_age;
 	idi->dbinfo.max_acknowledgements_age=ndo2db_db_settings.max_acknowledgements_age;	
+	idi->dbinfo.incremental_config_sync=ndo2db_db_settings.incremental_config_sync;
+	idi->dbinfo.config_sync_active=NDO_FALSE;
+	idi->dbinfo.config_sync_cleared=NDO_FALSE;
+	idi->dbinfo.confighash_hashlist=NULL;
 	idi->dbinfo.last_table_trim_time=(time_t)0L;
 	idi->dbinfo.last_logentry_time=(time_t)0L;
 	idi->dbinfo.last_logentry_data=NULL;
 	idi->dbinfo.object_hashlist=NULL;
+	idi->dbinfo.objectkey_hashlist=NULL;
+	ndo2db_db_users++;
+
+	/* the shared connection is set up when the first client connects */
+	if(ndo2db_db_shared==NDO_TRUE && idi->dbinfo.pooled==NDO_FALSE){
+		idi->dbinfo.mysql_link=&ndo2db_db_shared_conn;
+		return NDO_OK;
+		}
+	idi->dbinfo.mysql_link=&idi->dbinfo.mysql_conn;
 
 	/* initialize db structures, etc. */
-	if(!mysql_init(&idi->dbinfo.mysql_conn)){
+	if(!mysql_init(idi->dbinfo.mysql_link)){
 		syslog(LOG_USER|LOG_INFO,"Error: mysql_init() failed\n");
 		return NDO_ERROR;
 	}
@@ -182,8 +203,10 @@ int ndo2db_db_deinit(ndo2db_idi *idi){
 	if(idi==NULL)
 		return NDO_ERROR;
 
-	/* free table names */
-	for(x=0;x<NDO2DB_MAX_DBTABLES;x++){
+	/* free table names once the last client is gone */
+	if(ndo2db_db_users>0)
+		ndo2db_db_users--;
+	for(x=0;ndo2db_db_users==0 && x<NDO2DB_MAX_DBTABLES;x++){
 		if(ndo2db_db_tablenames[x])
 			free(ndo2db_db_tablenames[x]);
 		ndo2db_db_tablenames[x]=NULL;
@@ -191,6 +214,7 @@ int ndo2db_db_deinit(ndo2db_idi *idi){
 
 	/* free cached object ids */
 	ndo2db_free_cached_object_ids(idi);
+	ndo2db_free_config_hashes(idi);
 
 	return NDO_OK;
         }
@@ -207,8 +231,21 @@ int ndo2db_db_connect(ndo2db_idi *idi){
 	if(idi->dbinfo.connected==NDO_TRUE)
 		return NDO_OK;
 
+	/* another client already opened the shared connection */
+	if(idi->dbinfo.mysql_link==&ndo2db_db_shared_conn){
+		if(ndo2db_db_shared_connected==NDO_TRUE){
+			idi->dbinfo.connected=NDO_TRUE;
+			return NDO_OK;
+			}
+		if(!mysql_init(&ndo2db_db_shared_conn)){
+			syslog(LOG_USER|LOG_INFO,"Error: mysql_init() failed\n");
+			idi->disconnect_client=NDO_TRUE;
+			return NDO_ERROR;
+			}
+		}
+
 	if (!mysql_real_connect(
-			&idi->dbinfo.mysql_conn,
+			idi->dbinfo.mysql_link,
 			ndo2db_db_settings.host,
 			ndo2db_db_settings.username,
 			ndo2db_db_settings.password,
@@ -217,12 +254,14 @@ int ndo2db_db_connect(ndo2db_idi *idi){
 			ndo2db_db_settings.socket,
 			CLIENT_REMEMBER_OPTIONS
 	)) {
-		mysql_close(&idi->dbinfo.mysql_conn);
-		syslog(LOG_USER|LOG_INFO,"Error: Could not connect to MySQL database: %s",mysql_error(&idi->dbinfo.mysql_conn));
+		mysql_close(idi->dbinfo.mysql_link);
+		syslog(LOG_USER|LOG_INFO,"Error: Could not connect to MySQL database: %s",mysql_error(idi->dbinfo.mysql_link));
 		result=NDO_ERROR;
 		idi->disconnect_client=NDO_TRUE;
 	} else {
 		idi->dbinfo.connected=NDO_TRUE;
+		if(idi->dbinfo.mysql_link==&ndo2db_db_shared_conn)
+			ndo2db_db_shared_connected=NDO_TRUE;
 		syslog(LOG_USER|LOG_DEBUG,"Successfully connected to MySQL database");
 	}
 
@@ -240,9 +279,28 @@ int ndo2db_db_disconnect(ndo2db_idi *idi){
 	if(idi->dbinfo.connected==NDO_FALSE)
 		return NDO_OK;
 
-	/* close the connection to the database server */
-	mysql_close(&idi->dbinfo.mysql_conn);
 	idi->dbinfo.connected=NDO_FALSE;
+
+	/* other clients may still be using the shared connection */
+	if(idi->dbinfo.mysql_link==&ndo2db_db_shared_conn)
+		return NDO_OK;
+
+	/* close the connection to the database server */
+	mysql_close(idi->dbinfo.mysql_link);
+	syslog(LOG_USER|LOG_DEBUG,"Successfully disconnected from MySQL database");
+
+	return NDO_OK;
+        }
+
+
+/* closes the connection shared by all clients in event loop mode */
+int ndo2db_db_close_shared(void){
+
+	if(ndo2db_db_shared_connected==NDO_FALSE)
+		return NDO_OK;
+
+	mysql_close(&ndo2db_db_shared_conn);
+	ndo2db_db_shared_connected=NDO_FALSE;
 	syslog(LOG_USER|LOG_DEBUG,"Successfully disconnected from MySQL database");
 
 	return NDO_OK;
@@ -265,7 +323,7 @@ int ndo2db_db_hello(ndo2db_idi *idi){
 	if(asprintf(&buf,"SELECT instance_id FROM %s WHERE instance_name='%s'",ndo2db_db_tablenames[NDO2DB_DBTABLE_INSTANCES],idi->instance_name)==-1)
 		buf=NULL;
 	if((result=ndo2db_db_query(idi,buf))==NDO_OK){
-		idi->dbinfo.mysql_result=mysql_store_result(&idi->dbinfo.mysql_conn);
+		idi->dbinfo.mysql_result=mysql_store_result(idi->dbinfo.mysql_link);
 		if((idi->dbinfo.mysql_row=mysql_fetch_row(idi->dbinfo.mysql_result))!=NULL){
 			ndo2db_convert_string_to_unsignedlong(idi->dbinfo.mysql_row[0],&idi->dbinfo.instance_id);
 			have_instance=NDO_TRUE;
@@ -280,7 +338,7 @@ int ndo2db_db_hello(ndo2db_idi *idi){
 		if(asprintf(&buf,"INSERT INTO %s SET instance_name='%s'",ndo2db_db_tablenames[NDO2DB_DBTABLE_INSTANCES],idi->instance_name)==-1)
 			buf=NULL;
 		if((result=ndo2db_db_query(idi,buf))==NDO_OK){
-			idi->dbinfo.instance_id=mysql_insert_id(&idi->dbinfo.mysql_conn);
+			idi->dbinfo.instance_id=mysql_insert_id(idi->dbinfo.mysql_link);
 		}
 		free(buf);
 	        }
@@ -300,7 +358,7 @@ int ndo2db_db_hello(ndo2db_idi *idi){
 		   )==-1)
 		buf=NULL;
 	if((result=ndo2db_db_query(idi,buf))==NDO_OK){
-		idi->dbinfo.conninfo_id=mysql_insert_id(&idi->dbinfo.mysql_conn);
+		idi->dbinfo.conninfo_id=mysql_insert_id(idi->dbinfo.mysql_link);
 	}
 	free(buf);
 	free(ts);
@@ -346,12 +404,31 @@ int ndo2db_db_hello(ndo2db_idi *idi){
         }
 
 
+/* logs events ndomod's rate limits and sampling have dropped since we last looked */
+static void ndo2db_db_log_events_shed(ndo2db_idi *idi){
+
+	if(idi->events_shed<=idi->events_shed_logged)
+		return;
+
+	syslog(LOG_USER|LOG_INFO,"Instance '%s' has shed %lu events to rate limits and sampling (%lu since the last checkin).",
+	       (idi->instance_name==NULL)?"default":idi->instance_name,idi->events_shed,idi->events_shed-idi->events_shed_logged);
+	idi->events_shed_logged=idi->events_shed;
+
+	return;
+        }
+
+
 /* pre-disconnect routines */
 int ndo2db_db_goodbye(ndo2db_idi *idi){
 	int result=NDO_OK;
 	char *buf=NULL;
 	char *ts=NULL;
 
+	/* whatever the writer threads still have came before the goodbye */
+	ndo2db_dbpool_drain();
+
+	ndo2db_db_log_events_shed(idi);
+
 	ts=ndo2db_db_timet_to_sql(idi,idi->data_end_time);
 
 	/* record last connection information */
@@ -378,6 +455,8 @@ int ndo2db_db_checkin(ndo2db_idi *idi){
 	int result=NDO_OK;
 	char *buf=NULL;
 
+	ndo2db_db_log_events_shed(idi);
+
 	/* record last connection information */
 	if(asprintf(&buf,"UPDATE %s SET last_checkin_time=NOW(), bytes_processed='%lu', lines_processed='%lu', entries_processed='%lu' WHERE conninfo_id='%lu'"
 		    ,ndo2db_db_tablenames[NDO2DB_DBTABLE_CONNINFO]
@@ -401,33 +480,15 @@ int ndo2db_db_checkin(ndo2db_idi *idi){
 /* MISC FUNCTIONS                                                           */
 /****************************************************************************/
 
-/* escape a string for a SQL statement */
-char *ndo2db_db_escape_string(ndo2db_idi *idi, char *buf){
-	register int x,y,z;
-	char *newbuf=NULL;
+/* escape a string for a SQL statement - allocated says whether the result has to be freed */
+char *ndo2db_db_escape_string(ndo2db_idi *idi, char *buf, int *allocated){
 
-	if(idi==NULL || buf==NULL)
-		return NULL;
-
-	z=strlen(buf);
+	*allocated=NDO_FALSE;
 
-	/* allocate space for the new string */
-	if((newbuf=(char *)malloc((z*2)+1))==NULL)
+	if(idi==NULL || buf==NULL)
 		return NULL;
 
-	/* escape characters */
-	for(x=0,y=0;x<z;x++){
-
-		if(buf[x]=='\'' || buf[x]=='\"' || buf[x]=='*' || buf[x]=='\\' || buf[x]=='$' || buf[x]=='?' || buf[x]=='.' || buf[x]=='^' || buf[x]=='+' || buf[x]=='[' || buf[x]==']' || buf[x]=='(' || buf[x]==')')
-			newbuf[y++]='\\';
-
-		newbuf[y++]=buf[x];
-	        }
-
-	/* terminate escape string */
-	newbuf [y]='\0';
-
-	return newbuf;
+	return ndo_sql_escape_buffer(buf,allocated);
         }
 
 
@@ -465,7 +526,8 @@ int ndo2db_db_query(ndo2db_idi *idi, char *buf){
 	if(idi->dbinfo.connected==NDO_FALSE){
 		if(ndo2db_db_connect(idi)==NDO_ERROR)
 			return NDO_ERROR;
-		ndo2db_db_hello(idi);
+		if(idi->dbinfo.pooled==NDO_FALSE)
+			ndo2db_db_hello(idi);
 	        }
 
 #ifdef DEBUG_NDO2DB_QUERIES
@@ -474,9 +536,9 @@ int ndo2db_db_query(ndo2db_idi *idi, char *buf){
 
 	ndo2db_log_debug_info(NDO2DB_DEBUGL_SQL,0,"%s\n",buf);
 
-	if (mysql_query(&idi->dbinfo.mysql_conn,buf)) {
+	if (mysql_query(idi->dbinfo.mysql_link,buf)) {
 		syslog(LOG_USER|LOG_INFO,"Error: mysql_query() failed for '%s'\n",buf);
-		syslog(LOG_USER|LOG_INFO,"mysql_error: '%s'\n", mysql_error(&idi->dbinfo.mysql_conn));
+		syslog(LOG_USER|LOG_INFO,"mysql_error: '%s'\n", mysql_error(idi->dbinfo.mysql_link));
 		result=NDO_ERROR;
 	}
 
@@ -509,11 +571,15 @@ int ndo2db_handle_db_error(ndo2db_idi *idi, int query_result){
 	if(idi->dbinfo.connected==NDO_FALSE)
 		return NDO_OK;
 
-	result=mysql_errno(&idi->dbinfo.mysql_conn);
+	result=mysql_errno(idi->dbinfo.mysql_link);
 	if(result==CR_SERVER_LOST || result==CR_SERVER_GONE_ERROR){
 		syslog(LOG_USER|LOG_INFO,"Error: Connection to MySQL database has been lost!\n");
 		ndo2db_db_disconnect(idi);
 		idi->disconnect_client=NDO_TRUE;
+
+		/* every client loses it, the event loop will drop them all */
+		if(idi->dbinfo.mysql_link==&ndo2db_db_shared_conn)
+			ndo2db_db_close_shared();
 	}
 
 	return NDO_OK;
@@ -562,7 +628,7 @@ int ndo2db_db_get_latest_data_time(ndo2db_idi *idi, char *table_name, char *fiel
 		buf=NULL;
 
 	if((result=ndo2db_db_query(idi,buf))==NDO_OK){
-		idi->dbinfo.mysql_result=mysql_store_result(&idi->dbinfo.mysql_conn);
+		idi->dbinfo.mysql_result=mysql_store_result(idi->dbinfo.mysql_link);
 		if((idi->dbinfo.mysql_row=mysql_fetch_row(idi->dbinfo.mysql_result))!=NULL){
 			ndo2db_convert_string_to_unsignedlong(idi->dbinfo.mysql_row[0],t);
 		}
@@ -55,6 +55,9 @@ extern int errno;
 
 extern char *ndo2db_db_tablenames[NDO2DB_MAX_DBTABLES];
 
+/* database writer threads can miss the same new object at once, and nothing in the objects table stops a second insert */
+static pthread_mutex_t ndo2db_object_insert_lock=PTHREAD_MUTEX_INITIALIZER;
+
 
 
 /****************************************************************************/
@@ -72,6 +75,7 @@ int ndo2db_get_object_id(ndo2db_idi *idi, int object_type, char *n1, char *n2, u
 	char *buf1=NULL;
 	char *buf2=NULL;
 	char *es[2];
+	int es_allocated[2]={NDO_FALSE};
 
 	/* make sure empty strings are set to null */
 	name1=n1;
@@ -99,7 +103,7 @@ int ndo2db_get_object_id(ndo2db_idi *idi, int object_type, char *n1, char *n2, u
 			buf1=NULL;
 	        }
 	else{
-		es[0]=ndo2db_db_escape_string(idi,name1);
+		es[0]=ndo2db_db_escape_string(idi,name1,&es_allocated[0]);
 		/* HINT: HB 10/27/2009
 		 * BINARY operator is just a MySQL special to provide case sensitive queries
 		 * Think about it in the future if not only MySQL is supported
@@ -114,7 +118,7 @@ int ndo2db_get_object_id(ndo2db_idi *idi, int object_type, char *n1, char *n2, u
 			buf2=NULL;
 	        }
 	else{
-		es[1]=ndo2db_db_escape_string(idi,name2);
+		es[1]=ndo2db_db_escape_string(idi,name2,&es_allocated[1]);
 		/* HINT: HB 10/27/2009
 		 * BINARY operator is just a MySQL special to provide case sensitive queries
 		 * Think about it in the future if not only MySQL is supported
@@ -132,7 +136,7 @@ int ndo2db_get_object_id(ndo2db_idi *idi, int object_type, char *n1, char *n2, u
 		   )==-1)
 		buf=NULL;
 	if((result=ndo2db_db_query(idi,buf))==NDO_OK){
-		idi->dbinfo.mysql_result=mysql_store_result(&idi->dbinfo.mysql_conn);
+		idi->dbinfo.mysql_result=mysql_store_result(idi->dbinfo.mysql_link);
 		if((idi->dbinfo.mysql_row=mysql_fetch_row(idi->dbinfo.mysql_result))!=NULL){
 			ndo2db_convert_string_to_unsignedlong(idi->dbinfo.mysql_row[0],object_id);
 			found_object=NDO_TRUE;
@@ -147,7 +151,8 @@ int ndo2db_get_object_id(ndo2db_idi *idi, int object_type, char *n1, char *n2, u
 	free(buf2);
 
 	for (x = 0; x < NAGIOS_SIZEOF_ARRAY(es); x++)
-		free(es[x]);
+		if(es_allocated[x]==NDO_TRUE)
+			free(es[x]);
 
 	if(found_object==NDO_FALSE)
 		result=NDO_ERROR;
@@ -165,6 +170,7 @@ int ndo2db_get_object_id_with_insert(ndo2db_idi *idi, int object_type, char *n1,
 	char *name1=NULL;
 	char *name2=NULL;
 	char *es[2];
+	int es_allocated[2]={NDO_FALSE};
 
 	/* make sure empty strings are set to null */
 	name1=n1;
@@ -184,15 +190,22 @@ int ndo2db_get_object_id_with_insert(ndo2db_idi *idi, int object_type, char *n1,
 	if((result=ndo2db_get_object_id(idi,object_type,name1,name2,object_id))==NDO_OK)
 		return NDO_OK;
 
+	/* look again once we have the lock, in case another writer just added it */
+	pthread_mutex_lock(&ndo2db_object_insert_lock);
+	if((result=ndo2db_get_object_id(idi,object_type,name1,name2,object_id))==NDO_OK){
+		pthread_mutex_unlock(&ndo2db_object_insert_lock);
+		return NDO_OK;
+		}
+
 	if(name1!=NULL){
-		es[0]=ndo2db_db_escape_string(idi,name1);
+		es[0]=ndo2db_db_escape_string(idi,name1,&es_allocated[0]);
 		if(asprintf(&buf1,", name1='%s'",es[0])==-1)
 			buf1=NULL;
 	        }
 	else
 		es[0]=NULL;
 	if(name2!=NULL){
-		es[1]=ndo2db_db_escape_string(idi,name2);
+		es[1]=ndo2db_db_escape_string(idi,name2,&es_allocated[1]);
 		if(asprintf(&buf2,", name2='%s'",es[1])==-1)
 			buf2=NULL;
 	        }
@@ -208,26 +221,43 @@ int ndo2db_get_object_id_with_insert(ndo2db_idi *idi, int object_type, char *n1,
 		   )==-1)
 		buf=NULL;
 	if((result=ndo2db_db_query(idi,buf))==NDO_OK){
-		*object_id=mysql_insert_id(&idi->dbinfo.mysql_conn);
+		*object_id=mysql_insert_id(idi->dbinfo.mysql_link);
 	}
 	free(buf);
 
 	/* cache object id for later lookups */
 	ndo2db_add_cached_object_id(idi,object_type,name1,name2,*object_id);
 
+	pthread_mutex_unlock(&ndo2db_object_insert_lock);
+
 	/* free memory */
 	free(buf1);
 	free(buf2);
 
         /* free memory */
 	for (x = 0; x < NAGIOS_SIZEOF_ARRAY(es); x++)
-		free(es[x]);
+		if(es_allocated[x]==NDO_TRUE)
+			free(es[x]);
 
 	return result;
         }
 
 
 
+/* looks up the object an event is about by the key ndomod sent with it, falling back to its names */
+int ndo2db_get_object_id_with_key(ndo2db_idi *idi, int object_type, char *n1, char *n2, unsigned long *object_id){
+	unsigned long long key=0L;
+
+	ndo2db_get_input_unsignedlonglong(idi,NDO_DATA_OBJECTKEY,&key);
+
+	if(key!=0L && ndo2db_get_cached_object_key(idi,key,object_type,n1,n2,object_id)==NDO_OK)
+		return NDO_OK;
+
+	/* a new object, a key collision or an ndomod that doesn't send keys - caching it adds its key */
+	return ndo2db_get_object_id_with_insert(idi,object_type,n1,n2,object_id);
+        }
+
+
 int ndo2db_get_cached_object_ids(ndo2db_idi *idi){
 	int result=NDO_OK;
 	unsigned long object_id=0L;
@@ -242,7 +272,7 @@ int ndo2db_get_cached_object_ids(ndo2db_idi *idi){
 		buf=NULL;
 
 	if((result=ndo2db_db_query(idi,buf))==NDO_OK){
-		idi->dbinfo.mysql_result=mysql_store_result(&idi->dbinfo.mysql_conn);
+		idi->dbinfo.mysql_result=mysql_store_result(idi->dbinfo.mysql_link);
 		if(NULL != idi->dbinfo.mysql_result) {
 			while((idi->dbinfo.mysql_row=mysql_fetch_row(idi->dbinfo.mysql_result))!=NULL){
 
@@ -254,7 +284,7 @@ int ndo2db_get_cached_object_ids(ndo2db_idi *idi){
 				}
 			mysql_free_result(idi->dbinfo.mysql_result);
 			}
-		else if(mysql_errno(&idi->dbinfo.mysql_conn) != 0) {
+		else if(mysql_errno(idi->dbinfo.mysql_link) != 0) {
 			syslog(LOG_USER|LOG_INFO,
 					"Error: mysql_store_result() failed for '%s'\n", buf);
 		}
@@ -378,11 +408,58 @@ int ndo2db_add_cached_object_id(ndo2db_idi *idi, int object_type, char *n1, char
 		idi->dbinfo.object_hashlist[hashslot]=new_object;
 	new_object->nexthash=temp_object;
 
+	/* hosts and services can also be found by the key ndomod sends for them */
+	if(object_type==NDO2DB_OBJECTTYPE_HOST || object_type==NDO2DB_OBJECTTYPE_SERVICE)
+		result=ndo2db_add_cached_object_key(idi,ndo_object_key(object_type,name1,name2),new_object);
+
 	return result;
         }
 
 
 
+int ndo2db_get_cached_object_key(ndo2db_idi *idi, unsigned long long key, int object_type, char *name1, char *name2, unsigned long *object_id){
+	ndo2db_dbobjectkey *temp_key=NULL;
+
+	if(idi->dbinfo.objectkey_hashlist==NULL)
+		return NDO_ERROR;
+
+	/* keys are hashes already, but two objects can share one - a hit only counts if the names match too */
+	for(temp_key=idi->dbinfo.objectkey_hashlist[key%NDO2DB_OBJECTKEY_HASHSLOTS];temp_key!=NULL;temp_key=temp_key->nexthash){
+		if(temp_key->key==key && temp_key->object->object_type==object_type && ndo2db_compare_object_hashdata(temp_key->object->name1,temp_key->object->name2,name1,name2)==0){
+			*object_id=temp_key->object->object_id;
+			return NDO_OK;
+			}
+		}
+
+	return NDO_ERROR;
+        }
+
+
+
+int ndo2db_add_cached_object_key(ndo2db_idi *idi, unsigned long long key, ndo2db_dbobject *object){
+	ndo2db_dbobjectkey *new_key=NULL;
+	int hashslot=0;
+
+	/* initialize hash list if necessary */
+	if(idi->dbinfo.objectkey_hashlist==NULL){
+		if((idi->dbinfo.objectkey_hashlist=(ndo2db_dbobjectkey **)calloc(NDO2DB_OBJECTKEY_HASHSLOTS,sizeof(ndo2db_dbobjectkey *)))==NULL)
+			return NDO_ERROR;
+	        }
+
+	if((new_key=(ndo2db_dbobjectkey *)malloc(sizeof(ndo2db_dbobjectkey)))==NULL)
+		return NDO_ERROR;
+	new_key->key=key;
+	new_key->object=object;
+
+	hashslot=key%NDO2DB_OBJECTKEY_HASHSLOTS;
+	new_key->nexthash=idi->dbinfo.objectkey_hashlist[hashslot];
+	idi->dbinfo.objectkey_hashlist[hashslot]=new_key;
+
+	return NDO_OK;
+        }
+
+
+
 int ndo2db_object_hashfunc(const char *name1,const char *name2,int hashslots){
 	unsigned int i,result;
 
@@ -436,6 +513,8 @@ int ndo2db_free_cached_object_ids(ndo2db_idi *idi){
 	int x=0;
 	ndo2db_dbobject *temp_object=NULL;
 	ndo2db_dbobject *next_object=NULL;
+	ndo2db_dbobjectkey *temp_key=NULL;
+	ndo2db_dbobjectkey *next_key=NULL;
 
 	if(idi==NULL)
 		return NDO_OK;
@@ -455,6 +534,19 @@ int ndo2db_free_cached_object_ids(ndo2db_idi *idi){
 		idi->dbinfo.object_hashlist=NULL;
 	        }
 
+	if(idi->dbinfo.objectkey_hashlist){
+
+		for(x=0;x<NDO2DB_OBJECTKEY_HASHSLOTS;x++){
+			for(temp_key=idi->dbinfo.objectkey_hashlist[x];temp_key!=NULL;temp_key=next_key){
+				next_key=temp_key->nexthash;
+				free(temp_key);
+			        }
+		        }
+
+		free(idi->dbinfo.objectkey_hashlist);
+		idi->dbinfo.objectkey_hashlist=NULL;
+	        }
+
 	return NDO_OK;
         }
 
@@ -500,6 +592,377 @@ int ndo2db_set_object_as_active(ndo2db_idi *idi, int object_type, unsigned long
 
 
 
+/****************************************************************************/
+/* INCREMENTAL CONFIG SYNC ROUTINES                                         */
+/****************************************************************************/
+
+/* where each kind of object definition is stored, and the tables hanging off it */
+typedef struct ndo2db_config_tables_struct{
+	int object_type;
+	int table;
+	char *id_column;
+	char *object_column;
+	int per_config_type;		/* the table's unique key includes config_type */
+	int children[3];		/* keyed by id_column, -1 if unused */
+        }ndo2db_config_tables;
+
+static ndo2db_config_tables ndo2db_config_table_list[]={
+	{NDO2DB_OBJECTTYPE_HOST,NDO2DB_DBTABLE_HOSTS,"host_id","host_object_id",NDO_TRUE,{NDO2DB_DBTABLE_HOSTPARENTHOSTS,NDO2DB_DBTABLE_HOSTCONTACTS,NDO2DB_DBTABLE_HOSTCONTACTGROUPS}},
+	{NDO2DB_OBJECTTYPE_SERVICE,NDO2DB_DBTABLE_SERVICES,"service_id","service_object_id",NDO_TRUE,{NDO2DB_DBTABLE_SERVICECONTACTS,NDO2DB_DBTABLE_SERVICECONTACTGROUPS,NDO2DB_DBTABLE_SERVICEPARENTSERVICES}},
+	{NDO2DB_OBJECTTYPE_HOSTGROUP,NDO2DB_DBTABLE_HOSTGROUPS,"hostgroup_id","hostgroup_object_id",NDO_FALSE,{NDO2DB_DBTABLE_HOSTGROUPMEMBERS,-1,-1}},
+	{NDO2DB_OBJECTTYPE_SERVICEGROUP,NDO2DB_DBTABLE_SERVICEGROUPS,"servicegroup_id","servicegroup_object_id",NDO_TRUE,{NDO2DB_DBTABLE_SERVICEGROUPMEMBERS,-1,-1}},
+	{NDO2DB_OBJECTTYPE_TIMEPERIOD,NDO2DB_DBTABLE_TIMEPERIODS,"timeperiod_id","timeperiod_object_id",NDO_TRUE,{NDO2DB_DBTABLE_TIMEPERIODTIMERANGES,-1,-1}},
+	{NDO2DB_OBJECTTYPE_CONTACT,NDO2DB_DBTABLE_CONTACTS,"contact_id","contact_object_id",NDO_TRUE,{NDO2DB_DBTABLE_CONTACTADDRESSES,NDO2DB_DBTABLE_CONTACTNOTIFICATIONCOMMANDS,-1}},
+	{NDO2DB_OBJECTTYPE_CONTACTGROUP,NDO2DB_DBTABLE_CONTACTGROUPS,"contactgroup_id","contactgroup_object_id",NDO_TRUE,{NDO2DB_DBTABLE_CONTACTGROUPMEMBERS,-1,-1}},
+	{NDO2DB_OBJECTTYPE_COMMAND,NDO2DB_DBTABLE_COMMANDS,"command_id","object_id",NDO_TRUE,{-1,-1,-1}},
+        };
+
+
+static ndo2db_confighash *ndo2db_find_config_hash(ndo2db_idi *idi, unsigned long object_id, int config_type){
+	ndo2db_confighash *temp_hash=NULL;
+
+	if(idi->dbinfo.confighash_hashlist==NULL)
+		return NULL;
+
+	for(temp_hash=idi->dbinfo.confighash_hashlist[object_id%NDO2DB_CONFIGHASH_HASHSLOTS];temp_hash!=NULL;temp_hash=temp_hash->nexthash){
+		if(temp_hash->object_id==object_id && temp_hash->config_type==config_type)
+			return temp_hash;
+		}
+
+	return NULL;
+        }
+
+
+static ndo2db_confighash *ndo2db_add_config_hash(ndo2db_idi *idi, unsigned long object_id, int object_type, int config_type, unsigned long long hash){
+	ndo2db_confighash *new_hash=NULL;
+	int hashslot=0;
+
+	if(idi->dbinfo.confighash_hashlist==NULL){
+		if((idi->dbinfo.confighash_hashlist=(ndo2db_confighash **)calloc(NDO2DB_CONFIGHASH_HASHSLOTS,sizeof(ndo2db_confighash *)))==NULL)
+			return NULL;
+	        }
+
+	if((new_hash=(ndo2db_confighash *)malloc(sizeof(ndo2db_confighash)))==NULL)
+		return NULL;
+	new_hash->object_id=object_id;
+	new_hash->object_type=object_type;
+	new_hash->config_type=config_type;
+	new_hash->hash=hash;
+	new_hash->seen=NDO_FALSE;
+	new_hash->dirty=NDO_FALSE;
+
+	hashslot=object_id%NDO2DB_CONFIGHASH_HASHSLOTS;
+	new_hash->nexthash=idi->dbinfo.confighash_hashlist[hashslot];
+	idi->dbinfo.confighash_hashlist[hashslot]=new_hash;
+
+	return new_hash;
+        }
+
+
+int ndo2db_free_config_hashes(ndo2db_idi *idi){
+	ndo2db_confighash *temp_hash=NULL;
+	ndo2db_confighash *next_hash=NULL;
+	int x=0;
+
+	if(idi==NULL || idi->dbinfo.confighash_hashlist==NULL)
+		return NDO_OK;
+
+	for(x=0;x<NDO2DB_CONFIGHASH_HASHSLOTS;x++){
+		for(temp_hash=idi->dbinfo.confighash_hashlist[x];temp_hash!=NULL;temp_hash=next_hash){
+			next_hash=temp_hash->nexthash;
+			free(temp_hash);
+		        }
+	        }
+
+	free(idi->dbinfo.confighash_hashlist);
+	idi->dbinfo.confighash_hashlist=NULL;
+
+	return NDO_OK;
+        }
+
+
+/* reads the hashes of the definitions we stored last time - returns the number of them, or -1 on error */
+static int ndo2db_read_config_hashes(ndo2db_idi *idi){
+	unsigned long object_id=0L;
+	int object_type=0;
+	int config_type=0;
+	unsigned long long hash=0L;
+	int loaded=0;
+	char *buf=NULL;
+
+	ndo2db_free_config_hashes(idi);
+
+	if(asprintf(&buf,"SELECT object_id, objecttype_id, config_type, config_hash FROM %s WHERE instance_id='%lu'"
+		    ,ndo2db_db_tablenames[NDO2DB_DBTABLE_OBJECTCONFIGHASHES]
+		    ,idi->dbinfo.instance_id
+		   )==-1)
+		buf=NULL;
+
+	if(ndo2db_db_query(idi,buf)!=NDO_OK){
+		free(buf);
+		return -1;
+	        }
+	free(buf);
+
+	if((idi->dbinfo.mysql_result=mysql_store_result(idi->dbinfo.mysql_link))==NULL)
+		return -1;
+
+	while((idi->dbinfo.mysql_row=mysql_fetch_row(idi->dbinfo.mysql_result))!=NULL){
+
+		ndo2db_convert_string_to_unsignedlong(idi->dbinfo.mysql_row[0],&object_id);
+		ndo2db_convert_string_to_int(idi->dbinfo.mysql_row[1],&object_type);
+		ndo2db_convert_string_to_int(idi->dbinfo.mysql_row[2],&config_type);
+		hash=strtoull(idi->dbinfo.mysql_row[3],NULL,10);
+
+		if(ndo2db_add_config_hash(idi,object_id,object_type,config_type,hash)==NULL){
+			loaded=-1;
+			break;
+			}
+		loaded++;
+		}
+
+	mysql_free_result(idi->dbinfo.mysql_result);
+	idi->dbinfo.mysql_result=NULL;
+
+	return loaded;
+        }
+
+
+/* decides at startup whether definitions can be synced incrementally - NDO_OK if so */
+int ndo2db_load_config_hashes(ndo2db_idi *idi){
+	int loaded=0;
+
+	idi->dbinfo.config_sync_active=NDO_FALSE;
+	idi->dbinfo.config_sync_cleared=NDO_FALSE;
+
+	if(idi->dbinfo.incremental_config_sync==NDO_FALSE || idi->config_hashes==NDO_FALSE){
+		ndo2db_free_config_hashes(idi);
+		return NDO_ERROR;
+	        }
+
+	if((loaded=ndo2db_read_config_hashes(idi))<0){
+		syslog(LOG_USER|LOG_INFO,"Warning: Could not read object config hashes, so all object definitions will be rewritten.  Does the database schema need upgrading?");
+		ndo2db_free_config_hashes(idi);
+		return NDO_ERROR;
+	        }
+
+	/* nothing to compare against, so it's quicker to start from empty tables */
+	if(loaded==0)
+		idi->dbinfo.config_sync_cleared=NDO_TRUE;
+
+	idi->dbinfo.config_sync_active=NDO_TRUE;
+
+	return NDO_OK;
+        }
+
+
+/* deletes an object's stored definition, along with its member rows and custom variables */
+int ndo2db_delete_object_config(ndo2db_idi *idi, int object_type, unsigned long object_id, int config_type){
+	ndo2db_config_tables *tables=NULL;
+	ndo2db_confighash *temp_hash=NULL;
+	char *where=NULL;
+	char *buf=NULL;
+	int result=NDO_OK;
+	int x=0;
+
+	for(x=0;x<(int)(sizeof(ndo2db_config_table_list)/sizeof(ndo2db_config_table_list[0]));x++){
+		if(ndo2db_config_table_list[x].object_type==object_type){
+			tables=&ndo2db_config_table_list[x];
+			break;
+			}
+		}
+	if(tables==NULL)
+		return NDO_ERROR;
+
+	if(tables->per_config_type==NDO_TRUE){
+		if(asprintf(&where,"instance_id='%lu' AND config_type='%d' AND %s='%lu'",idi->dbinfo.instance_id,config_type,tables->object_column,object_id)==-1)
+			where=NULL;
+		}
+	else{
+		if(asprintf(&where,"instance_id='%lu' AND %s='%lu'",idi->dbinfo.instance_id,tables->object_column,object_id)==-1)
+			where=NULL;
+
+		/* the definition of the other config type went too, so it has to be written again */
+		temp_hash=ndo2db_find_config_hash(idi,object_id,(config_type==NDO2DB_CONFIGTYPE_ORIGINAL)?NDO2DB_CONFIGTYPE_RETAINED:NDO2DB_CONFIGTYPE_ORIGINAL);
+		if(temp_hash!=NULL)
+			temp_hash->hash=0L;
+		}
+	if(where==NULL)
+		return NDO_ERROR;
+
+	for(x=0;x<3;x++){
+		if(tables->children[x]<0)
+			continue;
+		if(asprintf(&buf,"DELETE FROM %s WHERE %s IN (SELECT %s FROM %s WHERE %s)"
+			    ,ndo2db_db_tablenames[tables->children[x]]
+			    ,tables->id_column
+			    ,tables->id_column
+			    ,ndo2db_db_tablenames[tables->table]
+			    ,where
+			   )==-1)
+			buf=NULL;
+		if(ndo2db_db_query(idi,buf)!=NDO_OK)
+			result=NDO_ERROR;
+		free(buf);
+		}
+
+	if(asprintf(&buf,"DELETE FROM %s WHERE %s",ndo2db_db_tablenames[tables->table],where)==-1)
+		buf=NULL;
+	if(ndo2db_db_query(idi,buf)!=NDO_OK)
+		result=NDO_ERROR;
+	free(buf);
+	free(where);
+
+	if(asprintf(&buf,"DELETE FROM %s WHERE instance_id='%lu' AND object_id='%lu' AND config_type='%d'"
+		    ,ndo2db_db_tablenames[NDO2DB_DBTABLE_CUSTOMVARIABLES]
+		    ,idi->dbinfo.instance_id
+		    ,object_id
+		    ,config_type
+		   )==-1)
+		buf=NULL;
+	if(ndo2db_db_query(idi,buf)!=NDO_OK)
+		result=NDO_ERROR;
+	free(buf);
+
+	return result;
+        }
+
+
+/* returns NDO_TRUE if a definition is the same as the one we stored, otherwise clears the old one out so it can be written again */
+int ndo2db_config_unchanged(ndo2db_idi *idi, int object_type, char *n1, char *n2){
+	ndo2db_confighash *temp_hash=NULL;
+	unsigned long long hash=0L;
+	unsigned long object_id=0L;
+
+	if(idi->dbinfo.config_sync_active==NDO_FALSE)
+		return NDO_FALSE;
+
+	if(ndo2db_get_object_id_with_insert(idi,object_type,n1,n2,&object_id)!=NDO_OK)
+		return NDO_FALSE;
+
+	/* zero never matches, so definitions without a hash are always written */
+	ndo2db_get_input_unsignedlonglong(idi,NDO_DATA_CONFIGHASH,&hash);
+
+	temp_hash=ndo2db_find_config_hash(idi,object_id,idi->current_object_config_type);
+	if(temp_hash!=NULL && temp_hash->seen==NDO_FALSE && hash!=0L && temp_hash->hash==hash){
+		temp_hash->seen=NDO_TRUE;
+		return NDO_TRUE;
+	        }
+
+	/* new objects may still have rows if we went away before saving their hash */
+	if(temp_hash!=NULL || idi->dbinfo.config_sync_cleared==NDO_FALSE)
+		ndo2db_delete_object_config(idi,object_type,object_id,idi->current_object_config_type);
+
+	if(temp_hash==NULL)
+		temp_hash=ndo2db_add_config_hash(idi,object_id,object_type,idi->current_object_config_type,hash);
+	if(temp_hash!=NULL){
+		temp_hash->hash=hash;
+		temp_hash->seen=NDO_TRUE;
+		temp_hash->dirty=NDO_TRUE;
+		}
+
+	return NDO_FALSE;
+        }
+
+
+/* saves the hashes of definitions written during a config dump, and removes the definitions of objects that have gone */
+int ndo2db_save_config_hashes(ndo2db_idi *idi){
+	ndo2db_confighash *temp_hash=NULL;
+	ndo2db_confighash *last_hash=NULL;
+	ndo2db_confighash *next_hash=NULL;
+	ndo_dbuf dbuf;
+	char temp_buffer[256];
+	char *buf=NULL;
+	unsigned long removed=0L;
+	int batched=0;
+	int x=0;
+
+	if(idi->dbinfo.config_sync_active==NDO_FALSE || idi->dbinfo.confighash_hashlist==NULL)
+		return NDO_OK;
+
+	ndo_dbuf_init(&dbuf,4096);
+
+	for(x=0;x<NDO2DB_CONFIGHASH_HASHSLOTS;x++){
+		last_hash=NULL;
+		for(temp_hash=idi->dbinfo.confighash_hashlist[x];temp_hash!=NULL;temp_hash=next_hash){
+			next_hash=temp_hash->nexthash;
+
+			if(temp_hash->config_type!=idi->current_object_config_type){
+				last_hash=temp_hash;
+				continue;
+				}
+
+			/* the object wasn't in this dump, so it has been removed */
+			if(temp_hash->seen==NDO_FALSE){
+
+				ndo2db_delete_object_config(idi,temp_hash->object_type,temp_hash->object_id,temp_hash->config_type);
+
+				if(asprintf(&buf,"DELETE FROM %s WHERE instance_id='%lu' AND object_id='%lu' AND config_type='%d'"
+					    ,ndo2db_db_tablenames[NDO2DB_DBTABLE_OBJECTCONFIGHASHES]
+					    ,idi->dbinfo.instance_id
+					    ,temp_hash->object_id
+					    ,temp_hash->config_type
+					   )==-1)
+					buf=NULL;
+				ndo2db_db_query(idi,buf);
+				free(buf);
+
+				if(asprintf(&buf,"UPDATE %s SET is_active='0' WHERE instance_id='%lu' AND object_id='%lu'"
+					    ,ndo2db_db_tablenames[NDO2DB_DBTABLE_OBJECTS]
+					    ,idi->dbinfo.instance_id
+					    ,temp_hash->object_id
+					   )==-1)
+					buf=NULL;
+				ndo2db_db_query(idi,buf);
+				free(buf);
+
+				if(last_hash==NULL)
+					idi->dbinfo.confighash_hashlist[x]=next_hash;
+				else
+					last_hash->nexthash=next_hash;
+				free(temp_hash);
+				removed++;
+				continue;
+				}
+
+			last_hash=temp_hash;
+			temp_hash->seen=NDO_FALSE;
+			if(temp_hash->dirty==NDO_FALSE)
+				continue;
+			temp_hash->dirty=NDO_FALSE;
+
+			if(batched==0){
+				snprintf(temp_buffer,sizeof(temp_buffer),"INSERT INTO %s (instance_id, object_id, objecttype_id, config_type, config_hash) VALUES ",ndo2db_db_tablenames[NDO2DB_DBTABLE_OBJECTCONFIGHASHES]);
+				ndo_dbuf_strcat(&dbuf,temp_buffer);
+				}
+			else
+				ndo_dbuf_addchar(&dbuf,',');
+			snprintf(temp_buffer,sizeof(temp_buffer),"('%lu','%lu','%d','%d','%llu')",idi->dbinfo.instance_id,temp_hash->object_id,temp_hash->object_type,temp_hash->config_type,temp_hash->hash);
+			ndo_dbuf_strcat(&dbuf,temp_buffer);
+
+			if(++batched>=NDO2DB_CONFIGHASH_BATCH){
+				ndo_dbuf_strcat(&dbuf," ON DUPLICATE KEY UPDATE config_hash=VALUES(config_hash)");
+				ndo2db_db_query(idi,dbuf.buf);
+				ndo_dbuf_reset(&dbuf);
+				batched=0;
+				}
+			}
+		}
+
+	if(batched>0){
+		ndo_dbuf_strcat(&dbuf," ON DUPLICATE KEY UPDATE config_hash=VALUES(config_hash)");
+		ndo2db_db_query(idi,dbuf.buf);
+		}
+	ndo_dbuf_free(&dbuf);
+
+	if(removed>0L)
+		syslog(LOG_USER|LOG_INFO,"Removed the definitions of %lu objects no longer in the config.",removed);
+
+	return NDO_OK;
+        }
+
+
+
 /****************************************************************************/
 /* ARCHIVED LOG DATA HANDLER                                                */
 /****************************************************************************/
@@ -508,6 +971,7 @@ int ndo2db_handle_logentry(ndo2db_idi *idi){
 	char *ptr=NULL;
 	char *buf=NULL;
 	char *es[1];
+	int es_allocated[1]={NDO_FALSE};
 	time_t etime=0L;
 	char *ts[1];
 	unsigned long type=0L;
@@ -527,7 +991,7 @@ int ndo2db_handle_logentry(ndo2db_idi *idi){
 	ts[0]=ndo2db_db_timet_to_sql(idi,etime);
 	if((ptr=strtok(NULL,"\x0"))==NULL)
 		return NDO_ERROR;
-	es[0]=ndo2db_db_escape_string(idi,(ptr+1));
+	es[0]=ndo2db_db_escape_string(idi,(ptr+1),&es_allocated[0]);
 
 	/* strip newline chars from end */
 	len=strlen(es[0]);
@@ -550,7 +1014,7 @@ int ndo2db_handle_logentry(ndo2db_idi *idi){
 		   )==-1)
 		buf=NULL;
 	if((result=ndo2db_db_query(idi,buf))==NDO_OK){
-		idi->dbinfo.mysql_result=mysql_store_result(&idi->dbinfo.mysql_conn);
+		idi->dbinfo.mysql_result=mysql_store_result(idi->dbinfo.mysql_link);
 		if((idi->dbinfo.mysql_row=mysql_fetch_row(idi->dbinfo.mysql_result))!=NULL)
 			duplicate_record=NDO_TRUE;
 		mysql_free_result(idi->dbinfo.mysql_result);
@@ -592,7 +1056,8 @@ int ndo2db_handle_logentry(ndo2db_idi *idi){
 	for (x = 0; x < NAGIOS_SIZEOF_ARRAY(ts); x++)
 		free(ts[x]);
 	for (x = 0; x < NAGIOS_SIZEOF_ARRAY(es); x++)
-		free(es[x]);
+		if(es_allocated[x]==NDO_TRUE)
+			free(es[x]);
 
 	/* TODO - further processing of log entry to expand archived data... */
 
@@ -613,6 +1078,7 @@ int ndo2db_handle_processdata(ndo2db_idi *idi){
 	int result=NDO_OK;
 	char *ts[1];
 	char *es[3];
+	int es_allocated[3]={NDO_FALSE};
 	int x=0;
 	char *buf=NULL;
 
@@ -623,13 +1089,13 @@ int ndo2db_handle_processdata(ndo2db_idi *idi){
 	result=ndo2db_convert_standard_data_elements(idi,&type,&flags,&attr,&tstamp);
 
 	/* convert vars */
-	result=ndo2db_convert_string_to_unsignedlong(idi->buffered_input[NDO_DATA_PROCESSID],&process_id);
+	result=ndo2db_get_input_unsignedlong(idi,NDO_DATA_PROCESSID,&process_id);
 
 	ts[0]=ndo2db_db_timet_to_sql(idi,tstamp.tv_sec);
 
-	es[0]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_PROGRAMNAME]);
-	es[1]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_PROGRAMVERSION]);
-	es[2]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_PROGRAMDATE]);
+	es[0]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_PROGRAMNAME],&es_allocated[0]);
+	es[1]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_PROGRAMVERSION],&es_allocated[1]);
+	es[2]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_PROGRAMDATE],&es_allocated[2]);
 
 	/* save entry to db */
 	if(asprintf(&buf,"INSERT INTO %s SET instance_id='%lu', event_type='%d', event_time=%s, event_time_usec='%lu', process_id='%lu', program_name='%s', program_version='%s', program_date='%s'"
@@ -663,43 +1129,50 @@ int ndo2db_handle_processdata(ndo2db_idi *idi){
 		ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_RUNTIMEVARIABLES]);
 		ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_CUSTOMVARIABLESTATUS]);
 
+		/* see whether object definitions can be kept and only rewritten when they change */
+		ndo2db_load_config_hashes(idi);
+
 		/* clear config data */
 		ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_CONFIGFILES]);
 		ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_CONFIGFILEVARIABLES]);
-		ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_CUSTOMVARIABLES]);
-		ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_COMMANDS]);
-		ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_TIMEPERIODS]);
-		ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_TIMEPERIODTIMERANGES]);
-		ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_CONTACTGROUPS]);
-		ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_CONTACTGROUPMEMBERS]);
-		ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_HOSTGROUPS]);
-		ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_HOSTGROUPMEMBERS]);
-		ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_SERVICEGROUPS]);
-		ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_SERVICEGROUPMEMBERS]);
 		ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_HOSTESCALATIONS]);
 		ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_HOSTESCALATIONCONTACTS]);
+		ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_HOSTESCALATIONCONTACTGROUPS]);
 		ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_SERVICEESCALATIONS]);
 		ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_SERVICEESCALATIONCONTACTS]);
+		ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_SERVICEESCALATIONCONTACTGROUPS]);
 		ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_HOSTDEPENDENCIES]);
 		ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_SERVICEDEPENDENCIES]);
-		ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_CONTACTS]);
-		ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_CONTACTADDRESSES]);
-		ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_CONTACTNOTIFICATIONCOMMANDS]);
-		ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_HOSTS]);
-		ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_HOSTPARENTHOSTS]);
-		ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_HOSTCONTACTS]);
-		ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_SERVICES]);
+
+		if(idi->dbinfo.config_sync_active==NDO_FALSE || idi->dbinfo.config_sync_cleared==NDO_TRUE){
+			ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_CUSTOMVARIABLES]);
+			ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_COMMANDS]);
+			ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_TIMEPERIODS]);
+			ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_TIMEPERIODTIMERANGES]);
+			ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_CONTACTGROUPS]);
+			ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_CONTACTGROUPMEMBERS]);
+			ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_HOSTGROUPS]);
+			ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_HOSTGROUPMEMBERS]);
+			ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_SERVICEGROUPS]);
+			ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_SERVICEGROUPMEMBERS]);
+			ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_CONTACTS]);
+			ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_CONTACTADDRESSES]);
+			ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_CONTACTNOTIFICATIONCOMMANDS]);
+			ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_HOSTS]);
+			ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_HOSTPARENTHOSTS]);
+			ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_HOSTCONTACTS]);
+			ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_HOSTCONTACTGROUPS]);
+			ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_SERVICES]);
 #ifdef BUILD_NAGIOS_4X
-		ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_SERVICEPARENTSERVICES]);
+			ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_SERVICEPARENTSERVICES]);
 #endif
-		ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_SERVICECONTACTS]);
-		ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_SERVICECONTACTGROUPS]);
-		ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_HOSTCONTACTGROUPS]);
-		ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_HOSTESCALATIONCONTACTGROUPS]);
-		ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_SERVICEESCALATIONCONTACTGROUPS]);
+			ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_SERVICECONTACTS]);
+			ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_SERVICECONTACTGROUPS]);
+			ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_OBJECTCONFIGHASHES]);
 
-		/* flag all objects as being inactive */
-		ndo2db_set_all_objects_as_inactive(idi);
+			/* flag all objects as being inactive */
+			ndo2db_set_all_objects_as_inactive(idi);
+		        }
 
 #ifdef BAD_IDEA
 		/* record a fake log entry to indicate that Nagios is starting - this normally occurs during the module's "blackout period" */
@@ -734,7 +1207,8 @@ int ndo2db_handle_processdata(ndo2db_idi *idi){
 	for (x = 0; x < NAGIOS_SIZEOF_ARRAY(ts); x++)
 		free(ts[x]);
 	for (x = 0; x < NAGIOS_SIZEOF_ARRAY(es); x++)
-		free(es[x]);
+		if(es_allocated[x]==NDO_TRUE)
+			free(es[x]);
 
 	return NDO_OK;
         }
@@ -760,9 +1234,9 @@ int ndo2db_handle_timedeventdata(ndo2db_idi *idi){
 	result=ndo2db_convert_standard_data_elements(idi,&type,&flags,&attr,&tstamp);
 
 	/* convert vars */
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_EVENTTYPE],&event_type);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_RECURRING],&recurring_event);
-	result=ndo2db_convert_string_to_unsignedlong(idi->buffered_input[NDO_DATA_RUNTIME],&run_time);
+	result=ndo2db_get_input_int(idi,NDO_DATA_EVENTTYPE,&event_type);
+	result=ndo2db_get_input_int(idi,NDO_DATA_RECURRING,&recurring_event);
+	result=ndo2db_get_input_unsignedlong(idi,NDO_DATA_RUNTIME,&run_time);
 
 	/* skip sleep events.... */
 	if(type==NEBTYPE_TIMEDEVENT_SLEEP){
@@ -944,6 +1418,7 @@ int ndo2db_handle_logdata(ndo2db_idi *idi){
 	int result=NDO_OK;
 	char *ts[2];
 	char *es[1];
+	int es_allocated[1]={NDO_FALSE};
 	char *buf=NULL;
 	int len=0;
 	int x=0;
@@ -955,13 +1430,13 @@ int ndo2db_handle_logdata(ndo2db_idi *idi){
 	result=ndo2db_convert_standard_data_elements(idi,&type,&flags,&attr,&tstamp);
 
 	/* convert data */
-	result=ndo2db_convert_string_to_unsignedlong(idi->buffered_input[NDO_DATA_LOGENTRYTYPE],&letype);
-	result=ndo2db_convert_string_to_unsignedlong(idi->buffered_input[NDO_DATA_LOGENTRYTIME],(unsigned long *)&etime);
+	result=ndo2db_get_input_unsignedlong(idi,NDO_DATA_LOGENTRYTYPE,&letype);
+	result=ndo2db_get_input_unsignedlong(idi,NDO_DATA_LOGENTRYTIME,(unsigned long *)&etime);
 
 	ts[0]=ndo2db_db_timet_to_sql(idi,tstamp.tv_sec);
 	ts[1]=ndo2db_db_timet_to_sql(idi,etime);
 
-	es[0]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_LOGENTRY]);
+	es[0]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_LOGENTRY],&es_allocated[0]);
 
 	/* strip newline chars from end */
 	len=strlen(es[0]);
@@ -990,7 +1465,8 @@ int ndo2db_handle_logdata(ndo2db_idi *idi){
 	for (x = 0; x < NAGIOS_SIZEOF_ARRAY(ts); x++)
 		free(ts[x]);
 	for (x = 0; x < NAGIOS_SIZEOF_ARRAY(es); x++)
-		free(es[x]);
+		if(es_allocated[x]==NDO_TRUE)
+			free(es[x]);
 
 	return NDO_OK;
         }
@@ -1008,6 +1484,7 @@ int ndo2db_handle_systemcommanddata(ndo2db_idi *idi){
 	int return_code=0;
 	char *ts[2];
 	char *es[3];
+	int es_allocated[3]={NDO_FALSE};
 	char *buf=NULL;
 	char *buf1=NULL;
 	int result=NDO_OK;
@@ -1019,16 +1496,16 @@ int ndo2db_handle_systemcommanddata(ndo2db_idi *idi){
 	result=ndo2db_convert_standard_data_elements(idi,&type,&flags,&attr,&tstamp);
 
 	/* covert vars */
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_TIMEOUT],&timeout);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_EARLYTIMEOUT],&early_timeout);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_RETURNCODE],&return_code);
-	result=ndo2db_convert_string_to_double(idi->buffered_input[NDO_DATA_EXECUTIONTIME],&execution_time);
-	result=ndo2db_convert_string_to_timeval(idi->buffered_input[NDO_DATA_STARTTIME],&start_time);
-	result=ndo2db_convert_string_to_timeval(idi->buffered_input[NDO_DATA_ENDTIME],&end_time);
+	result=ndo2db_get_input_int(idi,NDO_DATA_TIMEOUT,&timeout);
+	result=ndo2db_get_input_int(idi,NDO_DATA_EARLYTIMEOUT,&early_timeout);
+	result=ndo2db_get_input_int(idi,NDO_DATA_RETURNCODE,&return_code);
+	result=ndo2db_get_input_double(idi,NDO_DATA_EXECUTIONTIME,&execution_time);
+	result=ndo2db_get_input_timeval(idi,NDO_DATA_STARTTIME,&start_time);
+	result=ndo2db_get_input_timeval(idi,NDO_DATA_ENDTIME,&end_time);
 
-	es[0]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_COMMANDLINE]);
-	es[1]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_OUTPUT]);
-	es[2]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_LONGOUTPUT]);
+	es[0]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_COMMANDLINE],&es_allocated[0]);
+	es[1]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_OUTPUT],&es_allocated[1]);
+	es[2]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_LONGOUTPUT],&es_allocated[2]);
 
 	ts[0]=ndo2db_db_timet_to_sql(idi,start_time.tv_sec);
 	ts[1]=ndo2db_db_timet_to_sql(idi,end_time.tv_sec);
@@ -1065,7 +1542,8 @@ int ndo2db_handle_systemcommanddata(ndo2db_idi *idi){
 	for (x = 0; x < NAGIOS_SIZEOF_ARRAY(ts); x++)
 		free(ts[x]);
 	for (x = 0; x < NAGIOS_SIZEOF_ARRAY(es); x++)
-		free(es[x]);
+		if(es_allocated[x]==NDO_TRUE)
+			free(es[x]);
 
 	return NDO_OK;
         }
@@ -1076,6 +1554,7 @@ int ndo2db_handle_eventhandlerdata(ndo2db_idi *idi){
 	struct timeval tstamp;
 	char *ts[2];
 	char *es[4];
+	int es_allocated[4]={NDO_FALSE};
 	int x=0;
 	int eventhandler_type=0;
 	int state=0;
@@ -1099,29 +1578,29 @@ int ndo2db_handle_eventhandlerdata(ndo2db_idi *idi){
 	result=ndo2db_convert_standard_data_elements(idi,&type,&flags,&attr,&tstamp);
 
 	/* covert vars */
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_EVENTHANDLERTYPE],&eventhandler_type);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_STATE],&state);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_STATETYPE],&state_type);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_TIMEOUT],&timeout);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_EARLYTIMEOUT],&early_timeout);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_RETURNCODE],&return_code);
-	result=ndo2db_convert_string_to_double(idi->buffered_input[NDO_DATA_EXECUTIONTIME],&execution_time);
-	result=ndo2db_convert_string_to_timeval(idi->buffered_input[NDO_DATA_STARTTIME],&start_time);
-	result=ndo2db_convert_string_to_timeval(idi->buffered_input[NDO_DATA_ENDTIME],&end_time);
-
-	es[0]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_COMMANDARGS]);
-	es[1]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_COMMANDLINE]);
-	es[2]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_OUTPUT]);
-	es[3]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_LONGOUTPUT]);
+	result=ndo2db_get_input_int(idi,NDO_DATA_EVENTHANDLERTYPE,&eventhandler_type);
+	result=ndo2db_get_input_int(idi,NDO_DATA_STATE,&state);
+	result=ndo2db_get_input_int(idi,NDO_DATA_STATETYPE,&state_type);
+	result=ndo2db_get_input_int(idi,NDO_DATA_TIMEOUT,&timeout);
+	result=ndo2db_get_input_int(idi,NDO_DATA_EARLYTIMEOUT,&early_timeout);
+	result=ndo2db_get_input_int(idi,NDO_DATA_RETURNCODE,&return_code);
+	result=ndo2db_get_input_double(idi,NDO_DATA_EXECUTIONTIME,&execution_time);
+	result=ndo2db_get_input_timeval(idi,NDO_DATA_STARTTIME,&start_time);
+	result=ndo2db_get_input_timeval(idi,NDO_DATA_ENDTIME,&end_time);
+
+	es[0]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_COMMANDARGS],&es_allocated[0]);
+	es[1]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_COMMANDLINE],&es_allocated[1]);
+	es[2]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_OUTPUT],&es_allocated[2]);
+	es[3]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_LONGOUTPUT],&es_allocated[3]);
 
 	ts[0]=ndo2db_db_timet_to_sql(idi,start_time.tv_sec);
 	ts[1]=ndo2db_db_timet_to_sql(idi,end_time.tv_sec);
 
 	/* get the object id */
 	if(eventhandler_type==SERVICE_EVENTHANDLER || eventhandler_type==GLOBAL_SERVICE_EVENTHANDLER)
-		result=ndo2db_get_object_id_with_insert(idi,NDO2DB_OBJECTTYPE_SERVICE,idi->buffered_input[NDO_DATA_HOST],idi->buffered_input[NDO_DATA_SERVICE],&object_id);
+		result=ndo2db_get_object_id_with_key(idi,NDO2DB_OBJECTTYPE_SERVICE,idi->buffered_input[NDO_DATA_HOST],idi->buffered_input[NDO_DATA_SERVICE],&object_id);
 	else
-		result=ndo2db_get_object_id_with_insert(idi,NDO2DB_OBJECTTYPE_HOST,idi->buffered_input[NDO_DATA_HOST],NULL,&object_id);
+		result=ndo2db_get_object_id_with_key(idi,NDO2DB_OBJECTTYPE_HOST,idi->buffered_input[NDO_DATA_HOST],NULL,&object_id);
 
 	/* get the command id */
 	result=ndo2db_get_object_id_with_insert(idi,NDO2DB_OBJECTTYPE_COMMAND,idi->buffered_input[NDO_DATA_COMMANDNAME],NULL,&command_id);
@@ -1164,7 +1643,8 @@ int ndo2db_handle_eventhandlerdata(ndo2db_idi *idi){
 	for (x = 0; x < NAGIOS_SIZEOF_ARRAY(ts); x++)
 		free(ts[x]);
 	for (x = 0; x < NAGIOS_SIZEOF_ARRAY(es); x++)
-		free(es[x]);
+		if(es_allocated[x]==NDO_TRUE)
+			free(es[x]);
 
 	return NDO_OK;
         }
@@ -1184,6 +1664,7 @@ int ndo2db_handle_notificationdata(ndo2db_idi *idi){
 	int result=NDO_OK;
 	char *ts[2];
 	char *es[2];
+	int es_allocated[2]={NDO_FALSE};
 	int x=0;
 	char *buf=NULL;
 	char *buf1=NULL;
@@ -1195,26 +1676,26 @@ int ndo2db_handle_notificationdata(ndo2db_idi *idi){
 	result=ndo2db_convert_standard_data_elements(idi,&type,&flags,&attr,&tstamp);
 
 	/* convert vars */
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_NOTIFICATIONTYPE],&notification_type);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_NOTIFICATIONREASON],&notification_reason);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_STATE],&state);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_ESCALATED],&escalated);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_CONTACTSNOTIFIED],&contacts_notified);
+	result=ndo2db_get_input_int(idi,NDO_DATA_NOTIFICATIONTYPE,&notification_type);
+	result=ndo2db_get_input_int(idi,NDO_DATA_NOTIFICATIONREASON,&notification_reason);
+	result=ndo2db_get_input_int(idi,NDO_DATA_STATE,&state);
+	result=ndo2db_get_input_int(idi,NDO_DATA_ESCALATED,&escalated);
+	result=ndo2db_get_input_int(idi,NDO_DATA_CONTACTSNOTIFIED,&contacts_notified);
 
-	result=ndo2db_convert_string_to_timeval(idi->buffered_input[NDO_DATA_STARTTIME],&start_time);
-	result=ndo2db_convert_string_to_timeval(idi->buffered_input[NDO_DATA_ENDTIME],&end_time);
+	result=ndo2db_get_input_timeval(idi,NDO_DATA_STARTTIME,&start_time);
+	result=ndo2db_get_input_timeval(idi,NDO_DATA_ENDTIME,&end_time);
 
-	es[0]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_OUTPUT]);
-	es[1]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_OUTPUT]);
+	es[0]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_OUTPUT],&es_allocated[0]);
+	es[1]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_OUTPUT],&es_allocated[1]);
 
 	ts[0]=ndo2db_db_timet_to_sql(idi,start_time.tv_sec);
 	ts[1]=ndo2db_db_timet_to_sql(idi,end_time.tv_sec);
 
 	/* get the object id */
 	if(notification_type==SERVICE_NOTIFICATION)
-		result=ndo2db_get_object_id_with_insert(idi,NDO2DB_OBJECTTYPE_SERVICE,idi->buffered_input[NDO_DATA_HOST],idi->buffered_input[NDO_DATA_SERVICE],&object_id);
+		result=ndo2db_get_object_id_with_key(idi,NDO2DB_OBJECTTYPE_SERVICE,idi->buffered_input[NDO_DATA_HOST],idi->buffered_input[NDO_DATA_SERVICE],&object_id);
 	if(notification_type==HOST_NOTIFICATION)
-		result=ndo2db_get_object_id_with_insert(idi,NDO2DB_OBJECTTYPE_HOST,idi->buffered_input[NDO_DATA_HOST],NULL,&object_id);
+		result=ndo2db_get_object_id_with_key(idi,NDO2DB_OBJECTTYPE_HOST,idi->buffered_input[NDO_DATA_HOST],NULL,&object_id);
 
 	/* save entry to db */
 	if(asprintf(&buf,"instance_id='%lu', notification_type='%d', notification_reason='%d', start_time=%s, start_time_usec='%lu', end_time=%s, end_time_usec='%lu', object_id='%lu', state='%d', output='%s', long_output='%s', escalated='%d', contacts_notified='%d'"
@@ -1248,7 +1729,7 @@ int ndo2db_handle_notificationdata(ndo2db_idi *idi){
 	if(type==NEBTYPE_NOTIFICATION_START)
 		idi->dbinfo.last_notification_id=0L;
 	if(result==NDO_OK && type==NEBTYPE_NOTIFICATION_START){
-		idi->dbinfo.last_notification_id=mysql_insert_id(&idi->dbinfo.mysql_conn);
+		idi->dbinfo.last_notification_id=mysql_insert_id(idi->dbinfo.mysql_link);
 	}
 	free(buf);
 	free(buf1);
@@ -1257,7 +1738,8 @@ int ndo2db_handle_notificationdata(ndo2db_idi *idi){
 	for (x = 0; x < NAGIOS_SIZEOF_ARRAY(ts); x++)
 		free(ts[x]);
 	for (x = 0; x < NAGIOS_SIZEOF_ARRAY(es); x++)
-		free(es[x]);
+		if(es_allocated[x]==NDO_TRUE)
+			free(es[x]);
 
 	return NDO_OK;
         }
@@ -1283,8 +1765,8 @@ int ndo2db_handle_contactnotificationdata(ndo2db_idi *idi){
 
 	/* convert vars */
 
-	result=ndo2db_convert_string_to_timeval(idi->buffered_input[NDO_DATA_STARTTIME],&start_time);
-	result=ndo2db_convert_string_to_timeval(idi->buffered_input[NDO_DATA_ENDTIME],&end_time);
+	result=ndo2db_get_input_timeval(idi,NDO_DATA_STARTTIME,&start_time);
+	result=ndo2db_get_input_timeval(idi,NDO_DATA_ENDTIME,&end_time);
 
 	ts[0]=ndo2db_db_timet_to_sql(idi,start_time.tv_sec);
 	ts[1]=ndo2db_db_timet_to_sql(idi,end_time.tv_sec);
@@ -1318,7 +1800,7 @@ int ndo2db_handle_contactnotificationdata(ndo2db_idi *idi){
 	if(type==NEBTYPE_CONTACTNOTIFICATION_START)
 		idi->dbinfo.last_contact_notification_id=0L;
 	if(result==NDO_OK && type==NEBTYPE_CONTACTNOTIFICATION_START){
-		idi->dbinfo.last_contact_notification_id=mysql_insert_id(&idi->dbinfo.mysql_conn);
+		idi->dbinfo.last_contact_notification_id=mysql_insert_id(idi->dbinfo.mysql_link);
 	}
 	free(buf);
 	free(buf1);
@@ -1340,6 +1822,7 @@ int ndo2db_handle_contactnotificationmethoddata(ndo2db_idi *idi){
 	int result=NDO_OK;
 	char *ts[2];
 	char *es[1];
+	int es_allocated[1]={NDO_FALSE};
 	int x=0;
 	char *buf=NULL;
 	char *buf1=NULL;
@@ -1352,10 +1835,10 @@ int ndo2db_handle_contactnotificationmethoddata(ndo2db_idi *idi){
 
 	/* convert vars */
 
-	result=ndo2db_convert_string_to_timeval(idi->buffered_input[NDO_DATA_STARTTIME],&start_time);
-	result=ndo2db_convert_string_to_timeval(idi->buffered_input[NDO_DATA_ENDTIME],&end_time);
+	result=ndo2db_get_input_timeval(idi,NDO_DATA_STARTTIME,&start_time);
+	result=ndo2db_get_input_timeval(idi,NDO_DATA_ENDTIME,&end_time);
 
-	es[0]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_COMMANDARGS]);
+	es[0]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_COMMANDARGS],&es_allocated[0]);
 
 	ts[0]=ndo2db_db_timet_to_sql(idi,start_time.tv_sec);
 	ts[1]=ndo2db_db_timet_to_sql(idi,end_time.tv_sec);
@@ -1393,7 +1876,8 @@ int ndo2db_handle_contactnotificationmethoddata(ndo2db_idi *idi){
 	for (x = 0; x < NAGIOS_SIZEOF_ARRAY(ts); x++)
 		free(ts[x]);
 	for (x = 0; x < NAGIOS_SIZEOF_ARRAY(es); x++)
-		free(es[x]);
+		if(es_allocated[x]==NDO_TRUE)
+			free(es[x]);
 
 	return NDO_OK;
         }
@@ -1404,6 +1888,7 @@ int ndo2db_handle_servicecheckdata(ndo2db_idi *idi){
 	struct timeval tstamp;
 	char *ts[2];
 	char *es[5];
+	int es_allocated[5]={NDO_FALSE};
 	int check_type=0;
 	struct timeval start_time;
 	struct timeval end_time;
@@ -1440,30 +1925,30 @@ int ndo2db_handle_servicecheckdata(ndo2db_idi *idi){
 #endif
 
 	/* covert vars */
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_CHECKTYPE],&check_type);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_CURRENTCHECKATTEMPT],&current_check_attempt);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_MAXCHECKATTEMPTS],&max_check_attempts);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_STATE],&state);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_STATETYPE],&state_type);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_TIMEOUT],&timeout);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_EARLYTIMEOUT],&early_timeout);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_RETURNCODE],&return_code);
-	result=ndo2db_convert_string_to_double(idi->buffered_input[NDO_DATA_EXECUTIONTIME],&execution_time);
-	result=ndo2db_convert_string_to_double(idi->buffered_input[NDO_DATA_LATENCY],&latency);
-	result=ndo2db_convert_string_to_timeval(idi->buffered_input[NDO_DATA_STARTTIME],&start_time);
-	result=ndo2db_convert_string_to_timeval(idi->buffered_input[NDO_DATA_ENDTIME],&end_time);
-
-	es[0]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_COMMANDARGS]);
-	es[1]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_COMMANDLINE]);
-	es[2]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_OUTPUT]);
-	es[3]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_LONGOUTPUT]);
-	es[4]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_PERFDATA]);
+	result=ndo2db_get_input_int(idi,NDO_DATA_CHECKTYPE,&check_type);
+	result=ndo2db_get_input_int(idi,NDO_DATA_CURRENTCHECKATTEMPT,&current_check_attempt);
+	result=ndo2db_get_input_int(idi,NDO_DATA_MAXCHECKATTEMPTS,&max_check_attempts);
+	result=ndo2db_get_input_int(idi,NDO_DATA_STATE,&state);
+	result=ndo2db_get_input_int(idi,NDO_DATA_STATETYPE,&state_type);
+	result=ndo2db_get_input_int(idi,NDO_DATA_TIMEOUT,&timeout);
+	result=ndo2db_get_input_int(idi,NDO_DATA_EARLYTIMEOUT,&early_timeout);
+	result=ndo2db_get_input_int(idi,NDO_DATA_RETURNCODE,&return_code);
+	result=ndo2db_get_input_double(idi,NDO_DATA_EXECUTIONTIME,&execution_time);
+	result=ndo2db_get_input_double(idi,NDO_DATA_LATENCY,&latency);
+	result=ndo2db_get_input_timeval(idi,NDO_DATA_STARTTIME,&start_time);
+	result=ndo2db_get_input_timeval(idi,NDO_DATA_ENDTIME,&end_time);
+
+	es[0]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_COMMANDARGS],&es_allocated[0]);
+	es[1]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_COMMANDLINE],&es_allocated[1]);
+	es[2]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_OUTPUT],&es_allocated[2]);
+	es[3]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_LONGOUTPUT],&es_allocated[3]);
+	es[4]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_PERFDATA],&es_allocated[4]);
 
 	ts[0]=ndo2db_db_timet_to_sql(idi,start_time.tv_sec);
 	ts[1]=ndo2db_db_timet_to_sql(idi,end_time.tv_sec);
 
 	/* get the object id */
-	result=ndo2db_get_object_id_with_insert(idi,NDO2DB_OBJECTTYPE_SERVICE,idi->buffered_input[NDO_DATA_HOST],idi->buffered_input[NDO_DATA_SERVICE],&object_id);
+	result=ndo2db_get_object_id_with_key(idi,NDO2DB_OBJECTTYPE_SERVICE,idi->buffered_input[NDO_DATA_HOST],idi->buffered_input[NDO_DATA_SERVICE],&object_id);
 
 	/* get the command id */
 	if(idi->buffered_input[NDO_DATA_COMMANDNAME]!=NULL && strcmp(idi->buffered_input[NDO_DATA_COMMANDNAME],""))
@@ -1513,7 +1998,8 @@ int ndo2db_handle_servicecheckdata(ndo2db_idi *idi){
 	for (x = 0; x < NAGIOS_SIZEOF_ARRAY(ts); x++)
 		free(ts[x]);
 	for (x = 0; x < NAGIOS_SIZEOF_ARRAY(es); x++)
-		free(es[x]);
+		if(es_allocated[x]==NDO_TRUE)
+			free(es[x]);
 
 	return NDO_OK;
         }
@@ -1524,6 +2010,7 @@ int ndo2db_handle_hostcheckdata(ndo2db_idi *idi){
 	struct timeval tstamp;
 	char *ts[2];
 	char *es[5];
+	int es_allocated[5]={NDO_FALSE};
 	int check_type=0;
 	int is_raw_check=0;
 	struct timeval start_time;
@@ -1563,30 +2050,30 @@ int ndo2db_handle_hostcheckdata(ndo2db_idi *idi){
 #endif
 
 	/* covert vars */
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_CHECKTYPE],&check_type);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_CURRENTCHECKATTEMPT],&current_check_attempt);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_MAXCHECKATTEMPTS],&max_check_attempts);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_STATE],&state);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_STATETYPE],&state_type);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_TIMEOUT],&timeout);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_EARLYTIMEOUT],&early_timeout);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_RETURNCODE],&return_code);
-	result=ndo2db_convert_string_to_double(idi->buffered_input[NDO_DATA_EXECUTIONTIME],&execution_time);
-	result=ndo2db_convert_string_to_double(idi->buffered_input[NDO_DATA_LATENCY],&latency);
-	result=ndo2db_convert_string_to_timeval(idi->buffered_input[NDO_DATA_STARTTIME],&start_time);
-	result=ndo2db_convert_string_to_timeval(idi->buffered_input[NDO_DATA_ENDTIME],&end_time);
-
-	es[0]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_COMMANDARGS]);
-	es[1]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_COMMANDLINE]);
-	es[2]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_OUTPUT]);
-	es[3]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_LONGOUTPUT]);
-	es[4]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_PERFDATA]);
+	result=ndo2db_get_input_int(idi,NDO_DATA_CHECKTYPE,&check_type);
+	result=ndo2db_get_input_int(idi,NDO_DATA_CURRENTCHECKATTEMPT,&current_check_attempt);
+	result=ndo2db_get_input_int(idi,NDO_DATA_MAXCHECKATTEMPTS,&max_check_attempts);
+	result=ndo2db_get_input_int(idi,NDO_DATA_STATE,&state);
+	result=ndo2db_get_input_int(idi,NDO_DATA_STATETYPE,&state_type);
+	result=ndo2db_get_input_int(idi,NDO_DATA_TIMEOUT,&timeout);
+	result=ndo2db_get_input_int(idi,NDO_DATA_EARLYTIMEOUT,&early_timeout);
+	result=ndo2db_get_input_int(idi,NDO_DATA_RETURNCODE,&return_code);
+	result=ndo2db_get_input_double(idi,NDO_DATA_EXECUTIONTIME,&execution_time);
+	result=ndo2db_get_input_double(idi,NDO_DATA_LATENCY,&latency);
+	result=ndo2db_get_input_timeval(idi,NDO_DATA_STARTTIME,&start_time);
+	result=ndo2db_get_input_timeval(idi,NDO_DATA_ENDTIME,&end_time);
+
+	es[0]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_COMMANDARGS],&es_allocated[0]);
+	es[1]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_COMMANDLINE],&es_allocated[1]);
+	es[2]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_OUTPUT],&es_allocated[2]);
+	es[3]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_LONGOUTPUT],&es_allocated[3]);
+	es[4]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_PERFDATA],&es_allocated[4]);
 
 	ts[0]=ndo2db_db_timet_to_sql(idi,start_time.tv_sec);
 	ts[1]=ndo2db_db_timet_to_sql(idi,end_time.tv_sec);
 
 	/* get the object id */
-	result=ndo2db_get_object_id_with_insert(idi,NDO2DB_OBJECTTYPE_HOST,idi->buffered_input[NDO_DATA_HOST],NULL,&object_id);
+	result=ndo2db_get_object_id_with_key(idi,NDO2DB_OBJECTTYPE_HOST,idi->buffered_input[NDO_DATA_HOST],NULL,&object_id);
 
 	/* get the command id */
 	if(idi->buffered_input[NDO_DATA_COMMANDNAME]!=NULL && strcmp(idi->buffered_input[NDO_DATA_COMMANDNAME],""))
@@ -1643,7 +2130,8 @@ int ndo2db_handle_hostcheckdata(ndo2db_idi *idi){
 	for (x = 0; x < NAGIOS_SIZEOF_ARRAY(ts); x++)
 		free(ts[x]);
 	for (x = 0; x < NAGIOS_SIZEOF_ARRAY(es); x++)
-		free(es[x]);
+		if(es_allocated[x]==NDO_TRUE)
+			free(es[x]);
 
 	return NDO_OK;
         }
@@ -1664,6 +2152,7 @@ int ndo2db_handle_commentdata(ndo2db_idi *idi){
 	int result=NDO_OK;
 	char *ts[3];
 	char *es[2];
+	int es_allocated[2]={NDO_FALSE};
 	int x=0;
 	char *buf=NULL;
 	char *buf1=NULL;
@@ -1675,18 +2164,18 @@ int ndo2db_handle_commentdata(ndo2db_idi *idi){
 	result=ndo2db_convert_standard_data_elements(idi,&type,&flags,&attr,&tstamp);
 
 	/* convert vars */
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_COMMENTTYPE],&comment_type);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_ENTRYTYPE],&entry_type);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_PERSISTENT],&is_persistent);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_SOURCE],&comment_source);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_EXPIRES],&expires);
+	result=ndo2db_get_input_int(idi,NDO_DATA_COMMENTTYPE,&comment_type);
+	result=ndo2db_get_input_int(idi,NDO_DATA_ENTRYTYPE,&entry_type);
+	result=ndo2db_get_input_int(idi,NDO_DATA_PERSISTENT,&is_persistent);
+	result=ndo2db_get_input_int(idi,NDO_DATA_SOURCE,&comment_source);
+	result=ndo2db_get_input_int(idi,NDO_DATA_EXPIRES,&expires);
 
-	result=ndo2db_convert_string_to_unsignedlong(idi->buffered_input[NDO_DATA_COMMENTID],&internal_comment_id);
-	result=ndo2db_convert_string_to_unsignedlong(idi->buffered_input[NDO_DATA_ENTRYTIME],&comment_time);
-	result=ndo2db_convert_string_to_unsignedlong(idi->buffered_input[NDO_DATA_EXPIRATIONTIME],&expire_time);
+	result=ndo2db_get_input_unsignedlong(idi,NDO_DATA_COMMENTID,&internal_comment_id);
+	result=ndo2db_get_input_unsignedlong(idi,NDO_DATA_ENTRYTIME,&comment_time);
+	result=ndo2db_get_input_unsignedlong(idi,NDO_DATA_EXPIRATIONTIME,&expire_time);
 
-	es[0]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_AUTHORNAME]);
-	es[1]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_COMMENT]);
+	es[0]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_AUTHORNAME],&es_allocated[0]);
+	es[1]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_COMMENT],&es_allocated[1]);
 
 	ts[0]=ndo2db_db_timet_to_sql(idi,tstamp.tv_sec);
 	ts[1]=ndo2db_db_timet_to_sql(idi,comment_time);
@@ -1694,9 +2183,9 @@ int ndo2db_handle_commentdata(ndo2db_idi *idi){
 
 	/* get the object id */
 	if(comment_type==SERVICE_COMMENT)
-		result=ndo2db_get_object_id_with_insert(idi,NDO2DB_OBJECTTYPE_SERVICE,idi->buffered_input[NDO_DATA_HOST],idi->buffered_input[NDO_DATA_SERVICE],&object_id);
+		result=ndo2db_get_object_id_with_key(idi,NDO2DB_OBJECTTYPE_SERVICE,idi->buffered_input[NDO_DATA_HOST],idi->buffered_input[NDO_DATA_SERVICE],&object_id);
 	if(comment_type==HOST_COMMENT)
-		result=ndo2db_get_object_id_with_insert(idi,NDO2DB_OBJECTTYPE_HOST,idi->buffered_input[NDO_DATA_HOST],NULL,&object_id);
+		result=ndo2db_get_object_id_with_key(idi,NDO2DB_OBJECTTYPE_HOST,idi->buffered_input[NDO_DATA_HOST],NULL,&object_id);
 
 	/* ADD HISTORICAL COMMENTS */
 	/* save a record of comments that get added (or get loaded and weren't previously recorded).... */
@@ -1804,7 +2293,8 @@ int ndo2db_handle_commentdata(ndo2db_idi *idi){
 	for (x = 0; x < NAGIOS_SIZEOF_ARRAY(ts); x++)
 		free(ts[x]);
 	for (x = 0; x < NAGIOS_SIZEOF_ARRAY(es); x++)
-		free(es[x]);
+		if(es_allocated[x]==NDO_TRUE)
+			free(es[x]);
 
 	return NDO_OK;
         }
@@ -1825,6 +2315,7 @@ int ndo2db_handle_downtimedata(ndo2db_idi *idi){
 	int result=NDO_OK;
 	char *ts[4];
 	char *es[2];
+	int es_allocated[2]={NDO_FALSE};
 	int x=0;
 	char *buf=NULL;
 	char *buf1=NULL;
@@ -1836,18 +2327,18 @@ int ndo2db_handle_downtimedata(ndo2db_idi *idi){
 	result=ndo2db_convert_standard_data_elements(idi,&type,&flags,&attr,&tstamp);
 
 	/* convert vars */
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_DOWNTIMETYPE],&downtime_type);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_FIXED],&fixed);
+	result=ndo2db_get_input_int(idi,NDO_DATA_DOWNTIMETYPE,&downtime_type);
+	result=ndo2db_get_input_int(idi,NDO_DATA_FIXED,&fixed);
 
-	result=ndo2db_convert_string_to_unsignedlong(idi->buffered_input[NDO_DATA_DURATION],&duration);
-	result=ndo2db_convert_string_to_unsignedlong(idi->buffered_input[NDO_DATA_DOWNTIMEID],&internal_downtime_id);
-	result=ndo2db_convert_string_to_unsignedlong(idi->buffered_input[NDO_DATA_TRIGGEREDBY],&triggered_by);
-	result=ndo2db_convert_string_to_unsignedlong(idi->buffered_input[NDO_DATA_ENTRYTIME],&entry_time);
-	result=ndo2db_convert_string_to_unsignedlong(idi->buffered_input[NDO_DATA_STARTTIME],&start_time);
-	result=ndo2db_convert_string_to_unsignedlong(idi->buffered_input[NDO_DATA_ENDTIME],&end_time);
+	result=ndo2db_get_input_unsignedlong(idi,NDO_DATA_DURATION,&duration);
+	result=ndo2db_get_input_unsignedlong(idi,NDO_DATA_DOWNTIMEID,&internal_downtime_id);
+	result=ndo2db_get_input_unsignedlong(idi,NDO_DATA_TRIGGEREDBY,&triggered_by);
+	result=ndo2db_get_input_unsignedlong(idi,NDO_DATA_ENTRYTIME,&entry_time);
+	result=ndo2db_get_input_unsignedlong(idi,NDO_DATA_STARTTIME,&start_time);
+	result=ndo2db_get_input_unsignedlong(idi,NDO_DATA_ENDTIME,&end_time);
 
-	es[0]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_AUTHORNAME]);
-	es[1]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_COMMENT]);
+	es[0]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_AUTHORNAME],&es_allocated[0]);
+	es[1]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_COMMENT],&es_allocated[1]);
 
 	ts[0]=ndo2db_db_timet_to_sql(idi,tstamp.tv_sec);
 	ts[1]=ndo2db_db_timet_to_sql(idi,entry_time);
@@ -1856,9 +2347,9 @@ int ndo2db_handle_downtimedata(ndo2db_idi *idi){
 
 	/* get the object id */
 	if(downtime_type==SERVICE_DOWNTIME)
-		result=ndo2db_get_object_id_with_insert(idi,NDO2DB_OBJECTTYPE_SERVICE,idi->buffered_input[NDO_DATA_HOST],idi->buffered_input[NDO_DATA_SERVICE],&object_id);
+		result=ndo2db_get_object_id_with_key(idi,NDO2DB_OBJECTTYPE_SERVICE,idi->buffered_input[NDO_DATA_HOST],idi->buffered_input[NDO_DATA_SERVICE],&object_id);
 	if(downtime_type==HOST_DOWNTIME)
-		result=ndo2db_get_object_id_with_insert(idi,NDO2DB_OBJECTTYPE_HOST,idi->buffered_input[NDO_DATA_HOST],NULL,&object_id);
+		result=ndo2db_get_object_id_with_key(idi,NDO2DB_OBJECTTYPE_HOST,idi->buffered_input[NDO_DATA_HOST],NULL,&object_id);
 
 	/* HISTORICAL DOWNTIME */
 
@@ -2018,7 +2509,8 @@ int ndo2db_handle_downtimedata(ndo2db_idi *idi){
 	for (x = 0; x < NAGIOS_SIZEOF_ARRAY(ts); x++)
 		free(ts[x]);
 	for (x = 0; x < NAGIOS_SIZEOF_ARRAY(es); x++)
-		free(es[x]);
+		if(es_allocated[x]==NDO_TRUE)
+			free(es[x]);
 
 	return NDO_OK;
         }
@@ -2046,21 +2538,21 @@ int ndo2db_handle_flappingdata(ndo2db_idi *idi){
 	result=ndo2db_convert_standard_data_elements(idi,&type,&flags,&attr,&tstamp);
 
 	/* convert vars */
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_FLAPPINGTYPE],&flapping_type);
-	result=ndo2db_convert_string_to_double(idi->buffered_input[NDO_DATA_PERCENTSTATECHANGE],&percent_state_change);
-	result=ndo2db_convert_string_to_double(idi->buffered_input[NDO_DATA_LOWTHRESHOLD],&low_threshold);
-	result=ndo2db_convert_string_to_double(idi->buffered_input[NDO_DATA_HIGHTHRESHOLD],&high_threshold);
-	result=ndo2db_convert_string_to_unsignedlong(idi->buffered_input[NDO_DATA_COMMENTTIME],&comment_time);
-	result=ndo2db_convert_string_to_unsignedlong(idi->buffered_input[NDO_DATA_COMMENTID],&internal_comment_id);
+	result=ndo2db_get_input_int(idi,NDO_DATA_FLAPPINGTYPE,&flapping_type);
+	result=ndo2db_get_input_double(idi,NDO_DATA_PERCENTSTATECHANGE,&percent_state_change);
+	result=ndo2db_get_input_double(idi,NDO_DATA_LOWTHRESHOLD,&low_threshold);
+	result=ndo2db_get_input_double(idi,NDO_DATA_HIGHTHRESHOLD,&high_threshold);
+	result=ndo2db_get_input_unsignedlong(idi,NDO_DATA_COMMENTTIME,&comment_time);
+	result=ndo2db_get_input_unsignedlong(idi,NDO_DATA_COMMENTID,&internal_comment_id);
 
 	ts[0]=ndo2db_db_timet_to_sql(idi,tstamp.tv_sec);
 	ts[1]=ndo2db_db_timet_to_sql(idi,comment_time);
 
 	/* get the object id (if applicable) */
 	if(flapping_type==SERVICE_FLAPPING)
-		result=ndo2db_get_object_id_with_insert(idi,NDO2DB_OBJECTTYPE_SERVICE,idi->buffered_input[NDO_DATA_HOST],idi->buffered_input[NDO_DATA_SERVICE],&object_id);
+		result=ndo2db_get_object_id_with_key(idi,NDO2DB_OBJECTTYPE_SERVICE,idi->buffered_input[NDO_DATA_HOST],idi->buffered_input[NDO_DATA_SERVICE],&object_id);
 	if(flapping_type==HOST_FLAPPING)
-		result=ndo2db_get_object_id_with_insert(idi,NDO2DB_OBJECTTYPE_HOST,idi->buffered_input[NDO_DATA_HOST],NULL,&object_id);
+		result=ndo2db_get_object_id_with_key(idi,NDO2DB_OBJECTTYPE_HOST,idi->buffered_input[NDO_DATA_HOST],NULL,&object_id);
 
 	/* save entry to db */
 	if(asprintf(&buf,"INSERT INTO %s SET instance_id='%lu', event_time=%s, event_time_usec='%lu', event_type='%d', reason_type='%d', flapping_type='%d', object_id='%lu', percent_state_change='%lf', low_threshold='%lf', high_threshold='%lf', comment_time=%s, internal_comment_id='%lu'"
@@ -2090,6 +2582,52 @@ int ndo2db_handle_flappingdata(ndo2db_idi *idi){
         }
 
 
+/* saves a status row, unless the stored one is newer - backlogged data can arrive after live data */
+int ndo2db_save_status_row(ndo2db_idi *idi, int table, char *id_column, unsigned long object_id, char *ts, char *row){
+	char *key=NULL;
+	char *buf=NULL;
+	int result=NDO_OK;
+
+	if(idi==NULL || row==NULL || ts==NULL)
+		return NDO_ERROR;
+
+	if(id_column==NULL){
+		if(asprintf(&key,"instance_id='%lu'",idi->dbinfo.instance_id)==-1)
+			key=NULL;
+		}
+	else{
+		if(asprintf(&key,"instance_id='%lu' AND %s='%lu'",idi->dbinfo.instance_id,id_column,object_id)==-1)
+			key=NULL;
+		}
+	if(key==NULL)
+		return NDO_ERROR;
+
+	if(asprintf(&buf,"UPDATE %s SET %s WHERE %s AND status_update_time<=%s"
+		    ,ndo2db_db_tablenames[table]
+		    ,row
+		    ,key
+		    ,ts
+		   )==-1)
+		buf=NULL;
+	result=ndo2db_db_query(idi,buf);
+	free(buf);
+	free(key);
+
+	/* nothing changed - either there is no row yet, or a newer one that must stay */
+	if(result==NDO_OK && mysql_affected_rows(idi->dbinfo.mysql_link)==0){
+		if(asprintf(&buf,"INSERT IGNORE INTO %s SET %s"
+			    ,ndo2db_db_tablenames[table]
+			    ,row
+			   )==-1)
+			buf=NULL;
+		result=ndo2db_db_query(idi,buf);
+		free(buf);
+		}
+
+	return result;
+        }
+
+
 int ndo2db_handle_programstatusdata(ndo2db_idi *idi){
 	int x = 0;
 	int type,flags,attr;
@@ -2114,7 +2652,7 @@ int ndo2db_handle_programstatusdata(ndo2db_idi *idi){
 	unsigned long modified_service_attributes=0L;
 	char *ts[4];
 	char *es[2];
-	char *buf=NULL;
+	int es_allocated[2]={NDO_FALSE};
 	char *buf1=NULL;
 	int result=NDO_OK;
 
@@ -2124,32 +2662,35 @@ int ndo2db_handle_programstatusdata(ndo2db_idi *idi){
 	/* convert timestamp, etc */
 	result=ndo2db_convert_standard_data_elements(idi,&type,&flags,&attr,&tstamp);
 
+	/* ndomod reports what it has shed with each update, logged at the next checkin */
+	ndo2db_get_input_unsignedlong(idi,NDO_DATA_EVENTSSHED,&idi->events_shed);
+
 	/* don't store old data */
 	if(tstamp.tv_sec < idi->dbinfo.latest_realtime_data_time)
 		return NDO_OK;
 
 	/* covert vars */
-	result=ndo2db_convert_string_to_unsignedlong(idi->buffered_input[NDO_DATA_PROGRAMSTARTTIME],&program_start_time);
-	result=ndo2db_convert_string_to_unsignedlong(idi->buffered_input[NDO_DATA_PROCESSID],&process_id);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_DAEMONMODE],&daemon_mode);
-	result=ndo2db_convert_string_to_unsignedlong(idi->buffered_input[NDO_DATA_LASTCOMMANDCHECK],&last_command_check);
-	result=ndo2db_convert_string_to_unsignedlong(idi->buffered_input[NDO_DATA_LASTLOGROTATION],&last_log_rotation);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_NOTIFICATIONSENABLED],&notifications_enabled);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_ACTIVESERVICECHECKSENABLED],&active_service_checks_enabled);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_PASSIVESERVICECHECKSENABLED],&passive_service_checks_enabled);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_ACTIVEHOSTCHECKSENABLED],&active_host_checks_enabled);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_PASSIVEHOSTCHECKSENABLED],&passive_host_checks_enabled);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_EVENTHANDLERSENABLED],&event_handlers_enabled);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_FLAPDETECTIONENABLED],&flap_detection_enabled);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_FAILUREPREDICTIONENABLED],&failure_prediction_enabled);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_PROCESSPERFORMANCEDATA],&process_performance_data);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_OBSESSOVERHOSTS],&obsess_over_hosts);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_OBSESSOVERSERVICES],&obsess_over_services);
-	result=ndo2db_convert_string_to_unsignedlong(idi->buffered_input[NDO_DATA_MODIFIEDHOSTATTRIBUTES],&modified_host_attributes);
-	result=ndo2db_convert_string_to_unsignedlong(idi->buffered_input[NDO_DATA_MODIFIEDSERVICEATTRIBUTES],&modified_service_attributes);
-
-	es[0]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_GLOBALHOSTEVENTHANDLER]);
-	es[1]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_GLOBALSERVICEEVENTHANDLER]);
+	result=ndo2db_get_input_unsignedlong(idi,NDO_DATA_PROGRAMSTARTTIME,&program_start_time);
+	result=ndo2db_get_input_unsignedlong(idi,NDO_DATA_PROCESSID,&process_id);
+	result=ndo2db_get_input_int(idi,NDO_DATA_DAEMONMODE,&daemon_mode);
+	result=ndo2db_get_input_unsignedlong(idi,NDO_DATA_LASTCOMMANDCHECK,&last_command_check);
+	result=ndo2db_get_input_unsignedlong(idi,NDO_DATA_LASTLOGROTATION,&last_log_rotation);
+	result=ndo2db_get_input_int(idi,NDO_DATA_NOTIFICATIONSENABLED,&notifications_enabled);
+	result=ndo2db_get_input_int(idi,NDO_DATA_ACTIVESERVICECHECKSENABLED,&active_service_checks_enabled);
+	result=ndo2db_get_input_int(idi,NDO_DATA_PASSIVESERVICECHECKSENABLED,&passive_service_checks_enabled);
+	result=ndo2db_get_input_int(idi,NDO_DATA_ACTIVEHOSTCHECKSENABLED,&active_host_checks_enabled);
+	result=ndo2db_get_input_int(idi,NDO_DATA_PASSIVEHOSTCHECKSENABLED,&passive_host_checks_enabled);
+	result=ndo2db_get_input_int(idi,NDO_DATA_EVENTHANDLERSENABLED,&event_handlers_enabled);
+	result=ndo2db_get_input_int(idi,NDO_DATA_FLAPDETECTIONENABLED,&flap_detection_enabled);
+	result=ndo2db_get_input_int(idi,NDO_DATA_FAILUREPREDICTIONENABLED,&failure_prediction_enabled);
+	result=ndo2db_get_input_int(idi,NDO_DATA_PROCESSPERFORMANCEDATA,&process_performance_data);
+	result=ndo2db_get_input_int(idi,NDO_DATA_OBSESSOVERHOSTS,&obsess_over_hosts);
+	result=ndo2db_get_input_int(idi,NDO_DATA_OBSESSOVERSERVICES,&obsess_over_services);
+	result=ndo2db_get_input_unsignedlong(idi,NDO_DATA_MODIFIEDHOSTATTRIBUTES,&modified_host_attributes);
+	result=ndo2db_get_input_unsignedlong(idi,NDO_DATA_MODIFIEDSERVICEATTRIBUTES,&modified_service_attributes);
+
+	es[0]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_GLOBALHOSTEVENTHANDLER],&es_allocated[0]);
+	es[1]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_GLOBALSERVICEEVENTHANDLER],&es_allocated[1]);
 
 	ts[0]=ndo2db_db_timet_to_sql(idi,tstamp.tv_sec);
 	ts[1]=ndo2db_db_timet_to_sql(idi,program_start_time);
@@ -2183,23 +2724,16 @@ int ndo2db_handle_programstatusdata(ndo2db_idi *idi){
 		   )==-1)
 		buf1=NULL;
 
-	if(asprintf(&buf,"INSERT INTO %s SET %s ON DUPLICATE KEY UPDATE %s"
-		    ,ndo2db_db_tablenames[NDO2DB_DBTABLE_PROGRAMSTATUS]
-		    ,buf1
-		    ,buf1
-		   )==-1)
-		buf=NULL;
-
 	/* save entry to db */
-	result=ndo2db_db_query(idi,buf);
-	free(buf);
+	result=ndo2db_save_status_row(idi,NDO2DB_DBTABLE_PROGRAMSTATUS,NULL,0L,ts[0],buf1);
 	free(buf1);
 
         /* free memory */
 	for (x = 0; x < NAGIOS_SIZEOF_ARRAY(ts); x++)
 		free(ts[x]);
 	for (x = 0; x < NAGIOS_SIZEOF_ARRAY(es); x++)
-		free(es[x]);
+		if(es_allocated[x]==NDO_TRUE)
+			free(es[x]);
 
 	return NDO_OK;
         }
@@ -2247,7 +2781,7 @@ int ndo2db_handle_hoststatusdata(ndo2db_idi *idi){
 	double retry_check_interval=0.0;
 	char *ts[10];
 	char *es[5];
-	char *buf=NULL;
+	int es_allocated[5]={NDO_FALSE};
 	char *buf1=NULL;
 	unsigned long object_id=0L;
 	unsigned long check_timeperiod_object_id=0L;
@@ -2265,49 +2799,49 @@ int ndo2db_handle_hoststatusdata(ndo2db_idi *idi){
 		return NDO_OK;
 
 	/* covert vars */
-	result=ndo2db_convert_string_to_unsignedlong(idi->buffered_input[NDO_DATA_LASTHOSTCHECK],&last_check);
-	result=ndo2db_convert_string_to_unsignedlong(idi->buffered_input[NDO_DATA_NEXTHOSTCHECK],&next_check);
-	result=ndo2db_convert_string_to_unsignedlong(idi->buffered_input[NDO_DATA_LASTSTATECHANGE],&last_state_change);
-	result=ndo2db_convert_string_to_unsignedlong(idi->buffered_input[NDO_DATA_LASTHARDSTATECHANGE],&last_hard_state_change);
-	result=ndo2db_convert_string_to_unsignedlong(idi->buffered_input[NDO_DATA_LASTTIMEUP],&last_time_up);
-	result=ndo2db_convert_string_to_unsignedlong(idi->buffered_input[NDO_DATA_LASTTIMEDOWN],&last_time_down);
-	result=ndo2db_convert_string_to_unsignedlong(idi->buffered_input[NDO_DATA_LASTTIMEUNREACHABLE],&last_time_unreachable);
-	result=ndo2db_convert_string_to_unsignedlong(idi->buffered_input[NDO_DATA_LASTHOSTNOTIFICATION],&last_notification);
-	result=ndo2db_convert_string_to_unsignedlong(idi->buffered_input[NDO_DATA_NEXTHOSTNOTIFICATION],&next_notification);
-	result=ndo2db_convert_string_to_unsignedlong(idi->buffered_input[NDO_DATA_MODIFIEDHOSTATTRIBUTES],&modified_host_attributes);
-	result=ndo2db_convert_string_to_double(idi->buffered_input[NDO_DATA_PERCENTSTATECHANGE],&percent_state_change);
-	result=ndo2db_convert_string_to_double(idi->buffered_input[NDO_DATA_LATENCY],&latency);
-	result=ndo2db_convert_string_to_double(idi->buffered_input[NDO_DATA_EXECUTIONTIME],&execution_time);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_CURRENTSTATE],&current_state);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_HASBEENCHECKED],&has_been_checked);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_SHOULDBESCHEDULED],&should_be_scheduled);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_CURRENTCHECKATTEMPT],&current_check_attempt);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_MAXCHECKATTEMPTS],&max_check_attempts);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_CHECKTYPE],&check_type);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_LASTHARDSTATE],&last_hard_state);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_STATETYPE],&state_type);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_NOMORENOTIFICATIONS],&no_more_notifications);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_NOTIFICATIONSENABLED],&notifications_enabled);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_PROBLEMHASBEENACKNOWLEDGED],&problem_has_been_acknowledged);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_ACKNOWLEDGEMENTTYPE],&acknowledgement_type);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_CURRENTNOTIFICATIONNUMBER],&current_notification_number);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_PASSIVEHOSTCHECKSENABLED],&passive_checks_enabled);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_ACTIVEHOSTCHECKSENABLED],&active_checks_enabled);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_EVENTHANDLERENABLED],&event_handler_enabled);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_FLAPDETECTIONENABLED],&flap_detection_enabled);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_ISFLAPPING],&is_flapping);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_SCHEDULEDDOWNTIMEDEPTH],&scheduled_downtime_depth);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_FAILUREPREDICTIONENABLED],&failure_prediction_enabled);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_PROCESSPERFORMANCEDATA],&process_performance_data);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_OBSESSOVERHOST],&obsess_over_host);
-	result=ndo2db_convert_string_to_double(idi->buffered_input[NDO_DATA_NORMALCHECKINTERVAL],&normal_check_interval);
-	result=ndo2db_convert_string_to_double(idi->buffered_input[NDO_DATA_RETRYCHECKINTERVAL],&retry_check_interval);
-
-	es[0]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_OUTPUT]);
-	es[1]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_LONGOUTPUT]);
-	es[2]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_PERFDATA]);
-	es[3]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_EVENTHANDLER]);
-	es[4]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_CHECKCOMMAND]);
+	result=ndo2db_get_input_unsignedlong(idi,NDO_DATA_LASTHOSTCHECK,&last_check);
+	result=ndo2db_get_input_unsignedlong(idi,NDO_DATA_NEXTHOSTCHECK,&next_check);
+	result=ndo2db_get_input_unsignedlong(idi,NDO_DATA_LASTSTATECHANGE,&last_state_change);
+	result=ndo2db_get_input_unsignedlong(idi,NDO_DATA_LASTHARDSTATECHANGE,&last_hard_state_change);
+	result=ndo2db_get_input_unsignedlong(idi,NDO_DATA_LASTTIMEUP,&last_time_up);
+	result=ndo2db_get_input_unsignedlong(idi,NDO_DATA_LASTTIMEDOWN,&last_time_down);
+	result=ndo2db_get_input_unsignedlong(idi,NDO_DATA_LASTTIMEUNREACHABLE,&last_time_unreachable);
+	result=ndo2db_get_input_unsignedlong(idi,NDO_DATA_LASTHOSTNOTIFICATION,&last_notification);
+	result=ndo2db_get_input_unsignedlong(idi,NDO_DATA_NEXTHOSTNOTIFICATION,&next_notification);
+	result=ndo2db_get_input_unsignedlong(idi,NDO_DATA_MODIFIEDHOSTATTRIBUTES,&modified_host_attributes);
+	result=ndo2db_get_input_double(idi,NDO_DATA_PERCENTSTATECHANGE,&percent_state_change);
+	result=ndo2db_get_input_double(idi,NDO_DATA_LATENCY,&latency);
+	result=ndo2db_get_input_double(idi,NDO_DATA_EXECUTIONTIME,&execution_time);
+	result=ndo2db_get_input_int(idi,NDO_DATA_CURRENTSTATE,&current_state);
+	result=ndo2db_get_input_int(idi,NDO_DATA_HASBEENCHECKED,&has_been_checked);
+	result=ndo2db_get_input_int(idi,NDO_DATA_SHOULDBESCHEDULED,&should_be_scheduled);
+	result=ndo2db_get_input_int(idi,NDO_DATA_CURRENTCHECKATTEMPT,&current_check_attempt);
+	result=ndo2db_get_input_int(idi,NDO_DATA_MAXCHECKATTEMPTS,&max_check_attempts);
+	result=ndo2db_get_input_int(idi,NDO_DATA_CHECKTYPE,&check_type);
+	result=ndo2db_get_input_int(idi,NDO_DATA_LASTHARDSTATE,&last_hard_state);
+	result=ndo2db_get_input_int(idi,NDO_DATA_STATETYPE,&state_type);
+	result=ndo2db_get_input_int(idi,NDO_DATA_NOMORENOTIFICATIONS,&no_more_notifications);
+	result=ndo2db_get_input_int(idi,NDO_DATA_NOTIFICATIONSENABLED,&notifications_enabled);
+	result=ndo2db_get_input_int(idi,NDO_DATA_PROBLEMHASBEENACKNOWLEDGED,&problem_has_been_acknowledged);
+	result=ndo2db_get_input_int(idi,NDO_DATA_ACKNOWLEDGEMENTTYPE,&acknowledgement_type);
+	result=ndo2db_get_input_int(idi,NDO_DATA_CURRENTNOTIFICATIONNUMBER,&current_notification_number);
+	result=ndo2db_get_input_int(idi,NDO_DATA_PASSIVEHOSTCHECKSENABLED,&passive_checks_enabled);
+	result=ndo2db_get_input_int(idi,NDO_DATA_ACTIVEHOSTCHECKSENABLED,&active_checks_enabled);
+	result=ndo2db_get_input_int(idi,NDO_DATA_EVENTHANDLERENABLED,&event_handler_enabled);
+	result=ndo2db_get_input_int(idi,NDO_DATA_FLAPDETECTIONENABLED,&flap_detection_enabled);
+	result=ndo2db_get_input_int(idi,NDO_DATA_ISFLAPPING,&is_flapping);
+	result=ndo2db_get_input_int(idi,NDO_DATA_SCHEDULEDDOWNTIMEDEPTH,&scheduled_downtime_depth);
+	result=ndo2db_get_input_int(idi,NDO_DATA_FAILUREPREDICTIONENABLED,&failure_prediction_enabled);
+	result=ndo2db_get_input_int(idi,NDO_DATA_PROCESSPERFORMANCEDATA,&process_performance_data);
+	result=ndo2db_get_input_int(idi,NDO_DATA_OBSESSOVERHOST,&obsess_over_host);
+	result=ndo2db_get_input_double(idi,NDO_DATA_NORMALCHECKINTERVAL,&normal_check_interval);
+	result=ndo2db_get_input_double(idi,NDO_DATA_RETRYCHECKINTERVAL,&retry_check_interval);
+
+	es[0]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_OUTPUT],&es_allocated[0]);
+	es[1]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_LONGOUTPUT],&es_allocated[1]);
+	es[2]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_PERFDATA],&es_allocated[2]);
+	es[3]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_EVENTHANDLER],&es_allocated[3]);
+	es[4]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_CHECKCOMMAND],&es_allocated[4]);
 
 	ts[0]=ndo2db_db_timet_to_sql(idi,tstamp.tv_sec);
 	ts[1]=ndo2db_db_timet_to_sql(idi,last_check);
@@ -2321,7 +2855,7 @@ int ndo2db_handle_hoststatusdata(ndo2db_idi *idi){
 	ts[9]=ndo2db_db_timet_to_sql(idi,next_notification);
 
 	/* get the object id */
-	result=ndo2db_get_object_id_with_insert(idi,NDO2DB_OBJECTTYPE_HOST,idi->buffered_input[NDO_DATA_HOST],NULL,&object_id);
+	result=ndo2db_get_object_id_with_key(idi,NDO2DB_OBJECTTYPE_HOST,idi->buffered_input[NDO_DATA_HOST],NULL,&object_id);
 	result=ndo2db_get_object_id_with_insert(idi,NDO2DB_OBJECTTYPE_TIMEPERIOD,idi->buffered_input[NDO_DATA_HOSTCHECKPERIOD],NULL,&check_timeperiod_object_id);
 
 	/* generate query string */
@@ -2375,21 +2909,14 @@ int ndo2db_handle_hoststatusdata(ndo2db_idi *idi){
 		   )==-1)
 		buf1=NULL;
 
-	if(asprintf(&buf,"INSERT INTO %s SET %s ON DUPLICATE KEY UPDATE %s"
-		    ,ndo2db_db_tablenames[NDO2DB_DBTABLE_HOSTSTATUS]
-		    ,buf1
-		    ,buf1
-		   )==-1)
-		buf=NULL;
-
 	/* save entry to db */
-	result=ndo2db_db_query(idi,buf);
-	free(buf);
+	result=ndo2db_save_status_row(idi,NDO2DB_DBTABLE_HOSTSTATUS,"host_object_id",object_id,ts[0],buf1);
 	free(buf1);
 
         /* free memory */
 	for (x = 0; x < NAGIOS_SIZEOF_ARRAY(es); x++)
-		free(es[x]);
+		if(es_allocated[x]==NDO_TRUE)
+			free(es[x]);
 
 	/* save custom variables to db */
 	result=ndo2db_save_custom_variables(idi,NDO2DB_DBTABLE_CUSTOMVARIABLESTATUS,object_id,ts[0]);
@@ -2446,7 +2973,7 @@ int ndo2db_handle_servicestatusdata(ndo2db_idi *idi){
 	double retry_check_interval=0.0;
 	char *ts[11];
 	char *es[5];
-	char *buf=NULL;
+	int es_allocated[5]={NDO_FALSE};
 	char *buf1=NULL;
 	unsigned long object_id=0L;
 	unsigned long check_timeperiod_object_id=0L;
@@ -2464,50 +2991,50 @@ int ndo2db_handle_servicestatusdata(ndo2db_idi *idi){
 		return NDO_OK;
 
 	/* covert vars */
-	result=ndo2db_convert_string_to_unsignedlong(idi->buffered_input[NDO_DATA_LASTSERVICECHECK],&last_check);
-	result=ndo2db_convert_string_to_unsignedlong(idi->buffered_input[NDO_DATA_NEXTSERVICECHECK],&next_check);
-	result=ndo2db_convert_string_to_unsignedlong(idi->buffered_input[NDO_DATA_LASTSTATECHANGE],&last_state_change);
-	result=ndo2db_convert_string_to_unsignedlong(idi->buffered_input[NDO_DATA_LASTHARDSTATECHANGE],&last_hard_state_change);
-	result=ndo2db_convert_string_to_unsignedlong(idi->buffered_input[NDO_DATA_LASTTIMEOK],&last_time_ok);
-	result=ndo2db_convert_string_to_unsignedlong(idi->buffered_input[NDO_DATA_LASTTIMEWARNING],&last_time_warning);
-	result=ndo2db_convert_string_to_unsignedlong(idi->buffered_input[NDO_DATA_LASTTIMEUNKNOWN],&last_time_unknown);
-	result=ndo2db_convert_string_to_unsignedlong(idi->buffered_input[NDO_DATA_LASTTIMECRITICAL],&last_time_critical);
-	result=ndo2db_convert_string_to_unsignedlong(idi->buffered_input[NDO_DATA_LASTSERVICENOTIFICATION],&last_notification);
-	result=ndo2db_convert_string_to_unsignedlong(idi->buffered_input[NDO_DATA_NEXTSERVICENOTIFICATION],&next_notification);
-	result=ndo2db_convert_string_to_unsignedlong(idi->buffered_input[NDO_DATA_MODIFIEDSERVICEATTRIBUTES],&modified_service_attributes);
-	result=ndo2db_convert_string_to_double(idi->buffered_input[NDO_DATA_PERCENTSTATECHANGE],&percent_state_change);
-	result=ndo2db_convert_string_to_double(idi->buffered_input[NDO_DATA_LATENCY],&latency);
-	result=ndo2db_convert_string_to_double(idi->buffered_input[NDO_DATA_EXECUTIONTIME],&execution_time);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_CURRENTSTATE],&current_state);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_HASBEENCHECKED],&has_been_checked);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_SHOULDBESCHEDULED],&should_be_scheduled);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_CURRENTCHECKATTEMPT],&current_check_attempt);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_MAXCHECKATTEMPTS],&max_check_attempts);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_CHECKTYPE],&check_type);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_LASTHARDSTATE],&last_hard_state);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_STATETYPE],&state_type);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_NOMORENOTIFICATIONS],&no_more_notifications);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_NOTIFICATIONSENABLED],&notifications_enabled);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_PROBLEMHASBEENACKNOWLEDGED],&problem_has_been_acknowledged);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_ACKNOWLEDGEMENTTYPE],&acknowledgement_type);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_CURRENTNOTIFICATIONNUMBER],&current_notification_number);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_PASSIVESERVICECHECKSENABLED],&passive_checks_enabled);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_ACTIVESERVICECHECKSENABLED],&active_checks_enabled);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_EVENTHANDLERENABLED],&event_handler_enabled);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_FLAPDETECTIONENABLED],&flap_detection_enabled);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_ISFLAPPING],&is_flapping);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_SCHEDULEDDOWNTIMEDEPTH],&scheduled_downtime_depth);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_FAILUREPREDICTIONENABLED],&failure_prediction_enabled);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_PROCESSPERFORMANCEDATA],&process_performance_data);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_OBSESSOVERSERVICE],&obsess_over_service);
-	result=ndo2db_convert_string_to_double(idi->buffered_input[NDO_DATA_NORMALCHECKINTERVAL],&normal_check_interval);
-	result=ndo2db_convert_string_to_double(idi->buffered_input[NDO_DATA_RETRYCHECKINTERVAL],&retry_check_interval);
-
-	es[0]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_OUTPUT]);
-	es[1]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_LONGOUTPUT]);
-	es[2]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_PERFDATA]);
-	es[3]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_EVENTHANDLER]);
-	es[4]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_CHECKCOMMAND]);
+	result=ndo2db_get_input_unsignedlong(idi,NDO_DATA_LASTSERVICECHECK,&last_check);
+	result=ndo2db_get_input_unsignedlong(idi,NDO_DATA_NEXTSERVICECHECK,&next_check);
+	result=ndo2db_get_input_unsignedlong(idi,NDO_DATA_LASTSTATECHANGE,&last_state_change);
+	result=ndo2db_get_input_unsignedlong(idi,NDO_DATA_LASTHARDSTATECHANGE,&last_hard_state_change);
+	result=ndo2db_get_input_unsignedlong(idi,NDO_DATA_LASTTIMEOK,&last_time_ok);
+	result=ndo2db_get_input_unsignedlong(idi,NDO_DATA_LASTTIMEWARNING,&last_time_warning);
+	result=ndo2db_get_input_unsignedlong(idi,NDO_DATA_LASTTIMEUNKNOWN,&last_time_unknown);
+	result=ndo2db_get_input_unsignedlong(idi,NDO_DATA_LASTTIMECRITICAL,&last_time_critical);
+	result=ndo2db_get_input_unsignedlong(idi,NDO_DATA_LASTSERVICENOTIFICATION,&last_notification);
+	result=ndo2db_get_input_unsignedlong(idi,NDO_DATA_NEXTSERVICENOTIFICATION,&next_notification);
+	result=ndo2db_get_input_unsignedlong(idi,NDO_DATA_MODIFIEDSERVICEATTRIBUTES,&modified_service_attributes);
+	result=ndo2db_get_input_double(idi,NDO_DATA_PERCENTSTATECHANGE,&percent_state_change);
+	result=ndo2db_get_input_double(idi,NDO_DATA_LATENCY,&latency);
+	result=ndo2db_get_input_double(idi,NDO_DATA_EXECUTIONTIME,&execution_time);
+	result=ndo2db_get_input_int(idi,NDO_DATA_CURRENTSTATE,&current_state);
+	result=ndo2db_get_input_int(idi,NDO_DATA_HASBEENCHECKED,&has_been_checked);
+	result=ndo2db_get_input_int(idi,NDO_DATA_SHOULDBESCHEDULED,&should_be_scheduled);
+	result=ndo2db_get_input_int(idi,NDO_DATA_CURRENTCHECKATTEMPT,&current_check_attempt);
+	result=ndo2db_get_input_int(idi,NDO_DATA_MAXCHECKATTEMPTS,&max_check_attempts);
+	result=ndo2db_get_input_int(idi,NDO_DATA_CHECKTYPE,&check_type);
+	result=ndo2db_get_input_int(idi,NDO_DATA_LASTHARDSTATE,&last_hard_state);
+	result=ndo2db_get_input_int(idi,NDO_DATA_STATETYPE,&state_type);
+	result=ndo2db_get_input_int(idi,NDO_DATA_NOMORENOTIFICATIONS,&no_more_notifications);
+	result=ndo2db_get_input_int(idi,NDO_DATA_NOTIFICATIONSENABLED,&notifications_enabled);
+	result=ndo2db_get_input_int(idi,NDO_DATA_PROBLEMHASBEENACKNOWLEDGED,&problem_has_been_acknowledged);
+	result=ndo2db_get_input_int(idi,NDO_DATA_ACKNOWLEDGEMENTTYPE,&acknowledgement_type);
+	result=ndo2db_get_input_int(idi,NDO_DATA_CURRENTNOTIFICATIONNUMBER,&current_notification_number);
+	result=ndo2db_get_input_int(idi,NDO_DATA_PASSIVESERVICECHECKSENABLED,&passive_checks_enabled);
+	result=ndo2db_get_input_int(idi,NDO_DATA_ACTIVESERVICECHECKSENABLED,&active_checks_enabled);
+	result=ndo2db_get_input_int(idi,NDO_DATA_EVENTHANDLERENABLED,&event_handler_enabled);
+	result=ndo2db_get_input_int(idi,NDO_DATA_FLAPDETECTIONENABLED,&flap_detection_enabled);
+	result=ndo2db_get_input_int(idi,NDO_DATA_ISFLAPPING,&is_flapping);
+	result=ndo2db_get_input_int(idi,NDO_DATA_SCHEDULEDDOWNTIMEDEPTH,&scheduled_downtime_depth);
+	result=ndo2db_get_input_int(idi,NDO_DATA_FAILUREPREDICTIONENABLED,&failure_prediction_enabled);
+	result=ndo2db_get_input_int(idi,NDO_DATA_PROCESSPERFORMANCEDATA,&process_performance_data);
+	result=ndo2db_get_input_int(idi,NDO_DATA_OBSESSOVERSERVICE,&obsess_over_service);
+	result=ndo2db_get_input_double(idi,NDO_DATA_NORMALCHECKINTERVAL,&normal_check_interval);
+	result=ndo2db_get_input_double(idi,NDO_DATA_RETRYCHECKINTERVAL,&retry_check_interval);
+
+	es[0]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_OUTPUT],&es_allocated[0]);
+	es[1]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_LONGOUTPUT],&es_allocated[1]);
+	es[2]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_PERFDATA],&es_allocated[2]);
+	es[3]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_EVENTHANDLER],&es_allocated[3]);
+	es[4]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_CHECKCOMMAND],&es_allocated[4]);
 
 	ts[0]=ndo2db_db_timet_to_sql(idi,tstamp.tv_sec);
 	ts[1]=ndo2db_db_timet_to_sql(idi,last_check);
@@ -2522,7 +3049,7 @@ int ndo2db_handle_servicestatusdata(ndo2db_idi *idi){
 	ts[10]=ndo2db_db_timet_to_sql(idi,next_notification);
 
 	/* get the object id */
-	result=ndo2db_get_object_id_with_insert(idi,NDO2DB_OBJECTTYPE_SERVICE,idi->buffered_input[NDO_DATA_HOST],idi->buffered_input[NDO_DATA_SERVICE],&object_id);
+	result=ndo2db_get_object_id_with_key(idi,NDO2DB_OBJECTTYPE_SERVICE,idi->buffered_input[NDO_DATA_HOST],idi->buffered_input[NDO_DATA_SERVICE],&object_id);
 	result=ndo2db_get_object_id_with_insert(idi,NDO2DB_OBJECTTYPE_TIMEPERIOD,idi->buffered_input[NDO_DATA_SERVICECHECKPERIOD],NULL,&check_timeperiod_object_id);
 
 	/* generate query string */
@@ -2577,21 +3104,14 @@ int ndo2db_handle_servicestatusdata(ndo2db_idi *idi){
 		   )==-1)
 		buf1=NULL;
 
-	if(asprintf(&buf,"INSERT INTO %s SET %s ON DUPLICATE KEY UPDATE %s"
-		    ,ndo2db_db_tablenames[NDO2DB_DBTABLE_SERVICESTATUS]
-		    ,buf1
-		    ,buf1
-		   )==-1)
-		buf=NULL;
-
 	/* save entry to db */
-	result=ndo2db_db_query(idi,buf);
-	free(buf);
+	result=ndo2db_save_status_row(idi,NDO2DB_DBTABLE_SERVICESTATUS,"service_object_id",object_id,ts[0],buf1);
 	free(buf1);
 
         /* free memory */
 	for (x = 0; x < NAGIOS_SIZEOF_ARRAY(es); x++)
-		free(es[x]);
+		if(es_allocated[x]==NDO_TRUE)
+			free(es[x]);
 
 	/* save custom variables to db */
 	result=ndo2db_save_custom_variables(idi,NDO2DB_DBTABLE_CUSTOMVARIABLESTATUS,object_id,ts[0]);
@@ -2604,6 +3124,247 @@ int ndo2db_handle_servicestatusdata(ndo2db_idi *idi){
         }
 
 
+/* columns that may appear in a host status delta */
+static ndo2db_status_column ndo2db_hoststatus_columns[]={
+	{NDO_DATA_OUTPUT,NDO2DB_COLUMN_STRING,"output"},
+	{NDO_DATA_LONGOUTPUT,NDO2DB_COLUMN_STRING,"long_output"},
+	{NDO_DATA_PERFDATA,NDO2DB_COLUMN_STRING,"perfdata"},
+	{NDO_DATA_CURRENTSTATE,NDO2DB_COLUMN_INT,"current_state"},
+	{NDO_DATA_HASBEENCHECKED,NDO2DB_COLUMN_INT,"has_been_checked"},
+	{NDO_DATA_SHOULDBESCHEDULED,NDO2DB_COLUMN_INT,"should_be_scheduled"},
+	{NDO_DATA_CURRENTCHECKATTEMPT,NDO2DB_COLUMN_INT,"current_check_attempt"},
+	{NDO_DATA_MAXCHECKATTEMPTS,NDO2DB_COLUMN_INT,"max_check_attempts"},
+	{NDO_DATA_LASTHOSTCHECK,NDO2DB_COLUMN_TIMET,"last_check"},
+	{NDO_DATA_NEXTHOSTCHECK,NDO2DB_COLUMN_TIMET,"next_check"},
+	{NDO_DATA_CHECKTYPE,NDO2DB_COLUMN_INT,"check_type"},
+	{NDO_DATA_LASTSTATECHANGE,NDO2DB_COLUMN_TIMET,"last_state_change"},
+	{NDO_DATA_LASTHARDSTATECHANGE,NDO2DB_COLUMN_TIMET,"last_hard_state_change"},
+	{NDO_DATA_LASTHARDSTATE,NDO2DB_COLUMN_INT,"last_hard_state"},
+	{NDO_DATA_LASTTIMEUP,NDO2DB_COLUMN_TIMET,"last_time_up"},
+	{NDO_DATA_LASTTIMEDOWN,NDO2DB_COLUMN_TIMET,"last_time_down"},
+	{NDO_DATA_LASTTIMEUNREACHABLE,NDO2DB_COLUMN_TIMET,"last_time_unreachable"},
+	{NDO_DATA_STATETYPE,NDO2DB_COLUMN_INT,"state_type"},
+	{NDO_DATA_LASTHOSTNOTIFICATION,NDO2DB_COLUMN_TIMET,"last_notification"},
+	{NDO_DATA_NEXTHOSTNOTIFICATION,NDO2DB_COLUMN_TIMET,"next_notification"},
+	{NDO_DATA_NOMORENOTIFICATIONS,NDO2DB_COLUMN_INT,"no_more_notifications"},
+	{NDO_DATA_NOTIFICATIONSENABLED,NDO2DB_COLUMN_INT,"notifications_enabled"},
+	{NDO_DATA_PROBLEMHASBEENACKNOWLEDGED,NDO2DB_COLUMN_INT,"problem_has_been_acknowledged"},
+	{NDO_DATA_ACKNOWLEDGEMENTTYPE,NDO2DB_COLUMN_INT,"acknowledgement_type"},
+	{NDO_DATA_CURRENTNOTIFICATIONNUMBER,NDO2DB_COLUMN_INT,"current_notification_number"},
+	{NDO_DATA_PASSIVEHOSTCHECKSENABLED,NDO2DB_COLUMN_INT,"passive_checks_enabled"},
+	{NDO_DATA_ACTIVEHOSTCHECKSENABLED,NDO2DB_COLUMN_INT,"active_checks_enabled"},
+	{NDO_DATA_EVENTHANDLERENABLED,NDO2DB_COLUMN_INT,"event_handler_enabled"},
+	{NDO_DATA_FLAPDETECTIONENABLED,NDO2DB_COLUMN_INT,"flap_detection_enabled"},
+	{NDO_DATA_ISFLAPPING,NDO2DB_COLUMN_INT,"is_flapping"},
+	{NDO_DATA_PERCENTSTATECHANGE,NDO2DB_COLUMN_DOUBLE,"percent_state_change"},
+	{NDO_DATA_LATENCY,NDO2DB_COLUMN_DOUBLE,"latency"},
+	{NDO_DATA_EXECUTIONTIME,NDO2DB_COLUMN_DOUBLE,"execution_time"},
+	{NDO_DATA_SCHEDULEDDOWNTIMEDEPTH,NDO2DB_COLUMN_INT,"scheduled_downtime_depth"},
+	{NDO_DATA_FAILUREPREDICTIONENABLED,NDO2DB_COLUMN_INT,"failure_prediction_enabled"},
+	{NDO_DATA_PROCESSPERFORMANCEDATA,NDO2DB_COLUMN_INT,"process_performance_data"},
+	{NDO_DATA_OBSESSOVERHOST,NDO2DB_COLUMN_INT,"obsess_over_host"},
+	{NDO_DATA_MODIFIEDHOSTATTRIBUTES,NDO2DB_COLUMN_ULONG,"modified_host_attributes"},
+	{NDO_DATA_EVENTHANDLER,NDO2DB_COLUMN_STRING,"event_handler"},
+	{NDO_DATA_CHECKCOMMAND,NDO2DB_COLUMN_STRING,"check_command"},
+	{NDO_DATA_NORMALCHECKINTERVAL,NDO2DB_COLUMN_DOUBLE,"normal_check_interval"},
+	{NDO_DATA_RETRYCHECKINTERVAL,NDO2DB_COLUMN_DOUBLE,"retry_check_interval"},
+	{NDO_DATA_HOSTCHECKPERIOD,NDO2DB_COLUMN_TIMEPERIOD,"check_timeperiod_object_id"}
+        };
+
+/* columns that may appear in a service status delta */
+static ndo2db_status_column ndo2db_servicestatus_columns[]={
+	{NDO_DATA_OUTPUT,NDO2DB_COLUMN_STRING,"output"},
+	{NDO_DATA_LONGOUTPUT,NDO2DB_COLUMN_STRING,"long_output"},
+	{NDO_DATA_PERFDATA,NDO2DB_COLUMN_STRING,"perfdata"},
+	{NDO_DATA_CURRENTSTATE,NDO2DB_COLUMN_INT,"current_state"},
+	{NDO_DATA_HASBEENCHECKED,NDO2DB_COLUMN_INT,"has_been_checked"},
+	{NDO_DATA_SHOULDBESCHEDULED,NDO2DB_COLUMN_INT,"should_be_scheduled"},
+	{NDO_DATA_CURRENTCHECKATTEMPT,NDO2DB_COLUMN_INT,"current_check_attempt"},
+	{NDO_DATA_MAXCHECKATTEMPTS,NDO2DB_COLUMN_INT,"max_check_attempts"},
+	{NDO_DATA_LASTSERVICECHECK,NDO2DB_COLUMN_TIMET,"last_check"},
+	{NDO_DATA_NEXTSERVICECHECK,NDO2DB_COLUMN_TIMET,"next_check"},
+	{NDO_DATA_CHECKTYPE,NDO2DB_COLUMN_INT,"check_type"},
+	{NDO_DATA_LASTSTATECHANGE,NDO2DB_COLUMN_TIMET,"last_state_change"},
+	{NDO_DATA_LASTHARDSTATECHANGE,NDO2DB_COLUMN_TIMET,"last_hard_state_change"},
+	{NDO_DATA_LASTHARDSTATE,NDO2DB_COLUMN_INT,"last_hard_state"},
+	{NDO_DATA_LASTTIMEOK,NDO2DB_COLUMN_TIMET,"last_time_ok"},
+	{NDO_DATA_LASTTIMEWARNING,NDO2DB_COLUMN_TIMET,"last_time_warning"},
+	{NDO_DATA_LASTTIMEUNKNOWN,NDO2DB_COLUMN_TIMET,"last_time_unknown"},
+	{NDO_DATA_LASTTIMECRITICAL,NDO2DB_COLUMN_TIMET,"last_time_critical"},
+	{NDO_DATA_STATETYPE,NDO2DB_COLUMN_INT,"state_type"},
+	{NDO_DATA_LASTSERVICENOTIFICATION,NDO2DB_COLUMN_TIMET,"last_notification"},
+	{NDO_DATA_NEXTSERVICENOTIFICATION,NDO2DB_COLUMN_TIMET,"next_notification"},
+	{NDO_DATA_NOMORENOTIFICATIONS,NDO2DB_COLUMN_INT,"no_more_notifications"},
+	{NDO_DATA_NOTIFICATIONSENABLED,NDO2DB_COLUMN_INT,"notifications_enabled"},
+	{NDO_DATA_PROBLEMHASBEENACKNOWLEDGED,NDO2DB_COLUMN_INT,"problem_has_been_acknowledged"},
+	{NDO_DATA_ACKNOWLEDGEMENTTYPE,NDO2DB_COLUMN_INT,"acknowledgement_type"},
+	{NDO_DATA_CURRENTNOTIFICATIONNUMBER,NDO2DB_COLUMN_INT,"current_notification_number"},
+	{NDO_DATA_PASSIVESERVICECHECKSENABLED,NDO2DB_COLUMN_INT,"passive_checks_enabled"},
+	{NDO_DATA_ACTIVESERVICECHECKSENABLED,NDO2DB_COLUMN_INT,"active_checks_enabled"},
+	{NDO_DATA_EVENTHANDLERENABLED,NDO2DB_COLUMN_INT,"event_handler_enabled"},
+	{NDO_DATA_FLAPDETECTIONENABLED,NDO2DB_COLUMN_INT,"flap_detection_enabled"},
+	{NDO_DATA_ISFLAPPING,NDO2DB_COLUMN_INT,"is_flapping"},
+	{NDO_DATA_PERCENTSTATECHANGE,NDO2DB_COLUMN_DOUBLE,"percent_state_change"},
+	{NDO_DATA_LATENCY,NDO2DB_COLUMN_DOUBLE,"latency"},
+	{NDO_DATA_EXECUTIONTIME,NDO2DB_COLUMN_DOUBLE,"execution_time"},
+	{NDO_DATA_SCHEDULEDDOWNTIMEDEPTH,NDO2DB_COLUMN_INT,"scheduled_downtime_depth"},
+	{NDO_DATA_FAILUREPREDICTIONENABLED,NDO2DB_COLUMN_INT,"failure_prediction_enabled"},
+	{NDO_DATA_PROCESSPERFORMANCEDATA,NDO2DB_COLUMN_INT,"process_performance_data"},
+	{NDO_DATA_OBSESSOVERSERVICE,NDO2DB_COLUMN_INT,"obsess_over_service"},
+	{NDO_DATA_MODIFIEDSERVICEATTRIBUTES,NDO2DB_COLUMN_ULONG,"modified_service_attributes"},
+	{NDO_DATA_EVENTHANDLER,NDO2DB_COLUMN_STRING,"event_handler"},
+	{NDO_DATA_CHECKCOMMAND,NDO2DB_COLUMN_STRING,"check_command"},
+	{NDO_DATA_NORMALCHECKINTERVAL,NDO2DB_COLUMN_DOUBLE,"normal_check_interval"},
+	{NDO_DATA_RETRYCHECKINTERVAL,NDO2DB_COLUMN_DOUBLE,"retry_check_interval"},
+	{NDO_DATA_SERVICECHECKPERIOD,NDO2DB_COLUMN_TIMEPERIOD,"check_timeperiod_object_id"}
+        };
+
+
+/* applies a status delta - only the columns present in the message are updated */
+int ndo2db_handle_statusdeltadata(ndo2db_idi *idi, int table, int object_type, char *id_column, ndo2db_status_column *columns, int ncolumns){
+	int type,flags,attr;
+	struct timeval tstamp;
+	ndo_dbuf dbuf;
+	unsigned long object_id=0L;
+	unsigned long ulval=0L;
+	double dval=0.0;
+	int ival=0;
+	char *val=NULL;
+	char *ts=NULL;
+	char *es=NULL;
+	int es_allocated=NDO_FALSE;
+	char *buf=NULL;
+	int result=NDO_OK;
+	int x=0;
+
+	if(idi==NULL)
+		return NDO_ERROR;
+
+	/* convert timestamp, etc */
+	result=ndo2db_convert_standard_data_elements(idi,&type,&flags,&attr,&tstamp);
+
+	/* skip precheck/old data */
+	if(tstamp.tv_sec<idi->dbinfo.latest_realtime_data_time)
+		return NDO_OK;
+
+	/* get the object id */
+	if(object_type==NDO2DB_OBJECTTYPE_SERVICE)
+		result=ndo2db_get_object_id_with_key(idi,object_type,idi->buffered_input[NDO_DATA_HOST],idi->buffered_input[NDO_DATA_SERVICE],&object_id);
+	else
+		result=ndo2db_get_object_id_with_key(idi,object_type,idi->buffered_input[NDO_DATA_HOST],NULL,&object_id);
+
+	ts=ndo2db_db_timet_to_sql(idi,tstamp.tv_sec);
+
+	ndo_dbuf_init(&dbuf,1024);
+	if(asprintf(&buf,"status_update_time=%s",ts)==-1)
+		buf=NULL;
+	ndo_dbuf_strcat(&dbuf,buf);
+	free(buf);
+
+	/* add each column that was sent */
+	for(x=0;x<ncolumns;x++){
+
+		if(ndo2db_has_input(idi,columns[x].key)==NDO_FALSE)
+			continue;
+		val=idi->buffered_input[columns[x].key];
+
+		buf=NULL;
+		switch(columns[x].type){
+		case NDO2DB_COLUMN_INT:
+			result=ndo2db_get_input_int(idi,columns[x].key,&ival);
+			if(asprintf(&buf,", %s='%d'",columns[x].name,ival)==-1)
+				buf=NULL;
+			break;
+		case NDO2DB_COLUMN_ULONG:
+			result=ndo2db_get_input_unsignedlong(idi,columns[x].key,&ulval);
+			if(asprintf(&buf,", %s='%lu'",columns[x].name,ulval)==-1)
+				buf=NULL;
+			break;
+		case NDO2DB_COLUMN_DOUBLE:
+			result=ndo2db_get_input_double(idi,columns[x].key,&dval);
+			if(asprintf(&buf,", %s='%lf'",columns[x].name,dval)==-1)
+				buf=NULL;
+			break;
+		case NDO2DB_COLUMN_TIMET:
+			result=ndo2db_get_input_unsignedlong(idi,columns[x].key,&ulval);
+			es=ndo2db_db_timet_to_sql(idi,(time_t)ulval);
+			if(asprintf(&buf,", %s=%s",columns[x].name,(es==NULL)?"NULL":es)==-1)
+				buf=NULL;
+			free(es);
+			break;
+		case NDO2DB_COLUMN_STRING:
+			es=ndo2db_db_escape_string(idi,val,&es_allocated);
+			if(asprintf(&buf,", %s='%s'",columns[x].name,(es==NULL)?"":es)==-1)
+				buf=NULL;
+			if(es_allocated==NDO_TRUE)
+				free(es);
+			break;
+		case NDO2DB_COLUMN_TIMEPERIOD:
+			ulval=0L;
+			result=ndo2db_get_object_id_with_insert(idi,NDO2DB_OBJECTTYPE_TIMEPERIOD,val,NULL,&ulval);
+			if(asprintf(&buf,", %s='%lu'",columns[x].name,ulval)==-1)
+				buf=NULL;
+			break;
+		default:
+			break;
+		        }
+
+		if(buf!=NULL)
+			ndo_dbuf_strcat(&dbuf,buf);
+		free(buf);
+	        }
+
+	/* a delta older than the stored status changes nothing */
+	if(asprintf(&buf,"UPDATE %s SET %s WHERE instance_id='%lu' AND %s='%lu' AND status_update_time<=%s"
+		    ,ndo2db_db_tablenames[table]
+		    ,(dbuf.buf==NULL)?"":dbuf.buf
+		    ,idi->dbinfo.instance_id
+		    ,id_column
+		    ,object_id
+		    ,ts
+		   )==-1)
+		buf=NULL;
+
+	/* save entry to db */
+	result=ndo2db_db_query(idi,buf);
+	free(buf);
+
+	/* no row was changed - the object may have no status row yet (say the table was cleared after the last full update), so insert what we have, but don't replace a newer row */
+	if(result==NDO_OK && mysql_affected_rows(idi->dbinfo.mysql_link)==0){
+		if(asprintf(&buf,"INSERT IGNORE INTO %s SET instance_id='%lu', %s='%lu', %s"
+			    ,ndo2db_db_tablenames[table]
+			    ,idi->dbinfo.instance_id
+			    ,id_column
+			    ,object_id
+			    ,(dbuf.buf==NULL)?"":dbuf.buf
+			   )==-1)
+			buf=NULL;
+		result=ndo2db_db_query(idi,buf);
+		free(buf);
+		}
+	ndo_dbuf_free(&dbuf);
+
+	/* save custom variables to db */
+	result=ndo2db_save_custom_variables(idi,NDO2DB_DBTABLE_CUSTOMVARIABLESTATUS,object_id,ts);
+	free(ts);
+
+	return NDO_OK;
+        }
+
+
+int ndo2db_handle_hoststatusdeltadata(ndo2db_idi *idi){
+
+	return ndo2db_handle_statusdeltadata(idi,NDO2DB_DBTABLE_HOSTSTATUS,NDO2DB_OBJECTTYPE_HOST,"host_object_id",ndo2db_hoststatus_columns,NAGIOS_SIZEOF_ARRAY(ndo2db_hoststatus_columns));
+        }
+
+
+int ndo2db_handle_servicestatusdeltadata(ndo2db_idi *idi){
+
+	return ndo2db_handle_statusdeltadata(idi,NDO2DB_DBTABLE_SERVICESTATUS,NDO2DB_OBJECTTYPE_SERVICE,"service_object_id",ndo2db_servicestatus_columns,NAGIOS_SIZEOF_ARRAY(ndo2db_servicestatus_columns));
+        }
+
+
+
 int ndo2db_handle_contactstatusdata(ndo2db_idi *idi){
 	int type,flags,attr;
 	struct timeval tstamp;
@@ -2615,7 +3376,6 @@ int ndo2db_handle_contactstatusdata(ndo2db_idi *idi){
 	int host_notifications_enabled=0;
 	int service_notifications_enabled=0;
 	char *ts[3];
-	char *buf=NULL;
 	char *buf1=NULL;
 	unsigned long object_id=0L;
 	int x=0;
@@ -2632,13 +3392,13 @@ int ndo2db_handle_contactstatusdata(ndo2db_idi *idi){
 		return NDO_OK;
 
 	/* covert vars */
-	result=ndo2db_convert_string_to_unsignedlong(idi->buffered_input[NDO_DATA_LASTHOSTNOTIFICATION],&last_host_notification);
-	result=ndo2db_convert_string_to_unsignedlong(idi->buffered_input[NDO_DATA_LASTSERVICENOTIFICATION],&last_service_notification);
-	result=ndo2db_convert_string_to_unsignedlong(idi->buffered_input[NDO_DATA_MODIFIEDCONTACTATTRIBUTES],&modified_attributes);
-	result=ndo2db_convert_string_to_unsignedlong(idi->buffered_input[NDO_DATA_MODIFIEDHOSTATTRIBUTES],&modified_host_attributes);
-	result=ndo2db_convert_string_to_unsignedlong(idi->buffered_input[NDO_DATA_MODIFIEDSERVICEATTRIBUTES],&modified_service_attributes);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_HOSTNOTIFICATIONSENABLED],&host_notifications_enabled);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_SERVICENOTIFICATIONSENABLED],&service_notifications_enabled);
+	result=ndo2db_get_input_unsignedlong(idi,NDO_DATA_LASTHOSTNOTIFICATION,&last_host_notification);
+	result=ndo2db_get_input_unsignedlong(idi,NDO_DATA_LASTSERVICENOTIFICATION,&last_service_notification);
+	result=ndo2db_get_input_unsignedlong(idi,NDO_DATA_MODIFIEDCONTACTATTRIBUTES,&modified_attributes);
+	result=ndo2db_get_input_unsignedlong(idi,NDO_DATA_MODIFIEDHOSTATTRIBUTES,&modified_host_attributes);
+	result=ndo2db_get_input_unsignedlong(idi,NDO_DATA_MODIFIEDSERVICEATTRIBUTES,&modified_service_attributes);
+	result=ndo2db_get_input_int(idi,NDO_DATA_HOSTNOTIFICATIONSENABLED,&host_notifications_enabled);
+	result=ndo2db_get_input_int(idi,NDO_DATA_SERVICENOTIFICATIONSENABLED,&service_notifications_enabled);
 
 	ts[0]=ndo2db_db_timet_to_sql(idi,tstamp.tv_sec);
 	ts[1]=ndo2db_db_timet_to_sql(idi,last_host_notification);
@@ -2662,16 +3422,8 @@ int ndo2db_handle_contactstatusdata(ndo2db_idi *idi){
 		   )==-1)
 		buf1=NULL;
 
-	if(asprintf(&buf,"INSERT INTO %s SET %s ON DUPLICATE KEY UPDATE %s"
-		    ,ndo2db_db_tablenames[NDO2DB_DBTABLE_CONTACTSTATUS]
-		    ,buf1
-		    ,buf1
-		   )==-1)
-		buf=NULL;
-
 	/* save entry to db */
-	result=ndo2db_db_query(idi,buf);
-	free(buf);
+	result=ndo2db_save_status_row(idi,NDO2DB_DBTABLE_CONTACTSTATUS,"contact_object_id",object_id,ts[0],buf1);
 	free(buf1);
 
 	/* save custom variables to db */
@@ -2736,6 +3488,7 @@ int ndo2db_handle_externalcommanddata(ndo2db_idi *idi){
 	struct timeval tstamp;
 	char *ts=NULL;
 	char *es[2];
+	int es_allocated[2]={NDO_FALSE};
 	int command_type=0;
 	unsigned long entry_time=0L;
 	char *buf=NULL;
@@ -2752,11 +3505,11 @@ int ndo2db_handle_externalcommanddata(ndo2db_idi *idi){
 		return NDO_OK;
 
 	/* covert vars */
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_COMMANDTYPE],&command_type);
-	result=ndo2db_convert_string_to_unsignedlong(idi->buffered_input[NDO_DATA_ENTRYTIME],&entry_time);
+	result=ndo2db_get_input_int(idi,NDO_DATA_COMMANDTYPE,&command_type);
+	result=ndo2db_get_input_unsignedlong(idi,NDO_DATA_ENTRYTIME,&entry_time);
 
-	es[0]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_COMMANDSTRING]);
-	es[1]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_COMMANDARGS]);
+	es[0]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_COMMANDSTRING],&es_allocated[0]);
+	es[1]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_COMMANDARGS],&es_allocated[1]);
 
 	ts=ndo2db_db_timet_to_sql(idi,entry_time);
 
@@ -2775,7 +3528,8 @@ int ndo2db_handle_externalcommanddata(ndo2db_idi *idi){
 
         /* free memory */
 	for (x = 0; x < NAGIOS_SIZEOF_ARRAY(es); x++)
-		free(es[x]);
+		if(es_allocated[x]==NDO_TRUE)
+			free(es[x]);
 	free(ts);
 
 	return NDO_OK;
@@ -2816,6 +3570,7 @@ int ndo2db_handle_acknowledgementdata(ndo2db_idi *idi){
 	int result=NDO_OK;
 	char *ts[1];
 	char *es[2];
+	int es_allocated[2]={NDO_FALSE};
 	int x=0;
 	char *buf=NULL;
 	char *buf1=NULL;
@@ -2827,22 +3582,22 @@ int ndo2db_handle_acknowledgementdata(ndo2db_idi *idi){
 	result=ndo2db_convert_standard_data_elements(idi,&type,&flags,&attr,&tstamp);
 
 	/* convert vars */
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_ACKNOWLEDGEMENTTYPE],&acknowledgement_type);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_STATE],&state);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_STICKY],&is_sticky);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_PERSISTENT],&persistent_comment);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_NOTIFYCONTACTS],&notify_contacts);
+	result=ndo2db_get_input_int(idi,NDO_DATA_ACKNOWLEDGEMENTTYPE,&acknowledgement_type);
+	result=ndo2db_get_input_int(idi,NDO_DATA_STATE,&state);
+	result=ndo2db_get_input_int(idi,NDO_DATA_STICKY,&is_sticky);
+	result=ndo2db_get_input_int(idi,NDO_DATA_PERSISTENT,&persistent_comment);
+	result=ndo2db_get_input_int(idi,NDO_DATA_NOTIFYCONTACTS,&notify_contacts);
 
-	es[0]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_AUTHORNAME]);
-	es[1]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_COMMENT]);
+	es[0]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_AUTHORNAME],&es_allocated[0]);
+	es[1]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_COMMENT],&es_allocated[1]);
 
 	ts[0]=ndo2db_db_timet_to_sql(idi,tstamp.tv_sec);
 
 	/* get the object id */
 	if(acknowledgement_type==SERVICE_ACKNOWLEDGEMENT)
-		result=ndo2db_get_object_id_with_insert(idi,NDO2DB_OBJECTTYPE_SERVICE,idi->buffered_input[NDO_DATA_HOST],idi->buffered_input[NDO_DATA_SERVICE],&object_id);
+		result=ndo2db_get_object_id_with_key(idi,NDO2DB_OBJECTTYPE_SERVICE,idi->buffered_input[NDO_DATA_HOST],idi->buffered_input[NDO_DATA_SERVICE],&object_id);
 	if(acknowledgement_type==HOST_ACKNOWLEDGEMENT)
-		result=ndo2db_get_object_id_with_insert(idi,NDO2DB_OBJECTTYPE_HOST,idi->buffered_input[NDO_DATA_HOST],NULL,&object_id);
+		result=ndo2db_get_object_id_with_key(idi,NDO2DB_OBJECTTYPE_HOST,idi->buffered_input[NDO_DATA_HOST],NULL,&object_id);
 
 	/* save entry to db */
 	if(asprintf(&buf,"instance_id='%lu', entry_time=%s, entry_time_usec='%lu', acknowledgement_type='%d', object_id='%lu', state='%d', author_name='%s', comment_data='%s', is_sticky='%d', persistent_comment='%d', notify_contacts='%d'"
@@ -2875,7 +3630,8 @@ int ndo2db_handle_acknowledgementdata(ndo2db_idi *idi){
 	for (x = 0; x < NAGIOS_SIZEOF_ARRAY(ts); x++)
 		free(ts[x]);
 	for (x = 0; x < NAGIOS_SIZEOF_ARRAY(es); x++)
-		free(es[x]);
+		if(es_allocated[x]==NDO_TRUE)
+			free(es[x]);
 
 	return NDO_OK;
         }
@@ -2897,6 +3653,7 @@ int ndo2db_handle_statechangedata(ndo2db_idi *idi){
 	int result=NDO_OK;
 	char *ts[1];
 	char *es[2];
+	int es_allocated[2]={NDO_FALSE};
 	char *buf=NULL;
 
 	if(idi==NULL)
@@ -2910,25 +3667,25 @@ int ndo2db_handle_statechangedata(ndo2db_idi *idi){
 		return NDO_OK;
 
 	/* convert vars */
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_STATECHANGETYPE],&statechange_type);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_STATECHANGE],&state_change_occurred);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_STATE],&state);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_STATETYPE],&state_type);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_CURRENTCHECKATTEMPT],&current_attempt);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_MAXCHECKATTEMPTS],&max_attempts);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_LASTHARDSTATE],&last_hard_state);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_LASTSTATE],&last_state);
-
-	es[0]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_OUTPUT]);
-	es[1]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_LONGOUTPUT]);
+	result=ndo2db_get_input_int(idi,NDO_DATA_STATECHANGETYPE,&statechange_type);
+	result=ndo2db_get_input_int(idi,NDO_DATA_STATECHANGE,&state_change_occurred);
+	result=ndo2db_get_input_int(idi,NDO_DATA_STATE,&state);
+	result=ndo2db_get_input_int(idi,NDO_DATA_STATETYPE,&state_type);
+	result=ndo2db_get_input_int(idi,NDO_DATA_CURRENTCHECKATTEMPT,&current_attempt);
+	result=ndo2db_get_input_int(idi,NDO_DATA_MAXCHECKATTEMPTS,&max_attempts);
+	result=ndo2db_get_input_int(idi,NDO_DATA_LASTHARDSTATE,&last_hard_state);
+	result=ndo2db_get_input_int(idi,NDO_DATA_LASTSTATE,&last_state);
+
+	es[0]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_OUTPUT],&es_allocated[0]);
+	es[1]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_LONGOUTPUT],&es_allocated[1]);
 
 	ts[0]=ndo2db_db_timet_to_sql(idi,tstamp.tv_sec);
 
 	/* get the object id */
 	if(statechange_type==SERVICE_STATECHANGE)
-		result=ndo2db_get_object_id_with_insert(idi,NDO2DB_OBJECTTYPE_SERVICE,idi->buffered_input[NDO_DATA_HOST],idi->buffered_input[NDO_DATA_SERVICE],&object_id);
+		result=ndo2db_get_object_id_with_key(idi,NDO2DB_OBJECTTYPE_SERVICE,idi->buffered_input[NDO_DATA_HOST],idi->buffered_input[NDO_DATA_SERVICE],&object_id);
 	else
-		result=ndo2db_get_object_id_with_insert(idi,NDO2DB_OBJECTTYPE_HOST,idi->buffered_input[NDO_DATA_HOST],NULL,&object_id);
+		result=ndo2db_get_object_id_with_key(idi,NDO2DB_OBJECTTYPE_HOST,idi->buffered_input[NDO_DATA_HOST],NULL,&object_id);
 
 	/* save entry to db */
 	if(asprintf(&buf,"INSERT INTO %s SET instance_id='%lu', state_time=%s, state_time_usec='%lu', object_id='%lu', state_change='%d', state='%d', state_type='%d', current_check_attempt='%d', max_check_attempts='%d', last_state='%d', last_hard_state='%d', output='%s', long_output='%s'"
@@ -2956,7 +3713,8 @@ int ndo2db_handle_statechangedata(ndo2db_idi *idi){
 	for (x = 0; x < NAGIOS_SIZEOF_ARRAY(ts); x++)
 		free(ts[x]);
 	for (x = 0; x < NAGIOS_SIZEOF_ARRAY(es); x++)
-		free(es[x]);
+		if(es_allocated[x]==NDO_TRUE)
+			free(es[x]);
 
 	return NDO_OK;
         }
@@ -2973,6 +3731,7 @@ int ndo2db_handle_configfilevariables(ndo2db_idi *idi, int configfile_type){
 	unsigned long configfile_id=0L;
 	int result=NDO_OK;
 	char *es[3];
+	int es_allocated[3]={NDO_FALSE};
 	int x=0;
 	char *buf=NULL;
 	char *buf1=NULL;
@@ -2997,7 +3756,7 @@ int ndo2db_handle_configfilevariables(ndo2db_idi *idi, int configfile_type){
 
 	ndo2db_log_debug_info(NDO2DB_DEBUGL_SQL,0,"HANDLE_CONFIGFILEVARS [3]\n");
 
-	es[0]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_CONFIGFILENAME]);
+	es[0]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_CONFIGFILENAME],&es_allocated[0]);
 
 	/* add config file to db */
 	if(asprintf(&buf,"instance_id='%lu', configfile_type='%d', configfile_path='%s'"
@@ -3015,12 +3774,13 @@ int ndo2db_handle_configfilevariables(ndo2db_idi *idi, int configfile_type){
 		buf1=NULL;
 
 	if((result=ndo2db_db_query(idi,buf1))==NDO_OK){
-		configfile_id=mysql_insert_id(&idi->dbinfo.mysql_conn);
+		configfile_id=mysql_insert_id(idi->dbinfo.mysql_link);
 	}
 	free(buf);
 	free(buf1);
 
-	free(es[0]);
+	if(es_allocated[0]==NDO_TRUE)
+		free(es[0]);
 
 	/* save config file variables to db */
 	mbuf=idi->mbuf[NDO2DB_MBUF_CONFIGFILEVARIABLE];
@@ -3033,8 +3793,8 @@ int ndo2db_handle_configfilevariables(ndo2db_idi *idi, int configfile_type){
 		varname=strtok(mbuf.buffer[x],"=");
 		varvalue=strtok(NULL,"\x0");
 
-		es[1]=ndo2db_db_escape_string(idi,varname);
-		es[2]=ndo2db_db_escape_string(idi,varvalue);
+		es[1]=ndo2db_db_escape_string(idi,varname,&es_allocated[1]);
+		es[2]=ndo2db_db_escape_string(idi,varvalue,&es_allocated[2]);
 
 		if(asprintf(&buf,"instance_id='%lu', configfile_id='%lu', varname='%s', varvalue='%s'"
 			    ,idi->dbinfo.instance_id
@@ -3062,8 +3822,10 @@ int ndo2db_handle_configfilevariables(ndo2db_idi *idi, int configfile_type){
 		free(buf);
 		free(buf1);
 
-		free(es[1]);
-		free(es[2]);
+		if(es_allocated[1]==NDO_TRUE)
+			free(es[1]);
+		if(es_allocated[2]==NDO_TRUE)
+			free(es[2]);
 	        }
 
 	return NDO_OK;
@@ -3085,6 +3847,7 @@ int ndo2db_handle_runtimevariables(ndo2db_idi *idi){
 	struct timeval tstamp;
 	int result=NDO_OK;
 	char *es[2];
+	int es_allocated[2]={NDO_FALSE};
 	int x=0;
 	char *buf=NULL;
 	char *buf1=NULL;
@@ -3113,8 +3876,8 @@ int ndo2db_handle_runtimevariables(ndo2db_idi *idi){
 		varname=strtok(mbuf.buffer[x],"=");
 		varvalue=strtok(NULL,"\x0");
 
-		es[0]=ndo2db_db_escape_string(idi,varname);
-		es[1]=ndo2db_db_escape_string(idi,varvalue);
+		es[0]=ndo2db_db_escape_string(idi,varname,&es_allocated[0]);
+		es[1]=ndo2db_db_escape_string(idi,varvalue,&es_allocated[1]);
 
 		if(asprintf(&buf,"instance_id='%lu', varname='%s', varvalue='%s'"
 			    ,idi->dbinfo.instance_id
@@ -3134,8 +3897,10 @@ int ndo2db_handle_runtimevariables(ndo2db_idi *idi){
 		free(buf);
 		free(buf1);
 
-		free(es[0]);
-		free(es[1]);
+		if(es_allocated[0]==NDO_TRUE)
+			free(es[0]);
+		if(es_allocated[1]==NDO_TRUE)
+			free(es[1]);
 	        }
 
 	return NDO_OK;
@@ -3167,6 +3932,9 @@ int ndo2db_handle_configdumpstart(ndo2db_idi *idi){
 
 int ndo2db_handle_configdumpend(ndo2db_idi *idi){
 
+	/* save the hashes of what changed and drop objects that weren't dumped */
+	ndo2db_save_config_hashes(idi);
+
 	return NDO_OK;
         }
 
@@ -3220,6 +3988,7 @@ int ndo2db_handle_hostdefinition(ndo2db_idi *idi){
 	unsigned long member_id=0L;
 	int result=NDO_OK;
 	char *es[13];
+	int es_allocated[13]={NDO_FALSE};
 	int x=0;
 	char *buf=NULL;
 	char *buf1=NULL;
@@ -3240,72 +4009,76 @@ int ndo2db_handle_hostdefinition(ndo2db_idi *idi){
 	if(tstamp.tv_sec<idi->dbinfo.latest_realtime_data_time)
 		return NDO_OK;
 
+	/* nothing to do if we already have this definition */
+	if(ndo2db_config_unchanged(idi,NDO2DB_OBJECTTYPE_HOST,idi->buffered_input[NDO_DATA_HOSTNAME],NULL)==NDO_TRUE)
+		return NDO_OK;
+
 	/* convert vars */
-	result=ndo2db_convert_string_to_double(idi->buffered_input[NDO_DATA_HOSTCHECKINTERVAL],&check_interval);
-	result=ndo2db_convert_string_to_double(idi->buffered_input[NDO_DATA_HOSTRETRYINTERVAL],&retry_interval);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_HOSTMAXCHECKATTEMPTS],&max_check_attempts);
-	result=ndo2db_convert_string_to_double(idi->buffered_input[NDO_DATA_FIRSTNOTIFICATIONDELAY],&first_notification_delay);
-	result=ndo2db_convert_string_to_double(idi->buffered_input[NDO_DATA_HOSTNOTIFICATIONINTERVAL],&notification_interval);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_NOTIFYHOSTDOWN],&notify_on_down);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_NOTIFYHOSTUNREACHABLE],&notify_on_unreachable);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_NOTIFYHOSTRECOVERY],&notify_on_recovery);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_NOTIFYHOSTFLAPPING],&notify_on_flapping);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_NOTIFYHOSTDOWNTIME],&notify_on_downtime);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_STALKHOSTONUP],&stalk_on_up);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_STALKHOSTONDOWN],&stalk_on_down);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_STALKHOSTONUNREACHABLE],&stalk_on_unreachable);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_HOSTFLAPDETECTIONENABLED],&flap_detection_enabled);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_FLAPDETECTIONONUP],&flap_detection_on_up);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_FLAPDETECTIONONDOWN],&flap_detection_on_down);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_FLAPDETECTIONONUNREACHABLE],&flap_detection_on_unreachable);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_PROCESSHOSTPERFORMANCEDATA],&process_performance_data);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_HOSTFRESHNESSCHECKSENABLED],&freshness_checks_enabled);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_HOSTFRESHNESSTHRESHOLD],&freshness_threshold);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_PASSIVEHOSTCHECKSENABLED],&passive_checks_enabled);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_HOSTEVENTHANDLERENABLED],&event_handler_enabled);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_ACTIVEHOSTCHECKSENABLED],&active_checks_enabled);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_RETAINHOSTSTATUSINFORMATION],&retain_status_information);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_RETAINHOSTNONSTATUSINFORMATION],&retain_nonstatus_information);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_HOSTNOTIFICATIONSENABLED],&notifications_enabled);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_OBSESSOVERHOST],&obsess_over_host);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_HOSTFAILUREPREDICTIONENABLED],&failure_prediction_enabled);
-	result=ndo2db_convert_string_to_double(idi->buffered_input[NDO_DATA_LOWHOSTFLAPTHRESHOLD],&low_flap_threshold);
-	result=ndo2db_convert_string_to_double(idi->buffered_input[NDO_DATA_HIGHHOSTFLAPTHRESHOLD],&high_flap_threshold);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_HAVE2DCOORDS],&have_2d_coords);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_X2D],&x_2d);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_Y3D],&y_2d);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_HAVE3DCOORDS],&have_3d_coords);
-	result=ndo2db_convert_string_to_double(idi->buffered_input[NDO_DATA_X3D],&x_3d);
-	result=ndo2db_convert_string_to_double(idi->buffered_input[NDO_DATA_Y3D],&y_3d);
-	result=ndo2db_convert_string_to_double(idi->buffered_input[NDO_DATA_Z3D],&z_3d);
+	result=ndo2db_get_input_double(idi,NDO_DATA_HOSTCHECKINTERVAL,&check_interval);
+	result=ndo2db_get_input_double(idi,NDO_DATA_HOSTRETRYINTERVAL,&retry_interval);
+	result=ndo2db_get_input_int(idi,NDO_DATA_HOSTMAXCHECKATTEMPTS,&max_check_attempts);
+	result=ndo2db_get_input_double(idi,NDO_DATA_FIRSTNOTIFICATIONDELAY,&first_notification_delay);
+	result=ndo2db_get_input_double(idi,NDO_DATA_HOSTNOTIFICATIONINTERVAL,&notification_interval);
+	result=ndo2db_get_input_int(idi,NDO_DATA_NOTIFYHOSTDOWN,&notify_on_down);
+	result=ndo2db_get_input_int(idi,NDO_DATA_NOTIFYHOSTUNREACHABLE,&notify_on_unreachable);
+	result=ndo2db_get_input_int(idi,NDO_DATA_NOTIFYHOSTRECOVERY,&notify_on_recovery);
+	result=ndo2db_get_input_int(idi,NDO_DATA_NOTIFYHOSTFLAPPING,&notify_on_flapping);
+	result=ndo2db_get_input_int(idi,NDO_DATA_NOTIFYHOSTDOWNTIME,&notify_on_downtime);
+	result=ndo2db_get_input_int(idi,NDO_DATA_STALKHOSTONUP,&stalk_on_up);
+	result=ndo2db_get_input_int(idi,NDO_DATA_STALKHOSTONDOWN,&stalk_on_down);
+	result=ndo2db_get_input_int(idi,NDO_DATA_STALKHOSTONUNREACHABLE,&stalk_on_unreachable);
+	result=ndo2db_get_input_int(idi,NDO_DATA_HOSTFLAPDETECTIONENABLED,&flap_detection_enabled);
+	result=ndo2db_get_input_int(idi,NDO_DATA_FLAPDETECTIONONUP,&flap_detection_on_up);
+	result=ndo2db_get_input_int(idi,NDO_DATA_FLAPDETECTIONONDOWN,&flap_detection_on_down);
+	result=ndo2db_get_input_int(idi,NDO_DATA_FLAPDETECTIONONUNREACHABLE,&flap_detection_on_unreachable);
+	result=ndo2db_get_input_int(idi,NDO_DATA_PROCESSHOSTPERFORMANCEDATA,&process_performance_data);
+	result=ndo2db_get_input_int(idi,NDO_DATA_HOSTFRESHNESSCHECKSENABLED,&freshness_checks_enabled);
+	result=ndo2db_get_input_int(idi,NDO_DATA_HOSTFRESHNESSTHRESHOLD,&freshness_threshold);
+	result=ndo2db_get_input_int(idi,NDO_DATA_PASSIVEHOSTCHECKSENABLED,&passive_checks_enabled);
+	result=ndo2db_get_input_int(idi,NDO_DATA_HOSTEVENTHANDLERENABLED,&event_handler_enabled);
+	result=ndo2db_get_input_int(idi,NDO_DATA_ACTIVEHOSTCHECKSENABLED,&active_checks_enabled);
+	result=ndo2db_get_input_int(idi,NDO_DATA_RETAINHOSTSTATUSINFORMATION,&retain_status_information);
+	result=ndo2db_get_input_int(idi,NDO_DATA_RETAINHOSTNONSTATUSINFORMATION,&retain_nonstatus_information);
+	result=ndo2db_get_input_int(idi,NDO_DATA_HOSTNOTIFICATIONSENABLED,&notifications_enabled);
+	result=ndo2db_get_input_int(idi,NDO_DATA_OBSESSOVERHOST,&obsess_over_host);
+	result=ndo2db_get_input_int(idi,NDO_DATA_HOSTFAILUREPREDICTIONENABLED,&failure_prediction_enabled);
+	result=ndo2db_get_input_double(idi,NDO_DATA_LOWHOSTFLAPTHRESHOLD,&low_flap_threshold);
+	result=ndo2db_get_input_double(idi,NDO_DATA_HIGHHOSTFLAPTHRESHOLD,&high_flap_threshold);
+	result=ndo2db_get_input_int(idi,NDO_DATA_HAVE2DCOORDS,&have_2d_coords);
+	result=ndo2db_get_input_int(idi,NDO_DATA_X2D,&x_2d);
+	result=ndo2db_get_input_int(idi,NDO_DATA_Y3D,&y_2d);
+	result=ndo2db_get_input_int(idi,NDO_DATA_HAVE3DCOORDS,&have_3d_coords);
+	result=ndo2db_get_input_double(idi,NDO_DATA_X3D,&x_3d);
+	result=ndo2db_get_input_double(idi,NDO_DATA_Y3D,&y_3d);
+	result=ndo2db_get_input_double(idi,NDO_DATA_Z3D,&z_3d);
 #ifdef BUILD_NAGIOS_4X
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_IMPORTANCE],&importance);
+	result=ndo2db_get_input_int(idi,NDO_DATA_IMPORTANCE,&importance);
 #endif
 
-	es[0]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_HOSTADDRESS]);
-	es[1]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_HOSTFAILUREPREDICTIONOPTIONS]);
+	es[0]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_HOSTADDRESS],&es_allocated[0]);
+	es[1]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_HOSTFAILUREPREDICTIONOPTIONS],&es_allocated[1]);
 
 	/* get the check command */
 	cmdptr=strtok(idi->buffered_input[NDO_DATA_HOSTCHECKCOMMAND],"!");
 	argptr=strtok(NULL,"\x0");
 	result=ndo2db_get_object_id_with_insert(idi,NDO2DB_OBJECTTYPE_COMMAND,cmdptr,NULL,&check_command_id);
-	es[2]=ndo2db_db_escape_string(idi,argptr);
+	es[2]=ndo2db_db_escape_string(idi,argptr,&es_allocated[2]);
 
 	/* get the event handler command */
 	cmdptr=strtok(idi->buffered_input[NDO_DATA_HOSTEVENTHANDLER],"!");
 	argptr=strtok(NULL,"\x0");
 	result=ndo2db_get_object_id_with_insert(idi,NDO2DB_OBJECTTYPE_COMMAND,cmdptr,NULL,&eventhandler_command_id);
-	es[3]=ndo2db_db_escape_string(idi,argptr);
-
-	es[4]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_NOTES]);
-	es[5]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_NOTESURL]);
-	es[6]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_ACTIONURL]);
-	es[7]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_ICONIMAGE]);
-	es[8]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_ICONIMAGEALT]);
-	es[9]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_VRMLIMAGE]);
-	es[10]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_STATUSMAPIMAGE]);
-	es[11]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_DISPLAYNAME]);
-	es[12]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_HOSTALIAS]);
+	es[3]=ndo2db_db_escape_string(idi,argptr,&es_allocated[3]);
+
+	es[4]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_NOTES],&es_allocated[4]);
+	es[5]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_NOTESURL],&es_allocated[5]);
+	es[6]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_ACTIONURL],&es_allocated[6]);
+	es[7]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_ICONIMAGE],&es_allocated[7]);
+	es[8]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_ICONIMAGEALT],&es_allocated[8]);
+	es[9]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_VRMLIMAGE],&es_allocated[9]);
+	es[10]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_STATUSMAPIMAGE],&es_allocated[10]);
+	es[11]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_DISPLAYNAME],&es_allocated[11]);
+	es[12]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_HOSTALIAS],&es_allocated[12]);
 
 	/* get the object id */
 	result=ndo2db_get_object_id_with_insert(idi,NDO2DB_OBJECTTYPE_HOST,idi->buffered_input[NDO_DATA_HOSTNAME],NULL,&object_id);
@@ -3393,13 +4166,14 @@ int ndo2db_handle_hostdefinition(ndo2db_idi *idi){
 		buf1=NULL;
 
 	if((result=ndo2db_db_query(idi,buf1))==NDO_OK){
-		host_id=mysql_insert_id(&idi->dbinfo.mysql_conn);
+		host_id=mysql_insert_id(idi->dbinfo.mysql_link);
 	}
 	free(buf);
 	free(buf1);
 
 	for(x=0;x<13;x++)
-		free(es[x]);
+		if(es_allocated[x]==NDO_TRUE)
+			free(es[x]);
 
 	/* save parent hosts to db */
 	mbuf=idi->mbuf[NDO2DB_MBUF_PARENTHOST];
@@ -3503,6 +4277,7 @@ int ndo2db_handle_hostgroupdefinition(ndo2db_idi *idi){
 	unsigned long member_id=0L;
 	int result=NDO_OK;
 	char *es[1];
+	int es_allocated[1]={NDO_FALSE};
 	int x=0;
 	char *buf=NULL;
 	char *buf1=NULL;
@@ -3518,7 +4293,11 @@ int ndo2db_handle_hostgroupdefinition(ndo2db_idi *idi){
 	if(tstamp.tv_sec<idi->dbinfo.latest_realtime_data_time)
 		return NDO_OK;
 
-	es[0]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_HOSTGROUPALIAS]);
+	/* nothing to do if we already have this definition */
+	if(ndo2db_config_unchanged(idi,NDO2DB_OBJECTTYPE_HOSTGROUP,idi->buffered_input[NDO_DATA_HOSTGROUPNAME],NULL)==NDO_TRUE)
+		return NDO_OK;
+
+	es[0]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_HOSTGROUPALIAS],&es_allocated[0]);
 
 	/* get the object id */
 	result=ndo2db_get_object_id_with_insert(idi,NDO2DB_OBJECTTYPE_HOSTGROUP,idi->buffered_input[NDO_DATA_HOSTGROUPNAME],NULL,&object_id);
@@ -3543,12 +4322,13 @@ int ndo2db_handle_hostgroupdefinition(ndo2db_idi *idi){
 		buf1=NULL;
 
 	if((result=ndo2db_db_query(idi,buf1))==NDO_OK){
-		group_id=mysql_insert_id(&idi->dbinfo.mysql_conn);
+		group_id=mysql_insert_id(idi->dbinfo.mysql_link);
 	}
 	free(buf);
 	free(buf1);
 
-	free(es[0]);
+	if(es_allocated[0]==NDO_TRUE)
+		free(es[0]);
 
 	/* save hostgroup members to db */
 	mbuf=idi->mbuf[NDO2DB_MBUF_HOSTGROUPMEMBER];
@@ -3630,6 +4410,7 @@ int ndo2db_handle_servicedefinition(ndo2db_idi *idi){
 	unsigned long member_id=0L;
 	int result=NDO_OK;
 	char *es[9];
+	int es_allocated[9]={NDO_FALSE};
 	int x=0;
 	char *buf=NULL;
 	char *buf1=NULL;
@@ -3652,65 +4433,69 @@ int ndo2db_handle_servicedefinition(ndo2db_idi *idi){
 	if(tstamp.tv_sec<idi->dbinfo.latest_realtime_data_time)
 		return NDO_OK;
 
+	/* nothing to do if we already have this definition */
+	if(ndo2db_config_unchanged(idi,NDO2DB_OBJECTTYPE_SERVICE,idi->buffered_input[NDO_DATA_HOSTNAME],idi->buffered_input[NDO_DATA_SERVICEDESCRIPTION])==NDO_TRUE)
+		return NDO_OK;
+
 	/* convert vars */
-	result=ndo2db_convert_string_to_double(idi->buffered_input[NDO_DATA_SERVICECHECKINTERVAL],&check_interval);
-	result=ndo2db_convert_string_to_double(idi->buffered_input[NDO_DATA_SERVICERETRYINTERVAL],&retry_interval);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_MAXSERVICECHECKATTEMPTS],&max_check_attempts);
-	result=ndo2db_convert_string_to_double(idi->buffered_input[NDO_DATA_FIRSTNOTIFICATIONDELAY],&first_notification_delay);
-	result=ndo2db_convert_string_to_double(idi->buffered_input[NDO_DATA_SERVICENOTIFICATIONINTERVAL],&notification_interval);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_NOTIFYSERVICEWARNING],&notify_on_warning);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_NOTIFYSERVICEUNKNOWN],&notify_on_unknown);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_NOTIFYSERVICECRITICAL],&notify_on_critical);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_NOTIFYSERVICERECOVERY],&notify_on_recovery);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_NOTIFYSERVICEFLAPPING],&notify_on_flapping);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_NOTIFYSERVICEDOWNTIME],&notify_on_downtime);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_STALKSERVICEONOK],&stalk_on_ok);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_STALKSERVICEONWARNING],&stalk_on_warning);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_STALKSERVICEONUNKNOWN],&stalk_on_unknown);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_STALKSERVICEONCRITICAL],&stalk_on_critical);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_SERVICEISVOLATILE],&is_volatile);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_SERVICEFLAPDETECTIONENABLED],&flap_detection_enabled);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_FLAPDETECTIONONOK],&flap_detection_on_ok);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_FLAPDETECTIONONWARNING],&flap_detection_on_warning);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_FLAPDETECTIONONUNKNOWN],&flap_detection_on_unknown);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_FLAPDETECTIONONCRITICAL],&flap_detection_on_critical);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_PROCESSSERVICEPERFORMANCEDATA],&process_performance_data);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_SERVICEFRESHNESSCHECKSENABLED],&freshness_checks_enabled);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_SERVICEFRESHNESSTHRESHOLD],&freshness_threshold);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_PASSIVESERVICECHECKSENABLED],&passive_checks_enabled);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_SERVICEEVENTHANDLERENABLED],&event_handler_enabled);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_ACTIVESERVICECHECKSENABLED],&active_checks_enabled);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_RETAINSERVICESTATUSINFORMATION],&retain_status_information);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_RETAINSERVICENONSTATUSINFORMATION],&retain_nonstatus_information);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_SERVICENOTIFICATIONSENABLED],&notifications_enabled);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_OBSESSOVERSERVICE],&obsess_over_service);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_SERVICEFAILUREPREDICTIONENABLED],&failure_prediction_enabled);
-	result=ndo2db_convert_string_to_double(idi->buffered_input[NDO_DATA_LOWSERVICEFLAPTHRESHOLD],&low_flap_threshold);
-	result=ndo2db_convert_string_to_double(idi->buffered_input[NDO_DATA_HIGHSERVICEFLAPTHRESHOLD],&high_flap_threshold);
+	result=ndo2db_get_input_double(idi,NDO_DATA_SERVICECHECKINTERVAL,&check_interval);
+	result=ndo2db_get_input_double(idi,NDO_DATA_SERVICERETRYINTERVAL,&retry_interval);
+	result=ndo2db_get_input_int(idi,NDO_DATA_MAXSERVICECHECKATTEMPTS,&max_check_attempts);
+	result=ndo2db_get_input_double(idi,NDO_DATA_FIRSTNOTIFICATIONDELAY,&first_notification_delay);
+	result=ndo2db_get_input_double(idi,NDO_DATA_SERVICENOTIFICATIONINTERVAL,&notification_interval);
+	result=ndo2db_get_input_int(idi,NDO_DATA_NOTIFYSERVICEWARNING,&notify_on_warning);
+	result=ndo2db_get_input_int(idi,NDO_DATA_NOTIFYSERVICEUNKNOWN,&notify_on_unknown);
+	result=ndo2db_get_input_int(idi,NDO_DATA_NOTIFYSERVICECRITICAL,&notify_on_critical);
+	result=ndo2db_get_input_int(idi,NDO_DATA_NOTIFYSERVICERECOVERY,&notify_on_recovery);
+	result=ndo2db_get_input_int(idi,NDO_DATA_NOTIFYSERVICEFLAPPING,&notify_on_flapping);
+	result=ndo2db_get_input_int(idi,NDO_DATA_NOTIFYSERVICEDOWNTIME,&notify_on_downtime);
+	result=ndo2db_get_input_int(idi,NDO_DATA_STALKSERVICEONOK,&stalk_on_ok);
+	result=ndo2db_get_input_int(idi,NDO_DATA_STALKSERVICEONWARNING,&stalk_on_warning);
+	result=ndo2db_get_input_int(idi,NDO_DATA_STALKSERVICEONUNKNOWN,&stalk_on_unknown);
+	result=ndo2db_get_input_int(idi,NDO_DATA_STALKSERVICEONCRITICAL,&stalk_on_critical);
+	result=ndo2db_get_input_int(idi,NDO_DATA_SERVICEISVOLATILE,&is_volatile);
+	result=ndo2db_get_input_int(idi,NDO_DATA_SERVICEFLAPDETECTIONENABLED,&flap_detection_enabled);
+	result=ndo2db_get_input_int(idi,NDO_DATA_FLAPDETECTIONONOK,&flap_detection_on_ok);
+	result=ndo2db_get_input_int(idi,NDO_DATA_FLAPDETECTIONONWARNING,&flap_detection_on_warning);
+	result=ndo2db_get_input_int(idi,NDO_DATA_FLAPDETECTIONONUNKNOWN,&flap_detection_on_unknown);
+	result=ndo2db_get_input_int(idi,NDO_DATA_FLAPDETECTIONONCRITICAL,&flap_detection_on_critical);
+	result=ndo2db_get_input_int(idi,NDO_DATA_PROCESSSERVICEPERFORMANCEDATA,&process_performance_data);
+	result=ndo2db_get_input_int(idi,NDO_DATA_SERVICEFRESHNESSCHECKSENABLED,&freshness_checks_enabled);
+	result=ndo2db_get_input_int(idi,NDO_DATA_SERVICEFRESHNESSTHRESHOLD,&freshness_threshold);
+	result=ndo2db_get_input_int(idi,NDO_DATA_PASSIVESERVICECHECKSENABLED,&passive_checks_enabled);
+	result=ndo2db_get_input_int(idi,NDO_DATA_SERVICEEVENTHANDLERENABLED,&event_handler_enabled);
+	result=ndo2db_get_input_int(idi,NDO_DATA_ACTIVESERVICECHECKSENABLED,&active_checks_enabled);
+	result=ndo2db_get_input_int(idi,NDO_DATA_RETAINSERVICESTATUSINFORMATION,&retain_status_information);
+	result=ndo2db_get_input_int(idi,NDO_DATA_RETAINSERVICENONSTATUSINFORMATION,&retain_nonstatus_information);
+	result=ndo2db_get_input_int(idi,NDO_DATA_SERVICENOTIFICATIONSENABLED,&notifications_enabled);
+	result=ndo2db_get_input_int(idi,NDO_DATA_OBSESSOVERSERVICE,&obsess_over_service);
+	result=ndo2db_get_input_int(idi,NDO_DATA_SERVICEFAILUREPREDICTIONENABLED,&failure_prediction_enabled);
+	result=ndo2db_get_input_double(idi,NDO_DATA_LOWSERVICEFLAPTHRESHOLD,&low_flap_threshold);
+	result=ndo2db_get_input_double(idi,NDO_DATA_HIGHSERVICEFLAPTHRESHOLD,&high_flap_threshold);
 #ifdef BUILD_NAGIOS_4X
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_IMPORTANCE],&importance);
+	result=ndo2db_get_input_int(idi,NDO_DATA_IMPORTANCE,&importance);
 #endif
 
-	es[0]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_SERVICEFAILUREPREDICTIONOPTIONS]);
+	es[0]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_SERVICEFAILUREPREDICTIONOPTIONS],&es_allocated[0]);
 
 	/* get the check command */
 	cmdptr=strtok(idi->buffered_input[NDO_DATA_SERVICECHECKCOMMAND],"!");
 	argptr=strtok(NULL,"\x0");
 	result=ndo2db_get_object_id_with_insert(idi,NDO2DB_OBJECTTYPE_COMMAND,cmdptr,NULL,&check_command_id);
-	es[1]=ndo2db_db_escape_string(idi,argptr);
+	es[1]=ndo2db_db_escape_string(idi,argptr,&es_allocated[1]);
 
 	/* get the event handler command */
 	cmdptr=strtok(idi->buffered_input[NDO_DATA_SERVICEEVENTHANDLER],"!");
 	argptr=strtok(NULL,"\x0");
 	result=ndo2db_get_object_id_with_insert(idi,NDO2DB_OBJECTTYPE_COMMAND,cmdptr,NULL,&eventhandler_command_id);
-	es[2]=ndo2db_db_escape_string(idi,argptr);
+	es[2]=ndo2db_db_escape_string(idi,argptr,&es_allocated[2]);
 
-	es[3]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_NOTES]);
-	es[4]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_NOTESURL]);
-	es[5]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_ACTIONURL]);
-	es[6]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_ICONIMAGE]);
-	es[7]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_ICONIMAGEALT]);
-	es[8]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_DISPLAYNAME]);
+	es[3]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_NOTES],&es_allocated[3]);
+	es[4]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_NOTESURL],&es_allocated[4]);
+	es[5]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_ACTIONURL],&es_allocated[5]);
+	es[6]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_ICONIMAGE],&es_allocated[6]);
+	es[7]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_ICONIMAGEALT],&es_allocated[7]);
+	es[8]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_DISPLAYNAME],&es_allocated[8]);
 
 	/* get the object ids */
 	result=ndo2db_get_object_id_with_insert(idi,NDO2DB_OBJECTTYPE_SERVICE,idi->buffered_input[NDO_DATA_HOSTNAME],idi->buffered_input[NDO_DATA_SERVICEDESCRIPTION],&object_id);
@@ -3793,13 +4578,14 @@ int ndo2db_handle_servicedefinition(ndo2db_idi *idi){
 		buf1=NULL;
 
 	if((result=ndo2db_db_query(idi,buf1))==NDO_OK){
-		service_id=mysql_insert_id(&idi->dbinfo.mysql_conn);
+		service_id=mysql_insert_id(idi->dbinfo.mysql_link);
 	}
 	free(buf);
 	free(buf1);
 
 	for(x=0;x<9;x++)
-		free(es[x]);
+		if(es_allocated[x]==NDO_TRUE)
+			free(es[x]);
 
 #ifdef BUILD_NAGIOS_4X
 	/* save parent services to db */
@@ -3907,6 +4693,7 @@ int ndo2db_handle_servicegroupdefinition(ndo2db_idi *idi){
 	unsigned long member_id=0L;
 	int result=NDO_OK;
 	char *es[1];
+	int es_allocated[1]={NDO_FALSE};
 	int x=0;
 	char *buf=NULL;
 	char *buf1=NULL;
@@ -3924,7 +4711,11 @@ int ndo2db_handle_servicegroupdefinition(ndo2db_idi *idi){
 	if(tstamp.tv_sec<idi->dbinfo.latest_realtime_data_time)
 		return NDO_OK;
 
-	es[0]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_SERVICEGROUPALIAS]);
+	/* nothing to do if we already have this definition */
+	if(ndo2db_config_unchanged(idi,NDO2DB_OBJECTTYPE_SERVICEGROUP,idi->buffered_input[NDO_DATA_SERVICEGROUPNAME],NULL)==NDO_TRUE)
+		return NDO_OK;
+
+	es[0]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_SERVICEGROUPALIAS],&es_allocated[0]);
 
 	/* get the object id */
 	result=ndo2db_get_object_id_with_insert(idi,NDO2DB_OBJECTTYPE_SERVICEGROUP,idi->buffered_input[NDO_DATA_SERVICEGROUPNAME],NULL,&object_id);
@@ -3949,12 +4740,13 @@ int ndo2db_handle_servicegroupdefinition(ndo2db_idi *idi){
 		buf1=NULL;
 
 	if((result=ndo2db_db_query(idi,buf1))==NDO_OK){
-		group_id=mysql_insert_id(&idi->dbinfo.mysql_conn);
+		group_id=mysql_insert_id(idi->dbinfo.mysql_link);
 	}
 	free(buf);
 	free(buf1);
 
-	free(es[0]);
+	if(es_allocated[0]==NDO_TRUE)
+		free(es[0]);
 
 	/* save members to db */
 	mbuf=idi->mbuf[NDO2DB_MBUF_SERVICEGROUPMEMBER];
@@ -4019,11 +4811,11 @@ int ndo2db_handle_hostdependencydefinition(ndo2db_idi *idi){
 		return NDO_OK;
 
 	/* convert vars */
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_DEPENDENCYTYPE],&dependency_type);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_INHERITSPARENT],&inherits_parent);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_FAILONUP],&fail_on_up);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_FAILONDOWN],&fail_on_down);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_FAILONUNREACHABLE],&fail_on_unreachable);
+	result=ndo2db_get_input_int(idi,NDO_DATA_DEPENDENCYTYPE,&dependency_type);
+	result=ndo2db_get_input_int(idi,NDO_DATA_INHERITSPARENT,&inherits_parent);
+	result=ndo2db_get_input_int(idi,NDO_DATA_FAILONUP,&fail_on_up);
+	result=ndo2db_get_input_int(idi,NDO_DATA_FAILONDOWN,&fail_on_down);
+	result=ndo2db_get_input_int(idi,NDO_DATA_FAILONUNREACHABLE,&fail_on_unreachable);
 
 	/* get the object ids */
 	result=ndo2db_get_object_id_with_insert(idi,NDO2DB_OBJECTTYPE_HOST,idi->buffered_input[NDO_DATA_HOSTNAME],NULL,&object_id);
@@ -4087,12 +4879,12 @@ int ndo2db_handle_servicedependencydefinition(ndo2db_idi *idi){
 		return NDO_OK;
 
 	/* convert vars */
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_DEPENDENCYTYPE],&dependency_type);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_INHERITSPARENT],&inherits_parent);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_FAILONOK],&fail_on_ok);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_FAILONWARNING],&fail_on_warning);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_FAILONUNKNOWN],&fail_on_unknown);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_FAILONCRITICAL],&fail_on_critical);
+	result=ndo2db_get_input_int(idi,NDO_DATA_DEPENDENCYTYPE,&dependency_type);
+	result=ndo2db_get_input_int(idi,NDO_DATA_INHERITSPARENT,&inherits_parent);
+	result=ndo2db_get_input_int(idi,NDO_DATA_FAILONOK,&fail_on_ok);
+	result=ndo2db_get_input_int(idi,NDO_DATA_FAILONWARNING,&fail_on_warning);
+	result=ndo2db_get_input_int(idi,NDO_DATA_FAILONUNKNOWN,&fail_on_unknown);
+	result=ndo2db_get_input_int(idi,NDO_DATA_FAILONCRITICAL,&fail_on_critical);
 
 	/* get the object ids */
 	result=ndo2db_get_object_id_with_insert(idi,NDO2DB_OBJECTTYPE_SERVICE,idi->buffered_input[NDO_DATA_HOSTNAME],idi->buffered_input[NDO_DATA_SERVICEDESCRIPTION],&object_id);
@@ -4160,12 +4952,12 @@ int ndo2db_handle_hostescalationdefinition(ndo2db_idi *idi){
 		return NDO_OK;
 
 	/* convert vars */
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_FIRSTNOTIFICATION],&first_notification);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_LASTNOTIFICATION],&last_notification);
-	result=ndo2db_convert_string_to_double(idi->buffered_input[NDO_DATA_NOTIFICATIONINTERVAL],&notification_interval);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_ESCALATEONRECOVERY],&escalate_recovery);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_ESCALATEONDOWN],&escalate_down);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_ESCALATEONUNREACHABLE],&escalate_unreachable);
+	result=ndo2db_get_input_int(idi,NDO_DATA_FIRSTNOTIFICATION,&first_notification);
+	result=ndo2db_get_input_int(idi,NDO_DATA_LASTNOTIFICATION,&last_notification);
+	result=ndo2db_get_input_double(idi,NDO_DATA_NOTIFICATIONINTERVAL,&notification_interval);
+	result=ndo2db_get_input_int(idi,NDO_DATA_ESCALATEONRECOVERY,&escalate_recovery);
+	result=ndo2db_get_input_int(idi,NDO_DATA_ESCALATEONDOWN,&escalate_down);
+	result=ndo2db_get_input_int(idi,NDO_DATA_ESCALATEONUNREACHABLE,&escalate_unreachable);
 
 	/* get the object id */
 	result=ndo2db_get_object_id_with_insert(idi,NDO2DB_OBJECTTYPE_HOST,idi->buffered_input[NDO_DATA_HOSTNAME],NULL,&object_id);
@@ -4196,7 +4988,7 @@ int ndo2db_handle_hostescalationdefinition(ndo2db_idi *idi){
 		buf1=NULL;
 
 	if((result=ndo2db_db_query(idi,buf1))==NDO_OK){
-		escalation_id=mysql_insert_id(&idi->dbinfo.mysql_conn);
+		escalation_id=mysql_insert_id(idi->dbinfo.mysql_link);
 	}
 	free(buf);
 	free(buf1);
@@ -4294,13 +5086,13 @@ int ndo2db_handle_serviceescalationdefinition(ndo2db_idi *idi){
 		return NDO_OK;
 
 	/* convert vars */
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_FIRSTNOTIFICATION],&first_notification);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_LASTNOTIFICATION],&last_notification);
-	result=ndo2db_convert_string_to_double(idi->buffered_input[NDO_DATA_NOTIFICATIONINTERVAL],&notification_interval);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_ESCALATEONRECOVERY],&escalate_recovery);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_ESCALATEONWARNING],&escalate_warning);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_ESCALATEONUNKNOWN],&escalate_unknown);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_ESCALATEONCRITICAL],&escalate_critical);
+	result=ndo2db_get_input_int(idi,NDO_DATA_FIRSTNOTIFICATION,&first_notification);
+	result=ndo2db_get_input_int(idi,NDO_DATA_LASTNOTIFICATION,&last_notification);
+	result=ndo2db_get_input_double(idi,NDO_DATA_NOTIFICATIONINTERVAL,&notification_interval);
+	result=ndo2db_get_input_int(idi,NDO_DATA_ESCALATEONRECOVERY,&escalate_recovery);
+	result=ndo2db_get_input_int(idi,NDO_DATA_ESCALATEONWARNING,&escalate_warning);
+	result=ndo2db_get_input_int(idi,NDO_DATA_ESCALATEONUNKNOWN,&escalate_unknown);
+	result=ndo2db_get_input_int(idi,NDO_DATA_ESCALATEONCRITICAL,&escalate_critical);
 
 	/* get the object id */
 	result=ndo2db_get_object_id_with_insert(idi,NDO2DB_OBJECTTYPE_SERVICE,idi->buffered_input[NDO_DATA_HOSTNAME],idi->buffered_input[NDO_DATA_SERVICEDESCRIPTION],&object_id);
@@ -4332,7 +5124,7 @@ int ndo2db_handle_serviceescalationdefinition(ndo2db_idi *idi){
 		buf1=NULL;
 
 	if((result=ndo2db_db_query(idi,buf1))==NDO_OK){
-		escalation_id=mysql_insert_id(&idi->dbinfo.mysql_conn);
+		escalation_id=mysql_insert_id(idi->dbinfo.mysql_link);
 	}
 	free(buf);
 	free(buf1);
@@ -4405,6 +5197,7 @@ int ndo2db_handle_commanddefinition(ndo2db_idi *idi){
 	unsigned long object_id=0L;
 	int result=NDO_OK;
 	char *es[1];
+	int es_allocated[1]={NDO_FALSE};
 	int x=0;
 	char *buf=NULL;
 	char *buf1=NULL;
@@ -4419,7 +5212,11 @@ int ndo2db_handle_commanddefinition(ndo2db_idi *idi){
 	if(tstamp.tv_sec<idi->dbinfo.latest_realtime_data_time)
 		return NDO_OK;
 
-	es[0]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_COMMANDLINE]);
+	/* nothing to do if we already have this definition */
+	if(ndo2db_config_unchanged(idi,NDO2DB_OBJECTTYPE_COMMAND,idi->buffered_input[NDO_DATA_COMMANDNAME],NULL)==NDO_TRUE)
+		return NDO_OK;
+
+	es[0]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_COMMANDLINE],&es_allocated[0]);
 
 	/* get the object id */
 	result=ndo2db_get_object_id_with_insert(idi,NDO2DB_OBJECTTYPE_COMMAND,idi->buffered_input[NDO_DATA_COMMANDNAME],NULL,&object_id);
@@ -4448,7 +5245,8 @@ int ndo2db_handle_commanddefinition(ndo2db_idi *idi){
 	free(buf1);
 
 	for(x=0;x<1;x++)
-		free(es[x]);
+		if(es_allocated[x]==NDO_TRUE)
+			free(es[x]);
 
 	return NDO_OK;
         }
@@ -4467,6 +5265,7 @@ int ndo2db_handle_timeperiodefinition(ndo2db_idi *idi){
 	unsigned long end_sec=0L;
 	int result=NDO_OK;
 	char *es[1];
+	int es_allocated[1]={NDO_FALSE};
 	int x=0;
 	char *buf=NULL;
 	char *buf1=NULL;
@@ -4482,7 +5281,11 @@ int ndo2db_handle_timeperiodefinition(ndo2db_idi *idi){
 	if(tstamp.tv_sec<idi->dbinfo.latest_realtime_data_time)
 		return NDO_OK;
 
-	es[0]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_TIMEPERIODALIAS]);
+	/* nothing to do if we already have this definition */
+	if(ndo2db_config_unchanged(idi,NDO2DB_OBJECTTYPE_TIMEPERIOD,idi->buffered_input[NDO_DATA_TIMEPERIODNAME],NULL)==NDO_TRUE)
+		return NDO_OK;
+
+	es[0]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_TIMEPERIODALIAS],&es_allocated[0]);
 
 	/* get the object id */
 	result=ndo2db_get_object_id_with_insert(idi,NDO2DB_OBJECTTYPE_TIMEPERIOD,idi->buffered_input[NDO_DATA_TIMEPERIODNAME],NULL,&object_id);
@@ -4507,12 +5310,13 @@ int ndo2db_handle_timeperiodefinition(ndo2db_idi *idi){
 		buf1=NULL;
 
 	if((result=ndo2db_db_query(idi,buf1))==NDO_OK){
-		timeperiod_id=mysql_insert_id(&idi->dbinfo.mysql_conn);
+		timeperiod_id=mysql_insert_id(idi->dbinfo.mysql_link);
 	}
 	free(buf);
 	free(buf1);
 
-	free(es[0]);
+	if(es_allocated[0]==NDO_TRUE)
+		free(es[0]);
 
 	/* save timeranges to db */
 	mbuf=idi->mbuf[NDO2DB_MBUF_TIMERANGE];
@@ -4581,6 +5385,7 @@ int ndo2db_handle_contactdefinition(ndo2db_idi *idi){
 	unsigned long command_id=0L;
 	int result=NDO_OK;
 	char *es[3];
+	int es_allocated[3]={NDO_FALSE};
 	int x=0;
 	char *buf=NULL;
 	char *buf1=NULL;
@@ -4604,28 +5409,32 @@ int ndo2db_handle_contactdefinition(ndo2db_idi *idi){
 	if(tstamp.tv_sec<idi->dbinfo.latest_realtime_data_time)
 		return NDO_OK;
 
+	/* nothing to do if we already have this definition */
+	if(ndo2db_config_unchanged(idi,NDO2DB_OBJECTTYPE_CONTACT,idi->buffered_input[NDO_DATA_CONTACTNAME],NULL)==NDO_TRUE)
+		return NDO_OK;
+
 	/* convert vars */
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_HOSTNOTIFICATIONSENABLED],&host_notifications_enabled);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_SERVICENOTIFICATIONSENABLED],&service_notifications_enabled);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_CANSUBMITCOMMANDS],&can_submit_commands);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_NOTIFYSERVICEWARNING],&notify_service_warning);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_NOTIFYSERVICEUNKNOWN],&notify_service_unknown);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_NOTIFYSERVICECRITICAL],&notify_service_critical);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_NOTIFYSERVICERECOVERY],&notify_service_recovery);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_NOTIFYSERVICEFLAPPING],&notify_service_flapping);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_NOTIFYSERVICEDOWNTIME],&notify_service_downtime);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_NOTIFYHOSTDOWN],&notify_host_down);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_NOTIFYHOSTUNREACHABLE],&notify_host_unreachable);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_NOTIFYHOSTRECOVERY],&notify_host_recovery);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_NOTIFYHOSTFLAPPING],&notify_host_flapping);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_NOTIFYHOSTDOWNTIME],&notify_host_downtime);
+	result=ndo2db_get_input_int(idi,NDO_DATA_HOSTNOTIFICATIONSENABLED,&host_notifications_enabled);
+	result=ndo2db_get_input_int(idi,NDO_DATA_SERVICENOTIFICATIONSENABLED,&service_notifications_enabled);
+	result=ndo2db_get_input_int(idi,NDO_DATA_CANSUBMITCOMMANDS,&can_submit_commands);
+	result=ndo2db_get_input_int(idi,NDO_DATA_NOTIFYSERVICEWARNING,&notify_service_warning);
+	result=ndo2db_get_input_int(idi,NDO_DATA_NOTIFYSERVICEUNKNOWN,&notify_service_unknown);
+	result=ndo2db_get_input_int(idi,NDO_DATA_NOTIFYSERVICECRITICAL,&notify_service_critical);
+	result=ndo2db_get_input_int(idi,NDO_DATA_NOTIFYSERVICERECOVERY,&notify_service_recovery);
+	result=ndo2db_get_input_int(idi,NDO_DATA_NOTIFYSERVICEFLAPPING,&notify_service_flapping);
+	result=ndo2db_get_input_int(idi,NDO_DATA_NOTIFYSERVICEDOWNTIME,&notify_service_downtime);
+	result=ndo2db_get_input_int(idi,NDO_DATA_NOTIFYHOSTDOWN,&notify_host_down);
+	result=ndo2db_get_input_int(idi,NDO_DATA_NOTIFYHOSTUNREACHABLE,&notify_host_unreachable);
+	result=ndo2db_get_input_int(idi,NDO_DATA_NOTIFYHOSTRECOVERY,&notify_host_recovery);
+	result=ndo2db_get_input_int(idi,NDO_DATA_NOTIFYHOSTFLAPPING,&notify_host_flapping);
+	result=ndo2db_get_input_int(idi,NDO_DATA_NOTIFYHOSTDOWNTIME,&notify_host_downtime);
 #ifdef BUILD_NAGIOS_4X
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_MINIMUMIMPORTANCE],&minimum_importance);
+	result=ndo2db_get_input_int(idi,NDO_DATA_MINIMUMIMPORTANCE,&minimum_importance);
 #endif
 
-	es[0]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_CONTACTALIAS]);
-	es[1]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_EMAILADDRESS]);
-	es[2]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_PAGERADDRESS]);
+	es[0]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_CONTACTALIAS],&es_allocated[0]);
+	es[1]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_EMAILADDRESS],&es_allocated[1]);
+	es[2]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_PAGERADDRESS],&es_allocated[2]);
 
 	/* get the object id */
 	result=ndo2db_get_object_id_with_insert(idi,NDO2DB_OBJECTTYPE_CONTACT,idi->buffered_input[NDO_DATA_CONTACTNAME],NULL,&contact_id);
@@ -4678,13 +5487,14 @@ int ndo2db_handle_contactdefinition(ndo2db_idi *idi){
 		buf1=NULL;
 
 	if((result=ndo2db_db_query(idi,buf1))==NDO_OK){
-		contact_id=mysql_insert_id(&idi->dbinfo.mysql_conn);
+		contact_id=mysql_insert_id(idi->dbinfo.mysql_link);
 	}
 	free(buf);
 	free(buf1);
 
 	for(x=0;x<3;x++)
-		free(es[x]);
+		if(es_allocated[x]==NDO_TRUE)
+			free(es[x]);
 
 	/* save addresses to db */
 	mbuf=idi->mbuf[NDO2DB_MBUF_CONTACTADDRESS];
@@ -4700,7 +5510,7 @@ int ndo2db_handle_contactdefinition(ndo2db_idi *idi){
 			continue;
 
 		address_number=atoi(numptr);
-		es[0]=ndo2db_db_escape_string(idi,addressptr);
+		es[0]=ndo2db_db_escape_string(idi,addressptr,&es_allocated[0]);
 
 		if(asprintf(&buf,"instance_id='%d', contact_id='%lu', address_number='%d', address='%s'"
 			    ,idi->dbinfo.instance_id
@@ -4721,7 +5531,8 @@ int ndo2db_handle_contactdefinition(ndo2db_idi *idi){
 		free(buf);
 		free(buf1);
 
-		free(es[0]);
+		if(es_allocated[0]==NDO_TRUE)
+			free(es[0]);
 	        }
 
 	/* save host notification commands to db */
@@ -4740,7 +5551,7 @@ int ndo2db_handle_contactdefinition(ndo2db_idi *idi){
 		/* find the command */
 		result=ndo2db_get_object_id_with_insert(idi,NDO2DB_OBJECTTYPE_COMMAND,cmdptr,NULL,&command_id);
 
-		es[0]=ndo2db_db_escape_string(idi,argptr);
+		es[0]=ndo2db_db_escape_string(idi,argptr,&es_allocated[0]);
 
 		if(asprintf(&buf,"instance_id='%d', contact_id='%lu', notification_type='%d', command_object_id='%lu', command_args='%s'"
 			    ,idi->dbinfo.instance_id
@@ -4762,7 +5573,8 @@ int ndo2db_handle_contactdefinition(ndo2db_idi *idi){
 		free(buf);
 		free(buf1);
 
-		free(es[0]);
+		if(es_allocated[0]==NDO_TRUE)
+			free(es[0]);
 	        }
 
 	/* save service notification commands to db */
@@ -4781,7 +5593,7 @@ int ndo2db_handle_contactdefinition(ndo2db_idi *idi){
 		/* find the command */
 		result=ndo2db_get_object_id_with_insert(idi,NDO2DB_OBJECTTYPE_COMMAND,cmdptr,NULL,&command_id);
 
-		es[0]=ndo2db_db_escape_string(idi,argptr);
+		es[0]=ndo2db_db_escape_string(idi,argptr,&es_allocated[0]);
 
 		if(asprintf(&buf,"instance_id='%d', contact_id='%lu', notification_type='%d', command_object_id='%lu', command_args='%s'"
 			    ,idi->dbinfo.instance_id
@@ -4803,7 +5615,8 @@ int ndo2db_handle_contactdefinition(ndo2db_idi *idi){
 		free(buf);
 		free(buf1);
 
-		free(es[0]);
+		if(es_allocated[0]==NDO_TRUE)
+			free(es[0]);
 	}
 
 	/* save custom variables to db */
@@ -4821,6 +5634,7 @@ int ndo2db_handle_contactgroupdefinition(ndo2db_idi *idi){
 	unsigned long member_id=0L;
 	int result=NDO_OK;
 	char *es[1];
+	int es_allocated[1]={NDO_FALSE};
 	int x=0;
 	char *buf=NULL;
 	char *buf1=NULL;
@@ -4836,7 +5650,11 @@ int ndo2db_handle_contactgroupdefinition(ndo2db_idi *idi){
 	if(tstamp.tv_sec<idi->dbinfo.latest_realtime_data_time)
 		return NDO_OK;
 
-	es[0]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_CONTACTGROUPALIAS]);
+	/* nothing to do if we already have this definition */
+	if(ndo2db_config_unchanged(idi,NDO2DB_OBJECTTYPE_CONTACTGROUP,idi->buffered_input[NDO_DATA_CONTACTGROUPNAME],NULL)==NDO_TRUE)
+		return NDO_OK;
+
+	es[0]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_CONTACTGROUPALIAS],&es_allocated[0]);
 
 	/* get the object id */
 	result=ndo2db_get_object_id_with_insert(idi,NDO2DB_OBJECTTYPE_CONTACTGROUP,idi->buffered_input[NDO_DATA_CONTACTGROUPNAME],NULL,&object_id);
@@ -4861,12 +5679,13 @@ int ndo2db_handle_contactgroupdefinition(ndo2db_idi *idi){
 		buf1=NULL;
 
 	if((result=ndo2db_db_query(idi,buf1))==NDO_OK){
-		group_id=mysql_insert_id(&idi->dbinfo.mysql_conn);
+		group_id=mysql_insert_id(idi->dbinfo.mysql_link);
 	}
 	free(buf);
 	free(buf1);
 
-	free(es[0]);
+	if(es_allocated[0]==NDO_TRUE)
+		free(es[0]);
 
 	/* save contact group members to db */
 	mbuf=idi->mbuf[NDO2DB_MBUF_CONTACTGROUPMEMBER];
@@ -4910,13 +5729,14 @@ int ndo2db_handle_activeobjectlist(ndo2db_idi *idi)
 {
 	ndo_dbuf	dbuf;
 	char		*buf = NULL, *name1, *name2 = NULL;
+	int			name1_allocated = NDO_FALSE, name2_allocated = NDO_FALSE;
 	int			rc, i, object_type, num_objs = 0, sz, first = 1;
 
 	if(idi==NULL)
 		return NDO_ERROR;
 
 	/* What type of object are we dealing with? */
-	ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_ACTIVEOBJECTSTYPE], &object_type);
+	ndo2db_get_input_int(idi,NDO_DATA_ACTIVEOBJECTSTYPE, &object_type);
 
 	/* Find out how many objects we're daling with */
 	while (idi->buffered_input[num_objs])
@@ -4983,17 +5803,19 @@ int ndo2db_handle_activeobjectlist(ndo2db_idi *idi)
 			ndo_dbuf_strcat(&dbuf, "OR ");
 
 		if (object_type == NDO2DB_OBJECTTYPE_SERVICE) {
-			name2 = ndo2db_db_escape_string(idi, idi->buffered_input[num_objs--]);
-			name1 = ndo2db_db_escape_string(idi, idi->buffered_input[num_objs--]);
+			name2 = ndo2db_db_escape_string(idi, idi->buffered_input[num_objs--], &name2_allocated);
+			name1 = ndo2db_db_escape_string(idi, idi->buffered_input[num_objs--], &name1_allocated);
 			rc = asprintf(&buf, "(name1='%s' AND name2='%s')", name1, name2);
 
 		} else {
-			name1 = ndo2db_db_escape_string(idi, idi->buffered_input[num_objs--]);
+			name1 = ndo2db_db_escape_string(idi, idi->buffered_input[num_objs--], &name1_allocated);
 			rc = asprintf(&buf, "name1='%s'", name1);
 		}
 
-		free(name1);
-		free(name2);
+		if (name1_allocated == NDO_TRUE)
+			free(name1);
+		if (name2_allocated == NDO_TRUE)
+			free(name2);
 
 		if (rc == -1) {
 			ndo_dbuf_free(&dbuf);
@@ -5028,6 +5850,7 @@ int ndo2db_save_custom_variables(ndo2db_idi *idi,int table_idx, unsigned long o_
 	char *buf1=NULL;
 	ndo2db_mbuf mbuf;
 	char *es[2];
+	int es_allocated[2]={NDO_FALSE};
 	char *ptr1=NULL;
 	char *ptr2=NULL;
 	char *ptr3=NULL;
@@ -5046,14 +5869,13 @@ int ndo2db_save_custom_variables(ndo2db_idi *idi,int table_idx, unsigned long o_
 			continue;
 
 		es[0]=strdup(ptr1);
+		es_allocated[0]=NDO_TRUE;
 		if((ptr2=strtok(NULL,":"))==NULL)
 			continue;
 		has_been_modified=atoi(ptr2);
 		ptr3=strtok(NULL,"\n");
 
-		buf1=strdup((ptr3==NULL)?"":ptr3);
-		es[1]=ndo2db_db_escape_string(idi,buf1);
-		free(buf1);
+		es[1]=ndo2db_db_escape_string(idi,(ptr3==NULL)?"":ptr3,&es_allocated[1]);
 
 		if (table_idx==NDO2DB_DBTABLE_CUSTOMVARIABLES) {
 			if(asprintf(&buf,"instance_id='%d', object_id='%lu', config_type='%d', has_been_modified='%d', varname='%s', varvalue='%s'"
@@ -5077,8 +5899,10 @@ int ndo2db_save_custom_variables(ndo2db_idi *idi,int table_idx, unsigned long o_
 				)==-1)
 				buf=NULL;
 		}
-		free(es[0]);
-		free(es[1]);
+		if(es_allocated[0]==NDO_TRUE)
+			free(es[0]);
+		if(es_allocated[1]==NDO_TRUE)
+			free(es[1]);
 
 		if(asprintf(&buf1,"INSERT INtO %s SET %s ON DUPLICATE KEY UPDATE %s"
 			    ,ndo2db_db_tablenames[table_idx]
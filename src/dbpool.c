@@ -0,0 +1,342 @@
+/**
+ * @file dbpool.c Database writer threads for ndo2db daemon
+ */
+/*
+ * Copyright 2009-2014 Nagios Core Development Team and Community Contributors
+ *
+ * This file is part of NDOUtils.
+ *
+ * NDOUtils is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * NDOUtils is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with NDOUtils. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Realtime data about one object only has to reach the database in order
+ * with other data about the same object.  That data is handed to a pool of
+ * writer threads, each with its own connection, picked by a hash of the
+ * instance and object.  Everything else - process events, config dumps and
+ * definitions - waits for the pool to empty and is written by the reader.
+ */
+
+/* include our project's header files */
+#include "../include/config.h"
+#include "../include/common.h"
+#include "../include/io.h"
+#include "../include/utils.h"
+#include "../include/protoapi.h"
+#include "../include/ndo2db.h"
+#include "../include/db.h"
+#include "../include/dbhandlers.h"
+#include "../include/dbpool.h"
+
+extern int ndo2db_db_writer_threads;
+
+static ndo2db_dbwriter *ndo2db_dbwriters=NULL;
+static int ndo2db_dbwriter_count=0;
+static int ndo2db_dbpool_started=NDO_FALSE;
+static pthread_mutex_t ndo2db_dbpool_lock=PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t ndo2db_dbpool_idle=PTHREAD_COND_INITIALIZER;
+static unsigned long ndo2db_dbpool_pending=0L;		/* items queued or being written */
+
+
+/* writes one item with the writer's connection */
+static void ndo2db_dbwriter_run(ndo2db_dbwriter *w, ndo2db_dbjob *job){
+
+	/* cached object ids only hold for one instance */
+	if(w->idi.dbinfo.instance_id!=job->instance_id)
+		ndo2db_free_cached_object_ids(&w->idi);
+
+	w->idi.current_input_data=job->input_data;
+	w->idi.buffered_input=job->buffered_input;
+	w->idi.input_values=job->input_values;
+	memcpy(w->idi.mbuf,job->mbuf,sizeof(job->mbuf));
+	w->idi.dbinfo.instance_id=job->instance_id;
+	w->idi.dbinfo.latest_realtime_data_time=job->latest_realtime_data_time;
+
+	ndo2db_handle_input_data(&w->idi);
+	ndo2db_free_input_memory(&w->idi);
+
+	/* a lost connection is picked up again by the next query */
+	w->idi.disconnect_client=NDO_FALSE;
+
+	free(job);
+
+	return;
+        }
+
+
+static void *ndo2db_dbwriter_thread(void *arg){
+	ndo2db_dbwriter *w=(ndo2db_dbwriter *)arg;
+	ndo2db_dbjob *job=NULL;
+
+	mysql_thread_init();
+
+	while(1){
+
+		pthread_mutex_lock(&w->lock);
+		while(w->head==NULL && w->stop==NDO_FALSE)
+			pthread_cond_wait(&w->cond,&w->lock);
+
+		/* only stop once everything queued is written */
+		if(w->head==NULL){
+			pthread_mutex_unlock(&w->lock);
+			break;
+			}
+
+		job=w->head;
+		w->head=job->next;
+		if(w->head==NULL)
+			w->tail=NULL;
+		w->queued--;
+
+		/* the reader may be waiting for room */
+		pthread_cond_broadcast(&w->cond);
+		pthread_mutex_unlock(&w->lock);
+
+		ndo2db_dbwriter_run(w,job);
+
+		pthread_mutex_lock(&ndo2db_dbpool_lock);
+		if(--ndo2db_dbpool_pending==0L)
+			pthread_cond_broadcast(&ndo2db_dbpool_idle);
+		pthread_mutex_unlock(&ndo2db_dbpool_lock);
+		}
+
+	mysql_thread_end();
+
+	return NULL;
+        }
+
+
+/* starts the writers the first time there is something for them - threads don't survive a fork, so this happens in the process that writes */
+static int ndo2db_dbpool_start(void){
+	ndo2db_dbwriter *w=NULL;
+	int x=0;
+
+	ndo2db_dbpool_started=NDO_TRUE;
+
+	if(ndo2db_db_writer_threads<=0)
+		return NDO_ERROR;
+
+	if((ndo2db_dbwriters=(ndo2db_dbwriter *)calloc(ndo2db_db_writer_threads,sizeof(ndo2db_dbwriter)))==NULL)
+		return NDO_ERROR;
+
+	for(x=0;x<ndo2db_db_writer_threads;x++){
+
+		w=&ndo2db_dbwriters[x];
+
+		pthread_mutex_init(&w->lock,NULL);
+		pthread_cond_init(&w->cond,NULL);
+
+		/* each writer has a connection of its own, even in event loop mode */
+		ndo2db_idi_init(&w->idi);
+		w->idi.dbinfo.pooled=NDO_TRUE;
+		ndo2db_db_init(&w->idi);
+		ndo2db_db_connect(&w->idi);
+
+		if(pthread_create(&w->thread,NULL,ndo2db_dbwriter_thread,w)!=0){
+			syslog(LOG_ERR,"Error: Could not start database writer thread: %s",strerror(errno));
+			ndo2db_db_disconnect(&w->idi);
+			ndo2db_db_deinit(&w->idi);
+			break;
+			}
+
+		ndo2db_dbwriter_count++;
+		}
+
+	if(ndo2db_dbwriter_count==0){
+		free(ndo2db_dbwriters);
+		ndo2db_dbwriters=NULL;
+		return NDO_ERROR;
+		}
+
+	syslog(LOG_USER|LOG_INFO,"Started %d database writer threads.",ndo2db_dbwriter_count);
+
+	return NDO_OK;
+        }
+
+
+/* decides where an item goes - NDO_FALSE means the reader writes it itself */
+static int ndo2db_dbpool_route(ndo2db_idi *idi, unsigned long long *key, int *barrier){
+	char **bi=idi->buffered_input;
+
+	*barrier=NDO_TRUE;
+
+	if(bi==NULL)
+		return NDO_FALSE;
+
+	switch(idi->current_input_data){
+
+	/* data about one host or service */
+	case NDO2DB_INPUT_DATA_HOSTSTATUSDATA:
+	case NDO2DB_INPUT_DATA_SERVICESTATUSDATA:
+	case NDO2DB_INPUT_DATA_HOSTSTATUSDELTADATA:
+	case NDO2DB_INPUT_DATA_SERVICESTATUSDELTADATA:
+	case NDO2DB_INPUT_DATA_HOSTCHECKDATA:
+	case NDO2DB_INPUT_DATA_SERVICECHECKDATA:
+	case NDO2DB_INPUT_DATA_COMMENTDATA:
+	case NDO2DB_INPUT_DATA_DOWNTIMEDATA:
+	case NDO2DB_INPUT_DATA_FLAPPINGDATA:
+	case NDO2DB_INPUT_DATA_ACKNOWLEDGEMENTDATA:
+	case NDO2DB_INPUT_DATA_STATECHANGEDATA:
+	case NDO2DB_INPUT_DATA_EVENTHANDLERDATA:
+	case NDO2DB_INPUT_DATA_ADAPTIVEHOSTDATA:
+	case NDO2DB_INPUT_DATA_ADAPTIVESERVICEDATA:
+		*key=ndo_object_key(0,bi[NDO_DATA_HOST],bi[NDO_DATA_SERVICE]);
+		break;
+
+	/* data about one contact */
+	case NDO2DB_INPUT_DATA_CONTACTSTATUSDATA:
+	case NDO2DB_INPUT_DATA_ADAPTIVECONTACTDATA:
+		*key=ndo_object_key(NDO2DB_OBJECTTYPE_CONTACT,bi[NDO_DATA_CONTACTNAME],NULL);
+		break;
+
+	/* the handlers carry ids and duplicate checks from one item to the next, so one writer gets them all */
+	case NDO2DB_INPUT_DATA_NOTIFICATIONDATA:
+	case NDO2DB_INPUT_DATA_CONTACTNOTIFICATIONDATA:
+	case NDO2DB_INPUT_DATA_CONTACTNOTIFICATIONMETHODDATA:
+		*key=NDO2DB_INPUT_DATA_NOTIFICATIONDATA;
+		break;
+	case NDO2DB_INPUT_DATA_LOGENTRY:
+	case NDO2DB_INPUT_DATA_LOGDATA:
+		*key=NDO2DB_INPUT_DATA_LOGDATA;
+		break;
+	case NDO2DB_INPUT_DATA_SYSTEMCOMMANDDATA:
+	case NDO2DB_INPUT_DATA_EXTERNALCOMMANDDATA:
+		*key=idi->current_input_data;
+		break;
+
+	/* these only touch tables the writers never do, so there is no need to wait for them */
+	case NDO2DB_INPUT_DATA_TIMEDEVENTDATA:
+	case NDO2DB_INPUT_DATA_PROGRAMSTATUSDATA:
+		*barrier=NDO_FALSE;
+		return NDO_FALSE;
+
+	/* process events, config dumps and definitions are written in order with everything */
+	default:
+		return NDO_FALSE;
+	        }
+
+	/* the same object on another instance is a different object */
+	*key^=idi->dbinfo.instance_id*0x9e3779b97f4a7c15ULL;
+
+	return NDO_TRUE;
+        }
+
+
+/* hands an item to a writer thread, returns NDO_FALSE if the caller should write it itself */
+int ndo2db_dbpool_dispatch(ndo2db_idi *idi){
+	ndo2db_dbwriter *w=NULL;
+	ndo2db_dbjob *job=NULL;
+	unsigned long long key=0L;
+	int barrier=NDO_TRUE;
+	int x=0;
+
+	if(ndo2db_dbpool_started==NDO_FALSE)
+		ndo2db_dbpool_start();
+
+	if(ndo2db_dbwriter_count==0)
+		return NDO_FALSE;
+
+	if(ndo2db_dbpool_route(idi,&key,&barrier)==NDO_FALSE){
+		if(barrier==NDO_TRUE)
+			ndo2db_dbpool_drain();
+		return NDO_FALSE;
+		}
+
+	if((job=(ndo2db_dbjob *)malloc(sizeof(ndo2db_dbjob)))==NULL){
+		ndo2db_dbpool_drain();
+		return NDO_FALSE;
+		}
+
+	/* the writer takes over the parsed data */
+	job->input_data=idi->current_input_data;
+	job->buffered_input=idi->buffered_input;
+	idi->buffered_input=NULL;
+	job->input_values=idi->input_values;
+	idi->input_values=NULL;
+	for(x=0;x<NDO2DB_MAX_MBUF_ITEMS;x++){
+		job->mbuf[x]=idi->mbuf[x];
+		idi->mbuf[x].used_lines=0;
+		idi->mbuf[x].allocated_lines=0;
+		idi->mbuf[x].buffer=NULL;
+		}
+	job->instance_id=idi->dbinfo.instance_id;
+	job->latest_realtime_data_time=idi->dbinfo.latest_realtime_data_time;
+	job->next=NULL;
+
+	pthread_mutex_lock(&ndo2db_dbpool_lock);
+	ndo2db_dbpool_pending++;
+	pthread_mutex_unlock(&ndo2db_dbpool_lock);
+
+	w=&ndo2db_dbwriters[key%ndo2db_dbwriter_count];
+
+	pthread_mutex_lock(&w->lock);
+	while(w->queued>=NDO2DB_DBPOOL_MAX_QUEUED)
+		pthread_cond_wait(&w->cond,&w->lock);
+	if(w->tail==NULL)
+		w->head=job;
+	else
+		w->tail->next=job;
+	w->tail=job;
+	w->queued++;
+	pthread_cond_broadcast(&w->cond);
+	pthread_mutex_unlock(&w->lock);
+
+	return NDO_TRUE;
+        }
+
+
+/* waits until the writers have written everything handed to them */
+int ndo2db_dbpool_drain(void){
+
+	if(ndo2db_dbwriter_count==0)
+		return NDO_OK;
+
+	pthread_mutex_lock(&ndo2db_dbpool_lock);
+	while(ndo2db_dbpool_pending>0L)
+		pthread_cond_wait(&ndo2db_dbpool_idle,&ndo2db_dbpool_lock);
+	pthread_mutex_unlock(&ndo2db_dbpool_lock);
+
+	return NDO_OK;
+        }
+
+
+/* lets the writers finish and closes their connections */
+int ndo2db_dbpool_stop(void){
+	ndo2db_dbwriter *w=NULL;
+	int x=0;
+
+	for(x=0;x<ndo2db_dbwriter_count;x++){
+		w=&ndo2db_dbwriters[x];
+		pthread_mutex_lock(&w->lock);
+		w->stop=NDO_TRUE;
+		pthread_cond_broadcast(&w->cond);
+		pthread_mutex_unlock(&w->lock);
+		}
+
+	for(x=0;x<ndo2db_dbwriter_count;x++){
+		w=&ndo2db_dbwriters[x];
+		pthread_join(w->thread,NULL);
+		ndo2db_db_disconnect(&w->idi);
+		ndo2db_db_deinit(&w->idi);
+		ndo2db_free_input_memory(&w->idi);
+		pthread_mutex_destroy(&w->lock);
+		pthread_cond_destroy(&w->cond);
+		}
+
+	free(ndo2db_dbwriters);
+	ndo2db_dbwriters=NULL;
+	ndo2db_dbwriter_count=0;
+	ndo2db_dbpool_started=NDO_FALSE;
+
+	return NDO_OK;
+        }
@@ -50,7 +50,7 @@ int show_help=NDO_FALSE;
 int main(int argc, char **argv){
 	int sd=0;
 	int fd=0;
-	char ch[511];	/* Matches ndo2db read buffer size */
+	static char ch[65536];
 	int result=0;
 	int nbytesread,n,i;
 	char *p;
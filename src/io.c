@@ -23,6 +23,12 @@
 #include "../include/config.h"
 #include "../include/common.h"
 #include "../include/io.h"
+#include "../include/utils.h"
+
+#if defined(__linux__)
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#endif
 
 #ifdef HAVE_SSL
 # if (defined(__sun) && defined(SOLARIS_10)) || defined(_AIX) || defined(__hpux)
@@ -156,6 +162,16 @@ char *ndo_mmap_fgets(ndo_mmapfile *temp_mmapfile){
 /**************************************************************/
 
 
+/* raises the send buffer of a message socket so big events still fit in one message */
+static void ndo_sink_set_sndbuf(int fd){
+	int size=NDO_SEQPACKET_SNDBUF;
+
+	setsockopt(fd,SOL_SOCKET,SO_SNDBUF,(char *)&size,sizeof(size));
+
+	return;
+        }
+
+
 /* opens data sink */
 int ndo_sink_open(char *name, int fd, int type, int port, int flags, int *nfd){
 	struct sockaddr_un server_address_u;
@@ -180,15 +196,19 @@ int ndo_sink_open(char *name, int fd, int type, int port, int flags, int *nfd){
 	        }
 
 	/* we are sending output to a unix domain socket */
-	else if(type==NDO_SINK_UNIXSOCKET){
+	else if(type==NDO_SINK_UNIXSOCKET || type==NDO_SINK_UNIXSEQPACKET){
 
 		if(name==NULL)
 			return NDO_ERROR;
 
 		/* create a socket */
-		if(!(newfd=socket(PF_UNIX,SOCK_STREAM,0)))
+		if(!(newfd=socket(PF_UNIX,(type==NDO_SINK_UNIXSEQPACKET)?SOCK_SEQPACKET:SOCK_STREAM,0)))
 			return NDO_ERROR;
 
+		/* the send buffer limits how big a message can be */
+		if(type==NDO_SINK_UNIXSEQPACKET)
+			ndo_sink_set_sndbuf(newfd);
+
 		/* copy the socket address/path */
 		strncpy(server_address_u.sun_path,name,sizeof(server_address_u.sun_path));
 		server_address_u.sun_family=AF_UNIX;
@@ -280,6 +300,86 @@ int ndo_sink_open(char *name, int fd, int type, int port, int flags, int *nfd){
         }
 
 
+/* resolves the address of a TCP sink */
+int ndo_sink_resolve(char *name, int port, struct sockaddr_in *addr){
+	struct hostent *hp=NULL;
+
+	if(name==NULL || addr==NULL)
+		return NDO_ERROR;
+
+	/* clear the address */
+	bzero((char *)addr,sizeof(struct sockaddr_in));
+
+	/* try to bypass using a DNS lookup if this is just an IP address */
+	if(!ndo_inet_aton(name,&addr->sin_addr)){
+
+		/* else do a DNS lookup */
+		if((hp=gethostbyname((const char *)name))==NULL)
+			return NDO_ERROR;
+
+		memcpy(&addr->sin_addr,hp->h_addr,hp->h_length);
+	        }
+
+	addr->sin_family=AF_INET;
+	addr->sin_port=htons(port);
+
+	return NDO_OK;
+        }
+
+
+/* starts connecting to a socket sink without blocking - returns NDO_SINK_CONNECTING if the connect is still in progress */
+int ndo_sink_connect_nonblocking(char *name, int type, struct sockaddr_in *addr, int *nfd){
+	struct sockaddr_un server_address_u;
+	int newfd=-1;
+	int result=0;
+
+	/* unix domain socket */
+	if(type==NDO_SINK_UNIXSOCKET || type==NDO_SINK_UNIXSEQPACKET){
+
+		if(name==NULL)
+			return NDO_ERROR;
+
+		if((newfd=socket(PF_UNIX,(type==NDO_SINK_UNIXSEQPACKET)?SOCK_SEQPACKET:SOCK_STREAM,0))<0)
+			return NDO_ERROR;
+
+		if(type==NDO_SINK_UNIXSEQPACKET)
+			ndo_sink_set_sndbuf(newfd);
+
+		strncpy(server_address_u.sun_path,name,sizeof(server_address_u.sun_path));
+		server_address_u.sun_family=AF_UNIX;
+
+		fcntl(newfd,F_SETFL,fcntl(newfd,F_GETFL)|O_NONBLOCK);
+		result=connect(newfd,(struct sockaddr *)&server_address_u,SUN_LEN(&server_address_u));
+	        }
+
+	/* TCP socket */
+	else if(type==NDO_SINK_TCPSOCKET){
+
+		if(addr==NULL)
+			return NDO_ERROR;
+
+		if((newfd=socket(PF_INET,SOCK_STREAM,0))<0)
+			return NDO_ERROR;
+
+		fcntl(newfd,F_SETFL,fcntl(newfd,F_GETFL)|O_NONBLOCK);
+		result=connect(newfd,(struct sockaddr *)addr,sizeof(struct sockaddr_in));
+	        }
+
+	/* other sinks can't be opened this way */
+	else
+		return NDO_ERROR;
+
+	if(result!=0 && errno!=EINPROGRESS){
+		close(newfd);
+		return NDO_ERROR;
+	        }
+
+	*nfd=newfd;
+
+	return (result==0)?NDO_OK:NDO_SINK_CONNECTING;
+        }
+
+
 /* writes to data sink */
 int ndo_sink_write(int fd, char *buf, int buflen){
 	int tbytes=0;
@@ -317,6 +417,62 @@ int ndo_sink_write(int fd, char *buf, int buflen){
         }
 
 
+/* writes a set of buffers to data sink in as few calls as possible - if an error stops it part way, the bytes that did get out are returned (short of the total) */
+int ndo_sink_writev(int fd, struct iovec *iov, int iovcnt){
+	int tbytes=0;
+	int result=0;
+	int x=0;
+
+	if(iov==NULL)
+		return NDO_ERROR;
+
+#ifdef HAVE_SSL
+	/* no scatter/gather with SSL */
+	if (use_ssl == NDO_TRUE){
+		for(x=0;x<iovcnt;x++){
+			if((result=ndo_sink_write(fd,(char *)iov[x].iov_base,(int)iov[x].iov_len))<0)
+				return (tbytes>0)?tbytes:NDO_ERROR;
+			tbytes+=result;
+			}
+		return tbytes;
+		}
+#endif
+
+	while(x<iovcnt){
+
+		/* skip anything already written */
+		if(iov[x].iov_len==0){
+			x++;
+			continue;
+			}
+
+		result=writev(fd,iov+x,iovcnt-x);
+
+		/* some kind of error occurred */
+		if(result==-1){
+
+			/* unless we encountered a recoverable error, bail out */
+			if(errno!=EAGAIN && errno!=EINTR)
+				return (tbytes>0)?tbytes:NDO_ERROR;
+			continue;
+		        }
+
+		/* update the number of bytes we've written and move past them */
+		tbytes+=result;
+		while(x<iovcnt && (size_t)result>=iov[x].iov_len){
+			result-=iov[x].iov_len;
+			x++;
+			}
+		if(x<iovcnt && result>0){
+			iov[x].iov_base=(char *)iov[x].iov_base+result;
+			iov[x].iov_len-=result;
+			}
+	        }
+
+	return tbytes;
+        }
+
+
 /* writes a newline to data sink */
 int ndo_sink_write_newline(int fd){
 
@@ -450,6 +606,429 @@ int ndo_inet_aton(register const char *cp, struct in_addr *addr){
         }
 
 
+/**************************************************************/
+/****** SHARED MEMORY RING FUNCTIONS **************************/
+/**************************************************************/
+
+/* records are padded so every header stays aligned */
+#define NDO_SHM_ALIGN(x)	(((x)+7ULL)&~7ULL)
+
+/* how many times the consumer looks for new data before it goes to sleep */
+#define NDO_SHM_SPIN_COUNT	2000
+
+#if !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+#define MAP_ANONYMOUS		MAP_ANON
+#endif
+
+
+/* wakes the consumer if it went to sleep on an empty ring */
+static void ndo_shm_wake(ndo_shm_header *hdr){
+
+	if(__atomic_load_n(&hdr->consumer_waiting,__ATOMIC_SEQ_CST)==0)
+		return;
+
+	__atomic_store_n(&hdr->consumer_waiting,0,__ATOMIC_SEQ_CST);
+#if defined(__linux__)
+	syscall(SYS_futex,&hdr->consumer_waiting,FUTEX_WAKE,1,NULL,NULL,0);
+#endif
+
+	return;
+        }
+
+
+/* wakes the producer if it is waiting for room */
+static void ndo_shm_wake_producer(ndo_shm_header *hdr){
+
+	if(__atomic_load_n(&hdr->producer_waiting,__ATOMIC_SEQ_CST)==0)
+		return;
+
+	__atomic_store_n(&hdr->producer_waiting,0,__ATOMIC_SEQ_CST);
+#if defined(__linux__)
+	syscall(SYS_futex,&hdr->producer_waiting,FUTEX_WAKE,1,NULL,NULL,0);
+#endif
+
+	return;
+        }
+
+
+/* maps a ring segment (anonymous memory if fd is -1), returns NULL on error */
+static ndo_shm_ring *ndo_shm_map(int fd, unsigned long map_size){
+	ndo_shm_ring *ring=NULL;
+	void *mmap_buf=NULL;
+
+	if((mmap_buf=mmap(0,map_size,PROT_READ|PROT_WRITE,(fd==-1)?MAP_SHARED|MAP_ANONYMOUS:MAP_SHARED,fd,0))==MAP_FAILED)
+		return NULL;
+
+	if((ring=(ndo_shm_ring *)calloc(1,sizeof(ndo_shm_ring)))==NULL){
+		munmap(mmap_buf,map_size);
+		return NULL;
+		}
+
+	ring->fd=fd;
+	ring->map_size=map_size;
+	ring->hdr=(ndo_shm_header *)mmap_buf;
+	ring->data=(char *)mmap_buf+sizeof(ndo_shm_header);
+
+	return ring;
+        }
+
+
+/* creates a new ring for a consumer - an old segment is unlinked, so anyone still attached to it keeps a valid mapping */
+ndo_shm_ring *ndo_shm_create(char *name, unsigned long size){
+	ndo_shm_ring *ring=NULL;
+	long page_size=sysconf(_SC_PAGESIZE);
+	int fd=-1;
+
+	if(name==NULL)
+		return NULL;
+
+	if(size<NDO_SHM_MIN_SIZE)
+		size=NDO_SHM_MIN_SIZE;
+	if(page_size>0L)
+		size=((size+page_size-1)/page_size)*page_size;
+
+	unlink(name);
+	if((fd=open(name,O_RDWR|O_CREAT|O_EXCL,S_IRUSR|S_IWUSR|S_IRGRP|S_IWGRP))==-1)
+		return NULL;
+
+	/* the module usually runs as a different user in our group */
+	fchmod(fd,S_IRUSR|S_IWUSR|S_IRGRP|S_IWGRP);
+
+	if(ftruncate(fd,(off_t)(sizeof(ndo_shm_header)+size))==-1 || (ring=ndo_shm_map(fd,sizeof(ndo_shm_header)+size))==NULL){
+		close(fd);
+		unlink(name);
+		return NULL;
+		}
+
+	ring->size=size;
+	ring->producer=NDO_FALSE;
+	ring->hdr->size=size;
+	ring->hdr->version=NDO_SHM_VERSION;
+	ring->hdr->consumer_pid=(int)getpid();
+
+	/* producers check the magic last */
+	__atomic_store_n(&ring->hdr->magic,NDO_SHM_MAGIC,__ATOMIC_RELEASE);
+
+	return ring;
+        }
+
+
+/* attaches a producer to an existing ring */
+ndo_shm_ring *ndo_shm_attach(char *name){
+	ndo_shm_ring *ring=NULL;
+	struct stat statbuf;
+	ndo_shm_header *hdr=NULL;
+	int pid=0;
+	int fd=-1;
+
+	if(name==NULL)
+		return NULL;
+
+	if((fd=open(name,O_RDWR))==-1)
+		return NULL;
+
+	if(fstat(fd,&statbuf)==-1 || (unsigned long)statbuf.st_size<=sizeof(ndo_shm_header) || (ring=ndo_shm_map(fd,(unsigned long)statbuf.st_size))==NULL){
+		close(fd);
+		return NULL;
+		}
+
+	hdr=ring->hdr;
+	ring->size=hdr->size;
+	ring->producer=NDO_TRUE;
+
+	/* make sure this is a ring we understand and that someone is reading it */
+	if(__atomic_load_n(&hdr->magic,__ATOMIC_ACQUIRE)!=NDO_SHM_MAGIC || hdr->version!=NDO_SHM_VERSION || hdr->size+sizeof(ndo_shm_header)>ring->map_size || (hdr->size&7ULL) || hdr->consumer_pid==0){
+		munmap(ring->hdr,ring->map_size);
+		close(fd);
+		free(ring);
+		errno=EINVAL;
+		return NULL;
+		}
+
+	/* there can only be one producer */
+	pid=hdr->producer_pid;
+	if(pid!=0 && pid!=(int)getpid() && (kill((pid_t)pid,0)==0 || errno!=ESRCH)){
+		munmap(ring->hdr,ring->map_size);
+		close(fd);
+		free(ring);
+		errno=EBUSY;
+		return NULL;
+		}
+
+	hdr->producer_pid=(int)getpid();
+	ring->session=__atomic_add_fetch(&hdr->session,1,__ATOMIC_SEQ_CST);
+
+	return ring;
+        }
+
+
+/* creates a ring between a process and a child it is about to fork - the parent writes, the child calls ndo_shm_consume() */
+ndo_shm_ring *ndo_shm_create_anon(unsigned long size){
+	ndo_shm_ring *ring=NULL;
+	long page_size=sysconf(_SC_PAGESIZE);
+
+	if(size<NDO_SHM_MIN_SIZE)
+		size=NDO_SHM_MIN_SIZE;
+	if(page_size>0L)
+		size=((size+page_size-1)/page_size)*page_size;
+
+	if((ring=ndo_shm_map(-1,sizeof(ndo_shm_header)+size))==NULL)
+		return NULL;
+
+	ring->size=size;
+	ring->producer=NDO_TRUE;
+	ring->session=1;
+	ring->hdr->size=size;
+	ring->hdr->version=NDO_SHM_VERSION;
+	ring->hdr->session=1;
+	ring->hdr->producer_pid=(int)getpid();
+	ring->hdr->consumer_pid=(int)getpid();
+	ring->hdr->magic=NDO_SHM_MAGIC;
+
+	return ring;
+        }
+
+
+/* makes the calling process the reader of a ring from ndo_shm_create_anon() */
+int ndo_shm_consume(ndo_shm_ring *ring){
+
+	if(ring==NULL)
+		return NDO_ERROR;
+
+	ring->producer=NDO_FALSE;
+	__atomic_store_n(&ring->hdr->consumer_pid,(int)getpid(),__ATOMIC_SEQ_CST);
+
+	return NDO_OK;
+        }
+
+
+/* puts one or more records into the ring - a zero length record marks the end of a session */
+static int ndo_shm_put(ndo_shm_ring *ring, const char *buf, unsigned long len){
+	ndo_shm_header *hdr=ring->hdr;
+	ndo_shm_record *rec=NULL;
+	unsigned long long head=hdr->head;
+	unsigned long long tail=__atomic_load_n(&hdr->tail,__ATOMIC_ACQUIRE);
+	unsigned long long max_chunk=ring->size/4;
+	unsigned long long need=0L;
+	unsigned long long pos=0L;
+	unsigned long long off=0L;
+	unsigned long chunk=0L;
+	unsigned long done=0L;
+
+	/* the consumer is gone - the caller should attach to a new ring */
+	if(hdr->consumer_pid==0){
+		errno=EPIPE;
+		return -1;
+		}
+
+	/* worst case is a header and padding for every piece plus the space skipped by a wrap */
+	need=len+(len/max_chunk+1)*(sizeof(ndo_shm_record)+8)+max_chunk+sizeof(ndo_shm_record)+8;
+	if(ring->size-(head-tail)<need){
+
+		/* a full ring is normal, one nobody is reading is not */
+		if(kill((pid_t)hdr->consumer_pid,0)==-1 && errno==ESRCH){
+			errno=EPIPE;
+			return -1;
+			}
+
+		errno=EAGAIN;
+		return -1;
+		}
+
+	pos=head;
+	do{
+		chunk=(len-done<max_chunk)?len-done:(unsigned long)max_chunk;
+
+		/* records never straddle the end of the data area */
+		off=pos%ring->size;
+		if(off+sizeof(ndo_shm_record)+NDO_SHM_ALIGN(chunk)>ring->size){
+			((ndo_shm_record *)(ring->data+off))->len=NDO_SHM_RECORD_WRAP;
+			pos+=ring->size-off;
+			off=0L;
+			}
+
+		rec=(ndo_shm_record *)(ring->data+off);
+		rec->len=(unsigned int)chunk;
+		rec->session=ring->session;
+		if(chunk>0L)
+			memcpy((char *)(rec+1),buf+done,chunk);
+
+		pos+=sizeof(ndo_shm_record)+NDO_SHM_ALIGN(chunk);
+		done+=chunk;
+		}while(done<len);
+
+	/* publish the records, then see if the consumer needs a nudge */
+	__atomic_store_n(&hdr->head,pos,__ATOMIC_SEQ_CST);
+	ndo_shm_wake(hdr);
+
+	return (int)len;
+        }
+
+
+/* writes data to the ring, returns -1 with errno set to EAGAIN if there isn't room for all of it */
+int ndo_shm_write(ndo_shm_ring *ring, const char *buf, unsigned long len){
+
+	if(ring==NULL || buf==NULL){
+		errno=EINVAL;
+		return -1;
+		}
+
+	if(len==0L)
+		return 0;
+
+	/* this could never fit, so waiting for room won't help */
+	if(len>ring->size/2){
+		errno=EMSGSIZE;
+		return -1;
+		}
+
+	return ndo_shm_put(ring,buf,len);
+        }
+
+
+/* detaches from a ring - producers tell the consumer they are done, consumers tell producers to go away */
+int ndo_shm_detach(ndo_shm_ring *ring){
+
+	if(ring==NULL)
+		return NDO_OK;
+
+	if(ring->producer==NDO_TRUE){
+		ndo_shm_put(ring,NULL,0L);
+		if(ring->hdr->producer_pid==(int)getpid())
+			ring->hdr->producer_pid=0;
+		}
+	else
+		ring->hdr->consumer_pid=0;
+
+	munmap(ring->hdr,ring->map_size);
+	if(ring->fd>=0)
+		close(ring->fd);
+	free(ring);
+
+	return NDO_OK;
+        }
+
+
+/* returns the next record without removing it - the consumer can work on it in place until it is released */
+char *ndo_shm_peek(ndo_shm_ring *ring, unsigned long *len, unsigned int *session){
+	ndo_shm_header *hdr=ring->hdr;
+	ndo_shm_record *rec=NULL;
+	unsigned long long pos=hdr->tail;
+	unsigned long long off=0L;
+
+	while(pos!=__atomic_load_n(&hdr->head,__ATOMIC_ACQUIRE)){
+
+		off=pos%ring->size;
+		rec=(ndo_shm_record *)(ring->data+off);
+
+		/* skip the unused end of the data area */
+		if(rec->len==NDO_SHM_RECORD_WRAP){
+			pos+=ring->size-off;
+			__atomic_store_n(&hdr->tail,pos,__ATOMIC_RELEASE);
+			continue;
+			}
+
+		*len=rec->len;
+		*session=rec->session;
+		ring->next=pos+sizeof(ndo_shm_record)+NDO_SHM_ALIGN(rec->len);
+
+		return (char *)(rec+1);
+		}
+
+	return NULL;
+        }
+
+
+/* gives the space used by the last record we peeked at back to the producer */
+int ndo_shm_release(ndo_shm_ring *ring){
+
+	__atomic_store_n(&ring->hdr->tail,ring->next,__ATOMIC_SEQ_CST);
+	ndo_shm_wake_producer(ring->hdr);
+
+	return NDO_OK;
+        }
+
+
+/* waits up to timeout ms for the producer to write something */
+int ndo_shm_wait(ndo_shm_ring *ring, int timeout){
+	ndo_shm_header *hdr=ring->hdr;
+	struct timespec delay;
+	int x=0;
+
+	/* data usually comes in bursts, so look again for a bit before sleeping */
+	for(x=0;x<NDO_SHM_SPIN_COUNT;x++){
+		if(__atomic_load_n(&hdr->head,__ATOMIC_ACQUIRE)!=hdr->tail)
+			return NDO_OK;
+		}
+
+	/* tell the producer we're going to sleep, then make sure nothing slipped in before it could see that */
+	__atomic_store_n(&hdr->consumer_waiting,1,__ATOMIC_SEQ_CST);
+	if(__atomic_load_n(&hdr->head,__ATOMIC_SEQ_CST)!=hdr->tail){
+		__atomic_store_n(&hdr->consumer_waiting,0,__ATOMIC_SEQ_CST);
+		return NDO_OK;
+		}
+
+#if defined(__linux__)
+	delay.tv_sec=timeout/1000;
+	delay.tv_nsec=(timeout%1000)*1000000L;
+	syscall(SYS_futex,&hdr->consumer_waiting,FUTEX_WAIT,1,&delay,NULL,0);
+#else
+	/* no futexes, so just poll every few ms */
+	delay.tv_sec=0;
+	delay.tv_nsec=(timeout<5)?timeout*1000000L:5000000L;
+	nanosleep(&delay,NULL);
+#endif
+
+	__atomic_store_n(&hdr->consumer_waiting,0,__ATOMIC_SEQ_CST);
+
+	return NDO_OK;
+        }
+
+
+/* waits up to timeout ms for the consumer to make some room after a write failed with EAGAIN */
+int ndo_shm_wait_for_room(ndo_shm_ring *ring, int timeout){
+	ndo_shm_header *hdr=ring->hdr;
+	unsigned long long tail=__atomic_load_n(&hdr->tail,__ATOMIC_SEQ_CST);
+	struct timespec delay;
+
+	/* tell the consumer we're waiting, then make sure it didn't free something before it could see that */
+	__atomic_store_n(&hdr->producer_waiting,1,__ATOMIC_SEQ_CST);
+	if(__atomic_load_n(&hdr->tail,__ATOMIC_SEQ_CST)!=tail){
+		__atomic_store_n(&hdr->producer_waiting,0,__ATOMIC_SEQ_CST);
+		return NDO_OK;
+		}
+
+#if defined(__linux__)
+	delay.tv_sec=timeout/1000;
+	delay.tv_nsec=(timeout%1000)*1000000L;
+	syscall(SYS_futex,&hdr->producer_waiting,FUTEX_WAIT,1,&delay,NULL,0);
+#else
+	delay.tv_sec=0;
+	delay.tv_nsec=(timeout<5)?timeout*1000000L:5000000L;
+	nanosleep(&delay,NULL);
+#endif
+
+	__atomic_store_n(&hdr->producer_waiting,0,__ATOMIC_SEQ_CST);
+
+	return NDO_OK;
+        }
+
+
+/* is the producer that attached to the ring still around? */
+int ndo_shm_producer_alive(ndo_shm_ring *ring){
+	int pid=ring->hdr->producer_pid;
+
+	if(pid==0)
+		return NDO_FALSE;
+
+	if(kill((pid_t)pid,0)==-1 && errno==ESRCH)
+		return NDO_FALSE;
+
+	return NDO_TRUE;
+        }
+
+
+
 /******************************************************************/
 /************************ STRING FUNCTIONS ************************/
 /******************************************************************/
@@ -475,47 +1054,31 @@ void ndo_strip_buffer(char *buffer){
 	}
 
 
-/* escape special characters in string */
-char *ndo_escape_buffer(char *buffer){
-	char *newbuf;
-	register int x=0;
-	register int y=0;
-	register int len=0;
+/* escape special characters in string - allocated says whether the result has to be freed, a string with nothing to escape is handed back as is */
+char *ndo_escape_buffer(char *buffer, int *allocated){
+	char *newbuf=NULL;
+	unsigned long len=0L;
+	unsigned long span=0L;
+
+	*allocated=NDO_FALSE;
 
 	if(buffer==NULL)
 		return NULL;
 
-	/* allocate memory for escaped string */
-	if((newbuf=(char *)malloc((strlen(buffer)*2)+1))==NULL)
-		return NULL;
+	len=strlen(buffer);
+	span=ndo_escape_span(buffer,len);
 
-	/* initialize string */
-	newbuf[0]='\x0';
+	/* nothing to escape */
+	if(span==len)
+		return buffer;
 
-	len=(int)strlen(buffer);
-	for(x=0;x<len;x++){
-		if(buffer[x]=='\t'){
-			newbuf[y++]='\\';
-			newbuf[y++]='t';
-		        }
-		else if(buffer[x]=='\r'){
-			newbuf[y++]='\\';
-			newbuf[y++]='r';
-		        }
-		else if(buffer[x]=='\n'){
-			newbuf[y++]='\\';
-			newbuf[y++]='n';
-		        }
-		else if(buffer[x]=='\\'){
-			newbuf[y++]='\\';
-			newbuf[y++]='\\';
-		        }
-		else
-			newbuf[y++]=buffer[x];
-	        }
+	/* allocate memory for escaped string */
+	if((newbuf=(char *)malloc(span+((len-span)*2)+1))==NULL)
+		return NULL;
 
-	/* terminate new string */
-	newbuf[y++]='\x0';
+	memcpy(newbuf,buffer,span);
+	ndo_escape_into(newbuf+span,buffer+span,len-span);
+	*allocated=NDO_TRUE;
 
 	return newbuf;
         }
@@ -523,34 +1086,49 @@ char *ndo_escape_buffer(char *buffer){
 
 /* unescape special characters in string */
 char *ndo_unescape_buffer(char *buffer){
-	register int x=0;
-	register int y=0;
-	register int len=0;
+	char *p=NULL;
+	unsigned long x=0L;
+	unsigned long y=0L;
+	unsigned long len=0L;
+	unsigned long span=0L;
 
 	if(buffer==NULL)
 		return NULL;
 
-	len=(int)strlen(buffer);
-	for(x=0;x<len;x++){
-		if(buffer[x]=='\\'){
-			if(buffer[x+1]=='t')
-				buffer[y++]='\t';
-			else if(buffer[x+1]=='r')
-				buffer[y++]='\r';
-			else if(buffer[x+1]=='n')
-				buffer[y++]='\n';
-			else if(buffer[x+1]=='\\')
-				buffer[y++]='\\';
-			else
-				buffer[y++]=buffer[x+1];
-			x++;
-		        }
+	/* most strings have nothing to unescape */
+	if((p=strchr(buffer,'\\'))==NULL)
+		return buffer;
+
+	len=strlen(p)+(p-buffer);
+	x=y=p-buffer;
+	while(x<len){
+
+		/* move everything up to the next backslash down in one go */
+		if((p=memchr(buffer+x,'\\',len-x))==NULL)
+			p=buffer+len;
+		span=p-(buffer+x);
+		if(y!=x)
+			memmove(buffer+y,buffer+x,span);
+		x+=span;
+		y+=span;
+		if(x>=len)
+			break;
+
+		if(buffer[x+1]=='t')
+			buffer[y++]='\t';
+		else if(buffer[x+1]=='r')
+			buffer[y++]='\r';
+		else if(buffer[x+1]=='n')
+			buffer[y++]='\n';
+		else if(buffer[x+1]=='\\')
+			buffer[y++]='\\';
 		else
-			buffer[y++]=buffer[x];
+			buffer[y++]=buffer[x+1];
+		x+=2;
 	        }
 
 	/* terminate string */
-	buffer[y++]='\x0';
+	buffer[y]='\x0';
 
 	return buffer;
         }
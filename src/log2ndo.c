@@ -50,6 +50,7 @@ int main(int argc, char **argv){
 	char *connection_type=NULL;
 	char *input=NULL;
 	char *input2=NULL;
+	int input2_allocated=NDO_FALSE;
 	int sd=2;
 	char tempbuf[1024];
 	int result=0;
@@ -149,7 +150,7 @@ int main(int argc, char **argv){
 
 		/* strip and escape log entry */
 		ndo_strip_buffer(input);
-		if((input2=ndo_escape_buffer(input))==NULL){
+		if((input2=ndo_escape_buffer(input,&input2_allocated))==NULL){
 			free(input);
 			input2=NULL;
 			continue;
@@ -167,8 +168,9 @@ int main(int argc, char **argv){
 		ndo_sink_write(sd,tempbuf,strlen(tempbuf));
 
 		/* free allocated memory */
+		if(input2_allocated==NDO_TRUE)
+			free(input2);
 		free(input);
-		free(input2);
 		input=NULL;
 		input2=NULL;
 	        }
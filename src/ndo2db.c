@@ -38,7 +38,7 @@
 #include "../include/ndo2db.h"
 #include "../include/db.h"
 #include "../include/dbhandlers.h"
-#include "../include/queue.h"
+#include "../include/dbpool.h"
 
 #ifdef HAVE_SYSTEMD
 #include <systemd/sd_daemon.h>
@@ -49,6 +49,10 @@
 #endif
 
 #include <pthread.h>
+#include <sys/resource.h>
+#if defined(__linux__)
+#include <sys/epoll.h>
+#endif
 
 #define NDO2DB_VERSION "2.1.2"
 #define NDO2DB_NAME "NDO2DB"
@@ -75,8 +79,18 @@ int ndo2db_sd=0;
 int ndo2db_socket_type=NDO_SINK_UNIXSOCKET;
 char *ndo2db_socket_name=NULL;
 int ndo2db_tcp_port=NDO_DEFAULT_TCP_PORT;
+unsigned long ndo2db_shm_size=NDO_SHM_DEFAULT_SIZE;
+unsigned long ndo2db_max_frame_size=NDO2DB_DEFAULT_MAX_FRAME_SIZE;
+unsigned long ndo2db_max_line_length=NDO2DB_MAX_LINE_LENGTH;
+unsigned long ndo2db_read_buffer_size=NDO2DB_DEFAULT_READ_BUFFER_SIZE;
+ndo_shm_ring *ndo2db_shm=NULL;
+unsigned long ndo2db_queue_size=NDO_SHM_DEFAULT_SIZE;
+int ndo2db_db_writer_threads=0;
+static ndo_shm_ring *ndo2db_queue=NULL;		/* carries client input from the reader to the writer process */
+static pid_t ndo2db_writer_pid=0;
 int ndo2db_use_inetd=NDO_FALSE;
 int ndo2db_no_fork=NDO_FALSE;
+int ndo2db_use_event_loop=NDO_FALSE;
 int ndo2db_show_version=NDO_FALSE;
 int ndo2db_show_license=NDO_FALSE;
 int ndo2db_show_help=NDO_FALSE;
@@ -91,6 +105,8 @@ FILE *ndo2db_debug_file_fp=NULL;
 unsigned long ndo2db_max_debug_file_size=0L;
 
 extern char *ndo2db_db_tablenames[NDO2DB_MAX_DBTABLES];
+extern int ndo2db_db_shared;
+extern int ndo2db_db_shared_connected;
 
 
 
@@ -141,10 +157,11 @@ int main(int argc, char **argv){
 		printf("and processing.  Clients that are capable of sending data to the NDO2DB daemon\n");
 		printf("include the LOG2NDO utility and NDOMOD event broker module.\n");
 		printf("\n");
-		printf("Usage: %s -c <config_file> [-i] [-f]\n",argv[0]);
+		printf("Usage: %s -c <config_file> [-i] [-f] [-e]\n",argv[0]);
 		printf("\n");
 		printf("-i  = Run under INETD/XINETD.\n");
 		printf("-f  = Do not fork daemon.\n");
+		printf("-e  = Handle all clients in one process with one database connection.\n");
 		printf("\n");
 		exit(1);
 	        }
@@ -288,6 +305,7 @@ int ndo2db_process_arguments(int argc, char **argv){
 		{"configfile", required_argument, 0, 'c'},
 		{"inetd", no_argument, 0, 'i'},
 		{"no-forking", no_argument, 0, 'f'},
+		{"event-loop", no_argument, 0, 'e'},
 		{"help", no_argument, 0, 'h'},
 		{"license", no_argument, 0, 'l'},
 		{"version", no_argument, 0, 'V'},
@@ -301,7 +319,7 @@ int ndo2db_process_arguments(int argc, char **argv){
 		return NDO_OK;
 	        }
 
-	snprintf(optchars,sizeof(optchars),"c:ifhlV");
+	snprintf(optchars,sizeof(optchars),"c:ifehlV");
 
 	while(1){
 #ifdef HAVE_GETOPT_H
@@ -335,6 +353,9 @@ int ndo2db_process_arguments(int argc, char **argv){
 			ndo2db_use_inetd=NDO_FALSE;
 			ndo2db_no_fork=NDO_TRUE;
 			break;
+		case 'e':
+			ndo2db_use_event_loop=NDO_TRUE;
+			break;
 		default:
 			return NDO_ERROR;
 			break;
@@ -418,9 +439,51 @@ int ndo2db_process_config_var(char *arg){
 	else if(!strcmp(var,"socket_type")){
 		if(!strcmp(val,"tcp"))
 			ndo2db_socket_type=NDO_SINK_TCPSOCKET;
+		else if(!strcmp(val,"shm"))
+			ndo2db_socket_type=NDO_SINK_SHM;
+		else if(!strcmp(val,"unixseqpacket"))
+			ndo2db_socket_type=NDO_SINK_UNIXSEQPACKET;
 		else
 			ndo2db_socket_type=NDO_SINK_UNIXSOCKET;
 	        }
+	else if(!strcmp(var,"max_frame_size")){
+		ndo2db_max_frame_size=strtoul(val,NULL,0);
+		if(ndo2db_max_frame_size<NDO2DB_MAX_LINE_LENGTH)
+			ndo2db_max_frame_size=NDO2DB_MAX_LINE_LENGTH;
+	        }
+	else if(!strcmp(var,"max_line_length")){
+		ndo2db_max_line_length=strtoul(val,NULL,0);
+		if(ndo2db_max_line_length<NDO2DB_MIN_LINE_LENGTH)
+			ndo2db_max_line_length=NDO2DB_MIN_LINE_LENGTH;
+	        }
+	else if(!strcmp(var,"read_buffer_size")){
+		ndo2db_read_buffer_size=strtoul(val,NULL,0);
+		if(ndo2db_read_buffer_size<NDO2DB_MIN_READ_BUFFER_SIZE)
+			ndo2db_read_buffer_size=NDO2DB_MIN_READ_BUFFER_SIZE;
+		else if(ndo2db_read_buffer_size>NDO2DB_MAX_READ_BUFFER_SIZE)
+			ndo2db_read_buffer_size=NDO2DB_MAX_READ_BUFFER_SIZE;
+	        }
+	else if(!strcmp(var,"shm_size")){
+		ndo2db_shm_size=strtoul(val,NULL,0);
+		if(ndo2db_shm_size<NDO_SHM_MIN_SIZE)
+			ndo2db_shm_size=NDO_SHM_MIN_SIZE;
+		if(ndo2db_shm_size>NDO_SHM_MAX_SIZE)
+			ndo2db_shm_size=NDO_SHM_MAX_SIZE;
+	        }
+	else if(!strcmp(var,"db_writer_threads")){
+		ndo2db_db_writer_threads=atoi(val);
+		if(ndo2db_db_writer_threads<0)
+			ndo2db_db_writer_threads=0;
+		if(ndo2db_db_writer_threads>NDO2DB_DBPOOL_MAX_WRITERS)
+			ndo2db_db_writer_threads=NDO2DB_DBPOOL_MAX_WRITERS;
+	        }
+	else if(!strcmp(var,"queue_size")){
+		ndo2db_queue_size=strtoul(val,NULL,0);
+		if(ndo2db_queue_size<NDO_SHM_MIN_SIZE)
+			ndo2db_queue_size=NDO_SHM_MIN_SIZE;
+		if(ndo2db_queue_size>NDO_SHM_MAX_SIZE)
+			ndo2db_queue_size=NDO_SHM_MAX_SIZE;
+	        }
 	else if(!strcmp(var,"socket_name")){
 		if((ndo2db_socket_name=strdup(val))==NULL)
 			return NDO_ERROR;
@@ -496,6 +559,9 @@ int ndo2db_process_config_var(char *arg){
 
 	else if(!strcmp(var,"max_acknowledgements_age"))
 		ndo2db_db_settings.max_acknowledgements_age=strtoul(val,NULL,0)*60;
+
+	else if(!strcmp(var,"incremental_config_sync"))
+		ndo2db_db_settings.incremental_config_sync=(atoi(val)>0)?NDO_TRUE:NDO_FALSE;
 		
 	else if(!strcmp(var,"ndo2db_user"))
 		ndo2db_user=strdup(val);
@@ -547,6 +613,7 @@ int ndo2db_initialize_variables(void){
 	ndo2db_db_settings.max_contactnotificationmethods_age=0L;
 	ndo2db_db_settings.max_logentries_age=0L;
 	ndo2db_db_settings.max_acknowledgements_age=0L;
+	ndo2db_db_settings.incremental_config_sync=NDO_FALSE;
 
 	return NDO_OK;
         }
@@ -616,7 +683,7 @@ int ndo2db_free_program_memory(void){
 
 int ndo2db_check_init_reqs(void){
 
-	if(ndo2db_socket_type==NDO_SINK_UNIXSOCKET){
+	if(ndo2db_socket_type==NDO_SINK_UNIXSOCKET || ndo2db_socket_type==NDO_SINK_UNIXSEQPACKET || ndo2db_socket_type==NDO_SINK_SHM){
 		if(ndo2db_socket_name==NULL){
 			printf("No socket name specified.\n");
 			return NDO_ERROR;
@@ -837,13 +904,25 @@ int ndo2db_cleanup_socket(void){
 	if(ndo2db_use_inetd==NDO_TRUE)
 		return NDO_OK;
 
-	/* close the socket */
-	shutdown(ndo2db_sd,2);
-	close(ndo2db_sd);
+	/* tell the module to let go of the ring */
+	if(ndo2db_socket_type==NDO_SINK_SHM){
+		if(ndo2db_shm!=NULL && ndo2db_shm->hdr->consumer_pid==(int)getpid()){
+			ndo_shm_detach(ndo2db_shm);
+			unlink(ndo2db_socket_name);
+			}
+		ndo2db_shm=NULL;
+		}
+
+	else{
+
+		/* close the socket */
+		shutdown(ndo2db_sd,2);
+		close(ndo2db_sd);
 
-	/* unlink the file */
-	if(ndo2db_socket_type==NDO_SINK_UNIXSOCKET)
-		unlink(ndo2db_socket_name);
+		/* unlink the file */
+		if(ndo2db_socket_type==NDO_SINK_UNIXSOCKET || ndo2db_socket_type==NDO_SINK_UNIXSEQPACKET)
+			unlink(ndo2db_socket_name);
+		}
 
 	if(lock_file)
 		unlink(lock_file);
@@ -904,6 +983,9 @@ int ndo2db_wait_for_connections(void){
 	socklen_t client_address_length;
 	static int listen_backlog = INT_MAX;
 
+	/* the module writes straight into a shared memory ring, so there is nothing to accept */
+	if(ndo2db_socket_type==NDO_SINK_SHM)
+		return ndo2db_handle_shm_connection();
 
 #ifdef HAVE_SYSTEMD
 	/* Socket inherited from systemd */
@@ -953,7 +1035,7 @@ int ndo2db_wait_for_connections(void){
 	else{
 
 		/* create a socket */
-		if(!(ndo2db_sd=socket(AF_UNIX,SOCK_STREAM,0))){
+		if(!(ndo2db_sd=socket(AF_UNIX,(ndo2db_socket_type==NDO_SINK_UNIXSEQPACKET)?SOCK_SEQPACKET:SOCK_STREAM,0))){
 			perror("Cannot create socket");
 			return NDO_ERROR;
 	                }
@@ -993,6 +1075,10 @@ int ndo2db_wait_for_connections(void){
 		return NDO_ERROR;
 #endif
 
+	/* one process for every client instead of one (or two) each */
+	if(ndo2db_use_event_loop==NDO_TRUE)
+		return ndo2db_run_event_loop();
+
 	/* accept connections... */
 	while(1){
 
@@ -1039,7 +1125,10 @@ int ndo2db_wait_for_connections(void){
 		case 0:
 #endif
 			/* child processes data... */
-			ndo2db_handle_client_connection(new_sd);
+			if(ndo2db_socket_type==NDO_SINK_UNIXSEQPACKET)
+				ndo2db_handle_seqpacket_connection(new_sd);
+			else
+				ndo2db_handle_client_connection(new_sd);
 
 			/* close socket when we're done */
 			close(new_sd);
@@ -1067,10 +1156,15 @@ int ndo2db_wait_for_connections(void){
 
 
 int ndo2db_handle_client_connection(int sd){
-	ndo_dbuf dbuf;
-	int dbuf_chunk=2048;
 	ndo2db_idi idi;
-	char buf[512];
+	ndo2db_stream stream;
+	char *buf=NULL;
+	unsigned long reads=0L;
+	unsigned long bytes_read=0L;
+	unsigned long interval_reads=0L;
+	unsigned long interval_bytes=0L;
+	time_t interval_start=0L;
+	time_t now=0L;
 	int result=0;
 	int error=NDO_FALSE;
 
@@ -1092,16 +1186,36 @@ int ndo2db_handle_client_connection(int sd){
 	signal(SIGSEGV,ndo2db_child_sighandler);
 	signal(SIGFPE,ndo2db_child_sighandler);
 
-	pid_t chpid;
-	if ((chpid = fork()) == 0) {
+	/* each read takes as much as the client has sent, up to the whole buffer */
+	if((buf=(char *)malloc(ndo2db_read_buffer_size+1))==NULL){
+		syslog(LOG_ERR,"Error: Could not allocate read buffer for client data.");
+		return NDO_ERROR;
+		}
+
+	/* the writer gets everything we read through a ring set up before it is forked */
+	if((ndo2db_queue=ndo_shm_create_anon(ndo2db_queue_size))==NULL){
+		syslog(LOG_ERR,"Error: Could not create queue for client data: %s",strerror(errno));
+		free(buf);
+		return NDO_ERROR;
+		}
+
+	if((ndo2db_writer_pid=fork())==0){
 		ndo2db_async_client_handle();
-	}
+		exit(0);
+		}
+	else if(ndo2db_writer_pid==-1){
+		syslog(LOG_ERR,"Error: Could not fork writer process: %s",strerror(errno));
+		ndo_shm_detach(ndo2db_queue);
+		ndo2db_queue=NULL;
+		free(buf);
+		return NDO_ERROR;
+		}
 
 	/* initialize input data information */
 	ndo2db_idi_init(&idi);
 
-	/* initialize dynamic buffer (2KB chunk size) */
-	ndo_dbuf_init(&dbuf,dbuf_chunk);
+	/* we don't know if the client compresses its data until we've seen the hello */
+	ndo2db_stream_init(&stream);
 
 	/* initialize database connection */
 	ndo2db_db_init(&idi);
@@ -1118,6 +1232,8 @@ int ndo2db_handle_client_connection(int sd){
 
 			if(result!=1){
 				syslog(LOG_ERR,"Error: Could not complete SSL handshake. %d\n",SSL_get_error(ssl,result));
+				ndo2db_queue_finish();
+				free(buf);
 
 				return NDO_ERROR;
 			}
@@ -1125,20 +1241,22 @@ int ndo2db_handle_client_connection(int sd){
 	}
 #endif
 
+	time(&interval_start);
+
 	/* read all data from client */
 	while(1){
 #ifdef HAVE_SSL
 		if(use_ssl==NDO_FALSE)
-			result=read(sd,buf,sizeof(buf)-1);
+			result=read(sd,buf,ndo2db_read_buffer_size);
 		else{
-			result=SSL_read(ssl,buf,sizeof(buf)-1);
+			result=SSL_read(ssl,buf,ndo2db_read_buffer_size);
 			if(result==-1 && (SSL_get_error(ssl,result)==SSL_ERROR_WANT_READ)){
 				syslog(LOG_ERR,"SSL read error\n");
 			}
 		}
 #else
 
-		result=read(sd,buf,sizeof(buf)-1);
+		result=read(sd,buf,ndo2db_read_buffer_size);
 #endif
 		/* bail out on hard errors */
 		if(result==-1) {
@@ -1172,7 +1290,6 @@ int ndo2db_handle_client_connection(int sd){
 
 			/* gracefully back out of current operation... */
 			ndo2db_db_goodbye(&idi);
-			kill (chpid, SIGTERM);
 
 			break;
 		        }
@@ -1181,22 +1298,36 @@ int ndo2db_handle_client_connection(int sd){
 		printf("BYTESREAD: %d\n",result);
 #endif
 
-		/* append data we just read to dynamic buffer */
+		reads++;
+		bytes_read+=result;
+		interval_reads++;
+		interval_bytes+=result;
+
+		/* a long-lived client doesn't disconnect often, so report how the reads are going as we go */
+		if((now=time(NULL))-interval_start>=NDO2DB_READ_STATS_INTERVAL){
+			syslog(LOG_USER|LOG_INFO,"Read %lu bytes in %lu reads over the last %lu seconds (%lu bytes per read on average).",interval_bytes,interval_reads,(unsigned long)(now-interval_start),interval_bytes/interval_reads);
+			interval_reads=0L;
+			interval_bytes=0L;
+			interval_start=now;
+			}
+
 		buf[result]='\x0';
-		ndo_dbuf_strcat(&dbuf,buf);
 
-		/* check for completed lines of input */
-		ndo2db_check_for_client_input(&idi,&dbuf);
-		/* reinitialize buffer */
-		ndo_dbuf_free(&dbuf);
-		ndo_dbuf_init(&dbuf,dbuf_chunk);
+		/* the hello and compressed data need a closer look */
+		if(stream.state!=NDO2DB_STREAM_TEXT){
+			if(ndo2db_stream_input(&stream,&idi,buf,(unsigned long)result)==NDO_ERROR)
+				idi.disconnect_client=NDO_TRUE;
+			}
+
+		/* plain data goes straight to the writer */
+		else if(ndo2db_check_for_client_input(&idi,buf,(unsigned long)result)==NDO_ERROR)
+			idi.disconnect_client=NDO_TRUE;
 
 		/* should we disconnect the client? */
 		if(idi.disconnect_client==NDO_TRUE){
 
 			/* gracefully back out of current operation... */
 			ndo2db_db_goodbye(&idi);
-			kill (chpid, SIGTERM);
 
 			break;
 		        }
@@ -1206,8 +1337,11 @@ int ndo2db_handle_client_connection(int sd){
 	printf("BYTES: %lu, LINES: %lu\n",idi.bytes_processed,idi.lines_processed);
 #endif
 
-	/* free memory allocated to dynamic buffer */
-	ndo_dbuf_free(&dbuf);
+	if(reads>0L)
+		syslog(LOG_USER|LOG_INFO,"Client disconnected after %lu bytes in %lu reads (%lu bytes per read on average).",bytes_read,reads,bytes_read/reads);
+
+	free(buf);
+	ndo2db_stream_deinit(&stream);
 
 	/* disconnect from database */
 	ndo2db_db_disconnect(&idi);
@@ -1217,11 +1351,8 @@ int ndo2db_handle_client_connection(int sd){
 	ndo2db_free_input_memory(&idi);
 	ndo2db_free_connection_memory(&idi);
 
-	/* clean queue */
-	del_queue();
-
-	/* wait for child to end work */
-	waitpid(chpid, NULL, 0);
+	/* let the writer finish what is queued, then wait for it */
+	ndo2db_queue_finish();
 
 	/* close syslog facility */
 	/*closelog();*/
@@ -1233,72 +1364,30 @@ int ndo2db_handle_client_connection(int sd){
         }
 
 
-/* initializes structure for tracking data */
-int ndo2db_idi_init(ndo2db_idi *idi){
-	int x=0;
-
-	if(idi==NULL)
-		return NDO_ERROR;
-
-	idi->disconnect_client=NDO_FALSE;
-	idi->ignore_client_data=NDO_FALSE;
-	idi->protocol_version=0;
-	idi->instance_name=NULL;
-	idi->buffered_input=NULL;
-	idi->agent_name=NULL;
-	idi->agent_version=NULL;
-	idi->disposition=NULL;
-	idi->connect_source=NULL;
-	idi->connect_type=NULL;
-	idi->current_input_section=NDO2DB_INPUT_SECTION_NONE;
-	idi->current_input_data=NDO2DB_INPUT_DATA_NONE;
-	idi->bytes_processed=0L;
-	idi->lines_processed=0L;
-	idi->entries_processed=0L;
-	idi->current_object_config_type=NDO2DB_CONFIGTYPE_ORIGINAL;
-	idi->data_start_time=0L;
-	idi->data_end_time=0L;
-
-	/* initialize mbuf */
-	for(x=0;x<NDO2DB_MAX_MBUF_ITEMS;x++){
-		idi->mbuf[x].used_lines=0;
-		idi->mbuf[x].allocated_lines=0;
-		idi->mbuf[x].buffer=NULL;
-	        }
-
-	return NDO_OK;
-        }
-
-
-/* checks for single lines of input from a client connection */
-int ndo2db_check_for_client_input(ndo2db_idi *idi,ndo_dbuf *dbuf){
+/* handles a client on a message socket - every message holds whole lines and frames, so they are handled right where they were read */
+int ndo2db_handle_seqpacket_connection(int sd){
+	ndo2db_idi idi;
 	char *buf=NULL;
-	register int x;
-
-
-	if(dbuf==NULL)
-		return NDO_OK;
-	if(dbuf->buf==NULL)
-		return NDO_OK;
-
-#ifdef DEBUG_NDO2DB2
-	printf("RAWBUF: %s\n",dbuf->buf);
-	printf("  USED1: %lu, BYTES: %lu, LINES: %lu\n",dbuf->used_size,idi->bytes_processed,idi->lines_processed);
-#endif
+	struct iovec iov;
+	struct msghdr msg;
+	ssize_t result=0;
+	unsigned long used=0L;
+	unsigned long frame_size=0L;
+	int error=NDO_FALSE;
 
-	get_queue_id(getpid());
-	push_into_queue(dbuf->buf);
+	/* re-open debug log */
+	ndo2db_close_debug_log();
+	ndo2db_open_debug_log();
 
-	return NDO_OK;
-        }
+	/* reset signal handling */
+	signal(SIGQUIT,ndo2db_child_sighandler);
+	signal(SIGTERM,ndo2db_child_sighandler);
+	signal(SIGINT,ndo2db_child_sighandler);
+	signal(SIGSEGV,ndo2db_child_sighandler);
+	signal(SIGFPE,ndo2db_child_sighandler);
 
-/* asynchronous handle clients events */
-void ndo2db_async_client_handle() {
-	ndo2db_idi idi;
-	size_t len = 0, curlen, insz, maxbuf = 1024 * 64, bufsz = 1024 * 66;
-    int i;
-	char *buf = (char*)calloc(bufsz, sizeof(char));
-	char *temp_buf;
+	if((buf=(char *)malloc(ndo2db_max_frame_size+1))==NULL)
+		return NDO_ERROR;
 
 	/* initialize input data information */
 	ndo2db_idi_init(&idi);
@@ -1307,51 +1396,57 @@ void ndo2db_async_client_handle() {
 	ndo2db_db_init(&idi);
 	ndo2db_db_connect(&idi);
 
-	get_queue_id(getppid());
+	/* read all data from client */
+	while(1){
+
+		iov.iov_base=buf;
+		iov.iov_len=ndo2db_max_frame_size;
+		memset(&msg,0,sizeof(msg));
+		msg.msg_iov=&iov;
+		msg.msg_iovlen=1;
 
-	for (;;) {
-		char * qbuf = pop_from_queue();
+		result=recvmsg(sd,&msg,0);
 
-		ndo2db_log_debug_info(NDO2DB_DEBUGL_PROCESSINFO, 2,"Queue Message: %s\n", qbuf);
+		/* bail out on hard errors */
+		if(result==-1){
+			/* EAGAIN and EINTR are soft errors, so try another read() */
+			if(errno==EAGAIN || errno==EINTR)
+				continue;
+			error=NDO_TRUE;
+			break;
+			}
 
-		insz = strlen(qbuf);
-		curlen = len + insz;
-		strcat(buf, qbuf);
-		free(qbuf);
+		/* zero bytes read means we lost the connection with the client */
+		if(result==0){
+			ndo2db_db_goodbye(&idi);
+			break;
+			}
 
-        i = 0;
-		for ( ; i < curlen; i++) {
-			if (buf[i] == '\n') {
-				temp_buf = (char*)malloc((curlen + 4) * sizeof(char));
-				strncpy(temp_buf, buf, i);
-				temp_buf[i] = '\x0';
+		/* the rest of the message is gone, so don't try to make sense of what we got */
+		if(msg.msg_flags & MSG_TRUNC){
+			syslog(LOG_USER|LOG_INFO,"Warning: Dropped a message larger than max_frame_size (%lu bytes).",ndo2db_max_frame_size);
+			continue;
+			}
 
-				ndo2db_log_debug_info(NDO2DB_DEBUGL_PROCESSINFO, 2,"Handling: %s\n", temp_buf);
-				ndo2db_handle_client_input(&idi,temp_buf);
-/*				ndo2db_log_debug_info(NDO2DB_DEBUGL_PROCESSINFO, 2,"Full Buffer: %s\n", buf); */
+		buf[result]='\x0';
+		used=ndo2db_process_client_data(&idi,buf,(unsigned long)result,&frame_size);
 
-				memmove(buf, &buf[i+1], bufsz - i);
-				len = 0;
-				curlen = strlen(buf);
-				free(temp_buf);
+		/* messages end on an event boundary, so anything left over is junk */
+		if(used<(unsigned long)result)
+			ndo2db_log_debug_info(NDO2DB_DEBUGL_PROCESSINFO,2,"Discarding %lu bytes at the end of a message\n",(unsigned long)result-used);
 
-				idi.lines_processed++;
-				idi.bytes_processed += i+1;
-                i = -1;
+		/* should we disconnect the client? */
+		if(idi.disconnect_client==NDO_TRUE){
+			ndo2db_db_goodbye(&idi);
+			break;
 			}
 		}
 
-		len = curlen;
-		if (len  > maxbuf) {
-			buf[maxbuf+1] = 0;
-			len = curlen = maxbuf;
-			ndo2db_log_debug_info(NDO2DB_DEBUGL_PROCESSINFO, 2,"Truncating text at position %d - %s\n", maxbuf+1, &buf[maxbuf+2]);
-		} else if (len == 0)
-			memset(buf, 0, bufsz * sizeof(char));
-	}
-
 	free(buf);
 
+	/* let the writer threads finish */
+	ndo2db_dbpool_stop();
+
 	/* disconnect from database */
 	ndo2db_db_disconnect(&idi);
 	ndo2db_db_deinit(&idi);
@@ -1359,286 +1454,1078 @@ void ndo2db_async_client_handle() {
 	/* free memory */
 	ndo2db_free_input_memory(&idi);
 	ndo2db_free_connection_memory(&idi);
-}
 
-/* handles a single line of input from a client connection */
-int ndo2db_handle_client_input(ndo2db_idi *idi, char *buf){
-	char *var=NULL;
-	char *val=NULL;
-	unsigned long data_type_long=0L;
-	int data_type=NDO_DATA_NONE;
-	int input_type=NDO2DB_INPUT_DATA_NONE;
+	if(error==NDO_TRUE)
+		return NDO_ERROR;
 
-#ifdef DEBUG_NDO2DB2
-	printf("HANDLING: '%s'\n",buf);
-#endif
+	return NDO_OK;
+        }
 
-	if(buf==NULL || idi==NULL)
-		return NDO_ERROR;
 
-	/* we're ignoring client data because of wrong protocol version, etc...  */
-	if(idi->ignore_client_data==NDO_TRUE)
-		return NDO_ERROR;
+/* ends a module session read from the shared memory ring */
+static void ndo2db_shm_end_session(ndo2db_idi *idi, ndo_dbuf *carry){
 
-	/* skip empty lines */
-	if(buf[0]=='\x0')
-		return NDO_OK;
+	/* gracefully back out of current operation... */
+	ndo2db_db_goodbye(idi);
 
-	switch(idi->current_input_section){
+	/* disconnect from database */
+	ndo2db_db_disconnect(idi);
+	ndo2db_db_deinit(idi);
 
-	case NDO2DB_INPUT_SECTION_NONE:
+	/* free memory */
+	ndo2db_free_input_memory(idi);
+	ndo2db_free_connection_memory(idi);
 
-		var=strtok(buf,":");
-		val=strtok(NULL,"\n");
+	ndo_dbuf_reset(carry);
 
-		if(!strcmp(var,NDO_API_HELLO)){
+	return;
+        }
 
-			idi->current_input_section=NDO2DB_INPUT_SECTION_HEADER;
-			idi->current_input_data=NDO2DB_INPUT_DATA_NONE;
 
-			/* free old connection memory (necessary in some cases) */
-			ndo2db_free_connection_memory(idi);
-		        }
+/* handles a chunk of client input - complete lines and frames are handled where they sit, only a line or frame split across chunks is copied */
+static void ndo2db_split_input(ndo2db_idi *idi, ndo_dbuf *carry, char *buf, unsigned long len){
+	unsigned long used=0L;
+	unsigned long take=0L;
+	unsigned long had=0L;
+	unsigned long frame_size=0L;
+	char *nl=NULL;
 
-		break;
+	/* finish off what was left over from the last chunk, copying only as much as that needs */
+	while(carry->used_size>0L){
 
-	case NDO2DB_INPUT_SECTION_HEADER:
+		/* a partial frame needs the rest of its header, then the rest of its body */
+		if(idi->protocol_version==NDO_API_PROTOVERSION_BINARY && idi->current_input_section==NDO2DB_INPUT_SECTION_DATA && idi->current_input_data==NDO2DB_INPUT_DATA_NONE && carry->buf[0]==NDO_API_FRAME_MARKER){
+			if((frame_size=ndo2db_get_frame_size(carry->buf,carry->used_size))==0L)
+				frame_size=NDO_API_FRAME_HEADER_SIZE;
+			take=(frame_size>carry->used_size)?frame_size-carry->used_size:0L;
 
-		var=strtok(buf,":");
-		val=strtok(NULL,"\n");
+			/* an oversized frame isn't collected - its header is enough to start skipping it */
+			if(frame_size>ndo2db_max_frame_size)
+				take=0L;
+			}
 
-		if(!strcmp(var,NDO_API_STARTDATADUMP)){
+		/* a partial line needs everything up to the next newline */
+		else{
+			frame_size=0L;
+			nl=memchr(buf,'\n',len);
+			take=(nl==NULL)?len:(unsigned long)(nl-buf)+1;
+			}
 
-			/* client is using wrong protocol version, bail out here... */
-			if(idi->protocol_version!=NDO_API_PROTOVERSION){
-				syslog(LOG_USER|LOG_INFO,"Error: Client protocol version %d is incompatible with server version %d.  Disconnecting client...",idi->protocol_version,NDO_API_PROTOVERSION);
-				idi->disconnect_client=NDO_TRUE;
-				idi->ignore_client_data=NDO_TRUE;
-				return NDO_ERROR;
-			        }
+		if(take>len)
+			take=len;
+
+		had=carry->used_size;
+		ndo_dbuf_strncat(carry,buf,take);
+		buf+=take;
+		len-=take;
+
+		/* overly long lines are cut short, but partial frames are kept whole */
+		if(frame_size==0L && carry->used_size>ndo2db_max_line_length+1){
+			if(had<ndo2db_max_line_length)
+				syslog(LOG_USER|LOG_INFO,"Warning: Truncating a line of input longer than max_line_length (%lu bytes).",ndo2db_max_line_length);
+			take=ndo2db_max_line_length;
+			if(carry->buf[carry->used_size-1]=='\n')
+				carry->buf[take++]='\n';
+			carry->used_size=take;
+			carry->buf[carry->used_size]='\x0';
+			}
 
-			idi->current_input_section=NDO2DB_INPUT_SECTION_DATA;
+		used=ndo2db_process_client_data(idi,carry->buf,carry->used_size,&frame_size);
+		memmove(carry->buf,carry->buf+used,carry->used_size-used);
+		carry->used_size-=used;
+		carry->buf[carry->used_size]='\x0';
 
-			/* save connection info to DB */
-			ndo2db_db_hello(idi);
-		        }
+		/* this chunk is used up - otherwise a header that just came together still needs its body */
+		if(len==0L)
+			return;
+		}
 
-		else if(!strcmp(var,NDO_API_PROTOCOL))
-			ndo2db_convert_string_to_int((val+1),&idi->protocol_version);
+	/* the rest is handled in place, and whatever is left over waits for the next chunk */
+	used=ndo2db_process_client_data(idi,buf,len,&frame_size);
+	if(used<len){
+		if(frame_size==0L && len-used>ndo2db_max_line_length){
+			syslog(LOG_USER|LOG_INFO,"Warning: Truncating a line of input longer than max_line_length (%lu bytes).",ndo2db_max_line_length);
+			len=used+ndo2db_max_line_length;
+			}
+		ndo_dbuf_strncat(carry,buf+used,len-used);
+		}
 
-		else if(!strcmp(var,NDO_API_INSTANCENAME))
-			idi->instance_name=strdup(val+1);
+	return;
+        }
 
-		else if(!strcmp(var,NDO_API_AGENT))
-			idi->agent_name=strdup(val+1);
 
-		else if(!strcmp(var,NDO_API_AGENTVERSION))
-			idi->agent_version=strdup(val+1);
+/* reads module sessions from the shared memory ring - there is only ever one module, so this runs in the daemon itself */
+int ndo2db_handle_shm_connection(void){
+	ndo2db_idi idi;
+	ndo_dbuf carry;
+	char *buf=NULL;
+	unsigned long len=0L;
+	unsigned int session=0;
+	unsigned int current_session=0;
+	unsigned int dropped_session=0;
+	int connected=NDO_FALSE;
 
-		else if(!strcmp(var,NDO_API_DISPOSITION))
-			idi->disposition=strdup(val+1);
+	/* daemonize */
+#ifndef DEBUG_NDO2DB
+	if(ndo2db_daemonize()!=NDO_OK)
+		return NDO_ERROR;
+#endif
 
-		else if(!strcmp(var,NDO_API_CONNECTION))
-			idi->connect_source=strdup(val+1);
+	/* the ring belongs to the process that reads it */
+	if((ndo2db_shm=ndo_shm_create(ndo2db_socket_name,ndo2db_shm_size))==NULL){
+		syslog(LOG_ERR,"Error: Could not create shared memory ring '%s': %s",ndo2db_socket_name,strerror(errno));
+		perror("Could not create shared memory ring");
+		return NDO_ERROR;
+		}
 
-		else if(!strcmp(var,NDO_API_CONNECTTYPE))
-			idi->connect_type=strdup(val+1);
+	/* lines split across records are put back together here */
+	ndo_dbuf_init(&carry,2048);
 
-		else if(!strcmp(var,NDO_API_STARTTIME))
-			ndo2db_convert_string_to_unsignedlong((val+1),&idi->data_start_time);
+	while(1){
 
-		break;
+		if((buf=ndo_shm_peek(ndo2db_shm,&len,&session))==NULL){
 
-	case NDO2DB_INPUT_SECTION_FOOTER:
+			/* the module went away without saying goodbye */
+			if(connected==NDO_TRUE && ndo_shm_producer_alive(ndo2db_shm)==NDO_FALSE){
+				ndo2db_shm_end_session(&idi,&carry);
+				connected=NDO_FALSE;
+				}
 
-		var=strtok(buf,":");
-		val=strtok(NULL,"\n");
+			ndo_shm_wait(ndo2db_shm,1000);
+			continue;
+			}
 
-		/* client is saying goodbye... */
-		if(!strcmp(var,NDO_API_GOODBYE))
-			idi->current_input_section=NDO2DB_INPUT_SECTION_NONE;
+		/* a new module attached before we saw the old one leave */
+		if(connected==NDO_TRUE && session!=current_session){
+			ndo2db_shm_end_session(&idi,&carry);
+			connected=NDO_FALSE;
+			}
 
-		else if(!strcmp(var,NDO_API_ENDTIME))
-			ndo2db_convert_string_to_unsignedlong((val+1),&idi->data_end_time);
+		/* end of session */
+		if(len==0L){
+			if(connected==NDO_TRUE){
+				ndo2db_shm_end_session(&idi,&carry);
+				connected=NDO_FALSE;
+				}
+			}
 
-		break;
+		/* anything else is data, unless it is the rest of a session we gave up on */
+		else if(dropped_session==0 || session!=dropped_session){
 
-	case NDO2DB_INPUT_SECTION_DATA:
+			/* first data from a new module */
+			if(connected==NDO_FALSE){
 
-		if(idi->current_input_data==NDO2DB_INPUT_DATA_NONE){
+				/* re-open debug log */
+				ndo2db_close_debug_log();
+				ndo2db_open_debug_log();
 
-			var=strtok(buf,":");
-			val=strtok(NULL,"\n");
+				/* initialize input data information */
+				ndo2db_idi_init(&idi);
 
-			input_type=atoi(var);
+				/* initialize database connection */
+				ndo2db_db_init(&idi);
+				ndo2db_db_connect(&idi);
 
-			switch(input_type){
+				current_session=session;
+				connected=NDO_TRUE;
+				}
 
-			/* we're reached the end of all of the data... */
-			case NDO_API_ENDDATADUMP:
-				idi->current_input_section=NDO2DB_INPUT_SECTION_FOOTER;
-				idi->current_input_data=NDO2DB_INPUT_DATA_NONE;
-				break;
+			ndo2db_split_input(&idi,&carry,buf,len);
 
-			/* config dumps */
-			case NDO_API_STARTCONFIGDUMP:
-				idi->current_input_data=NDO2DB_INPUT_DATA_CONFIGDUMPSTART;
-				break;
-			case NDO_API_ENDCONFIGDUMP:
-				idi->current_input_data=NDO2DB_INPUT_DATA_CONFIGDUMPEND;
-				break;
+			/* should we disconnect the client? */
+			if(idi.disconnect_client==NDO_TRUE){
+				ndo2db_shm_end_session(&idi,&carry);
+				connected=NDO_FALSE;
+				dropped_session=session;
+				}
+			}
 
-			/* archived data */
-			case NDO_API_LOGENTRY:
-				idi->current_input_data=NDO2DB_INPUT_DATA_LOGENTRY;
-				break;
+		ndo_shm_release(ndo2db_shm);
 
-			/* realtime data */
-			case NDO_API_PROCESSDATA:
-				idi->current_input_data=NDO2DB_INPUT_DATA_PROCESSDATA;
-				break;
-			case NDO_API_TIMEDEVENTDATA:
-				idi->current_input_data=NDO2DB_INPUT_DATA_TIMEDEVENTDATA;
-				break;
-			case NDO_API_LOGDATA:
-				idi->current_input_data=NDO2DB_INPUT_DATA_LOGDATA;
-				break;
-			case NDO_API_SYSTEMCOMMANDDATA:
-				idi->current_input_data=NDO2DB_INPUT_DATA_SYSTEMCOMMANDDATA;
-				break;
-			case NDO_API_EVENTHANDLERDATA:
-				idi->current_input_data=NDO2DB_INPUT_DATA_EVENTHANDLERDATA;
-				break;
-			case NDO_API_NOTIFICATIONDATA:
-				idi->current_input_data=NDO2DB_INPUT_DATA_NOTIFICATIONDATA;
-				break;
-			case NDO_API_SERVICECHECKDATA:
-				idi->current_input_data=NDO2DB_INPUT_DATA_SERVICECHECKDATA;
-				break;
-			case NDO_API_HOSTCHECKDATA:
-				idi->current_input_data=NDO2DB_INPUT_DATA_HOSTCHECKDATA;
-				break;
-			case NDO_API_COMMENTDATA:
-				idi->current_input_data=NDO2DB_INPUT_DATA_COMMENTDATA;
-				break;
-			case NDO_API_DOWNTIMEDATA:
-				idi->current_input_data=NDO2DB_INPUT_DATA_DOWNTIMEDATA;
-				break;
-			case NDO_API_FLAPPINGDATA:
-				idi->current_input_data=NDO2DB_INPUT_DATA_FLAPPINGDATA;
-				break;
-			case NDO_API_PROGRAMSTATUSDATA:
-				idi->current_input_data=NDO2DB_INPUT_DATA_PROGRAMSTATUSDATA;
-				break;
-			case NDO_API_HOSTSTATUSDATA:
-				idi->current_input_data=NDO2DB_INPUT_DATA_HOSTSTATUSDATA;
-				break;
-			case NDO_API_SERVICESTATUSDATA:
-				idi->current_input_data=NDO2DB_INPUT_DATA_SERVICESTATUSDATA;
-				break;
-			case NDO_API_CONTACTSTATUSDATA:
-				idi->current_input_data=NDO2DB_INPUT_DATA_CONTACTSTATUSDATA;
-				break;
-			case NDO_API_ADAPTIVEPROGRAMDATA:
-				idi->current_input_data=NDO2DB_INPUT_DATA_ADAPTIVEPROGRAMDATA;
-				break;
-			case NDO_API_ADAPTIVEHOSTDATA:
-				idi->current_input_data=NDO2DB_INPUT_DATA_ADAPTIVEHOSTDATA;
-				break;
-			case NDO_API_ADAPTIVESERVICEDATA:
-				idi->current_input_data=NDO2DB_INPUT_DATA_ADAPTIVESERVICEDATA;
-				break;
-			case NDO_API_ADAPTIVECONTACTDATA:
-				idi->current_input_data=NDO2DB_INPUT_DATA_ADAPTIVECONTACTDATA;
-				break;
-			case NDO_API_EXTERNALCOMMANDDATA:
-				idi->current_input_data=NDO2DB_INPUT_DATA_EXTERNALCOMMANDDATA;
-				break;
-			case NDO_API_AGGREGATEDSTATUSDATA:
-				idi->current_input_data=NDO2DB_INPUT_DATA_AGGREGATEDSTATUSDATA;
-				break;
-			case NDO_API_RETENTIONDATA:
-				idi->current_input_data=NDO2DB_INPUT_DATA_RETENTIONDATA;
-				break;
-			case NDO_API_CONTACTNOTIFICATIONDATA:
-				idi->current_input_data=NDO2DB_INPUT_DATA_CONTACTNOTIFICATIONDATA;
-				break;
-			case NDO_API_CONTACTNOTIFICATIONMETHODDATA:
-				idi->current_input_data=NDO2DB_INPUT_DATA_CONTACTNOTIFICATIONMETHODDATA;
-				break;
-			case NDO_API_ACKNOWLEDGEMENTDATA:
-				idi->current_input_data=NDO2DB_INPUT_DATA_ACKNOWLEDGEMENTDATA;
-				break;
-			case NDO_API_STATECHANGEDATA:
-				idi->current_input_data=NDO2DB_INPUT_DATA_STATECHANGEDATA;
-				break;
+#ifdef DEBUG_NDO2DB_EXIT_AFTER_CONNECTION
+		if(connected==NDO_FALSE && current_session!=0)
+			break;
+#endif
+		}
+
+	ndo_dbuf_free(&carry);
+
+	/* let the writer threads finish */
+	ndo2db_dbpool_stop();
+
+	/* cleanup after ourselves */
+	ndo2db_cleanup_socket();
+
+	return NDO_OK;
+        }
+
+
+/* one process reads every client and writes through a single database connection */
+#if defined(__linux__)
+
+/* sets which socket events we are waiting for on a client */
+static int ndo2db_event_loop_watch(int epfd, int op, ndo2db_client *client, unsigned int events){
+	struct epoll_event ev;
+
+	memset(&ev,0,sizeof(ev));
+	ev.events=events;
+	ev.data.ptr=client;
+
+	return epoll_ctl(epfd,op,client->sd,&ev);
+        }
+
+
+/* says goodbye for a client and frees everything it had */
+static void ndo2db_event_loop_close(int epfd, ndo2db_client **clients, ndo2db_client *client){
+	ndo2db_client *temp=NULL;
+
+	/* gracefully back out of current operation... */
+	ndo2db_db_goodbye(&client->idi);
+
+#ifdef HAVE_SSL
+	if(client->ssl!=NULL){
+		SSL_shutdown(client->ssl);
+		SSL_free(client->ssl);
+		}
+#endif
+
+	epoll_ctl(epfd,EPOLL_CTL_DEL,client->sd,NULL);
+	close(client->sd);
+
+	ndo2db_stream_deinit(&client->stream);
+	ndo_dbuf_free(&client->carry);
+
+	/* disconnect from database */
+	ndo2db_db_disconnect(&client->idi);
+	ndo2db_db_deinit(&client->idi);
+
+	/* free memory */
+	ndo2db_free_input_memory(&client->idi);
+	ndo2db_free_connection_memory(&client->idi);
+
+	if(*clients==client)
+		*clients=client->next;
+	else{
+		for(temp=*clients;temp!=NULL && temp->next!=client;temp=temp->next);
+		if(temp!=NULL)
+			temp->next=client->next;
+		}
+
+	free(client);
+
+	return;
+        }
+
+
+/* accepts every waiting client */
+static void ndo2db_event_loop_accept(int epfd, ndo2db_client **clients){
+	ndo2db_client *client=NULL;
+	int new_sd=0;
+
+	while((new_sd=accept(ndo2db_sd,NULL,NULL))>=0){
+
+		if((client=(ndo2db_client *)calloc(1,sizeof(ndo2db_client)))==NULL){
+			close(new_sd);
+			continue;
+			}
+
+		fcntl(new_sd,F_SETFL,fcntl(new_sd,F_GETFL)|O_NONBLOCK);
+		client->sd=new_sd;
+		client->seqpacket=(ndo2db_socket_type==NDO_SINK_UNIXSEQPACKET)?NDO_TRUE:NDO_FALSE;
+
+#ifdef HAVE_SSL
+		if(use_ssl==NDO_TRUE){
+			if((client->ssl=SSL_new(ctx))==NULL){
+				syslog(LOG_ERR,"Error: Could not create SSL connection structure.\n");
+				close(new_sd);
+				free(client);
+				continue;
+				}
+			SSL_set_fd(client->ssl,new_sd);
+			}
+#endif
+
+		/* initialize input data information */
+		ndo2db_idi_init(&client->idi);
+
+		/* we don't know if the client compresses its data until we've seen the hello */
+		ndo2db_stream_init(&client->stream);
+		ndo_dbuf_init(&client->carry,2048);
+		client->stream.carry=&client->carry;
+
+		/* initialize database connection */
+		ndo2db_db_init(&client->idi);
+		ndo2db_db_connect(&client->idi);
+
+		client->next=*clients;
+		*clients=client;
+
+		if(ndo2db_event_loop_watch(epfd,EPOLL_CTL_ADD,client,EPOLLIN)==-1){
+			syslog(LOG_ERR,"Error: Could not watch client socket: %s",strerror(errno));
+			ndo2db_event_loop_close(epfd,clients,client);
+			}
+		}
+
+	if(errno!=EAGAIN && errno!=EWOULDBLOCK && errno!=EINTR)
+		syslog(LOG_ERR,"Error: Accept error: %s",strerror(errno));
+
+	return;
+        }
+
+
+/* handles whatever a client has sent us, returns NDO_ERROR when the client should be dropped */
+static int ndo2db_event_loop_read(int epfd, ndo2db_client *client, char *buf, unsigned long bufsize){
+	struct iovec iov;
+	struct msghdr msg;
+	ssize_t result=0;
+	unsigned long frame_size=0L;
+
+	/* the shared database connection went away underneath this client */
+	if(client->idi.dbinfo.connected==NDO_TRUE && ndo2db_db_shared_connected==NDO_FALSE){
+		client->idi.dbinfo.connected=NDO_FALSE;
+		return NDO_ERROR;
+		}
+
+#ifdef HAVE_SSL
+	/* finish the handshake before anything else */
+	if(client->ssl!=NULL && client->ssl_ready==NDO_FALSE){
+		if((result=SSL_accept(client->ssl))==1){
+			client->ssl_ready=NDO_TRUE;
+			ndo2db_event_loop_watch(epfd,EPOLL_CTL_MOD,client,EPOLLIN);
+			}
+		else if(SSL_get_error(client->ssl,result)==SSL_ERROR_WANT_READ)
+			ndo2db_event_loop_watch(epfd,EPOLL_CTL_MOD,client,EPOLLIN);
+		else if(SSL_get_error(client->ssl,result)==SSL_ERROR_WANT_WRITE)
+			ndo2db_event_loop_watch(epfd,EPOLL_CTL_MOD,client,EPOLLOUT);
+		else{
+			syslog(LOG_ERR,"Error: Could not complete SSL handshake. %d\n",SSL_get_error(client->ssl,result));
+			return NDO_ERROR;
+			}
+		return NDO_OK;
+		}
+#endif
+
+	do{
+
+		/* each message is a whole number of events */
+		if(client->seqpacket==NDO_TRUE){
+			iov.iov_base=buf;
+			iov.iov_len=bufsize;
+			memset(&msg,0,sizeof(msg));
+			msg.msg_iov=&iov;
+			msg.msg_iovlen=1;
+			result=recvmsg(client->sd,&msg,0);
+			}
+#ifdef HAVE_SSL
+		else if(client->ssl!=NULL){
+			result=SSL_read(client->ssl,buf,bufsize);
+			if(result<=0)
+				return (SSL_get_error(client->ssl,result)==SSL_ERROR_WANT_READ)?NDO_OK:NDO_ERROR;
+			}
+#endif
+		else
+			result=read(client->sd,buf,bufsize);
+
+		/* EAGAIN and EINTR are soft errors, we'll be back when there is more */
+		if(result==-1)
+			return (errno==EAGAIN || errno==EWOULDBLOCK || errno==EINTR)?NDO_OK:NDO_ERROR;
+
+		/* zero bytes read means we lost the connection with the client */
+		if(result==0)
+			return NDO_ERROR;
+
+		buf[result]='\x0';
+
+		if(client->seqpacket==NDO_TRUE){
+			if(msg.msg_flags & MSG_TRUNC)
+				syslog(LOG_USER|LOG_INFO,"Warning: Dropped a message larger than max_frame_size (%lu bytes).",ndo2db_max_frame_size);
+			else
+				ndo2db_process_client_data(&client->idi,buf,(unsigned long)result,&frame_size);
+			}
+		else
+			ndo2db_stream_input(&client->stream,&client->idi,buf,(unsigned long)result);
+
+		/* should we disconnect the client? */
+		if(client->idi.disconnect_client==NDO_TRUE)
+			return NDO_ERROR;
+
+#ifdef HAVE_SSL
+		/* SSL may have decrypted more than it gave us, and epoll won't tell us about it */
+		}while(client->ssl!=NULL && SSL_pending(client->ssl)>0);
+#else
+		}while(0);
+#endif
+
+	return NDO_OK;
+        }
+
+
+/* multiplexes every client connection in this one process */
+int ndo2db_run_event_loop(void){
+	struct epoll_event listen_ev;
+	struct epoll_event events[NDO2DB_EVENT_LOOP_MAX_EVENTS];
+	ndo2db_client *clients=NULL;
+	ndo2db_client *client=NULL;
+	char *buf=NULL;
+	unsigned long bufsize=0L;
+	int epfd=-1;
+	int nfds=0;
+	int x=0;
+
+	/* message sockets need room for a whole frame */
+	bufsize=(ndo2db_max_frame_size>NDO2DB_EVENT_LOOP_READ_SIZE)?ndo2db_max_frame_size:NDO2DB_EVENT_LOOP_READ_SIZE;
+	if((buf=(char *)malloc(bufsize+1))==NULL)
+		return NDO_ERROR;
+
+	if((epfd=epoll_create(NDO2DB_EVENT_LOOP_MAX_EVENTS))==-1){
+		syslog(LOG_ERR,"Error: Could not create epoll instance: %s",strerror(errno));
+		free(buf);
+		return NDO_ERROR;
+		}
+
+	/* clients share one database connection */
+	ndo2db_db_shared=NDO_TRUE;
+
+	fcntl(ndo2db_sd,F_SETFL,fcntl(ndo2db_sd,F_GETFL)|O_NONBLOCK);
+	memset(&listen_ev,0,sizeof(listen_ev));
+	listen_ev.events=EPOLLIN;
+	listen_ev.data.ptr=NULL;
+	if(epoll_ctl(epfd,EPOLL_CTL_ADD,ndo2db_sd,&listen_ev)==-1){
+		syslog(LOG_ERR,"Error: Could not watch listening socket: %s",strerror(errno));
+		close(epfd);
+		free(buf);
+		return NDO_ERROR;
+		}
+
+	while(1){
+
+		if((nfds=epoll_wait(epfd,events,NDO2DB_EVENT_LOOP_MAX_EVENTS,-1))==-1){
+			if(errno==EINTR)
+				continue;
+			syslog(LOG_ERR,"Error: epoll_wait() failed: %s",strerror(errno));
+			break;
+			}
+
+		for(x=0;x<nfds;x++){
+
+			/* new clients */
+			if(events[x].data.ptr==NULL){
+				ndo2db_event_loop_accept(epfd,&clients);
+				continue;
+				}
+
+			client=(ndo2db_client *)events[x].data.ptr;
+
+			/* a client shows up once per batch at most, so it is safe to free it here */
+			if(ndo2db_event_loop_read(epfd,client,buf,bufsize)==NDO_ERROR)
+				ndo2db_event_loop_close(epfd,&clients,client);
+			}
+		}
+
+	while(clients!=NULL)
+		ndo2db_event_loop_close(epfd,&clients,clients);
+
+	/* let the writer threads finish */
+	ndo2db_dbpool_stop();
+
+	ndo2db_db_close_shared();
+	close(epfd);
+	free(buf);
+
+	/* cleanup after ourselves */
+	ndo2db_cleanup_socket();
+
+	return NDO_OK;
+        }
+
+#else
+
+int ndo2db_run_event_loop(void){
+
+	syslog(LOG_ERR,"Error: The event loop needs epoll, which this platform does not have.");
+
+	return NDO_ERROR;
+        }
+
+#endif
+
+
+/* initializes structure for tracking data */
+int ndo2db_idi_init(ndo2db_idi *idi){
+	int x=0;
+
+	if(idi==NULL)
+		return NDO_ERROR;
+
+	idi->disconnect_client=NDO_FALSE;
+	idi->ignore_client_data=NDO_FALSE;
+	idi->protocol_version=0;
+	idi->instance_name=NULL;
+	idi->buffered_input=NULL;
+	idi->input_values=NULL;
+	idi->agent_name=NULL;
+	idi->agent_version=NULL;
+	idi->disposition=NULL;
+	idi->connect_source=NULL;
+	idi->connect_type=NULL;
+	idi->current_input_section=NDO2DB_INPUT_SECTION_NONE;
+	idi->current_input_data=NDO2DB_INPUT_DATA_NONE;
+	idi->bytes_processed=0L;
+	idi->lines_processed=0L;
+	idi->frame_skip=0L;
+	idi->entries_processed=0L;
+	idi->events_shed=0L;
+	idi->events_shed_logged=0L;
+	idi->config_hashes=NDO_FALSE;
+	idi->current_object_config_type=NDO2DB_CONFIGTYPE_ORIGINAL;
+	idi->data_start_time=0L;
+	idi->data_end_time=0L;
+	idi->dbinfo.pooled=NDO_FALSE;
+
+	/* initialize mbuf */
+	for(x=0;x<NDO2DB_MAX_MBUF_ITEMS;x++){
+		idi->mbuf[x].used_lines=0;
+		idi->mbuf[x].allocated_lines=0;
+		idi->mbuf[x].buffer=NULL;
+	        }
+
+	return NDO_OK;
+        }
+
+
+/* passes data read from a client connection on to the writer */
+int ndo2db_check_for_client_input(ndo2db_idi *idi,char *buf,unsigned long len){
+
+	if(buf==NULL || len==0L)
+		return NDO_OK;
+
+#ifdef DEBUG_NDO2DB2
+	printf("RAWBUF: %s\n",buf);
+	printf("  USED1: %lu, BYTES: %lu, LINES: %lu\n",len,idi->bytes_processed,idi->lines_processed);
+#endif
+
+	return ndo2db_queue_input(buf,len);
+        }
+
+/* sets up stream state for a new client connection */
+int ndo2db_stream_init(ndo2db_stream *st){
+
+	if(st==NULL)
+		return NDO_ERROR;
+
+	memset(st,0,sizeof(ndo2db_stream));
+	st->state=NDO2DB_STREAM_HELLO;
+	ndo_dbuf_init(&st->zbuf,8192);
+
+	return NDO_OK;
+        }
+
+
+/* frees stream state and logs what compression did for us */
+int ndo2db_stream_deinit(ndo2db_stream *st){
+
+	if(st==NULL)
+		return NDO_ERROR;
+
+	if(st->blocks>0L){
+		syslog(LOG_USER|LOG_INFO,"Compression: %llu bytes in, %llu bytes out (%.2f:1), %lu blocks, %.3f ms CPU.",st->compressed_bytes,st->raw_bytes,(st->compressed_bytes>0)?((double)st->raw_bytes/st->compressed_bytes):0.0,st->blocks,(double)st->cpu_usec/1000.0);
+		ndo2db_log_debug_info(NDO2DB_DEBUGL_PROCESSINFO,0,"Compression: %llu bytes in, %llu bytes out, %lu blocks, %llu usec CPU\n",st->compressed_bytes,st->raw_bytes,st->blocks,st->cpu_usec);
+		}
+
+#ifdef HAVE_ZLIB
+	if(st->zs_ready==NDO_TRUE)
+		inflateEnd(&st->zs);
+	st->zs_ready=NDO_FALSE;
+#endif
+	ndo_dbuf_free(&st->zbuf);
+
+	return NDO_OK;
+        }
+
+
+/* passes client input to the writer process, waiting for room rather than dropping any of it */
+int ndo2db_queue_input(char *buf, unsigned long len){
+	unsigned long max_chunk=0L;
+	unsigned long chunk=0L;
+
+	if(ndo2db_queue==NULL)
+		return NDO_ERROR;
+
+	max_chunk=ndo2db_queue->size/4;
+
+	while(len>0L){
+		chunk=(len<max_chunk)?len:max_chunk;
+
+		while(ndo_shm_write(ndo2db_queue,buf,chunk)==-1){
+
+			/* the writer died, so nothing will ever empty the ring */
+			if(errno!=EAGAIN || waitpid(ndo2db_writer_pid,NULL,WNOHANG)==ndo2db_writer_pid){
+				syslog(LOG_ERR,"Error: Writer process for client data has gone away.  Disconnecting client...");
+				ndo2db_writer_pid=0;
+				return NDO_ERROR;
+				}
+
+			ndo_shm_wait_for_room(ndo2db_queue,1000);
+			}
+
+		buf+=chunk;
+		len-=chunk;
+		}
+
+	return NDO_OK;
+        }
+
+
+/* tells the writer process there is no more input and waits for it to finish */
+int ndo2db_queue_finish(void){
+
+	if(ndo2db_queue==NULL)
+		return NDO_OK;
+
+	/* let the writer drain the ring so the end of input marker is sure to fit */
+	while(ndo2db_writer_pid>0 && __atomic_load_n(&ndo2db_queue->hdr->tail,__ATOMIC_SEQ_CST)!=ndo2db_queue->hdr->head){
+		if(waitpid(ndo2db_writer_pid,NULL,WNOHANG)==ndo2db_writer_pid){
+			ndo2db_writer_pid=0;
+			break;
+			}
+		ndo_shm_wait_for_room(ndo2db_queue,1000);
+		}
+
+	ndo_shm_detach(ndo2db_queue);
+	ndo2db_queue=NULL;
+
+	if(ndo2db_writer_pid>0)
+		waitpid(ndo2db_writer_pid,NULL,0);
+	ndo2db_writer_pid=0;
+
+	return NDO_OK;
+        }
+
+
+/* hands decoded client input on to whoever handles it */
+static int ndo2db_stream_output(ndo2db_stream *st, ndo2db_idi *idi, char *buf, unsigned long len){
+
+	if(st->carry==NULL)
+		return ndo2db_queue_input(buf,len);
+
+	ndo2db_split_input(idi,st->carry,buf,len);
+
+	return NDO_OK;
+        }
+
+
+#ifdef HAVE_ZLIB
+/* cpu time used by this process, in usec */
+static unsigned long long ndo2db_cpu_usec(void){
+	struct rusage ru;
+
+	if(getrusage(RUSAGE_SELF,&ru)!=0)
+		return 0L;
+
+	return (unsigned long long)ru.ru_utime.tv_sec*1000000L+ru.ru_utime.tv_usec+(unsigned long long)ru.ru_stime.tv_sec*1000000L+ru.ru_stime.tv_usec;
+        }
 
-			/* config variables */
-			case NDO_API_MAINCONFIGFILEVARIABLES:
-				idi->current_input_data=NDO2DB_INPUT_DATA_MAINCONFIGFILEVARIABLES;
-				break;
-			case NDO_API_RESOURCECONFIGFILEVARIABLES:
-				idi->current_input_data=NDO2DB_INPUT_DATA_RESOURCECONFIGFILEVARIABLES;
-				break;
-			case NDO_API_CONFIGVARIABLES:
-				idi->current_input_data=NDO2DB_INPUT_DATA_CONFIGVARIABLES;
-				break;
-			case NDO_API_RUNTIMEVARIABLES:
-				idi->current_input_data=NDO2DB_INPUT_DATA_RUNTIMEVARIABLES;
-				break;
 
-			/* object configuration */
-			case NDO_API_HOSTDEFINITION:
-				idi->current_input_data=NDO2DB_INPUT_DATA_HOSTDEFINITION;
-				break;
-			case NDO_API_HOSTGROUPDEFINITION:
-				idi->current_input_data=NDO2DB_INPUT_DATA_HOSTGROUPDEFINITION;
-				break;
-			case NDO_API_SERVICEDEFINITION:
-				idi->current_input_data=NDO2DB_INPUT_DATA_SERVICEDEFINITION;
-				break;
-			case NDO_API_SERVICEGROUPDEFINITION:
-				idi->current_input_data=NDO2DB_INPUT_DATA_SERVICEGROUPDEFINITION;
-				break;
-			case NDO_API_HOSTDEPENDENCYDEFINITION:
-				idi->current_input_data=NDO2DB_INPUT_DATA_HOSTDEPENDENCYDEFINITION;
-				break;
-			case NDO_API_SERVICEDEPENDENCYDEFINITION:
-				idi->current_input_data=NDO2DB_INPUT_DATA_SERVICEDEPENDENCYDEFINITION;
-				break;
-			case NDO_API_HOSTESCALATIONDEFINITION:
-				idi->current_input_data=NDO2DB_INPUT_DATA_HOSTESCALATIONDEFINITION;
-				break;
-			case NDO_API_SERVICEESCALATIONDEFINITION:
-				idi->current_input_data=NDO2DB_INPUT_DATA_SERVICEESCALATIONDEFINITION;
-				break;
-			case NDO_API_COMMANDDEFINITION:
-				idi->current_input_data=NDO2DB_INPUT_DATA_COMMANDDEFINITION;
-				break;
-			case NDO_API_TIMEPERIODDEFINITION:
-				idi->current_input_data=NDO2DB_INPUT_DATA_TIMEPERIODDEFINITION;
-				break;
-			case NDO_API_CONTACTDEFINITION:
-				idi->current_input_data=NDO2DB_INPUT_DATA_CONTACTDEFINITION;
+/* inflates every complete block we have and passes the output on */
+static int ndo2db_stream_inflate(ndo2db_stream *st, ndo2db_idi *idi){
+	char out[16384];
+	unsigned char *hdr=NULL;
+	unsigned long zlen=0L;
+	unsigned long rawlen=0L;
+	unsigned long produced=0L;
+	unsigned long used=0L;
+	unsigned long long cpu_start=0L;
+	int result=Z_OK;
+
+	while(st->zbuf.used_size-used>=NDO_API_COMPRESSION_HEADER_SIZE){
+
+		hdr=(unsigned char *)st->zbuf.buf+used;
+		zlen=((unsigned long)hdr[0]<<24)|((unsigned long)hdr[1]<<16)|((unsigned long)hdr[2]<<8)|hdr[3];
+		rawlen=((unsigned long)hdr[4]<<24)|((unsigned long)hdr[5]<<16)|((unsigned long)hdr[6]<<8)|hdr[7];
+
+		/* the lengths come from the client, so don't collect or inflate more than any module will send - deflate can grow a block a little */
+		if(rawlen>NDO_API_COMPRESSION_MAX_BLOCK_SIZE || zlen>NDO_API_COMPRESSION_MAX_BLOCK_SIZE+(NDO_API_COMPRESSION_MAX_BLOCK_SIZE>>8)){
+			syslog(LOG_USER|LOG_INFO,"Error: Compressed block from client is too large (%lu bytes, %lu inflated).  Disconnecting client...",zlen,rawlen);
+			return NDO_ERROR;
+			}
+
+		/* wait for the rest of the block */
+		if(st->zbuf.used_size-used-NDO_API_COMPRESSION_HEADER_SIZE<zlen)
+			break;
+
+		cpu_start=ndo2db_cpu_usec();
+
+		st->zs.next_in=(Bytef *)(hdr+NDO_API_COMPRESSION_HEADER_SIZE);
+		st->zs.avail_in=(uInt)zlen;
+		produced=0L;
+		do{
+			st->zs.next_out=(Bytef *)out;
+			st->zs.avail_out=sizeof(out);
+			result=inflate(&st->zs,Z_SYNC_FLUSH);
+			if(result!=Z_OK && result!=Z_BUF_ERROR)
 				break;
-			case NDO_API_CONTACTGROUPDEFINITION:
-				idi->current_input_data=NDO2DB_INPUT_DATA_CONTACTGROUPDEFINITION;
+			produced+=sizeof(out)-st->zs.avail_out;
+			if(ndo2db_stream_output(st,idi,out,sizeof(out)-st->zs.avail_out)==NDO_ERROR)
+				return NDO_ERROR;
+			}while(st->zs.avail_out==0);
+
+		st->cpu_usec+=ndo2db_cpu_usec()-cpu_start;
+
+		if((result!=Z_OK && result!=Z_BUF_ERROR) || produced!=rawlen){
+			syslog(LOG_USER|LOG_INFO,"Error: Corrupt compressed data from client (%s).  Disconnecting client...",(st->zs.msg==NULL)?"length mismatch":st->zs.msg);
+			return NDO_ERROR;
+			}
+
+		st->compressed_bytes+=zlen+NDO_API_COMPRESSION_HEADER_SIZE;
+		st->raw_bytes+=rawlen;
+		st->blocks++;
+
+		used+=NDO_API_COMPRESSION_HEADER_SIZE+zlen;
+		}
+
+	/* keep any partial block for next time */
+	if(used>0L){
+		memmove(st->zbuf.buf,st->zbuf.buf+used,st->zbuf.used_size-used);
+		st->zbuf.used_size-=used;
+		st->zbuf.buf[st->zbuf.used_size]='\x0';
+		}
+
+	return NDO_OK;
+        }
+#endif
+
+
+/* queues client input, watching the hello to see whether the rest of the stream is compressed */
+int ndo2db_stream_input(ndo2db_stream *st, ndo2db_idi *idi, char *buf, unsigned long len){
+	unsigned long x=0L;
+	char *val=NULL;
+
+	if(st==NULL || idi==NULL || buf==NULL)
+		return NDO_ERROR;
+
+	if(st->state==NDO2DB_STREAM_HELLO){
+
+		for(x=0;x<len;x++){
+
+			if(buf[x]!='\n'){
+				if(st->line_len<sizeof(st->line)-1)
+					st->line[st->line_len++]=buf[x];
+				continue;
+				}
+
+			st->line[st->line_len]='\x0';
+			st->line_len=0L;
+
+			if(!strcmp(st->line,NDO_API_HELLO))
+				st->compression=NDO_FALSE;
+
+			else if(!strncmp(st->line,NDO_API_COMPRESSION":",strlen(NDO_API_COMPRESSION)+1)){
+				val=st->line+strlen(NDO_API_COMPRESSION)+1;
+				while(*val==' ')
+					val++;
+				st->compression=(!strcmp(val,NDO_API_COMPRESSION_ZLIB))?NDO_TRUE:NDO_FALSE;
+				}
+
+			/* the hello is done - everything after this line is either plain or compressed */
+			else if(!strcmp(st->line,NDO_API_STARTDATADUMP)){
+
+				if(ndo2db_stream_output(st,idi,buf,x+1)==NDO_ERROR)
+					return NDO_ERROR;
+				buf+=x+1;
+				len-=x+1;
+
+				if(st->compression==NDO_FALSE){
+					st->state=NDO2DB_STREAM_TEXT;
+					return ndo2db_stream_output(st,idi,buf,len);
+					}
+
+#ifdef HAVE_ZLIB
+				if(st->zs_ready==NDO_FALSE && inflateInit(&st->zs)!=Z_OK){
+					syslog(LOG_USER|LOG_INFO,"Error: Could not set up decompression for client.  Disconnecting client...");
+					idi->disconnect_client=NDO_TRUE;
+					return NDO_ERROR;
+					}
+				st->zs_ready=NDO_TRUE;
+				st->state=NDO2DB_STREAM_COMPRESSED;
 				break;
-			case NDO_API_HOSTEXTINFODEFINITION:
-				/* deprecated - merged with host definitions */
-			case NDO_API_SERVICEEXTINFODEFINITION:
-				/* deprecated - merged with service definitions */
+#else
+				syslog(LOG_USER|LOG_INFO,"Error: Client sends compressed data, but ndo2db was built without zlib.  Disconnecting client...");
+				idi->disconnect_client=NDO_TRUE;
+				return NDO_ERROR;
+#endif
+				}
+			}
+
+		if(st->state==NDO2DB_STREAM_HELLO){
+			return ndo2db_stream_output(st,idi,buf,len);
+			}
+		}
+
+	if(st->state==NDO2DB_STREAM_TEXT){
+		return ndo2db_stream_output(st,idi,buf,len);
+		}
+
+#ifdef HAVE_ZLIB
+	if(st->state==NDO2DB_STREAM_COMPRESSED){
+
+		if(len==0L)
+			return NDO_OK;
+
+		ndo_dbuf_strncat(&st->zbuf,buf,len);
+
+		if(ndo2db_stream_inflate(st,idi)==NDO_ERROR){
+			idi->disconnect_client=NDO_TRUE;
+			return NDO_ERROR;
+			}
+
+		return NDO_OK;
+		}
+#endif
+
+	return NDO_OK;
+        }
+
+
+/* writer process - handles client input passed on by the reader until it says there is no more */
+void ndo2db_async_client_handle(){
+	ndo2db_idi idi;
+	ndo_dbuf carry;
+	char *buf=NULL;
+	unsigned long len=0L;
+	unsigned int session=0;
+
+	/* the reader writes, we read */
+	ndo_shm_consume(ndo2db_queue);
+
+	/* initialize input data information */
+	ndo2db_idi_init(&idi);
+
+	/* initialize database connection */
+	ndo2db_db_init(&idi);
+	ndo2db_db_connect(&idi);
+
+	/* lines split across records are put back together here */
+	ndo_dbuf_init(&carry,2048);
+
+	while(1){
 
-			case NDO_API_ACTIVEOBJECTSLIST:
-				idi->current_input_data=NDO2DB_INPUT_DATA_ACTIVEOBJECTSLIST;
+		if((buf=ndo_shm_peek(ndo2db_queue,&len,&session))==NULL){
+
+			/* the reader went away without saying goodbye */
+			if(ndo_shm_producer_alive(ndo2db_queue)==NDO_FALSE)
 				break;
-	
-			default:
+
+			ndo_shm_wait(ndo2db_queue,1000);
+			continue;
+			}
+
+		/* end of input */
+		if(len==0L){
+			ndo_shm_release(ndo2db_queue);
+			break;
+			}
+
+		ndo2db_log_debug_info(NDO2DB_DEBUGL_PROCESSINFO,2,"Queue Message: %lu bytes\n",len);
+
+		ndo2db_split_input(&idi,&carry,buf,len);
+
+		ndo_shm_release(ndo2db_queue);
+		}
+
+	ndo_dbuf_free(&carry);
+	ndo_shm_detach(ndo2db_queue);
+	ndo2db_queue=NULL;
+
+	/* let the writer threads finish */
+	ndo2db_dbpool_stop();
+
+	/* disconnect from database */
+	ndo2db_db_disconnect(&idi);
+	ndo2db_db_deinit(&idi);
+
+	/* free memory */
+	ndo2db_free_input_memory(&idi);
+	ndo2db_free_connection_memory(&idi);
+
+	return;
+        }
+
+/* handles every complete line and frame in a buffer, returns how much of it was used */
+unsigned long ndo2db_process_client_data(ndo2db_idi *idi, char *buf, unsigned long len, unsigned long *frame_size){
+	unsigned long start=0L;
+	unsigned long skip=0L;
+	char *nl=NULL;
+
+	*frame_size=0L;
+
+	while(start<len){
+
+		/* the rest of an oversized frame goes straight in the bin */
+		if(idi->frame_skip>0L){
+			skip=(idi->frame_skip<len-start)?idi->frame_skip:len-start;
+			idi->frame_skip-=skip;
+			idi->bytes_processed+=skip;
+			start+=skip;
+			continue;
+			}
+
+		if(idi->protocol_version==NDO_API_PROTOVERSION_BINARY && idi->current_input_section==NDO2DB_INPUT_SECTION_DATA && idi->current_input_data==NDO2DB_INPUT_DATA_NONE && buf[start]==NDO_API_FRAME_MARKER){
+
+			/* frames are only put together up to max_frame_size - anything bigger is skipped rather than held in memory */
+			if((*frame_size=ndo2db_get_frame_size(buf+start,len-start))>ndo2db_max_frame_size){
+				syslog(LOG_USER|LOG_INFO,"Warning: Dropped a frame larger than max_frame_size (%lu bytes).",ndo2db_max_frame_size);
+				idi->frame_skip=*frame_size;
+				*frame_size=0L;
+				continue;
+				}
+
+			/* wait for the rest of the frame */
+			if(*frame_size==0L || *frame_size>len-start)
 				break;
+
+			ndo2db_handle_client_frame(idi,buf+start,*frame_size);
+
+			idi->bytes_processed+=*frame_size;
+			start+=*frame_size;
+			*frame_size=0L;
+			continue;
+			}
+
+		if((nl=memchr(buf+start,'\n',len-start))==NULL)
+			break;
+		*nl='\x0';
+
+		ndo2db_log_debug_info(NDO2DB_DEBUGL_PROCESSINFO,2,"Handling: %s\n",buf+start);
+		ndo2db_handle_client_input(idi,buf+start);
+
+		idi->lines_processed++;
+		idi->bytes_processed+=(nl-(buf+start))+1;
+		start=(nl-buf)+1;
+		}
+
+	return start;
+        }
+
+
+/* handles a single line of input from a client connection */
+int ndo2db_handle_client_input(ndo2db_idi *idi, char *buf){
+	char *var=NULL;
+	char *val=NULL;
+	unsigned long data_type_long=0L;
+	int data_type=NDO_DATA_NONE;
+	int input_type=NDO2DB_INPUT_DATA_NONE;
+
+#ifdef DEBUG_NDO2DB2
+	printf("HANDLING: '%s'\n",buf);
+#endif
+
+	if(buf==NULL || idi==NULL)
+		return NDO_ERROR;
+
+	/* we're ignoring client data because of wrong protocol version, etc...  */
+	if(idi->ignore_client_data==NDO_TRUE)
+		return NDO_ERROR;
+
+	/* skip empty lines */
+	if(buf[0]=='\x0')
+		return NDO_OK;
+
+	switch(idi->current_input_section){
+
+	case NDO2DB_INPUT_SECTION_NONE:
+
+		var=strtok(buf,":");
+		val=strtok(NULL,"\n");
+
+		if(!strcmp(var,NDO_API_HELLO)){
+
+			idi->current_input_section=NDO2DB_INPUT_SECTION_HEADER;
+			idi->current_input_data=NDO2DB_INPUT_DATA_NONE;
+
+			/* free old connection memory (necessary in some cases) */
+			ndo2db_free_connection_memory(idi);
+			idi->config_hashes=NDO_FALSE;
+		        }
+
+		break;
+
+	case NDO2DB_INPUT_SECTION_HEADER:
+
+		var=strtok(buf,":");
+		val=strtok(NULL,"\n");
+
+		if(!strcmp(var,NDO_API_STARTDATADUMP)){
+
+			/* client is using wrong protocol version, bail out here... */
+			if(idi->protocol_version!=NDO_API_PROTOVERSION && idi->protocol_version!=NDO_API_PROTOVERSION_BINARY){
+				syslog(LOG_USER|LOG_INFO,"Error: Client protocol version %d is incompatible with server versions %d and %d.  Disconnecting client...",idi->protocol_version,NDO_API_PROTOVERSION,NDO_API_PROTOVERSION_BINARY);
+				idi->disconnect_client=NDO_TRUE;
+				idi->ignore_client_data=NDO_TRUE;
+				return NDO_ERROR;
 			        }
 
-			/* initialize input data */
-			ndo2db_start_input_data(idi);
+			idi->current_input_section=NDO2DB_INPUT_SECTION_DATA;
+
+			/* save connection info to DB */
+			ndo2db_db_hello(idi);
+		        }
+
+		else if(!strcmp(var,NDO_API_PROTOCOL))
+			ndo2db_convert_string_to_int((val+1),&idi->protocol_version);
+
+		else if(!strcmp(var,NDO_API_INSTANCENAME))
+			idi->instance_name=strdup(val+1);
+
+		else if(!strcmp(var,NDO_API_AGENT))
+			idi->agent_name=strdup(val+1);
+
+		else if(!strcmp(var,NDO_API_AGENTVERSION))
+			idi->agent_version=strdup(val+1);
+
+		else if(!strcmp(var,NDO_API_DISPOSITION))
+			idi->disposition=strdup(val+1);
+
+		else if(!strcmp(var,NDO_API_CONNECTION))
+			idi->connect_source=strdup(val+1);
+
+		else if(!strcmp(var,NDO_API_CONNECTTYPE))
+			idi->connect_type=strdup(val+1);
+
+		else if(!strcmp(var,NDO_API_STARTTIME))
+			ndo2db_convert_string_to_unsignedlong((val+1),&idi->data_start_time);
+
+		else if(!strcmp(var,NDO_API_EVENTSSHED))
+			ndo2db_convert_string_to_unsignedlong((val+1),&idi->events_shed);
+
+		else if(!strcmp(var,NDO_API_CONFIGHASHES))
+			idi->config_hashes=(atoi(val+1)>0)?NDO_TRUE:NDO_FALSE;
+
+		break;
+
+	case NDO2DB_INPUT_SECTION_FOOTER:
+
+		var=strtok(buf,":");
+		val=strtok(NULL,"\n");
+
+		/* client is saying goodbye... */
+		if(!strcmp(var,NDO_API_GOODBYE))
+			idi->current_input_section=NDO2DB_INPUT_SECTION_NONE;
+
+		else if(!strcmp(var,NDO_API_ENDTIME))
+			ndo2db_convert_string_to_unsignedlong((val+1),&idi->data_end_time);
+
+		break;
+
+	case NDO2DB_INPUT_SECTION_DATA:
+
+		if(idi->current_input_data==NDO2DB_INPUT_DATA_NONE){
+
+			var=strtok(buf,":");
+			val=strtok(NULL,"\n");
+
+			input_type=atoi(var);
+
+			ndo2db_handle_input_type(idi,input_type);
 		        }
 
 		/* we are processing some type of data already... */
@@ -1679,7 +2566,7 @@ int ndo2db_handle_client_input(ndo2db_idi *idi, char *buf){
 #ifdef DEBUG_NDO2DB2
 				printf("LINE: %lu, TYPE: %d, VAL:%s\n",idi->lines_processed,data_type,val);
 #endif
-				ndo2db_add_input_data_item(idi,data_type,val);
+				ndo2db_add_input_data_item(idi,data_type,val,NDO_TRUE);
 			}
 		}
 
@@ -1693,6 +2580,336 @@ int ndo2db_handle_client_input(ndo2db_idi *idi, char *buf){
 }
 
 
+/* sets up handling for the data type that starts a new block of input */
+int ndo2db_handle_input_type(ndo2db_idi *idi, int input_type){
+
+	if(idi==NULL)
+		return NDO_ERROR;
+
+	switch(input_type){
+
+	/* we're reached the end of all of the data... */
+	case NDO_API_ENDDATADUMP:
+		idi->current_input_section=NDO2DB_INPUT_SECTION_FOOTER;
+		idi->current_input_data=NDO2DB_INPUT_DATA_NONE;
+		break;
+
+	/* config dumps */
+	case NDO_API_STARTCONFIGDUMP:
+		idi->current_input_data=NDO2DB_INPUT_DATA_CONFIGDUMPSTART;
+		break;
+	case NDO_API_ENDCONFIGDUMP:
+		idi->current_input_data=NDO2DB_INPUT_DATA_CONFIGDUMPEND;
+		break;
+
+	/* archived data */
+	case NDO_API_LOGENTRY:
+		idi->current_input_data=NDO2DB_INPUT_DATA_LOGENTRY;
+		break;
+
+	/* realtime data */
+	case NDO_API_PROCESSDATA:
+		idi->current_input_data=NDO2DB_INPUT_DATA_PROCESSDATA;
+		break;
+	case NDO_API_TIMEDEVENTDATA:
+		idi->current_input_data=NDO2DB_INPUT_DATA_TIMEDEVENTDATA;
+		break;
+	case NDO_API_LOGDATA:
+		idi->current_input_data=NDO2DB_INPUT_DATA_LOGDATA;
+		break;
+	case NDO_API_SYSTEMCOMMANDDATA:
+		idi->current_input_data=NDO2DB_INPUT_DATA_SYSTEMCOMMANDDATA;
+		break;
+	case NDO_API_EVENTHANDLERDATA:
+		idi->current_input_data=NDO2DB_INPUT_DATA_EVENTHANDLERDATA;
+		break;
+	case NDO_API_NOTIFICATIONDATA:
+		idi->current_input_data=NDO2DB_INPUT_DATA_NOTIFICATIONDATA;
+		break;
+	case NDO_API_SERVICECHECKDATA:
+		idi->current_input_data=NDO2DB_INPUT_DATA_SERVICECHECKDATA;
+		break;
+	case NDO_API_HOSTCHECKDATA:
+		idi->current_input_data=NDO2DB_INPUT_DATA_HOSTCHECKDATA;
+		break;
+	case NDO_API_COMMENTDATA:
+		idi->current_input_data=NDO2DB_INPUT_DATA_COMMENTDATA;
+		break;
+	case NDO_API_DOWNTIMEDATA:
+		idi->current_input_data=NDO2DB_INPUT_DATA_DOWNTIMEDATA;
+		break;
+	case NDO_API_FLAPPINGDATA:
+		idi->current_input_data=NDO2DB_INPUT_DATA_FLAPPINGDATA;
+		break;
+	case NDO_API_PROGRAMSTATUSDATA:
+		idi->current_input_data=NDO2DB_INPUT_DATA_PROGRAMSTATUSDATA;
+		break;
+	case NDO_API_HOSTSTATUSDATA:
+		idi->current_input_data=NDO2DB_INPUT_DATA_HOSTSTATUSDATA;
+		break;
+	case NDO_API_SERVICESTATUSDATA:
+		idi->current_input_data=NDO2DB_INPUT_DATA_SERVICESTATUSDATA;
+		break;
+	case NDO_API_HOSTSTATUSDELTADATA:
+		idi->current_input_data=NDO2DB_INPUT_DATA_HOSTSTATUSDELTADATA;
+		break;
+	case NDO_API_SERVICESTATUSDELTADATA:
+		idi->current_input_data=NDO2DB_INPUT_DATA_SERVICESTATUSDELTADATA;
+		break;
+	case NDO_API_CONTACTSTATUSDATA:
+		idi->current_input_data=NDO2DB_INPUT_DATA_CONTACTSTATUSDATA;
+		break;
+	case NDO_API_ADAPTIVEPROGRAMDATA:
+		idi->current_input_data=NDO2DB_INPUT_DATA_ADAPTIVEPROGRAMDATA;
+		break;
+	case NDO_API_ADAPTIVEHOSTDATA:
+		idi->current_input_data=NDO2DB_INPUT_DATA_ADAPTIVEHOSTDATA;
+		break;
+	case NDO_API_ADAPTIVESERVICEDATA:
+		idi->current_input_data=NDO2DB_INPUT_DATA_ADAPTIVESERVICEDATA;
+		break;
+	case NDO_API_ADAPTIVECONTACTDATA:
+		idi->current_input_data=NDO2DB_INPUT_DATA_ADAPTIVECONTACTDATA;
+		break;
+	case NDO_API_EXTERNALCOMMANDDATA:
+		idi->current_input_data=NDO2DB_INPUT_DATA_EXTERNALCOMMANDDATA;
+		break;
+	case NDO_API_AGGREGATEDSTATUSDATA:
+		idi->current_input_data=NDO2DB_INPUT_DATA_AGGREGATEDSTATUSDATA;
+		break;
+	case NDO_API_RETENTIONDATA:
+		idi->current_input_data=NDO2DB_INPUT_DATA_RETENTIONDATA;
+		break;
+	case NDO_API_CONTACTNOTIFICATIONDATA:
+		idi->current_input_data=NDO2DB_INPUT_DATA_CONTACTNOTIFICATIONDATA;
+		break;
+	case NDO_API_CONTACTNOTIFICATIONMETHODDATA:
+		idi->current_input_data=NDO2DB_INPUT_DATA_CONTACTNOTIFICATIONMETHODDATA;
+		break;
+	case NDO_API_ACKNOWLEDGEMENTDATA:
+		idi->current_input_data=NDO2DB_INPUT_DATA_ACKNOWLEDGEMENTDATA;
+		break;
+	case NDO_API_STATECHANGEDATA:
+		idi->current_input_data=NDO2DB_INPUT_DATA_STATECHANGEDATA;
+		break;
+
+	/* config variables */
+	case NDO_API_MAINCONFIGFILEVARIABLES:
+		idi->current_input_data=NDO2DB_INPUT_DATA_MAINCONFIGFILEVARIABLES;
+		break;
+	case NDO_API_RESOURCECONFIGFILEVARIABLES:
+		idi->current_input_data=NDO2DB_INPUT_DATA_RESOURCECONFIGFILEVARIABLES;
+		break;
+	case NDO_API_CONFIGVARIABLES:
+		idi->current_input_data=NDO2DB_INPUT_DATA_CONFIGVARIABLES;
+		break;
+	case NDO_API_RUNTIMEVARIABLES:
+		idi->current_input_data=NDO2DB_INPUT_DATA_RUNTIMEVARIABLES;
+		break;
+
+	/* object configuration */
+	case NDO_API_HOSTDEFINITION:
+		idi->current_input_data=NDO2DB_INPUT_DATA_HOSTDEFINITION;
+		break;
+	case NDO_API_HOSTGROUPDEFINITION:
+		idi->current_input_data=NDO2DB_INPUT_DATA_HOSTGROUPDEFINITION;
+		break;
+	case NDO_API_SERVICEDEFINITION:
+		idi->current_input_data=NDO2DB_INPUT_DATA_SERVICEDEFINITION;
+		break;
+	case NDO_API_SERVICEGROUPDEFINITION:
+		idi->current_input_data=NDO2DB_INPUT_DATA_SERVICEGROUPDEFINITION;
+		break;
+	case NDO_API_HOSTDEPENDENCYDEFINITION:
+		idi->current_input_data=NDO2DB_INPUT_DATA_HOSTDEPENDENCYDEFINITION;
+		break;
+	case NDO_API_SERVICEDEPENDENCYDEFINITION:
+		idi->current_input_data=NDO2DB_INPUT_DATA_SERVICEDEPENDENCYDEFINITION;
+		break;
+	case NDO_API_HOSTESCALATIONDEFINITION:
+		idi->current_input_data=NDO2DB_INPUT_DATA_HOSTESCALATIONDEFINITION;
+		break;
+	case NDO_API_SERVICEESCALATIONDEFINITION:
+		idi->current_input_data=NDO2DB_INPUT_DATA_SERVICEESCALATIONDEFINITION;
+		break;
+	case NDO_API_COMMANDDEFINITION:
+		idi->current_input_data=NDO2DB_INPUT_DATA_COMMANDDEFINITION;
+		break;
+	case NDO_API_TIMEPERIODDEFINITION:
+		idi->current_input_data=NDO2DB_INPUT_DATA_TIMEPERIODDEFINITION;
+		break;
+	case NDO_API_CONTACTDEFINITION:
+		idi->current_input_data=NDO2DB_INPUT_DATA_CONTACTDEFINITION;
+		break;
+	case NDO_API_CONTACTGROUPDEFINITION:
+		idi->current_input_data=NDO2DB_INPUT_DATA_CONTACTGROUPDEFINITION;
+		break;
+	case NDO_API_HOSTEXTINFODEFINITION:
+		/* deprecated - merged with host definitions */
+	case NDO_API_SERVICEEXTINFODEFINITION:
+		/* deprecated - merged with service definitions */
+
+	case NDO_API_ACTIVEOBJECTSLIST:
+		idi->current_input_data=NDO2DB_INPUT_DATA_ACTIVEOBJECTSLIST;
+		break;
+	
+	default:
+		break;
+	        }
+
+	/* initialize input data */
+	return ndo2db_start_input_data(idi);
+        }
+
+
+/* handles a complete protocol 3 frame - see ndo2db_get_frame_size() */
+int ndo2db_handle_client_frame(ndo2db_idi *idi, char *buf, unsigned long len){
+	const char *p=NULL;
+	const char *end=NULL;
+	unsigned long long input_type=0L;
+	unsigned long long data_type=0L;
+	unsigned long long val=0L;
+	unsigned long long val2=0L;
+	ndo2db_input_value value;
+	char *str=NULL;
+	int field_type=0;
+	int result=NDO_OK;
+	union {
+		double d;
+		unsigned long long u;
+		} fbits;
+
+	if(idi==NULL || buf==NULL || len<NDO_API_FRAME_HEADER_SIZE)
+		return NDO_ERROR;
+
+	p=buf+NDO_API_FRAME_HEADER_SIZE;
+	end=buf+len;
+
+	if(ndo_decode_varint(&p,end,&input_type)==NDO_ERROR)
+		return NDO_ERROR;
+
+	idi->current_input_data=NDO2DB_INPUT_DATA_NONE;
+	ndo2db_handle_input_type(idi,(int)input_type);
+
+	/* unknown data type - throw the frame out */
+	if(idi->current_input_data==NDO2DB_INPUT_DATA_NONE)
+		return NDO_OK;
+
+	while(p<end){
+
+		if(ndo_decode_varint(&p,end,&data_type)==NDO_ERROR || p>=end)
+			break;
+		field_type=*p++;
+
+		/* numbers are kept as they came, the handlers read them with ndo2db_get_input_*() */
+		switch(field_type){
+
+		case NDO_API_FIELD_INT:
+			if((result=ndo_decode_varint(&p,end,&val))==NDO_ERROR)
+				break;
+			value.type=NDO2DB_VALUE_INT;
+			value.value.integer=NDO_UNZIGZAG(val);
+			break;
+
+		case NDO_API_FIELD_UNSIGNED_LONG:
+			if((result=ndo_decode_varint(&p,end,&val))==NDO_ERROR)
+				break;
+			value.type=NDO2DB_VALUE_UNSIGNED;
+			value.value.unsigned_long=val;
+			break;
+
+		case NDO_API_FIELD_TIMEVAL:
+			if((result=ndo_decode_varint(&p,end,&val))==NDO_ERROR || (result=ndo_decode_varint(&p,end,&val2))==NDO_ERROR)
+				break;
+			value.type=NDO2DB_VALUE_TIMEVAL;
+			value.value.timestamp.tv_sec=(time_t)NDO_UNZIGZAG(val);
+			value.value.timestamp.tv_usec=(suseconds_t)val2;
+			break;
+
+		case NDO_API_FIELD_DOUBLE:
+			if((result=ndo_decode_varint(&p,end,&val))==NDO_ERROR)
+				break;
+			fbits.u=val;
+			value.type=NDO2DB_VALUE_DOUBLE;
+			value.value.floating_point=fbits.d;
+			break;
+
+		case NDO_API_FIELD_STRING:
+		case NDO_API_FIELD_ESCAPED_STRING:
+			if(ndo_decode_varint(&p,end,&val)==NDO_ERROR || val>(unsigned long long)(end-p)){
+				result=NDO_ERROR;
+				break;
+				}
+			if(data_type>=NDO_MAX_DATA_TYPES){
+				p+=val;
+				continue;
+				}
+
+			/* the string is copied out to terminate it - the frame may sit in a shared memory ring, where the byte after it belongs to the next record */
+			if((str=(char *)malloc(val+1))==NULL){
+				result=NDO_ERROR;
+				break;
+				}
+			memcpy(str,p,val);
+			str[val]='\x0';
+			p+=val;
+
+			/* a raw string is stored as it came, anything else goes the way text input does */
+			if(field_type==NDO_API_FIELD_STRING && idi->current_input_data!=NDO2DB_INPUT_DATA_ACTIVEOBJECTSLIST)
+				ndo2db_save_input_data_item(idi,(int)data_type,str);
+			else{
+				ndo2db_add_input_data_item(idi,(int)data_type,str,(field_type==NDO_API_FIELD_ESCAPED_STRING)?NDO_TRUE:NDO_FALSE);
+				free(str);
+				}
+			continue;
+
+		default:
+			/* we can't know how long an unknown field is */
+			result=NDO_ERROR;
+			break;
+			}
+
+		if(result==NDO_ERROR)
+			break;
+
+		/* the data type is out of range - throw it out */
+		if(data_type>=NDO_MAX_DATA_TYPES)
+			continue;
+
+		ndo2db_add_input_data_value(idi,(int)data_type,&value);
+		}
+
+	/* a malformed frame is thrown out along with whatever was read from it, so the next one starts clean */
+	if(result==NDO_ERROR){
+		ndo2db_free_input_memory(idi);
+		idi->current_input_data=NDO2DB_INPUT_DATA_NONE;
+		return NDO_ERROR;
+		}
+
+	/* finish current data processing */
+	ndo2db_end_input_data(idi);
+	idi->current_input_data=NDO2DB_INPUT_DATA_NONE;
+
+	return NDO_OK;
+        }
+
+
+/* returns the total size of the protocol 3 frame at buf, or 0 if we don't have its header yet */
+unsigned long ndo2db_get_frame_size(const char *buf, unsigned long len){
+	const char *p=NULL;
+	unsigned long long size=0L;
+
+	if(buf==NULL || len<NDO_API_FRAME_HEADER_SIZE)
+		return 0L;
+
+	p=buf+1;
+	if(ndo_decode_varint(&p,buf+NDO_API_FRAME_HEADER_SIZE,&size)==NDO_ERROR)
+		return 1L;	/* garbage - skip the marker byte */
+
+	return NDO_API_FRAME_HEADER_SIZE+(unsigned long)size;
+        }
+
+
 int ndo2db_start_input_data(ndo2db_idi *idi){
 	int x;
 
@@ -1705,18 +2922,23 @@ int ndo2db_start_input_data(ndo2db_idi *idi){
 	/* allocate memory for holding buffered input */
 	if((idi->buffered_input=(char **)malloc(sizeof(char *)*NDO_MAX_DATA_TYPES))==NULL)
 		return NDO_ERROR;
+	if((idi->input_values=(ndo2db_input_value *)malloc(sizeof(ndo2db_input_value)*NDO_MAX_DATA_TYPES))==NULL){
+		my_free(idi->buffered_input);
+		return NDO_ERROR;
+		}
 
 	/* initialize buffered input slots */
-	for(x=0;x<NDO_MAX_DATA_TYPES;x++)
+	for(x=0;x<NDO_MAX_DATA_TYPES;x++){
 		idi->buffered_input[x]=NULL;
+		idi->input_values[x].type=NDO2DB_VALUE_NONE;
+		}
 
 	return NDO_OK;
         }
 
 
-int ndo2db_add_input_data_item(ndo2db_idi *idi, int type, char *buf){
+int ndo2db_add_input_data_item(ndo2db_idi *idi, int type, char *buf, int escaped){
 	char *newbuf=NULL;
-	int mbuf_used=NDO_TRUE;
 
 	if(idi==NULL)
 		return NDO_ERROR;
@@ -1726,7 +2948,7 @@ int ndo2db_add_input_data_item(ndo2db_idi *idi, int type, char *buf){
 			newbuf=strdup("");
 		else
 			newbuf=strdup(buf);
-		if (type != NDO_DATA_ACTIVEOBJECTSTYPE)
+		if (type != NDO_DATA_ACTIVEOBJECTSTYPE && escaped==NDO_TRUE)
 			ndo_unescape_buffer(newbuf);
 		if(idi->buffered_input[type]!=NULL){
 			free(idi->buffered_input[type]);
@@ -1734,6 +2956,7 @@ int ndo2db_add_input_data_item(ndo2db_idi *idi, int type, char *buf){
 		}
 		/* save buffered item */
 		idi->buffered_input[type]=newbuf;
+		idi->input_values[type].type=NDO2DB_VALUE_NONE;
 
 		return NDO_OK;
 	}
@@ -1810,12 +3033,13 @@ int ndo2db_add_input_data_item(ndo2db_idi *idi, int type, char *buf){
 	case NDO_DATA_CONTACT:
 	case NDO_DATA_PARENTSERVICE:
 
-		/* strings are escaped when they arrive */
+		/* strings are escaped when they arrive (unless they came in a protocol 3 frame) */
 		if(buf==NULL)
 			newbuf=strdup("");
 		else
 			newbuf=strdup(buf);
-		ndo_unescape_buffer(newbuf);
+		if(escaped==NDO_TRUE)
+			ndo_unescape_buffer(newbuf);
 		break;
 
 	default:
@@ -1836,7 +3060,13 @@ int ndo2db_add_input_data_item(ndo2db_idi *idi, int type, char *buf){
 		return NDO_ERROR;
 	        }
 
-	/* store the buffered data */
+	return ndo2db_save_input_data_item(idi,type,newbuf);
+        }
+
+
+/* stores an item the caller allocated - it belongs to the input data from here on */
+int ndo2db_save_input_data_item(ndo2db_idi *idi, int type, char *newbuf){
+
 	switch(type){
 
 	/* special case for data items that may appear multiple times */
@@ -1890,8 +3120,6 @@ int ndo2db_add_input_data_item(ndo2db_idi *idi, int type, char *buf){
 	/* normal data items appear only once per data type */
 	default:
 
-		mbuf_used=NDO_FALSE;
-
 		/* if there was already a matching item, discard the old one */
 		if(idi->buffered_input[type]!=NULL){
 			free(idi->buffered_input[type]);
@@ -1900,12 +3128,30 @@ int ndo2db_add_input_data_item(ndo2db_idi *idi, int type, char *buf){
 
 		/* save buffered item */
 		idi->buffered_input[type]=newbuf;
+		idi->input_values[type].type=NDO2DB_VALUE_NONE;
 	        }
 
 	return NDO_OK;
         }
 
 
+/* stores a typed item from a protocol 3 frame in place of its string */
+int ndo2db_add_input_data_value(ndo2db_idi *idi, int type, ndo2db_input_value *value){
+
+	if(idi==NULL || idi->buffered_input==NULL || idi->input_values==NULL || value==NULL)
+		return NDO_ERROR;
+
+	if(idi->buffered_input[type]!=NULL){
+		free(idi->buffered_input[type]);
+		idi->buffered_input[type]=NULL;
+		}
+
+	idi->input_values[type]=*value;
+
+	return NDO_OK;
+        }
+
+
 
 int ndo2db_add_input_data_mbuf(ndo2db_idi *idi, int type, int mbuf_slot, char *buf){
 	int allocation_chunk=80;
@@ -1967,6 +3213,27 @@ int ndo2db_end_input_data(ndo2db_idi *idi){
 	printf("HANDLING TYPE: %d\n",idi->current_input_data);
 #endif
 
+	/* realtime data may go to a writer thread, anything else waits for them to catch up */
+	if(ndo2db_dbpool_dispatch(idi)==NDO_FALSE)
+		result=ndo2db_handle_input_data(idi);
+
+	/* free input memory */
+	ndo2db_free_input_memory(idi);
+
+	/* adjust items processed */
+	idi->entries_processed++;
+
+	/* perform periodic maintenance... */
+	ndo2db_db_perform_maintenance(idi);
+
+	return result;
+        }
+
+
+/* writes one complete data item to the database */
+int ndo2db_handle_input_data(ndo2db_idi *idi){
+	int result=NDO_OK;
+
 	switch(idi->current_input_data){
 
 	/* archived log entries */
@@ -2017,6 +3284,12 @@ int ndo2db_end_input_data(ndo2db_idi *idi){
 	case NDO2DB_INPUT_DATA_SERVICESTATUSDATA:
 		result=ndo2db_handle_servicestatusdata(idi);
 		break;
+	case NDO2DB_INPUT_DATA_HOSTSTATUSDELTADATA:
+		result=ndo2db_handle_hoststatusdeltadata(idi);
+		break;
+	case NDO2DB_INPUT_DATA_SERVICESTATUSDELTADATA:
+		result=ndo2db_handle_servicestatusdeltadata(idi);
+		break;
 	case NDO2DB_INPUT_DATA_CONTACTSTATUSDATA:
 		result=ndo2db_handle_contactstatusdata(idi);
 		break;
@@ -2125,15 +3398,6 @@ int ndo2db_end_input_data(ndo2db_idi *idi){
 		break;
 	        }
 
-	/* free input memory */
-	ndo2db_free_input_memory(idi);
-
-	/* adjust items processed */
-	idi->entries_processed++;
-
-	/* perform periodic maintenance... */
-	ndo2db_db_perform_maintenance(idi);
-
 	return result;
         }
 
@@ -2158,6 +3422,7 @@ int ndo2db_free_input_memory(ndo2db_idi *idi){
 		free(idi->buffered_input);
 		idi->buffered_input=NULL;
 	        }
+	my_free(idi->input_values);
 
 	/* free memory allocated to multi-instance data buffers */
 	if(idi->mbuf){
@@ -2224,10 +3489,10 @@ int ndo2db_convert_standard_data_elements(ndo2db_idi *idi, int *type, int *flags
 	int result3=NDO_OK;
 	int result4=NDO_OK;
 
-	result1=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_TYPE],type);
-	result2=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_FLAGS],flags);
-	result3=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_ATTRIBUTES],attr);
-	result4=ndo2db_convert_string_to_timeval(idi->buffered_input[NDO_DATA_TIMESTAMP],tstamp);
+	result1=ndo2db_get_input_int(idi,NDO_DATA_TYPE,type);
+	result2=ndo2db_get_input_int(idi,NDO_DATA_FLAGS,flags);
+	result3=ndo2db_get_input_int(idi,NDO_DATA_ATTRIBUTES,attr);
+	result4=ndo2db_get_input_timeval(idi,NDO_DATA_TIMESTAMP,tstamp);
 
 	if(result1==NDO_ERROR || result2==NDO_ERROR || result3==NDO_ERROR || result4==NDO_ERROR)
 		return NDO_ERROR;
@@ -2350,33 +3615,166 @@ int ndo2db_convert_string_to_timeval(char *buf, struct timeval *tv){
 
 
 
+
+/* returns the typed value of an item, or NULL if it came as a string (or not at all) */
+static ndo2db_input_value *ndo2db_get_input_value(ndo2db_idi *idi, int type){
+
+	if(idi->input_values==NULL || idi->input_values[type].type==NDO2DB_VALUE_NONE)
+		return NULL;
+
+	return &idi->input_values[type];
+        }
+
+
+/* a typed value as a whole number - the way atoi() and strtoul() read the same value as text */
+static long long ndo2db_input_value_to_longlong(ndo2db_input_value *v){
+
+	switch(v->type){
+	case NDO2DB_VALUE_UNSIGNED:
+		return (long long)v->value.unsigned_long;
+	case NDO2DB_VALUE_DOUBLE:
+		return (long long)v->value.floating_point;
+	case NDO2DB_VALUE_TIMEVAL:
+		return (long long)v->value.timestamp.tv_sec;
+	default:
+		return v->value.integer;
+		}
+        }
+
+
+/* is the item there at all, either as a string or typed? */
+int ndo2db_has_input(ndo2db_idi *idi, int type){
+
+	if(idi->buffered_input!=NULL && idi->buffered_input[type]!=NULL)
+		return NDO_TRUE;
+	if(ndo2db_get_input_value(idi,type)!=NULL)
+		return NDO_TRUE;
+
+	return NDO_FALSE;
+        }
+
+
+int ndo2db_get_input_int(ndo2db_idi *idi, int type, int *i){
+	ndo2db_input_value *v=NULL;
+
+	if((v=ndo2db_get_input_value(idi,type))==NULL)
+		return ndo2db_convert_string_to_int(idi->buffered_input[type],i);
+
+	*i=(int)ndo2db_input_value_to_longlong(v);
+
+	return NDO_OK;
+        }
+
+
+int ndo2db_get_input_double(ndo2db_idi *idi, int type, double *d){
+	ndo2db_input_value *v=NULL;
+
+	if((v=ndo2db_get_input_value(idi,type))==NULL)
+		return ndo2db_convert_string_to_double(idi->buffered_input[type],d);
+
+	switch(v->type){
+	case NDO2DB_VALUE_DOUBLE:
+		*d=v->value.floating_point;
+		break;
+	case NDO2DB_VALUE_UNSIGNED:
+		*d=(double)v->value.unsigned_long;
+		break;
+	case NDO2DB_VALUE_TIMEVAL:
+		*d=(double)v->value.timestamp.tv_sec+((double)v->value.timestamp.tv_usec/1000000.0);
+		break;
+	default:
+		*d=(double)v->value.integer;
+		break;
+		}
+
+	return NDO_OK;
+        }
+
+
+int ndo2db_get_input_unsignedlong(ndo2db_idi *idi, int type, unsigned long *ul){
+	ndo2db_input_value *v=NULL;
+
+	if((v=ndo2db_get_input_value(idi,type))==NULL)
+		return ndo2db_convert_string_to_unsignedlong(idi->buffered_input[type],ul);
+
+	*ul=(unsigned long)ndo2db_input_value_to_longlong(v);
+
+	return NDO_OK;
+        }
+
+
+/* object keys and config hashes use all 64 bits */
+int ndo2db_get_input_unsignedlonglong(ndo2db_idi *idi, int type, unsigned long long *ull){
+	ndo2db_input_value *v=NULL;
+
+	if((v=ndo2db_get_input_value(idi,type))==NULL){
+		if(idi->buffered_input==NULL || idi->buffered_input[type]==NULL)
+			return NDO_ERROR;
+		*ull=strtoull(idi->buffered_input[type],NULL,10);
+		return NDO_OK;
+		}
+
+	*ull=(unsigned long long)ndo2db_input_value_to_longlong(v);
+
+	return NDO_OK;
+        }
+
+
+int ndo2db_get_input_timeval(ndo2db_idi *idi, int type, struct timeval *tv){
+	ndo2db_input_value *v=NULL;
+
+	if((v=ndo2db_get_input_value(idi,type))==NULL)
+		return ndo2db_convert_string_to_timeval(idi->buffered_input[type],tv);
+
+	if(v->type==NDO2DB_VALUE_TIMEVAL){
+		*tv=v->value.timestamp;
+		return NDO_OK;
+		}
+
+	tv->tv_sec=(time_t)ndo2db_input_value_to_longlong(v);
+	tv->tv_usec=0;
+	if(v->type==NDO2DB_VALUE_DOUBLE)
+		tv->tv_usec=(suseconds_t)((v->value.floating_point-(double)tv->tv_sec)*1000000.0);
+
+	return NDO_OK;
+        }
+
 /****************************************************************************/
 /* LOGGING ROUTINES                                                         */
 /****************************************************************************/
 
+/* database writer threads log too, so the debug log is only touched with this held */
+static pthread_mutex_t ndo2db_debug_lock=PTHREAD_MUTEX_INITIALIZER;
+
+
 /* opens the debug log for writing */
 int ndo2db_open_debug_log(void){
+	int result=NDO_OK;
 
 	/* don't do anything if we're not debugging */
 	if(ndo2db_debug_level==NDO2DB_DEBUGL_NONE)
 		return NDO_OK;
 
+	pthread_mutex_lock(&ndo2db_debug_lock);
 	if((ndo2db_debug_file_fp=fopen(ndo2db_debug_file,"a+"))==NULL) {
 		syslog(LOG_ERR, "Warning: Could not open debug file '%s' - '%s'", ndo2db_debug_file, strerror(errno));
-		return NDO_ERROR;
+		result=NDO_ERROR;
 	}
+	pthread_mutex_unlock(&ndo2db_debug_lock);
 
-	return NDO_OK;
+	return result;
 	}
 
 
 /* closes the debug log */
 int ndo2db_close_debug_log(void){
 
+	pthread_mutex_lock(&ndo2db_debug_lock);
 	if(ndo2db_debug_file_fp!=NULL)
 		fclose(ndo2db_debug_file_fp);
 
 	ndo2db_debug_file_fp=NULL;
+	pthread_mutex_unlock(&ndo2db_debug_lock);
 
 	return NDO_OK;
 	}
@@ -2394,8 +3792,12 @@ int ndo2db_log_debug_info(int level, int verbosity, const char *fmt, ...){
 	if(verbosity>ndo2db_debug_verbosity)
 		return NDO_OK;
 
-	if(ndo2db_debug_file_fp==NULL)
+	pthread_mutex_lock(&ndo2db_debug_lock);
+
+	if(ndo2db_debug_file_fp==NULL){
+		pthread_mutex_unlock(&ndo2db_debug_lock);
 		return NDO_ERROR;
+		}
 
 	/* write the timestamp */
 	gettimeofday(&current_time,NULL);
@@ -2413,7 +3815,8 @@ int ndo2db_log_debug_info(int level, int verbosity, const char *fmt, ...){
 	if((unsigned long)ftell(ndo2db_debug_file_fp)>ndo2db_max_debug_file_size && ndo2db_max_debug_file_size>0L){
 
 		/* close the file */
-		ndo2db_close_debug_log();
+		fclose(ndo2db_debug_file_fp);
+		ndo2db_debug_file_fp=NULL;
 
 		/* rotate the log file */
 		asprintf(&temp_path,"%s.old",ndo2db_debug_file);
@@ -2430,9 +3833,12 @@ int ndo2db_log_debug_info(int level, int verbosity, const char *fmt, ...){
 			}
 
 		/* open a new file */
-		ndo2db_open_debug_log();
+		if((ndo2db_debug_file_fp=fopen(ndo2db_debug_file,"a+"))==NULL)
+			syslog(LOG_ERR, "Warning: Could not open debug file '%s' - '%s'", ndo2db_debug_file, strerror(errno));
 		}
 
+	pthread_mutex_unlock(&ndo2db_debug_lock);
+
 	return NDO_OK;
 	}
 
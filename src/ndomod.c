@@ -37,6 +37,7 @@
 #include "../include/utils.h"
 #include "../include/protoapi.h"
 #include "../include/ndomod.h"
+#include "../include/serialize.h"
 
 #include <pthread.h>
 
@@ -90,24 +91,6 @@ NEB_API_VERSION(CURRENT_NEB_API_VERSION)
 #define NDOMOD_NAME "NDOMOD"
 #define NDOMOD_DATE "11-14-2016"
 
-#define BD_INT				0
-#define BD_TIMEVAL			1
-#define BD_STRING			2
-#define BD_UNSIGNED_LONG	3
-#define BD_FLOAT			4
-
-struct ndo_broker_data {
-	int	key;
-	int datatype;
-	union {
-		int	integer;
-		struct timeval timestamp;
-		char *string;
-		unsigned long unsigned_long;
-		double floating_point;
-	} value;
-};
-
 void *ndomod_module_handle=NULL;
 char *ndomod_instance_name=NULL;
 char *ndomod_buffer_file=NULL;
@@ -121,6 +104,18 @@ time_t ndomod_sink_last_reconnect_attempt=0L;
 time_t ndomod_sink_last_reconnect_warning=0L;
 unsigned long ndomod_sink_connect_attempt=0L;
 unsigned long ndomod_sink_reconnect_interval=15;
+unsigned long ndomod_sink_reconnect_max_interval=120;
+unsigned long ndomod_sink_reconnect_delay=15;
+int ndomod_sink_connecting=NDO_FALSE;
+time_t ndomod_sink_connect_started=0L;
+static int ndomod_sink_connect_reconnect=NDO_FALSE;
+#ifdef BUILD_NAGIOS_4X
+static struct sockaddr_in ndomod_sink_address;		/* last good address of a tcp sink */
+static int ndomod_sink_address_valid=NDO_FALSE;
+static time_t ndomod_sink_address_next_lookup=0L;
+static unsigned long ndomod_sink_address_retry=0L;
+#endif
+static ndo_shm_ring *ndomod_shm=NULL;
 unsigned long ndomod_sink_reconnect_warning_interval=900;
 unsigned long ndomod_sink_rotation_interval=3600;
 char *ndomod_sink_rotation_command=NULL;
@@ -129,7 +124,91 @@ int ndomod_allow_sink_activity=NDO_TRUE;
 unsigned long ndomod_process_options=0;
 int ndomod_config_output_options=NDOMOD_CONFIG_DUMP_ALL;
 unsigned long ndomod_sink_buffer_slots=5000;
+unsigned long ndomod_sink_buffer_maxbytes=NDOMOD_SINK_BUFFER_BYTES;
+char *ndomod_spill_dir=NULL;
+unsigned long ndomod_spill_threshold=0L;
+unsigned long ndomod_spill_segment_size=NDOMOD_SPILL_SEGMENT_SIZE;
+unsigned long long ndomod_spill_max_bytes=NDOMOD_SPILL_MAX_BYTES;
+ndomod_spill_queue spillq;
+unsigned long ndomod_backlog_drain_items=0L;
+unsigned long ndomod_backlog_drain_bytes=0L;
+unsigned long ndomod_backlog_drain_time=20;
+ndomod_drain_state ndomod_drain;
 ndomod_sink_buffer sinkbuf;
+int ndomod_use_async_writer=NDO_FALSE;
+unsigned long ndomod_async_queue_size=NDOMOD_ASYNC_QUEUE_SIZE;
+unsigned long ndomod_async_enqueue_timeout=10;
+unsigned long ndomod_async_stats_interval=300;
+ndomod_async_queue asyncq;
+pthread_t ndomod_async_thread;
+int ndomod_async_thread_running=NDO_FALSE;
+volatile int ndomod_async_thread_stop=NDO_FALSE;
+time_t ndomod_async_last_stats=0L;
+pthread_mutex_t ndomod_sink_lock;				/* set up by ndomod_start_async_writer() */
+pthread_mutex_t ndomod_async_log_lock=PTHREAD_MUTEX_INITIALIZER;
+char *ndomod_async_log_msgs[NDOMOD_ASYNC_MAX_LOG_MSGS];
+volatile int ndomod_async_log_count=0;
+static ndo_dbuf ndomod_outbuf={NULL,0L,0L,2048L};	/* reused by ndomod_broker_data() so we don't malloc/free per event */
+static int ndomod_outbuf_depth=0;
+int ndomod_send_config_hashes=NDO_TRUE;
+unsigned long ndomod_status_conflation_window=0;
+static ndomod_conflated_status *ndomod_conflation_hashlist[NDOMOD_CONFLATION_HASHSLOTS];
+static ndomod_conflated_status *ndomod_conflation_head=NULL;
+static ndomod_conflated_status *ndomod_conflation_tail=NULL;
+static time_t ndomod_conflation_start=0L;
+unsigned long ndomod_status_delta_resync=0;
+static ndomod_delta_state *ndomod_delta_hashlist[NDOMOD_DELTA_HASHSLOTS];
+static volatile unsigned long ndomod_sink_generation=0L;	/* bumped by every hello, so deltas start over with full updates */
+static ndomod_object_key *ndomod_object_key_hashlist[NDOMOD_OBJECT_KEY_HASHSLOTS];
+/* NEBTYPE sub-types that aren't sent, by callback - by default the ones ndo2db throws away */
+unsigned long long ndomod_skipped_subtypes[NEBCALLBACK_NUMITEMS]={
+	[NEBCALLBACK_TIMED_EVENT_DATA]=NDOMOD_SUBTYPE(NEBTYPE_TIMEDEVENT_DELAY)|NDOMOD_SUBTYPE(NEBTYPE_TIMEDEVENT_SKIP)|NDOMOD_SUBTYPE(NEBTYPE_TIMEDEVENT_SLEEP),
+	[NEBCALLBACK_SERVICE_CHECK_DATA]=~NDOMOD_SUBTYPE(NEBTYPE_SERVICECHECK_PROCESSED),
+	[NEBCALLBACK_HOST_CHECK_DATA]=~NDOMOD_SUBTYPE(NEBTYPE_HOSTCHECK_PROCESSED),
+	[NEBCALLBACK_EXTERNAL_COMMAND_DATA]=NDOMOD_SUBTYPE(NEBTYPE_EXTERNALCOMMAND_END),
+	[NEBCALLBACK_AGGREGATED_STATUS_DATA]=NDOMOD_ALL_SUBTYPES,
+	[NEBCALLBACK_STATE_CHANGE_DATA]=NDOMOD_SUBTYPE(NEBTYPE_STATECHANGE_START)
+	};
+ndomod_event_limit ndomod_limits[NEBCALLBACK_NUMITEMS];
+static int ndomod_limits_active=NDO_FALSE;		/* set once any rate limit or sampling is configured */
+static ndomod_export_rule *ndomod_export_rules=NULL;
+static int ndomod_export_host_rules=0;
+static int ndomod_export_service_rules=0;
+#ifdef BUILD_NAGIOS_4X
+static bitmap *ndomod_export_hosts=NULL;		/* indexed by object id */
+static bitmap *ndomod_export_services=NULL;
+#endif
+int ndomod_output_compression=NDO_FALSE;
+int ndomod_compression_level=6;
+unsigned long ndomod_compression_block_size=NDOMOD_COMPRESSION_BLOCK_SIZE;
+unsigned long ndomod_compression_flush_interval=1;
+unsigned long ndomod_compression_stats_interval=300;
+ndomod_compression_stats zstats;
+static int ndomod_compression_active=NDO_FALSE;	/* set once the hello has gone out uncompressed */
+static ndo_dbuf ndomod_zblock={NULL,0L,0L,8192L};	/* data waiting to be compressed */
+static ndo_dbuf ndomod_zout={NULL,0L,0L,8192L};
+static time_t ndomod_zblock_time=0L;
+
+unsigned long ndomod_output_batch_size=0L;
+unsigned long ndomod_output_batch_delay=10;
+unsigned long ndomod_batch_writes=0L;
+unsigned long long ndomod_batch_bytes=0L;
+static ndo_dbuf ndomod_batch;
+static struct timeval ndomod_batch_time;
+#ifdef BUILD_NAGIOS_4X
+unsigned long ndomod_stats_log_interval=0L;		/* Nagios 4 can ask for them through the query handler */
+#else
+unsigned long ndomod_stats_log_interval=300;
+#endif
+ndomod_event_stats ndomod_stats[NEBCALLBACK_NUMITEMS];
+unsigned long ndomod_sink_reconnects=0L;
+unsigned long ndomod_sink_items_lost=0L;		/* overflow counts from before the last reconnect */
+static time_t ndomod_stats_reset_time=0L;
+static time_t ndomod_compression_last_stats=0L;
+#ifdef HAVE_ZLIB
+static z_stream ndomod_zstream;
+static int ndomod_zstream_ready=NDO_FALSE;
+#endif
 int has_ver403_long_output = (CURRENT_OBJECT_STRUCTURE_VERSION >= 403);
 
 extern int errno;
@@ -161,13 +240,16 @@ extern int __nagios_object_structure_version;
 
 extern int use_ssl;
 
-#define NDOMOD_FREE_ESC_BUFFERS(ary, num) { \
+/* only frees what the escaping had to allocate - strings with nothing to escape are Nagios' own */
+#define NDOMOD_FREE_ESC_BUFFERS(ary, allocated, num) { \
 		int i = num; \
 		if (i < 0) \
 			i = 0; \
 		while (i--) { \
-			free(ary[i]); \
+			if (allocated[i] == NDO_TRUE) \
+				free(ary[i]); \
 			ary[i] = NULL; \
+			allocated[i] = NDO_FALSE; \
 		} }
 
 #define DEBUG_NDO 1
@@ -253,17 +335,44 @@ int ndomod_init(void){
 	ndomod_sink_fd=-1;
 	ndomod_sink_last_reconnect_attempt=0L;
 	ndomod_sink_last_reconnect_warning=0L;
+	ndomod_sink_reconnect_delay=ndomod_sink_reconnect_interval;
+	ndomod_sink_connecting=NDO_FALSE;
+#ifdef BUILD_NAGIOS_4X
+	ndomod_sink_address_valid=NDO_FALSE;
+	ndomod_sink_address_next_lookup=0L;
+	ndomod_sink_address_retry=0L;
+#endif
 	ndomod_allow_sink_activity=NDO_TRUE;
 
 	/* initialize data sink buffer */
-	ndomod_sink_buffer_init(&sinkbuf,ndomod_sink_buffer_slots);
+	ndomod_sink_buffer_init(&sinkbuf,ndomod_sink_buffer_slots,ndomod_sink_buffer_maxbytes);
+
+	/* pick up any segments spilled to disk before we were last stopped */
+	ndomod_spill_init();
 
 	/* read unprocessed data from buffer file */
 	ndomod_load_unprocessed_data(ndomod_buffer_file);
 
+	/* set up stream compression before we say hello */
+	ndomod_init_compression();
+
+	/* callback timings and counters */
+	ndomod_reset_stats();
+
+	/* small writes are gathered here and sent together */
+	ndo_dbuf_init(&ndomod_batch,(ndomod_output_batch_size>0L)?ndomod_output_batch_size:NDOMOD_MAX_BUFLEN);
+
 	/* open data sink and say hello */
 	/* 05/04/06 - modified to flush buffer items that may have been read in from file */
-	ndomod_write_to_sink("\n",NDO_FALSE,NDO_TRUE);
+	/* in async mode the writer thread does this so we don't block on connect() */
+	if(ndomod_use_async_writer==NDO_TRUE){
+		if(ndomod_start_async_writer()==NDO_ERROR){
+			ndomod_write_to_logs("ndomod: Could not start async writer thread, falling back to synchronous output.",NSLOG_INFO_MESSAGE);
+			ndomod_write_to_sink("\n",NDO_FALSE,NDO_TRUE);
+			}
+		}
+	else
+		ndomod_write_to_sink("\n",NDO_FALSE,NDO_TRUE);
 
 	/* register callbacks */
 	if(ndomod_register_callbacks()==NDO_ERROR)
@@ -292,6 +401,61 @@ int ndomod_init(void){
 
 	        }
 
+	/* send held back status updates even when no new ones come in */
+	if(ndomod_status_conflation_window>0){
+		time(&current_time);
+#ifdef BUILD_NAGIOS_2X
+		schedule_new_event(EVENT_USER_FUNCTION,TRUE,current_time+ndomod_status_conflation_window,TRUE,ndomod_status_conflation_window,NULL,TRUE,(void *)ndomod_check_conflated_status,NULL);
+#else
+		schedule_new_event(EVENT_USER_FUNCTION,TRUE,current_time+ndomod_status_conflation_window,TRUE,ndomod_status_conflation_window,NULL,TRUE,(void *)ndomod_check_conflated_status,NULL,0);
+#endif
+		}
+
+	/* keep draining buffered output a slice at a time when no new data comes in */
+	if(ndomod_backlog_drain_items>0L || ndomod_backlog_drain_bytes>0L || ndomod_backlog_drain_time>0L){
+		time(&current_time);
+#ifdef BUILD_NAGIOS_2X
+		schedule_new_event(EVENT_USER_FUNCTION,TRUE,current_time+1,TRUE,1,NULL,TRUE,(void *)ndomod_check_backlog,NULL);
+#else
+		schedule_new_event(EVENT_USER_FUNCTION,TRUE,current_time+1,TRUE,1,NULL,TRUE,(void *)ndomod_check_backlog,NULL,0);
+#endif
+		}
+
+	/* the core only schedules to the second, so this just catches batches left over when things are quiet */
+	if(ndomod_output_batch_size>0L){
+		time(&current_time);
+#ifdef BUILD_NAGIOS_2X
+		schedule_new_event(EVENT_USER_FUNCTION,TRUE,current_time+1,TRUE,1,NULL,TRUE,(void *)ndomod_check_output_batch,NULL);
+#else
+		schedule_new_event(EVENT_USER_FUNCTION,TRUE,current_time+1,TRUE,1,NULL,TRUE,(void *)ndomod_check_output_batch,NULL,0);
+#endif
+		}
+
+	/* statistics can be asked for through the query handler on Nagios 4, or go to the log every so often */
+	if(ndomod_collect_stats==NDO_TRUE){
+		time(&current_time);
+#ifdef BUILD_NAGIOS_4X
+		schedule_new_event(EVENT_USER_FUNCTION,TRUE,current_time,FALSE,0,NULL,TRUE,(void *)ndomod_register_query_handler,NULL,0);
+#endif
+		if(ndomod_stats_log_interval>0){
+#ifdef BUILD_NAGIOS_2X
+			schedule_new_event(EVENT_USER_FUNCTION,TRUE,current_time+ndomod_stats_log_interval,TRUE,ndomod_stats_log_interval,NULL,TRUE,(void *)ndomod_log_stats,NULL);
+#else
+			schedule_new_event(EVENT_USER_FUNCTION,TRUE,current_time+ndomod_stats_log_interval,TRUE,ndomod_stats_log_interval,NULL,TRUE,(void *)ndomod_log_stats,NULL,0);
+#endif
+			}
+		}
+
+	/* make sure compressed output doesn't sit around when things are quiet */
+	if(ndomod_output_compression==NDO_TRUE && ndomod_compression_flush_interval>0){
+		time(&current_time);
+#ifdef BUILD_NAGIOS_2X
+		schedule_new_event(EVENT_USER_FUNCTION,TRUE,current_time+ndomod_compression_flush_interval,TRUE,ndomod_compression_flush_interval,NULL,TRUE,(void *)ndomod_flush_compressed_sink,NULL);
+#else
+		schedule_new_event(EVENT_USER_FUNCTION,TRUE,current_time+ndomod_compression_flush_interval,TRUE,ndomod_compression_flush_interval,NULL,TRUE,(void *)ndomod_flush_compressed_sink,NULL,0);
+#endif
+		}
+
 	return NDO_OK;
         }
 
@@ -300,11 +464,33 @@ int ndomod_init(void){
 int ndomod_deinit(void) {
 	ndomod_deregister_callbacks();
 
+	/* don't lose the latest status of anything */
+	ndomod_flush_conflated_status();
+
+	/* drain the async queue before touching the sink from this thread */
+	ndomod_stop_async_writer();
+
 	ndomod_save_unprocessed_data(ndomod_buffer_file);
 	ndomod_sink_buffer_deinit(&sinkbuf);
+	ndomod_log_spill_stats();
+	ndomod_spill_deinit();
 	ndomod_goodbye_sink();
 	ndomod_close_sink();
+	ndomod_log_compression_stats();
 
+#ifdef HAVE_ZLIB
+	if(ndomod_zstream_ready==NDO_TRUE){
+		deflateEnd(&ndomod_zstream);
+		ndomod_zstream_ready=NDO_FALSE;
+		}
+#endif
+	ndo_dbuf_free(&ndomod_zblock);
+	ndo_dbuf_free(&ndomod_zout);
+	ndo_dbuf_free(&ndomod_batch);
+	ndo_dbuf_free(&ndomod_outbuf);
+	ndomod_free_delta_state();
+	ndomod_free_export_filters();
+	ndomod_free_object_keys();
 	ndomod_free_config_memory();
 
 	return NDO_OK;
@@ -455,18 +641,112 @@ int ndomod_process_config_var(char *arg){
 			ndomod_sink_type=NDO_SINK_FILE;
 		else if(!strcmp(val,"tcpsocket"))
 			ndomod_sink_type=NDO_SINK_TCPSOCKET;
+		else if(!strcmp(val,"shm"))
+			ndomod_sink_type=NDO_SINK_SHM;
+		else if(!strcmp(val,"unixseqpacket"))
+			ndomod_sink_type=NDO_SINK_UNIXSEQPACKET;
 		else
 			ndomod_sink_type=NDO_SINK_UNIXSOCKET;
 	        }
 
+	else if(!strcmp(var,"output_protocol")){
+		if(atoi(val)==NDO_API_PROTOVERSION_BINARY)
+			ndomod_protocol_version=NDO_API_PROTOVERSION_BINARY;
+		else
+			ndomod_protocol_version=NDO_API_PROTOVERSION;
+		}
+
+	else if(!strcmp(var,"status_delta_resync"))
+		ndomod_status_delta_resync=strtoul(val,NULL,0);
+
+	else if(!strcmp(var,"status_conflation_window"))
+		ndomod_status_conflation_window=strtoul(val,NULL,0);
+
+	else if(!strcmp(var,"output_compression"))
+		ndomod_output_compression=(atoi(val)>0)?NDO_TRUE:NDO_FALSE;
+
+	else if(!strcmp(var,"compression_level"))
+		ndomod_compression_level=atoi(val);
+
+	else if(!strcmp(var,"compression_block_size"))
+		ndomod_compression_block_size=strtoul(val,NULL,0);
+
+	else if(!strcmp(var,"compression_flush_interval"))
+		ndomod_compression_flush_interval=strtoul(val,NULL,0);
+
+	else if(!strcmp(var,"compression_stats_interval"))
+		ndomod_compression_stats_interval=strtoul(val,NULL,0);
+
+	else if(!strcmp(var,"collect_stats"))
+		ndomod_collect_stats=(atoi(val)>0)?NDO_TRUE:NDO_FALSE;
+
+	else if(!strcmp(var,"stats_log_interval"))
+		ndomod_stats_log_interval=strtoul(val,NULL,0);
+
+	else if(!strcmp(var,"event_subtypes"))
+		ndomod_set_event_subtypes(val);
+
+	else if(!strcmp(var,"rate_limit"))
+		ndomod_set_event_limit(val,NDO_FALSE);
+	else if(!strcmp(var,"sample"))
+		ndomod_set_event_limit(val,NDO_TRUE);
+
+	else if(!strcmp(var,"export_hostgroup"))
+		ndomod_add_export_rule(NDOMOD_EXPORT_HOSTGROUP,val);
+	else if(!strcmp(var,"export_servicegroup"))
+		ndomod_add_export_rule(NDOMOD_EXPORT_SERVICEGROUP,val);
+	else if(!strcmp(var,"export_host_name"))
+		ndomod_add_export_rule(NDOMOD_EXPORT_HOST_NAME,val);
+	else if(!strcmp(var,"export_service_description"))
+		ndomod_add_export_rule(NDOMOD_EXPORT_SERVICE_NAME,val);
+	else if(!strcmp(var,"export_custom_variable"))
+		ndomod_add_export_rule(NDOMOD_EXPORT_CUSTOM_VARIABLE,val);
+
 	else if(!strcmp(var,"tcp_port"))
 		ndomod_sink_tcp_port=atoi(val);
 
 	else if(!strcmp(var,"output_buffer_items"))
 		ndomod_sink_buffer_slots=strtoul(val,NULL,0);
+	else if(!strcmp(var,"output_buffer_bytes"))
+		ndomod_sink_buffer_maxbytes=strtoul(val,NULL,0);
+	else if(!strcmp(var,"output_batch_size"))
+		ndomod_output_batch_size=strtoul(val,NULL,0);
+	else if(!strcmp(var,"output_batch_delay"))
+		ndomod_output_batch_delay=strtoul(val,NULL,0);
+	else if(!strcmp(var,"backlog_drain_items"))
+		ndomod_backlog_drain_items=strtoul(val,NULL,0);
+	else if(!strcmp(var,"backlog_drain_bytes"))
+		ndomod_backlog_drain_bytes=strtoul(val,NULL,0);
+	else if(!strcmp(var,"backlog_drain_time"))
+		ndomod_backlog_drain_time=strtoul(val,NULL,0);
+	else if(!strcmp(var,"spill_directory"))
+		ndomod_spill_dir=strdup(val);
+	else if(!strcmp(var,"spill_threshold"))
+		ndomod_spill_threshold=strtoul(val,NULL,0);
+	else if(!strcmp(var,"spill_segment_size"))
+		ndomod_spill_segment_size=strtoul(val,NULL,0);
+	else if(!strcmp(var,"spill_max_bytes"))
+		ndomod_spill_max_bytes=strtoull(val,NULL,0);
+
+	else if(!strcmp(var,"use_async_writer"))
+		ndomod_use_async_writer=(atoi(val)>0)?NDO_TRUE:NDO_FALSE;
+
+	else if(!strcmp(var,"async_queue_size")){
+		ndomod_async_queue_size=strtoul(val,NULL,0);
+		if(ndomod_async_queue_size<NDOMOD_ASYNC_QUEUE_MIN_SIZE)
+			ndomod_async_queue_size=NDOMOD_ASYNC_QUEUE_MIN_SIZE;
+		}
+
+	else if(!strcmp(var,"async_enqueue_timeout"))
+		ndomod_async_enqueue_timeout=strtoul(val,NULL,0);
+
+	else if(!strcmp(var,"async_stats_interval"))
+		ndomod_async_stats_interval=strtoul(val,NULL,0);
 
 	else if(!strcmp(var,"reconnect_interval"))
 		ndomod_sink_reconnect_interval=strtoul(val,NULL,0);
+	else if(!strcmp(var,"reconnect_max_interval"))
+		ndomod_sink_reconnect_max_interval=strtoul(val,NULL,0);
 
 	else if(!strcmp(var,"reconnect_warning_interval"))
 		ndomod_sink_reconnect_warning_interval=strtoul(val,NULL,0);
@@ -547,6 +827,9 @@ int ndomod_process_config_var(char *arg){
 	else if(!strcmp(var,"config_output_options"))
 		ndomod_config_output_options=atoi(val);
 
+	else if(!strcmp(var,"config_hashes"))
+		ndomod_send_config_hashes=(atoi(val)>0)?NDO_TRUE:NDO_FALSE;
+
 	else if(!strcmp(var,"buffer_file"))
 		ndomod_buffer_file=strdup(val);
 
@@ -574,6 +857,7 @@ static void ndomod_free_config_memory(void) {
 	my_free(ndomod_sink_name);
 	my_free(ndomod_sink_rotation_command);
 	my_free(ndomod_buffer_file);
+	my_free(ndomod_spill_dir);
 }
 
 
@@ -587,6 +871,15 @@ int ndomod_write_to_logs(char *buf, int flags){
 	if(buf==NULL)
 		return NDO_ERROR;
 
+	/* Nagios logging isn't thread-safe, so the writer thread leaves its messages for the core thread */
+	if(ndomod_async_thread_running==NDO_TRUE && pthread_equal(pthread_self(),ndomod_async_thread)){
+		pthread_mutex_lock(&ndomod_async_log_lock);
+		if(ndomod_async_log_count<NDOMOD_ASYNC_MAX_LOG_MSGS)
+			ndomod_async_log_msgs[ndomod_async_log_count++]=strdup(buf);
+		pthread_mutex_unlock(&ndomod_async_log_lock);
+		return NDO_OK;
+		}
+
 	return write_to_all_logs(buf,flags);
 	}
 
@@ -596,567 +889,2516 @@ int ndomod_write_to_logs(char *buf, int flags){
 /* DATA SINK FUNCTIONS                                                      */
 /****************************************************************************/
 
-/* (re)open data sink */
-int ndomod_open_sink(void){
-	int flags=0;
+/* sets up the deflate stream used for compressed output */
+int ndomod_init_compression(void){
 
-	/* sink is already open... */
-	if(ndomod_sink_is_open==NDO_TRUE)
-		return ndomod_sink_fd;
+	if(ndomod_output_compression==NDO_FALSE)
+		return NDO_OK;
 
-	/* try and open sink */
-	if(ndomod_sink_type==NDO_SINK_FILE)
-		flags=O_WRONLY|O_CREAT|O_APPEND;
-	if(ndo_sink_open(ndomod_sink_name,0,ndomod_sink_type,ndomod_sink_tcp_port,flags,&ndomod_sink_fd)==NDO_ERROR)
-		return NDO_ERROR;
+	if(ndomod_compression_block_size==0L)
+		ndomod_compression_block_size=NDOMOD_COMPRESSION_BLOCK_SIZE;
+	if(ndomod_compression_block_size>NDO_API_COMPRESSION_MAX_BLOCK_SIZE)
+		ndomod_compression_block_size=NDO_API_COMPRESSION_MAX_BLOCK_SIZE;
 
-	/* mark the sink as being open */
-	ndomod_sink_is_open=NDO_TRUE;
+	ndomod_compression_last_stats=time(NULL);
 
-	/* mark the sink as having once been open */
-	ndomod_sink_previously_open=NDO_TRUE;
+#ifdef HAVE_ZLIB
+	if(ndomod_zstream_ready==NDO_TRUE)
+		return NDO_OK;
+
+	memset(&ndomod_zstream,0,sizeof(ndomod_zstream));
+	if(ndomod_compression_level<Z_BEST_SPEED || ndomod_compression_level>Z_BEST_COMPRESSION)
+		ndomod_compression_level=Z_DEFAULT_COMPRESSION;
+	if(deflateInit(&ndomod_zstream,ndomod_compression_level)!=Z_OK){
+		ndomod_write_to_logs("ndomod: Could not initialize output compression, sending uncompressed output.",NSLOG_INFO_MESSAGE);
+		ndomod_output_compression=NDO_FALSE;
+		return NDO_ERROR;
+		}
+	ndomod_zstream_ready=NDO_TRUE;
 
 	return NDO_OK;
+#else
+	ndomod_write_to_logs("ndomod: Warning - output_compression requires zlib, which this module was built without.",NSLOG_INFO_MESSAGE);
+	ndomod_output_compression=NDO_FALSE;
+
+	return NDO_ERROR;
+#endif
         }
 
 
-/* (re)open data sink */
-int ndomod_close_sink(void){
+#ifdef HAVE_ZLIB
+/* cpu time used by the calling thread, in usec */
+static unsigned long long ndomod_cpu_usec(void){
+#ifdef CLOCK_THREAD_CPUTIME_ID
+	struct timespec ts;
 
-	/* sink is already closed... */
-	if(ndomod_sink_is_open==NDO_FALSE)
-		return NDO_OK;
+	if(clock_gettime(CLOCK_THREAD_CPUTIME_ID,&ts)==0)
+		return (unsigned long long)ts.tv_sec*1000000L+ts.tv_nsec/1000L;
+#endif
+	return (unsigned long long)clock()*1000000L/CLOCKS_PER_SEC;
+        }
+#endif
 
-	/* flush sink */
-	ndo_sink_flush(ndomod_sink_fd);
 
-	/* close sink */
-	ndo_sink_close(ndomod_sink_fd);
+/* compresses a block and writes it to the sink, prefixed by its compressed and raw lengths */
+static int ndomod_write_compressed_block(char *buf, unsigned long len){
+#ifdef HAVE_ZLIB
+	unsigned long long cpu_start=0L;
+	unsigned long avail=0L;
+	unsigned long zlen=0L;
+	unsigned char *hdr=NULL;
 
-	/* mark the sink as being closed */
-	ndomod_sink_is_open=NDO_FALSE;
+	if(len==0L)
+		return 0;
 
-	return NDO_OK;
-        }
+	cpu_start=ndomod_cpu_usec();
 
+	ndo_dbuf_reset(&ndomod_zout);
+	if(ndo_dbuf_reserve(&ndomod_zout,NDO_API_COMPRESSION_HEADER_SIZE)==NDO_ERROR)
+		return NDO_ERROR;
+	ndomod_zout.used_size=NDO_API_COMPRESSION_HEADER_SIZE;
 
-/* say hello */
-int ndomod_hello_sink(int reconnect, int problem_disconnect){
-	char temp_buffer[NDOMOD_MAX_BUFLEN];
-	char *connection_type=NULL;
-	char *connect_type=NULL;
+	ndomod_zstream.next_in=(Bytef *)buf;
+	ndomod_zstream.avail_in=(uInt)len;
 
-	/* get the connection type string */
-	if(ndomod_sink_type==NDO_SINK_FD || ndomod_sink_type==NDO_SINK_FILE)
-		connection_type=NDO_API_CONNECTION_FILE;
-	else if(ndomod_sink_type==NDO_SINK_TCPSOCKET)
-		connection_type=NDO_API_CONNECTION_TCPSOCKET;
-	else
-		connection_type=NDO_API_CONNECTION_UNIXSOCKET;
+	/* a sync flush ends each block on a byte boundary so ndo2db can inflate it right away */
+	do{
+		if(ndo_dbuf_reserve(&ndomod_zout,deflateBound(&ndomod_zstream,ndomod_zstream.avail_in)+64)==NDO_ERROR)
+			return NDO_ERROR;
+		avail=ndomod_zout.allocated_size-ndomod_zout.used_size-1;
+		ndomod_zstream.next_out=(Bytef *)(ndomod_zout.buf+ndomod_zout.used_size);
+		ndomod_zstream.avail_out=(uInt)avail;
+		if(deflate(&ndomod_zstream,Z_SYNC_FLUSH)==Z_STREAM_ERROR)
+			return NDO_ERROR;
+		ndomod_zout.used_size+=avail-ndomod_zstream.avail_out;
+		}while(ndomod_zstream.avail_out==0);
+
+	zlen=ndomod_zout.used_size-NDO_API_COMPRESSION_HEADER_SIZE;
+	hdr=(unsigned char *)ndomod_zout.buf;
+	hdr[0]=(zlen>>24)&0xff;
+	hdr[1]=(zlen>>16)&0xff;
+	hdr[2]=(zlen>>8)&0xff;
+	hdr[3]=zlen&0xff;
+	hdr[4]=(len>>24)&0xff;
+	hdr[5]=(len>>16)&0xff;
+	hdr[6]=(len>>8)&0xff;
+	hdr[7]=len&0xff;
+
+	zstats.cpu_usec+=ndomod_cpu_usec()-cpu_start;
+
+	if(ndo_sink_write(ndomod_sink_fd,ndomod_zout.buf,(int)ndomod_zout.used_size)<0)
+		return NDO_ERROR;
 
-	/* get the connect type string */
-	if(reconnect==TRUE && problem_disconnect==TRUE)
-		connect_type=NDO_API_CONNECTTYPE_RECONNECT;
-	else
-		connect_type=NDO_API_CONNECTTYPE_INITIAL;
+	zstats.raw_bytes+=len;
+	zstats.compressed_bytes+=ndomod_zout.used_size;
+	zstats.blocks++;
 
-	snprintf(temp_buffer,sizeof(temp_buffer)-1
-		 ,"\n\n%s\n%s: %d\n%s: %s\n%s: %s\n%s: %lu\n%s: %s\n%s: %s\n%s: %s\n%s: %s\n%s\n\n"
-		 ,NDO_API_HELLO
-		 ,NDO_API_PROTOCOL
-		 ,NDO_API_PROTOVERSION
-		 ,NDO_API_AGENT
-		 ,NDOMOD_NAME
-		 ,NDO_API_AGENTVERSION
-		 ,NDOMOD_VERSION
-		 ,NDO_API_STARTTIME
-		 ,(unsigned long)time(NULL)
-		 ,NDO_API_DISPOSITION
-		 ,NDO_API_DISPOSITION_REALTIME
-		 ,NDO_API_CONNECTION
-		 ,connection_type
-		 ,NDO_API_CONNECTTYPE
-		 ,connect_type
-		 ,NDO_API_INSTANCENAME
-		 ,(ndomod_instance_name==NULL)?"default":ndomod_instance_name
-		 ,NDO_API_STARTDATADUMP
-		);
+	return (int)len;
+#else
+	return NDO_ERROR;
+#endif
+        }
 
-	temp_buffer[sizeof(temp_buffer)-1]='\x0';
 
-	ndomod_write_to_sink(temp_buffer,NDO_FALSE,NDO_FALSE);
+/* compresses and sends the pending block */
+static int ndomod_flush_compression_block(void){
+	int result=0;
 
-	return NDO_OK;
-        }
+	if(ndomod_zblock.used_size==0L)
+		return 0;
 
+	result=ndomod_write_compressed_block(ndomod_zblock.buf,ndomod_zblock.used_size);
 
-/* say goodbye */
-int ndomod_goodbye_sink(void){
-	char temp_buffer[NDOMOD_MAX_BUFLEN];
+	/* the stream can't be resumed after a failed write, so keep the data for after we reconnect */
+	if(result<0){
+		ndomod_buffer_output(ndomod_zblock.buf);
+		ndo_dbuf_reset(&ndomod_zblock);
+		ndomod_compression_active=NDO_FALSE;
+		ndomod_close_sink();
+		return NDO_ERROR;
+		}
 
-	snprintf(temp_buffer,sizeof(temp_buffer)-1
-		 ,"\n%d\n%s: %lu\n%s\n\n"
-		 ,NDO_API_ENDDATADUMP
-		 ,NDO_API_ENDTIME
-		 ,(unsigned long)time(NULL)
-		 ,NDO_API_GOODBYE
-		 );
+	ndo_dbuf_reset(&ndomod_zblock);
 
-	temp_buffer[sizeof(temp_buffer)-1]='\x0';
+	return result;
+        }
 
-	ndomod_write_to_sink(temp_buffer,NDO_FALSE,NDO_TRUE);
 
-	return NDO_OK;
-        }
+/* returns how long (in msec) the oldest batched output has been waiting */
+static unsigned long ndomod_batch_age(void){
+	struct timeval now;
 
+	if(ndomod_batch.used_size==0L)
+		return 0L;
 
-/* used to rotate data sink file on a regular basis */
-int ndomod_rotate_sink_file(void *args){
-#ifdef BUILD_NAGIOS_2X
-	char raw_command_line[MAX_COMMAND_BUFFER];
-	char processed_command_line[MAX_COMMAND_BUFFER];
-#else
-	char *raw_command_line_3x=NULL;
-	char *processed_command_line_3x=NULL;
-#endif
-	int early_timeout=FALSE;
-	double exectime;
+	gettimeofday(&now,NULL);
 
-	/* close sink */
-	ndomod_goodbye_sink();
-	ndomod_close_sink();
+	return (unsigned long)((now.tv_sec-ndomod_batch_time.tv_sec)*1000L+(now.tv_usec-ndomod_batch_time.tv_usec)/1000L);
+        }
 
-	/* we shouldn't write any data to the sink while we're rotating it... */
-	ndomod_allow_sink_activity=NDO_FALSE;
 
+/* writes data to the sink - once the hello is out it is collected into blocks and compressed */
+int ndomod_sink_send(char *buf, int buflen, int flush_now){
+	int result=0;
+	int sent=0;
 
-	/****** ROTATE THE FILE *****/
+	/* the ring and message sockets take whole messages - a full ring leaves errno at EAGAIN so the data */
+	/* goes to the sink buffer, and a message that can never fit is dropped rather than retried forever */
+	if(ndomod_sink_type==NDO_SINK_SHM || (ndomod_sink_type==NDO_SINK_UNIXSEQPACKET && ndomod_output_batch_size==0L)){
+		if(ndomod_sink_type==NDO_SINK_SHM)
+			result=ndo_shm_write(ndomod_shm,buf,(unsigned long)buflen);
+		else
+			result=ndo_sink_write(ndomod_sink_fd,buf,buflen);
+		if(result<0 && errno==EMSGSIZE){
+			ndomod_write_to_logs("ndomod: Dropped output too large for the data sink.",NSLOG_INFO_MESSAGE);
+			return buflen;
+			}
+		return result;
+		}
 
-	/* get the raw command line */
-#ifdef BUILD_NAGIOS_2X
-	get_raw_command_line(ndomod_sink_rotation_command,raw_command_line,sizeof(raw_command_line),STRIP_ILLEGAL_MACRO_CHARS|ESCAPE_MACRO_CHARS);
-	strip(raw_command_line);
-#else
-	get_raw_command_line(find_command(ndomod_sink_rotation_command),ndomod_sink_rotation_command,&raw_command_line_3x,STRIP_ILLEGAL_MACRO_CHARS|ESCAPE_MACRO_CHARS);
-	strip(raw_command_line_3x);
-#endif
+	if(ndomod_compression_active==NDO_FALSE){
 
-	/* process any macros in the raw command line */
-#ifdef BUILD_NAGIOS_2X
-	process_macros(raw_command_line,processed_command_line,(int)sizeof(processed_command_line),STRIP_ILLEGAL_MACRO_CHARS|ESCAPE_MACRO_CHARS);
-#else
-	process_macros(raw_command_line_3x,&processed_command_line_3x,STRIP_ILLEGAL_MACRO_CHARS|ESCAPE_MACRO_CHARS);
-#endif
+		if(ndomod_output_batch_size==0L)
+			return ndo_sink_write(ndomod_sink_fd,buf,buflen);
 
-	/* run the command */
-#ifdef BUILD_NAGIOS_2X
-	my_system(processed_command_line,ndomod_sink_rotation_timeout,&early_timeout,&exectime,NULL,0);
-#else
-	my_system(processed_command_line_3x,ndomod_sink_rotation_timeout,&early_timeout,&exectime,NULL,0);
-#endif
+		/* send the pending batch first if this won't fit or has to go out now */
+		if(ndomod_batch.used_size>0L && (flush_now==NDO_TRUE || ndomod_batch.used_size+buflen>ndomod_output_batch_size)){
+			if(ndomod_flush_output_batch()<0)
+				return NDO_ERROR;
+			}
 
+		/* big writes and ones that can't wait go straight out */
+		if(flush_now==NDO_TRUE || (unsigned long)buflen>=ndomod_output_batch_size)
+			return ndo_sink_write(ndomod_sink_fd,buf,buflen);
 
-	/* allow data to be written to the sink */
-	ndomod_allow_sink_activity=NDO_TRUE;
+		if(ndomod_batch.used_size==0L)
+			gettimeofday(&ndomod_batch_time,NULL);
 
-	/* re-open sink */
-	ndomod_open_sink();
-	ndomod_hello_sink(TRUE,FALSE);
+		if(ndo_dbuf_strncat(&ndomod_batch,buf,buflen)==NDO_ERROR)
+			return NDO_ERROR;
 
-	return NDO_OK;
-        }
+		/* a failed flush requeues the batch (including this data), so it isn't an error for the caller */
+		if(ndomod_batch.used_size>=ndomod_output_batch_size || ndomod_batch_age()>=ndomod_output_batch_delay)
+			ndomod_flush_output_batch();
 
+		return buflen;
+		}
 
-/* writes data to sink */
-int ndomod_write_to_sink(char *buf, int buffer_write, int flush_buffer){
-	char *temp_buffer=NULL;
-	char *sbuf=NULL;
-	int buflen=0;
-	int result=NDO_OK;
-	time_t current_time;
-	int reconnect=NDO_FALSE;
-	unsigned long items_to_flush=0L;
+	/* send the pending block first if this won't fit */
+	if(ndomod_zblock.used_size>0L && ndomod_zblock.used_size+buflen>ndomod_compression_block_size){
+		if(ndomod_flush_compression_block()<0)
+			return NDO_ERROR;
+		}
 
-	/* we have nothing to write... */
-	if(buf==NULL)
-		return NDO_OK;
+	/* big writes get blocks of their own, no bigger than ndo2db will take */
+	if((unsigned long)buflen>=ndomod_compression_block_size){
+		for(sent=0;sent<buflen;sent+=result){
+			if((result=ndomod_write_compressed_block(buf+sent,(buflen-sent>NDO_API_COMPRESSION_MAX_BLOCK_SIZE)?NDO_API_COMPRESSION_MAX_BLOCK_SIZE:(unsigned long)(buflen-sent)))<0){
+				ndomod_compression_active=NDO_FALSE;
+				ndomod_close_sink();
+				return result;
+				}
+			}
+		return buflen;
+		}
 
-	/* we shouldn't be messing with things... */
-	if(ndomod_allow_sink_activity==NDO_FALSE)
+	if(ndomod_zblock.used_size==0L)
+		time(&ndomod_zblock_time);
+
+	if(ndo_dbuf_strncat(&ndomod_zblock,buf,buflen)==NDO_ERROR)
 		return NDO_ERROR;
 
-	/* open the sink if necessary... */
-	if(ndomod_sink_is_open==NDO_FALSE){
+	/* a failed flush requeues the block (including this data), so it isn't an error for the caller */
+	if(flush_now==NDO_TRUE || (unsigned long)(time(NULL)-ndomod_zblock_time)>=ndomod_compression_flush_interval)
+		ndomod_flush_compression_block();
 
-		time(&current_time);
-
-		/* are we reopening the sink? */
-		if(ndomod_sink_previously_open==NDO_TRUE)
-			reconnect=NDO_TRUE;
-
-		/* (re)connect to the sink if its time */
-		if((unsigned long)((unsigned long)current_time-ndomod_sink_reconnect_interval)>(unsigned long)ndomod_sink_last_reconnect_attempt){
-
-			result=ndomod_open_sink();
-
-			ndomod_sink_last_reconnect_attempt=current_time;
-
-			ndomod_sink_connect_attempt++;
-
-			/* sink was (re)opened... */
-			if(result==NDO_OK){
-
-				if(reconnect==NDO_TRUE){
-					asprintf(&temp_buffer,"ndomod: Successfully reconnected to data sink!  %lu items lost, %lu queued items to flush.",sinkbuf.overflow,sinkbuf.items);
-					ndomod_hello_sink(TRUE,TRUE);
-				        }
-				else{
-					if(sinkbuf.overflow==0L)
-						asprintf(&temp_buffer,"ndomod: Successfully connected to data sink.  %lu queued items to flush.",sinkbuf.items);
-					else
-						asprintf(&temp_buffer,"ndomod: Successfully connected to data sink.  %lu items lost, %lu queued items to flush.",sinkbuf.overflow,sinkbuf.items);
-					ndomod_hello_sink(FALSE,FALSE);
-				        }
-
-				ndomod_write_to_logs(temp_buffer,NSLOG_INFO_MESSAGE);
-				free(temp_buffer);
-				temp_buffer=NULL;
-
-				/* reset sink overflow */
-				sinkbuf.overflow=0L;
-				}
-
-			/* sink could not be (re)opened... */
-			else{
-
-				if((unsigned long)((unsigned long)current_time-ndomod_sink_reconnect_warning_interval)>(unsigned long)ndomod_sink_last_reconnect_warning){
-					if(reconnect==NDO_TRUE)
-						asprintf(&temp_buffer,"ndomod: Still unable to reconnect to data sink.  %lu items lost, %lu queued items to flush.",sinkbuf.overflow,sinkbuf.items);
-					else if(ndomod_sink_connect_attempt==1)
-						asprintf(&temp_buffer,"ndomod: Could not open data sink!  I'll keep trying, but some output may get lost...");
-					else
-						asprintf(&temp_buffer,"ndomod: Still unable to connect to data sink.  %lu items lost, %lu queued items to flush.",sinkbuf.overflow,sinkbuf.items);
-					ndomod_write_to_logs(temp_buffer,NSLOG_INFO_MESSAGE);
-					free(temp_buffer);
-					temp_buffer=NULL;
+	return buflen;
+        }
 
-					ndomod_sink_last_reconnect_warning=current_time;
-					}
-				}
-			}
-	        }
 
-	/* we weren't able to (re)connect */
-	if(ndomod_sink_is_open==NDO_FALSE){
+/* sends batched output */
+int ndomod_flush_output_batch(void){
+	int result=0;
 
-		/***** BUFFER OUTPUT FOR LATER *****/
+	if(ndomod_batch.used_size==0L)
+		return 0;
 
-		if(buffer_write==NDO_TRUE)
-			ndomod_sink_buffer_push(&sinkbuf,buf);
+	result=ndo_sink_write(ndomod_sink_fd,ndomod_batch.buf,(int)ndomod_batch.used_size);
 
+	/* keep the data for after we reconnect */
+	if(result<0){
+		ndomod_buffer_output(ndomod_batch.buf);
+		ndo_dbuf_reset(&ndomod_batch);
+		ndomod_close_sink();
 		return NDO_ERROR;
-	        }
+		}
 
+	ndomod_batch_writes++;
+	ndomod_batch_bytes+=ndomod_batch.used_size;
+	ndo_dbuf_reset(&ndomod_batch);
 
-	/***** FLUSH BUFFERED DATA FIRST *****/
+	return result;
+        }
 
-	if(flush_buffer==NDO_TRUE && (items_to_flush=ndomod_sink_buffer_items(&sinkbuf))>0){
 
-		while(ndomod_sink_buffer_items(&sinkbuf)>0){
+/* sends batched output that has been waiting too long - runs as a Nagios timed event */
+int ndomod_check_output_batch(void *args){
 
-			/* get next item from buffer */
-			sbuf=ndomod_sink_buffer_peek(&sinkbuf);
+	/* don't wait on the writer thread, it checks the batch itself */
+	if(ndomod_async_thread_running==NDO_TRUE)
+		return NDO_OK;
 
-			buflen=strlen(sbuf);
-			result=ndo_sink_write(ndomod_sink_fd,sbuf,buflen);
+	if(ndomod_sink_is_open==NDO_TRUE && ndomod_batch_age()>=ndomod_output_batch_delay)
+		ndomod_flush_output_batch();
 
-			/* an error occurred... */
-			if(result<0){
+	return NDO_OK;
+        }
 
-				/* sink problem! */
-				if(errno!=EAGAIN){
 
-					/* close the sink */
-					ndomod_close_sink();
+/* sends compressed output that has been waiting too long - runs as a Nagios timed event */
+int ndomod_flush_compressed_sink(void *args){
+	int locked=NDO_FALSE;
+	time_t current_time;
 
-					asprintf(&temp_buffer,"ndomod: Error writing to data sink!  Some output may get lost.  %lu queued items to flush.",sinkbuf.items);
-					ndomod_write_to_logs(temp_buffer,NSLOG_INFO_MESSAGE);
-					free(temp_buffer);
-					temp_buffer=NULL;
+	/* don't wait on the writer thread, we'll get it next time */
+	if(ndomod_async_thread_running==NDO_TRUE){
+		if(pthread_mutex_trylock(&ndomod_sink_lock)!=0)
+			return NDO_OK;
+		locked=NDO_TRUE;
+		}
 
-					time(&current_time);
-					ndomod_sink_last_reconnect_attempt=current_time;
-					ndomod_sink_last_reconnect_warning=current_time;
-		                        }
+	time(&current_time);
 
-				/***** BUFFER ORIGINAL OUTPUT FOR LATER *****/
+	if(ndomod_compression_active==NDO_TRUE && ndomod_zblock.used_size>0L && (unsigned long)(current_time-ndomod_zblock_time)>=ndomod_compression_flush_interval)
+		ndomod_flush_compression_block();
 
-				if(buffer_write==NDO_TRUE)
-					ndomod_sink_buffer_push(&sinkbuf,buf);
+	if(ndomod_compression_stats_interval>0 && (unsigned long)(current_time-ndomod_compression_last_stats)>=ndomod_compression_stats_interval){
+		ndomod_log_compression_stats();
+		ndomod_compression_last_stats=current_time;
+		}
 
-				return NDO_ERROR;
-	                        }
+	if(locked==NDO_TRUE)
+		pthread_mutex_unlock(&ndomod_sink_lock);
 
-			/* buffer was written okay, so remove it from buffer */
-			ndomod_sink_buffer_pop(&sinkbuf);
-		        }
+	return NDO_OK;
+        }
 
-		asprintf(&temp_buffer,"ndomod: Successfully flushed %lu queued items to data sink.",items_to_flush);
-		ndomod_write_to_logs(temp_buffer,NSLOG_INFO_MESSAGE);
-		free(temp_buffer);
-		temp_buffer=NULL;
-	        }
 
+/* logs compression ratio and cost */
+void ndomod_log_compression_stats(void){
+	char temp_buffer[NDOMOD_MAX_BUFLEN];
 
-	/***** WRITE ORIGINAL DATA *****/
+	if(zstats.blocks==0L)
+		return;
 
-	/* write the data */
-	buflen=strlen(buf);
-	result=ndo_sink_write(ndomod_sink_fd,buf,buflen);
+	snprintf(temp_buffer,sizeof(temp_buffer)-1,"ndomod: Compression: %llu bytes in, %llu bytes out (%.2f:1), %lu blocks, %.3f ms CPU (%.3f ms/MB).",
+		 zstats.raw_bytes,zstats.compressed_bytes,
+		 (zstats.compressed_bytes>0)?((double)zstats.raw_bytes/zstats.compressed_bytes):0.0,
+		 zstats.blocks,(double)zstats.cpu_usec/1000.0,
+		 (zstats.raw_bytes>0)?((double)zstats.cpu_usec/1000.0/((double)zstats.raw_bytes/1048576.0)):0.0);
+	temp_buffer[sizeof(temp_buffer)-1]='\x0';
+	ndomod_write_to_logs(temp_buffer,NSLOG_INFO_MESSAGE);
 
-	/* an error occurred... */
-	if(result<0){
+	return;
+        }
 
-		/* sink problem! */
-		if(errno!=EAGAIN){
 
-			/* close the sink */
-			ndomod_close_sink();
+/* (re)open data sink */
+int ndomod_open_sink(void){
+	int flags=0;
 
-			time(&current_time);
-			ndomod_sink_last_reconnect_attempt=current_time;
-			ndomod_sink_last_reconnect_warning=current_time;
+	/* sink is already open... */
+	if(ndomod_sink_is_open==NDO_TRUE)
+		return ndomod_sink_fd;
 
-			asprintf(&temp_buffer,"ndomod: Error writing to data sink!  Some output may get lost...");
-			ndomod_write_to_logs(temp_buffer,NSLOG_INFO_MESSAGE);
-			free(temp_buffer);
-			asprintf(&temp_buffer,"ndomod: Please check remote ndo2db log, database connection or SSL Parameters");
-			ndomod_write_to_logs(temp_buffer,NSLOG_INFO_MESSAGE);
-			free(temp_buffer);
+#ifdef BUILD_NAGIOS_4X
+	/* connect to sockets in the background so an unreachable ndo2db can't stall the core (the writer thread can just block) */
+	if((ndomod_sink_type==NDO_SINK_TCPSOCKET || ndomod_sink_type==NDO_SINK_UNIXSOCKET || ndomod_sink_type==NDO_SINK_UNIXSEQPACKET) && use_ssl==NDO_FALSE && nagios_iobs!=NULL && ndomod_async_thread_running==NDO_FALSE)
+		return ndomod_open_sink_nonblocking();
+#endif
 
-			temp_buffer=NULL;
-		        }
+	/* the ring is mapped rather than opened */
+	if(ndomod_sink_type==NDO_SINK_SHM){
+		if((ndomod_shm=ndo_shm_attach(ndomod_sink_name))==NULL)
+			return NDO_ERROR;
+		ndomod_sink_fd=ndomod_shm->fd;
+		}
 
-		/***** BUFFER OUTPUT FOR LATER *****/
+	/* try and open sink */
+	else{
+		if(ndomod_sink_type==NDO_SINK_FILE)
+			flags=O_WRONLY|O_CREAT|O_APPEND;
+		if(ndo_sink_open(ndomod_sink_name,0,ndomod_sink_type,ndomod_sink_tcp_port,flags,&ndomod_sink_fd)==NDO_ERROR)
+			return NDO_ERROR;
+		}
 
-		if(buffer_write==NDO_TRUE)
-			ndomod_sink_buffer_push(&sinkbuf,buf);
+	/* mark the sink as being open */
+	ndomod_sink_is_open=NDO_TRUE;
 
-		return NDO_ERROR;
-	        }
+	/* mark the sink as having once been open */
+	ndomod_sink_previously_open=NDO_TRUE;
 
 	return NDO_OK;
         }
 
 
+#ifdef BUILD_NAGIOS_4X
+/* starts a non-blocking connect to a socket sink, finished by ndomod_sink_connect_handler() */
+int ndomod_open_sink_nonblocking(void){
+	struct sockaddr_in address;
+	time_t current_time;
+	int result=0;
+	int fd=-1;
+
+	time(&current_time);
+
+	/* the lookup blocks the core, so it is only done once in a while - and less often while it keeps failing */
+	if(ndomod_sink_type==NDO_SINK_TCPSOCKET && current_time>=ndomod_sink_address_next_lookup){
+		if(ndo_sink_resolve(ndomod_sink_name,ndomod_sink_tcp_port,&address)==NDO_OK){
+			ndomod_sink_address=address;
+			ndomod_sink_address_valid=NDO_TRUE;
+			ndomod_sink_address_retry=0L;
+			ndomod_sink_address_next_lookup=current_time+NDOMOD_SINK_ADDRESS_TTL;
+			}
+		else{
+			if(ndomod_sink_address_retry==0L)
+				ndomod_sink_address_retry=NDOMOD_SINK_ADDRESS_RETRY;
+			else if((ndomod_sink_address_retry*=2)>NDOMOD_SINK_ADDRESS_TTL)
+				ndomod_sink_address_retry=NDOMOD_SINK_ADDRESS_TTL;
+			ndomod_sink_address_next_lookup=current_time+ndomod_sink_address_retry;
+			}
+		}
 
-/* save unprocessed data to buffer file */
-int ndomod_save_unprocessed_data(char *f){
-	FILE *fp=NULL;
-	char *buf=NULL;
-	char *ebuf=NULL;
+	/* a failed lookup falls back on the last good address */
+	if(ndomod_sink_type==NDO_SINK_TCPSOCKET && ndomod_sink_address_valid==NDO_FALSE)
+		return NDO_ERROR;
 
-	/* no file */
-	if(f==NULL)
-		return NDO_OK;
+	result=ndo_sink_connect_nonblocking(ndomod_sink_name,ndomod_sink_type,&ndomod_sink_address,&fd);
 
-	/* open the file for writing */
-	if((fp=fopen(f,"w"))==NULL)
+	if(result==NDO_ERROR)
 		return NDO_ERROR;
 
-	/* save all buffered items */
-	while(ndomod_sink_buffer_items(&sinkbuf)>0){
-
-		/* get next item from buffer */
-		buf=ndomod_sink_buffer_pop(&sinkbuf);
+	/* let the core tell us when the connect is done */
+	if(result==NDO_SINK_CONNECTING){
+		if(iobroker_register_out(nagios_iobs,fd,NULL,ndomod_sink_connect_handler)<0){
+			close(fd);
+			return NDO_ERROR;
+			}
+		ndomod_sink_fd=fd;
+		ndomod_sink_connecting=NDO_TRUE;
+		ndomod_sink_connect_started=current_time;
+		ndomod_sink_connect_reconnect=ndomod_sink_previously_open;
+		return NDO_SINK_CONNECTING;
+		}
 
-		/* escape the string */
-		ebuf=ndo_escape_buffer(buf);
+	/* connected right away - the rest of the code expects a blocking socket */
+	fcntl(fd,F_SETFL,fcntl(fd,F_GETFL)&~O_NONBLOCK);
+	ndomod_sink_fd=fd;
+	ndomod_sink_is_open=NDO_TRUE;
+	ndomod_sink_previously_open=NDO_TRUE;
 
-		/* write string to file */
-		fputs(ebuf,fp);
-		fputs("\n",fp);
+	return NDO_OK;
+        }
 
-		/* free memory */
-		free(buf);
-		buf=NULL;
-		free(ebuf);
-		ebuf=NULL;
-		}
 
-	fclose(fp);
+/* finishes a non-blocking connect - called by the core's iobroker once the socket is writable */
+int ndomod_sink_connect_handler(int sd, int events, void *arg){
+	int error=0;
+	socklen_t len=sizeof(error);
 
-	return NDO_OK;
-	}
+	iobroker_unregister(nagios_iobs,sd);
+	ndomod_sink_connecting=NDO_FALSE;
 
+	if(getsockopt(sd,SOL_SOCKET,SO_ERROR,&error,&len)<0 || error!=0){
+		close(sd);
+		ndomod_sink_fd=-1;
+		ndomod_sink_connect_failed(ndomod_sink_connect_reconnect);
+		return 0;
+		}
 
+	fcntl(sd,F_SETFL,fcntl(sd,F_GETFL)&~O_NONBLOCK);
+	ndomod_sink_fd=sd;
+	ndomod_sink_is_open=NDO_TRUE;
+	ndomod_sink_previously_open=NDO_TRUE;
 
-/* load unprocessed data from buffer file */
-int ndomod_load_unprocessed_data(char *f){
-	ndo_mmapfile *thefile=NULL;
-	char *ebuf=NULL;
-	char *buf=NULL;
+	ndomod_sink_connected(ndomod_sink_connect_reconnect);
 
-	/* open the file */
-	if((thefile=ndo_mmap_fopen(f))==NULL)
-		return NDO_ERROR;
+	/* start on whatever was buffered while we waited */
+	if(ndomod_sink_is_open==NDO_TRUE && ndomod_backlog_pending()==NDO_TRUE)
+		ndomod_drain_backlog();
 
-	/* process each line of the file */
-	while((ebuf=ndo_mmap_fgets(thefile))){
+	return 0;
+        }
+#endif
 
-		/* unescape string */
-		buf=ndo_unescape_buffer(ebuf);
 
-		/* save the data to the sink buffer */
-		ndomod_sink_buffer_push(&sinkbuf,buf);
+/* gives up on a non-blocking connect */
+int ndomod_abort_sink_connect(void){
 
-		/* free memory */
-		free(ebuf);
-	        }
+	if(ndomod_sink_connecting==NDO_FALSE)
+		return NDO_OK;
 
-	/* close the file */
-	ndo_mmap_fclose(thefile);
+#ifdef BUILD_NAGIOS_4X
+	iobroker_unregister(nagios_iobs,ndomod_sink_fd);
+#endif
+	close(ndomod_sink_fd);
+	ndomod_sink_fd=-1;
+	ndomod_sink_connecting=NDO_FALSE;
 
-	/* remove the file so we don't process it again in the future */
-	unlink(f);
+	ndomod_sink_connect_failed(ndomod_sink_connect_reconnect);
 
 	return NDO_OK;
-	}
+        }
 
 
+/* logs a new sink connection and says hello */
+int ndomod_sink_connected(int reconnect){
+	char *temp_buffer=NULL;
 
-/* initializes sink buffer */
-int ndomod_sink_buffer_init(ndomod_sink_buffer *sbuf,unsigned long maxitems){
-	unsigned long x;
+	if(reconnect==NDO_TRUE){
+		asprintf(&temp_buffer,"ndomod: Successfully reconnected to data sink!  %lu items lost, %lu queued items to flush.",sinkbuf.overflow,sinkbuf.items);
+		ndomod_hello_sink(TRUE,TRUE);
+	        }
+	else{
+		if(sinkbuf.overflow==0L)
+			asprintf(&temp_buffer,"ndomod: Successfully connected to data sink.  %lu queued items to flush.",sinkbuf.items);
+		else
+			asprintf(&temp_buffer,"ndomod: Successfully connected to data sink.  %lu items lost, %lu queued items to flush.",sinkbuf.overflow,sinkbuf.items);
+		ndomod_hello_sink(FALSE,FALSE);
+	        }
 
-	if(sbuf==NULL || maxitems<=0)
-		return NDO_ERROR;
+	ndomod_write_to_logs(temp_buffer,NSLOG_INFO_MESSAGE);
+	free(temp_buffer);
+	temp_buffer=NULL;
 
-	/* allocate memory for the buffer */
-	if((sbuf->buffer=(char **)malloc(sizeof(char *)*maxitems))){
-		for(x=0;x<maxitems;x++)
-			sbuf->buffer[x]=NULL;
-	        }
+	if(reconnect==NDO_TRUE)
+		ndomod_sink_reconnects++;
 
-	sbuf->size=0L;
-	sbuf->head=0L;
-	sbuf->tail=0L;
-	sbuf->items=0L;
-	sbuf->maxitems=maxitems;
-	sbuf->overflow=0L;
+	/* reset sink overflow and backoff */
+	ndomod_sink_items_lost+=sinkbuf.overflow;
+	sinkbuf.overflow=0L;
+	ndomod_sink_reconnect_delay=ndomod_sink_reconnect_interval;
 
 	return NDO_OK;
         }
 
 
-/* deinitializes sink buffer */
-int ndomod_sink_buffer_deinit(ndomod_sink_buffer *sbuf){
-	unsigned long x;
+/* backs off after a failed connect and warns about it once in a while */
+int ndomod_sink_connect_failed(int reconnect){
+	char *temp_buffer=NULL;
+	time_t current_time;
 
-	if(sbuf==NULL)
-		return NDO_ERROR;
+	time(&current_time);
 
-	/* free any allocated memory */
-	for(x=0;x<sbuf->maxitems;x++)
-		free(sbuf->buffer[x]);
+	/* wait twice as long before the next attempt, up to reconnect_max_interval */
+	ndomod_sink_reconnect_delay*=2;
+	if(ndomod_sink_reconnect_delay>ndomod_sink_reconnect_max_interval)
+		ndomod_sink_reconnect_delay=ndomod_sink_reconnect_max_interval;
+	if(ndomod_sink_reconnect_delay<ndomod_sink_reconnect_interval)
+		ndomod_sink_reconnect_delay=ndomod_sink_reconnect_interval;
 
-	free(sbuf->buffer);
-	sbuf->buffer=NULL;
+	if((unsigned long)((unsigned long)current_time-ndomod_sink_reconnect_warning_interval)>(unsigned long)ndomod_sink_last_reconnect_warning){
+		if(reconnect==NDO_TRUE)
+			asprintf(&temp_buffer,"ndomod: Still unable to reconnect to data sink.  %lu items lost, %lu queued items to flush.",sinkbuf.overflow,sinkbuf.items);
+		else if(ndomod_sink_connect_attempt==1)
+			asprintf(&temp_buffer,"ndomod: Could not open data sink!  I'll keep trying, but some output may get lost...");
+		else
+			asprintf(&temp_buffer,"ndomod: Still unable to connect to data sink.  %lu items lost, %lu queued items to flush.",sinkbuf.overflow,sinkbuf.items);
+		ndomod_write_to_logs(temp_buffer,NSLOG_INFO_MESSAGE);
+		free(temp_buffer);
+		temp_buffer=NULL;
+
+		ndomod_sink_last_reconnect_warning=current_time;
+		}
 
 	return NDO_OK;
         }
 
 
-/* buffers output */
-int ndomod_sink_buffer_push(ndomod_sink_buffer *sbuf,char *buf){
+/* (re)open data sink */
+int ndomod_close_sink(void){
 
-	if(sbuf==NULL || buf==NULL)
-		return NDO_ERROR;
+	/* forget about a connect that is still in progress */
+	if(ndomod_sink_connecting==NDO_TRUE){
+#ifdef BUILD_NAGIOS_4X
+		iobroker_unregister(nagios_iobs,ndomod_sink_fd);
+#endif
+		close(ndomod_sink_fd);
+		ndomod_sink_fd=-1;
+		ndomod_sink_connecting=NDO_FALSE;
+		}
 
-	/* no space to store buffer */
-	if(sbuf->buffer==NULL || sbuf->items==sbuf->maxitems){
-		sbuf->overflow++;
-		return NDO_ERROR;
-	        }
+	/* sink is already closed... */
+	if(ndomod_sink_is_open==NDO_FALSE)
+		return NDO_OK;
 
-	/* store buffer */
-	sbuf->buffer[sbuf->head]=strdup(buf);
-	sbuf->head=(sbuf->head+1)%sbuf->maxitems;
-	sbuf->items++;
+	/* send whatever is still waiting in the batch */
+	if(ndomod_batch.used_size>0L){
+		ndomod_flush_output_batch();
 
-	return NDO_OK;
-        }
+		/* a failed flush closes the sink itself */
+		if(ndomod_sink_is_open==NDO_FALSE)
+			return NDO_OK;
+		}
 
+	/* send whatever is still waiting to be compressed */
+	if(ndomod_compression_active==NDO_TRUE){
+		ndomod_flush_compression_block();
 
-/* gets and removes next item from buffer */
-char *ndomod_sink_buffer_pop(ndomod_sink_buffer *sbuf){
-	char *buf=NULL;
+		/* a failed flush closes the sink itself */
+		if(ndomod_sink_is_open==NDO_FALSE)
+			return NDO_OK;
 
-	if(sbuf==NULL)
-		return NULL;
+		ndomod_compression_active=NDO_FALSE;
+		}
 
-	if(sbuf->buffer==NULL)
-		return NULL;
+	/* let the reader know we're gone */
+	if(ndomod_sink_type==NDO_SINK_SHM){
+		ndo_shm_detach(ndomod_shm);
+		ndomod_shm=NULL;
+		ndomod_sink_fd=-1;
+		}
 
-	if(sbuf->items==0)
-		return NULL;
+	else{
 
-	/* remove item from buffer */
-	buf=sbuf->buffer[sbuf->tail];
-	sbuf->buffer[sbuf->tail]=NULL;
-	sbuf->tail=(sbuf->tail+1)%sbuf->maxitems;
-	sbuf->items--;
+		/* flush sink */
+		ndo_sink_flush(ndomod_sink_fd);
 
-	return buf;
-        }
+		/* close sink */
+		ndo_sink_close(ndomod_sink_fd);
+		}
 
+	/* mark the sink as being closed */
+	ndomod_sink_is_open=NDO_FALSE;
 
-/* gets next items from buffer */
-char *ndomod_sink_buffer_peek(ndomod_sink_buffer *sbuf){
-	char *buf=NULL;
+	/* ndo2db throws away a partial item along with the connection, so the next one gets all of it */
+	sinkbuf.sent=0L;
 
-	if(sbuf==NULL)
-		return NULL;
+	return NDO_OK;
+        }
 
-	if(sbuf->buffer==NULL)
-		return NULL;
 
-	buf=sbuf->buffer[sbuf->tail];
+/* say hello */
+int ndomod_hello_sink(int reconnect, int problem_disconnect){
+	char temp_buffer[NDOMOD_MAX_BUFLEN];
+	char *connection_type=NULL;
+	char *connect_type=NULL;
+	int compress=NDO_FALSE;
 
-	return buf;
-        }
+	/* keep the writer thread's queued data from getting mixed in with the hello */
+	if(ndomod_async_thread_running==NDO_TRUE)
+		pthread_mutex_lock(&ndomod_sink_lock);
+
+	/* the hello always goes out uncompressed */
+	ndomod_compression_active=NDO_FALSE;
+
+	/* ndo2db may not have anything we sent before */
+	ndomod_sink_generation++;
+
+	/* compression only applies to socket sinks */
+#ifdef HAVE_ZLIB
+	if(ndomod_zstream_ready==NDO_TRUE && (ndomod_sink_type==NDO_SINK_TCPSOCKET || ndomod_sink_type==NDO_SINK_UNIXSOCKET))
+		compress=NDO_TRUE;
+#endif
+
+	/* get the connection type string */
+	if(ndomod_sink_type==NDO_SINK_FD || ndomod_sink_type==NDO_SINK_FILE)
+		connection_type=NDO_API_CONNECTION_FILE;
+	else if(ndomod_sink_type==NDO_SINK_TCPSOCKET)
+		connection_type=NDO_API_CONNECTION_TCPSOCKET;
+	else if(ndomod_sink_type==NDO_SINK_SHM)
+		connection_type=NDO_API_CONNECTION_SHM;
+	else if(ndomod_sink_type==NDO_SINK_UNIXSEQPACKET)
+		connection_type=NDO_API_CONNECTION_UNIXSEQPACKET;
+	else
+		connection_type=NDO_API_CONNECTION_UNIXSOCKET;
+
+	/* get the connect type string */
+	if(reconnect==TRUE && problem_disconnect==TRUE)
+		connect_type=NDO_API_CONNECTTYPE_RECONNECT;
+	else
+		connect_type=NDO_API_CONNECTTYPE_INITIAL;
+
+	snprintf(temp_buffer,sizeof(temp_buffer)-1
+		 ,"\n\n%s\n%s: %d\n%s: %s\n%s: %s\n%s: %lu\n%s: %s\n%s: %s\n%s: %s\n%s: %s\n%s: %lu\n%s%s%s%s%s\n%s"
+		 ,NDO_API_HELLO
+		 ,NDO_API_PROTOCOL
+		 ,ndomod_protocol_version
+		 ,NDO_API_AGENT
+		 ,NDOMOD_NAME
+		 ,NDO_API_AGENTVERSION
+		 ,NDOMOD_VERSION
+		 ,NDO_API_STARTTIME
+		 ,(unsigned long)time(NULL)
+		 ,NDO_API_DISPOSITION
+		 ,NDO_API_DISPOSITION_REALTIME
+		 ,NDO_API_CONNECTION
+		 ,connection_type
+		 ,NDO_API_CONNECTTYPE
+		 ,connect_type
+		 ,NDO_API_INSTANCENAME
+		 ,(ndomod_instance_name==NULL)?"default":ndomod_instance_name
+		 ,NDO_API_EVENTSSHED
+		 ,ndomod_events_shed()
+		 ,(ndomod_send_config_hashes==NDO_TRUE)?NDO_API_CONFIGHASHES": 1\n":""
+		 ,(compress==NDO_TRUE)?NDO_API_COMPRESSION:""
+		 ,(compress==NDO_TRUE)?": ":""
+		 ,(compress==NDO_TRUE)?NDO_API_COMPRESSION_ZLIB"\n":""
+		 ,NDO_API_STARTDATADUMP
+		 ,(compress==NDO_TRUE)?"":"\n"
+		);
+
+	temp_buffer[sizeof(temp_buffer)-1]='\x0';
+
+	ndomod_write_to_sink(temp_buffer,NDO_FALSE,NDO_FALSE);
+
+	/* everything after the STARTDATADUMP line is compressed */
+#ifdef HAVE_ZLIB
+	if(compress==NDO_TRUE && ndomod_sink_is_open==NDO_TRUE){
+		deflateReset(&ndomod_zstream);
+		ndo_dbuf_reset(&ndomod_zblock);
+		ndomod_compression_active=NDO_TRUE;
+		}
+#endif
+
+	if(ndomod_async_thread_running==NDO_TRUE)
+		pthread_mutex_unlock(&ndomod_sink_lock);
+
+	return NDO_OK;
+        }
+
+
+/* say goodbye */
+int ndomod_goodbye_sink(void){
+	char temp_buffer[NDOMOD_MAX_BUFLEN];
+
+	snprintf(temp_buffer,sizeof(temp_buffer)-1
+		 ,"\n%d\n%s: %lu\n%s\n\n"
+		 ,NDO_API_ENDDATADUMP
+		 ,NDO_API_ENDTIME
+		 ,(unsigned long)time(NULL)
+		 ,NDO_API_GOODBYE
+		 );
+
+	temp_buffer[sizeof(temp_buffer)-1]='\x0';
+
+	if(ndomod_async_thread_running==NDO_TRUE)
+		pthread_mutex_lock(&ndomod_sink_lock);
+	ndomod_write_to_sink(temp_buffer,NDO_FALSE,NDO_TRUE);
+	if(ndomod_async_thread_running==NDO_TRUE)
+		pthread_mutex_unlock(&ndomod_sink_lock);
+
+	return NDO_OK;
+        }
+
+
+/* used to rotate data sink file on a regular basis */
+int ndomod_rotate_sink_file(void *args){
+#ifdef BUILD_NAGIOS_2X
+	char raw_command_line[MAX_COMMAND_BUFFER];
+	char processed_command_line[MAX_COMMAND_BUFFER];
+#else
+	char *raw_command_line_3x=NULL;
+	char *processed_command_line_3x=NULL;
+#endif
+	int early_timeout=FALSE;
+	double exectime;
+
+	/* keep the async writer thread away from the sink while we rotate it */
+	if(ndomod_async_thread_running==NDO_TRUE)
+		pthread_mutex_lock(&ndomod_sink_lock);
+
+	/* close sink */
+	ndomod_goodbye_sink();
+	ndomod_close_sink();
+
+	/* we shouldn't write any data to the sink while we're rotating it... */
+	ndomod_allow_sink_activity=NDO_FALSE;
+
+
+	/****** ROTATE THE FILE *****/
+
+	/* get the raw command line */
+#ifdef BUILD_NAGIOS_2X
+	get_raw_command_line(ndomod_sink_rotation_command,raw_command_line,sizeof(raw_command_line),STRIP_ILLEGAL_MACRO_CHARS|ESCAPE_MACRO_CHARS);
+	strip(raw_command_line);
+#else
+	get_raw_command_line(find_command(ndomod_sink_rotation_command),ndomod_sink_rotation_command,&raw_command_line_3x,STRIP_ILLEGAL_MACRO_CHARS|ESCAPE_MACRO_CHARS);
+	strip(raw_command_line_3x);
+#endif
+
+	/* process any macros in the raw command line */
+#ifdef BUILD_NAGIOS_2X
+	process_macros(raw_command_line,processed_command_line,(int)sizeof(processed_command_line),STRIP_ILLEGAL_MACRO_CHARS|ESCAPE_MACRO_CHARS);
+#else
+	process_macros(raw_command_line_3x,&processed_command_line_3x,STRIP_ILLEGAL_MACRO_CHARS|ESCAPE_MACRO_CHARS);
+#endif
+
+	/* run the command */
+#ifdef BUILD_NAGIOS_2X
+	my_system(processed_command_line,ndomod_sink_rotation_timeout,&early_timeout,&exectime,NULL,0);
+#else
+	my_system(processed_command_line_3x,ndomod_sink_rotation_timeout,&early_timeout,&exectime,NULL,0);
+#endif
+
+
+	/* allow data to be written to the sink */
+	ndomod_allow_sink_activity=NDO_TRUE;
+
+	/* re-open sink */
+	ndomod_open_sink();
+	ndomod_hello_sink(TRUE,FALSE);
+
+	if(ndomod_async_thread_running==NDO_TRUE)
+		pthread_mutex_unlock(&ndomod_sink_lock);
+
+	return NDO_OK;
+        }
+
+
+/* writes data to sink */
+int ndomod_write_to_sink(char *buf, int buffer_write, int flush_buffer){
+	char *temp_buffer=NULL;
+	int buflen=0;
+	int result=NDO_OK;
+	time_t current_time;
+	int reconnect=NDO_FALSE;
+
+	/* we have nothing to write... */
+	if(buf==NULL)
+		return NDO_OK;
+
+	/* hand buffered writes off to the async writer thread */
+	if(buffer_write==NDO_TRUE && ndomod_async_thread_running==NDO_TRUE && !pthread_equal(pthread_self(),ndomod_async_thread))
+		return ndomod_queue_for_sink(buf);
+
+	/* we shouldn't be messing with things... */
+	if(ndomod_allow_sink_activity==NDO_FALSE)
+		return NDO_ERROR;
+
+	/* give up on a non-blocking connect that is taking too long */
+	if(ndomod_sink_connecting==NDO_TRUE && (unsigned long)(time(NULL)-ndomod_sink_connect_started)>=NDOMOD_SINK_CONNECT_TIMEOUT)
+		ndomod_abort_sink_connect();
+
+	/* open the sink if necessary... */
+	if(ndomod_sink_is_open==NDO_FALSE && ndomod_sink_connecting==NDO_FALSE){
+
+		time(&current_time);
+
+		/* are we reopening the sink? */
+		if(ndomod_sink_previously_open==NDO_TRUE)
+			reconnect=NDO_TRUE;
+
+		/* (re)connect to the sink if its time */
+		if((unsigned long)((unsigned long)current_time-ndomod_sink_reconnect_delay)>(unsigned long)ndomod_sink_last_reconnect_attempt){
+
+			result=ndomod_open_sink();
+
+			ndomod_sink_last_reconnect_attempt=current_time;
+
+			ndomod_sink_connect_attempt++;
+
+			/* sink was (re)opened... */
+			if(result==NDO_OK)
+				ndomod_sink_connected(reconnect);
+
+			/* sink could not be (re)opened... */
+			else if(result!=NDO_SINK_CONNECTING)
+				ndomod_sink_connect_failed(reconnect);
+			}
+	        }
+
+	/* we weren't able to (re)connect */
+	if(ndomod_sink_is_open==NDO_FALSE){
+
+		/***** BUFFER OUTPUT FOR LATER *****/
+
+		if(buffer_write==NDO_TRUE)
+			ndomod_buffer_output(buf);
+
+		return NDO_ERROR;
+	        }
+
+
+	/***** FLUSH BUFFERED DATA FIRST *****/
+
+	/* only part of a big backlog goes out each time, so Nagios isn't held up */
+	if(flush_buffer==NDO_TRUE && ndomod_backlog_pending()==NDO_TRUE && ndomod_drain_backlog()==NDO_ERROR){
+
+		/***** BUFFER ORIGINAL OUTPUT FOR LATER *****/
+
+		if(buffer_write==NDO_TRUE)
+			ndomod_buffer_output(buf);
+
+		return NDO_ERROR;
+	        }
+
+	/* new data doesn't wait for the rest of the backlog, so fresh data keeps flowing - ndo2db drops status older than what it has */
+	/* ...but it can't cut into an item that is only partly written */
+	if(buffer_write==NDO_TRUE && sinkbuf.sent>0L)
+		return ndomod_buffer_output(buf);
+
+
+	/***** WRITE ORIGINAL DATA *****/
+
+	/* write the data */
+	/* output that can't be buffered for later doesn't wait in a batch either */
+	buflen=strlen(buf);
+	result=ndomod_sink_send(buf,buflen,(buffer_write==NDO_TRUE)?NDO_FALSE:NDO_TRUE);
+
+	/* an error occurred... */
+	if(result<0){
+
+		/* sink problem! */
+		if(errno!=EAGAIN){
+
+			/* close the sink */
+			ndomod_close_sink();
+
+			time(&current_time);
+			ndomod_sink_last_reconnect_attempt=current_time;
+			ndomod_sink_last_reconnect_warning=current_time;
+
+			asprintf(&temp_buffer,"ndomod: Error writing to data sink!  Some output may get lost...");
+			ndomod_write_to_logs(temp_buffer,NSLOG_INFO_MESSAGE);
+			free(temp_buffer);
+			asprintf(&temp_buffer,"ndomod: Please check remote ndo2db log, database connection or SSL Parameters");
+			ndomod_write_to_logs(temp_buffer,NSLOG_INFO_MESSAGE);
+			free(temp_buffer);
+
+			temp_buffer=NULL;
+		        }
+
+		/***** BUFFER OUTPUT FOR LATER *****/
+
+		if(buffer_write==NDO_TRUE)
+			ndomod_buffer_output(buf);
+
+		return NDO_ERROR;
+	        }
+
+	return NDO_OK;
+        }
+
+
+
+/* is there buffered output waiting to be sent? */
+int ndomod_backlog_pending(void){
+
+	if(ndomod_sink_buffer_items(&sinkbuf)>0 || ndomod_spill_pending()==NDO_TRUE)
+		return NDO_TRUE;
+
+	return NDO_FALSE;
+        }
+
+
+/* sends the next slice of buffered output, sized by the drain limits and measured throughput */
+int ndomod_drain_backlog(void){
+	char *temp_buffer=NULL;
+	char *sbuf=NULL;
+	unsigned long sbuflen=0L;
+	int result=0;
+	time_t current_time;
+	struct timeval start_time;
+	struct timeval now;
+	unsigned long long elapsed=0L;
+	unsigned long long budget=0L;
+	unsigned long sent_items=0L;
+	unsigned long long sent_bytes=0L;
+	unsigned long high_items=0L;
+	unsigned long high_bytes=0L;
+	unsigned long long left_bytes=0L;
+	int from_spill=NDO_FALSE;
+	int replayed_spill=NDO_FALSE;
+	struct iovec iov[NDOMOD_BATCH_IOV_MAX];
+	unsigned long iov_bytes=0L;
+	int flush_items=0;
+	int x=0;
+
+	gettimeofday(&start_time,NULL);
+
+	/* a new drain starts */
+	if(ndomod_drain.active==NDO_FALSE){
+		ndomod_drain.active=NDO_TRUE;
+		ndomod_drain.items=0L;
+		ndomod_drain.bytes=0L;
+		ndomod_drain.started=start_time.tv_sec;
+		ndomod_drain.last_log=start_time.tv_sec;
+		}
+
+	/* how much we expect to get through in our time slice */
+	if(ndomod_backlog_drain_time>0L && ndomod_drain.rate>0.0)
+		budget=(unsigned long long)(ndomod_drain.rate*(double)ndomod_backlog_drain_time/1000.0);
+	if(ndomod_backlog_drain_bytes>0L && (budget==0L || budget>ndomod_backlog_drain_bytes))
+		budget=ndomod_backlog_drain_bytes;
+
+	/* memory buffer first, then anything that was spilled to disk after it */
+	while(1){
+
+		/* get next items from buffer */
+		from_spill=NDO_FALSE;
+		flush_items=1;
+		if(ndomod_output_batch_size>0L && ndomod_compression_active==NDO_FALSE && ndomod_sink_type!=NDO_SINK_SHM && (flush_items=ndomod_sink_buffer_peek_iov(&sinkbuf,iov,NDOMOD_BATCH_IOV_MAX,ndomod_output_batch_size))>0){
+
+			/* gather memory buffer items straight from the ring, after anything already batched */
+			for(iov_bytes=0L,x=0;x<flush_items;x++)
+				iov_bytes+=iov[x].iov_len;
+			if((result=ndomod_flush_output_batch())>=0)
+				result=ndo_sink_writev(ndomod_sink_fd,iov,flush_items);
+
+			/* what did go out before an error must not be sent again */
+			if(result>=0 && (unsigned long)result<iov_bytes){
+				ndomod_sink_buffer_consume(&sinkbuf,(unsigned long)result);
+				result=NDO_ERROR;
+				}
+			}
+		else{
+			flush_items=1;
+			if((sbuf=ndomod_sink_buffer_peek(&sinkbuf,&sbuflen))!=NULL){
+				sbuf+=sinkbuf.sent;
+				sbuflen-=sinkbuf.sent;
+				}
+			else{
+				if((sbuf=ndomod_spill_peek(&sbuflen))==NULL)
+					break;
+				from_spill=NDO_TRUE;
+				}
+
+			result=ndomod_sink_send(sbuf,(int)sbuflen,NDO_FALSE);
+			}
+
+		/* an error occurred... */
+		if(result<0){
+
+			/* sink problem! */
+			if(errno!=EAGAIN){
+
+				/* close the sink */
+				ndomod_close_sink();
+
+				asprintf(&temp_buffer,"ndomod: Error writing to data sink!  Some output may get lost.  %lu queued items to flush.",sinkbuf.items);
+				ndomod_write_to_logs(temp_buffer,NSLOG_INFO_MESSAGE);
+				free(temp_buffer);
+				temp_buffer=NULL;
+
+				time(&current_time);
+				ndomod_sink_last_reconnect_attempt=current_time;
+				ndomod_sink_last_reconnect_warning=current_time;
+				}
+
+			ndomod_drain.active=NDO_FALSE;
+
+			return NDO_ERROR;
+			}
+
+		/* buffer was written okay, so remove it from buffer */
+		if(from_spill==NDO_TRUE){
+			ndomod_spill_pop(sbuflen);
+			replayed_spill=NDO_TRUE;
+			}
+		else{
+			for(x=0;x<flush_items;x++)
+				ndomod_sink_buffer_pop(&sinkbuf);
+			}
+		sent_items+=flush_items;
+		sent_bytes+=(unsigned long long)result;
+
+		/* stop once this slice is used up */
+		if(ndomod_backlog_drain_items>0L && sent_items>=ndomod_backlog_drain_items)
+			break;
+		if(budget>0L && sent_bytes>=budget)
+			break;
+		if(ndomod_backlog_drain_time>0L){
+			gettimeofday(&now,NULL);
+			elapsed=(unsigned long long)(now.tv_sec-start_time.tv_sec)*1000000L+(now.tv_usec-start_time.tv_usec);
+			if(elapsed>=(unsigned long long)ndomod_backlog_drain_time*1000L)
+				break;
+			}
+		}
+
+	/* keep a running estimate of how fast the sink takes data */
+	gettimeofday(&now,NULL);
+	elapsed=(unsigned long long)(now.tv_sec-start_time.tv_sec)*1000000L+(now.tv_usec-start_time.tv_usec);
+	if(sent_bytes>0L && elapsed>0L){
+		if(ndomod_drain.rate>0.0)
+			ndomod_drain.rate=(ndomod_drain.rate*0.7)+(((double)sent_bytes*1000000.0/(double)elapsed)*0.3);
+		else
+			ndomod_drain.rate=(double)sent_bytes*1000000.0/(double)elapsed;
+		}
+
+	ndomod_drain.items+=sent_items;
+	ndomod_drain.bytes+=sent_bytes;
+
+	if(replayed_spill==NDO_TRUE && ndomod_spill_pending()==NDO_FALSE)
+		ndomod_log_spill_stats();
+
+	/* all caught up */
+	if(ndomod_backlog_pending()==NDO_FALSE){
+
+		ndomod_sink_buffer_get_highwater(&sinkbuf,&high_items,&high_bytes);
+		asprintf(&temp_buffer,"ndomod: Successfully flushed %lu queued items to data sink in %lu seconds.  Buffer high-water mark: %lu items, %lu bytes.",ndomod_drain.items,(unsigned long)(now.tv_sec-ndomod_drain.started),high_items,high_bytes);
+		ndomod_write_to_logs(temp_buffer,NSLOG_INFO_MESSAGE);
+		free(temp_buffer);
+		temp_buffer=NULL;
+
+		ndomod_drain.active=NDO_FALSE;
+
+		return NDO_OK;
+		}
+
+	/* let people know how far behind we are */
+	if((unsigned long)(now.tv_sec-ndomod_drain.last_log)>=NDOMOD_DRAIN_LOG_INTERVAL){
+
+		left_bytes=(unsigned long long)ndomod_sink_buffer_bytes(&sinkbuf)+spillq.disk_bytes;
+		asprintf(&temp_buffer,"ndomod: Flushing queued items to data sink: %lu items sent, %lu items in memory and %llu bytes in total left, %.1f KB/s, about %lu seconds to catch up.",ndomod_drain.items,sinkbuf.items,left_bytes,ndomod_drain.rate/1024.0,(ndomod_drain.rate>0.0)?(unsigned long)((double)left_bytes/ndomod_drain.rate):0L);
+		ndomod_write_to_logs(temp_buffer,NSLOG_INFO_MESSAGE);
+		free(temp_buffer);
+		temp_buffer=NULL;
+
+		ndomod_drain.last_log=now.tv_sec;
+		}
+
+	return NDO_OK;
+        }
+
+
+/* keeps the backlog moving when no new data comes in - runs as a Nagios timed event */
+int ndomod_check_backlog(void *args){
+
+	/* the writer thread does this itself */
+	if(ndomod_async_thread_running==NDO_TRUE)
+		return NDO_OK;
+
+	if(ndomod_sink_is_open==NDO_TRUE && ndomod_backlog_pending()==NDO_TRUE)
+		ndomod_drain_backlog();
+
+	return NDO_OK;
+        }
+
+
+
+/* save unprocessed data to buffer file */
+int ndomod_save_unprocessed_data(char *f){
+	FILE *fp=NULL;
+	char *buf=NULL;
+	char *ebuf=NULL;
+	int ebuf_allocated=NDO_FALSE;
+
+	/* no file */
+	if(f==NULL)
+		return NDO_OK;
+
+	/* open the file for writing */
+	if((fp=fopen(f,"w"))==NULL)
+		return NDO_ERROR;
+
+	/* save all buffered items */
+	while(ndomod_sink_buffer_items(&sinkbuf)>0){
+
+		/* get next item from buffer */
+		buf=ndomod_sink_buffer_peek(&sinkbuf,NULL);
+
+		/* escape the string */
+		ebuf=ndo_escape_buffer(buf,&ebuf_allocated);
+
+		/* write string to file */
+		fputs(ebuf,fp);
+		fputs("\n",fp);
+
+		/* free memory */
+		if(ebuf_allocated==NDO_TRUE)
+			free(ebuf);
+		ebuf=NULL;
+
+		ndomod_sink_buffer_pop(&sinkbuf);
+		}
+
+	fclose(fp);
+
+	return NDO_OK;
+	}
+
+
+
+/* load unprocessed data from buffer file */
+int ndomod_load_unprocessed_data(char *f){
+	ndo_mmapfile *thefile=NULL;
+	char *ebuf=NULL;
+	char *buf=NULL;
+
+	/* open the file */
+	if((thefile=ndo_mmap_fopen(f))==NULL)
+		return NDO_ERROR;
+
+	/* process each line of the file */
+	while((ebuf=ndo_mmap_fgets(thefile))){
+
+		/* unescape string */
+		buf=ndo_unescape_buffer(ebuf);
+
+		/* save the data to the sink buffer */
+		ndomod_sink_buffer_push(&sinkbuf,buf);
+
+		/* free memory */
+		free(ebuf);
+	        }
+
+	/* close the file */
+	ndo_mmap_fclose(thefile);
+
+	/* remove the file so we don't process it again in the future */
+	unlink(f);
+
+	return NDO_OK;
+	}
+
+
+
+/* initializes sink buffer */
+int ndomod_sink_buffer_init(ndomod_sink_buffer *sbuf,unsigned long maxitems,unsigned long maxbytes){
+
+	if(sbuf==NULL || maxitems<=0)
+		return NDO_ERROR;
+
+	/* keep records aligned so a header never straddles the end of the ring */
+	maxbytes-=(maxbytes%NDOMOD_SINK_BUFFER_ALIGN);
+
+	/* allocate memory for the buffer - all of it up front */
+	sbuf->buffer=NULL;
+	if(maxbytes>0)
+		sbuf->buffer=(char *)malloc(maxbytes);
+
+	sbuf->size=(sbuf->buffer==NULL)?0L:maxbytes;
+	sbuf->head=0L;
+	sbuf->tail=0L;
+	sbuf->used=0L;
+	sbuf->items=0L;
+	sbuf->maxitems=maxitems;
+	sbuf->sent=0L;
+	sbuf->overflow=0L;
+	sbuf->high_items=0L;
+	sbuf->high_bytes=0L;
+
+	return NDO_OK;
+        }
+
+
+/* deinitializes sink buffer */
+int ndomod_sink_buffer_deinit(ndomod_sink_buffer *sbuf){
+
+	if(sbuf==NULL)
+		return NDO_ERROR;
+
+	free(sbuf->buffer);
+	sbuf->buffer=NULL;
+	sbuf->size=0L;
+	sbuf->head=0L;
+	sbuf->tail=0L;
+	sbuf->used=0L;
+	sbuf->items=0L;
+
+	return NDO_OK;
+        }
+
+
+/* buffers output */
+int ndomod_sink_buffer_push(ndomod_sink_buffer *sbuf,char *buf){
+	unsigned long len=0L;
+	unsigned long reclen=0L;
+	uint32_t hdr=0;
+
+	if(sbuf==NULL || buf==NULL)
+		return NDO_ERROR;
+
+	len=strlen(buf);
+
+	/* header + data + terminating NUL, rounded up to the record alignment */
+	reclen=sizeof(uint32_t)+len+1;
+	reclen+=(NDOMOD_SINK_BUFFER_ALIGN-(reclen%NDOMOD_SINK_BUFFER_ALIGN))%NDOMOD_SINK_BUFFER_ALIGN;
+
+	if(sbuf->buffer==NULL || sbuf->items>=sbuf->maxitems || reclen>sbuf->size || len>=NDOMOD_SINK_BUFFER_PAD){
+		sbuf->overflow++;
+		return NDO_ERROR;
+	        }
+
+	/* records never wrap, so find a contiguous spot for this one */
+	if(sbuf->used==0L){
+		sbuf->head=0L;
+		sbuf->tail=0L;
+	        }
+	else if(sbuf->head>sbuf->tail){
+		if(reclen>sbuf->size-sbuf->head){
+
+			/* not enough room at the end - pad it out and start over at the front */
+			if(reclen>sbuf->tail){
+				sbuf->overflow++;
+				return NDO_ERROR;
+			        }
+			hdr=NDOMOD_SINK_BUFFER_PAD;
+			memcpy(sbuf->buffer+sbuf->head,&hdr,sizeof(hdr));
+			sbuf->used+=sbuf->size-sbuf->head;
+			sbuf->head=0L;
+		        }
+	        }
+	else if(reclen>sbuf->tail-sbuf->head){
+		sbuf->overflow++;
+		return NDO_ERROR;
+	        }
+
+	/* store record */
+	hdr=(uint32_t)len;
+	memcpy(sbuf->buffer+sbuf->head,&hdr,sizeof(hdr));
+	memcpy(sbuf->buffer+sbuf->head+sizeof(hdr),buf,len+1);
+	sbuf->head+=reclen;
+	if(sbuf->head==sbuf->size)
+		sbuf->head=0L;
+	sbuf->used+=reclen;
+	sbuf->items++;
+
+	/* remember high-water marks */
+	if(sbuf->items>sbuf->high_items)
+		sbuf->high_items=sbuf->items;
+	if(sbuf->used>sbuf->high_bytes)
+		sbuf->high_bytes=sbuf->used;
+
+	return NDO_OK;
+        }
+
+
+/* points iovecs at the next items in the buffer without removing them, returns how many */
+int ndomod_sink_buffer_peek_iov(ndomod_sink_buffer *sbuf,struct iovec *iov,int maxitems,unsigned long maxbytes){
+	unsigned long pos=0L;
+	unsigned long bytes=0L;
+	unsigned long reclen=0L;
+	unsigned long x=0L;
+	uint32_t hdr=0;
+	int items=0;
+
+	if(sbuf==NULL || sbuf->buffer==NULL || iov==NULL)
+		return 0;
+
+	pos=sbuf->tail;
+	for(x=0;x<sbuf->items && items<maxitems;x++){
+
+		/* skip the padding at the end of the ring */
+		if(pos==sbuf->size)
+			pos=0L;
+		memcpy(&hdr,sbuf->buffer+pos,sizeof(hdr));
+		if(hdr==NDOMOD_SINK_BUFFER_PAD){
+			pos=0L;
+			memcpy(&hdr,sbuf->buffer+pos,sizeof(hdr));
+			}
+
+		/* always return at least one item */
+		if(items>0 && bytes+hdr>maxbytes)
+			break;
+
+		iov[items].iov_base=sbuf->buffer+pos+sizeof(hdr);
+		iov[items].iov_len=hdr;
+
+		/* pick up where a short write left off */
+		if(items==0){
+			iov[items].iov_base=(char *)iov[items].iov_base+sbuf->sent;
+			iov[items].iov_len-=sbuf->sent;
+			}
+
+		bytes+=iov[items].iov_len;
+		items++;
+
+		reclen=sizeof(uint32_t)+hdr+1;
+		reclen+=(NDOMOD_SINK_BUFFER_ALIGN-(reclen%NDOMOD_SINK_BUFFER_ALIGN))%NDOMOD_SINK_BUFFER_ALIGN;
+		pos+=reclen;
+		}
+
+	return items;
+        }
+
+
+/* removes next item from buffer */
+int ndomod_sink_buffer_pop(ndomod_sink_buffer *sbuf){
+	unsigned long reclen=0L;
+	uint32_t hdr=0;
+
+	if(sbuf==NULL || sbuf->buffer==NULL)
+		return NDO_ERROR;
+
+	if(sbuf->items==0)
+		return NDO_ERROR;
+
+	memcpy(&hdr,sbuf->buffer+sbuf->tail,sizeof(hdr));
+	reclen=sizeof(uint32_t)+hdr+1;
+	reclen+=(NDOMOD_SINK_BUFFER_ALIGN-(reclen%NDOMOD_SINK_BUFFER_ALIGN))%NDOMOD_SINK_BUFFER_ALIGN;
+
+	sbuf->tail+=reclen;
+	sbuf->used-=reclen;
+	sbuf->items--;
+	sbuf->sent=0L;
+
+	if(sbuf->items==0){
+		sbuf->head=0L;
+		sbuf->tail=0L;
+		sbuf->used=0L;
+		return NDO_OK;
+	        }
+
+	/* skip the padding at the end of the ring */
+	if(sbuf->tail<sbuf->size)
+		memcpy(&hdr,sbuf->buffer+sbuf->tail,sizeof(hdr));
+	if(sbuf->tail==sbuf->size || hdr==NDOMOD_SINK_BUFFER_PAD){
+		sbuf->used-=sbuf->size-sbuf->tail;
+		sbuf->tail=0L;
+	        }
+
+	return NDO_OK;
+        }
+
+
+/* marks bytes at the front of the buffer as written, removing the items that went out in full */
+int ndomod_sink_buffer_consume(ndomod_sink_buffer *sbuf,unsigned long bytes){
+	unsigned long len=0L;
+
+	while(bytes>0L && ndomod_sink_buffer_peek(sbuf,&len)!=NULL){
+
+		/* only part of this one made it */
+		if(bytes<len-sbuf->sent){
+			sbuf->sent+=bytes;
+			break;
+			}
+
+		bytes-=len-sbuf->sent;
+		ndomod_sink_buffer_pop(sbuf);
+		}
+
+	return NDO_OK;
+        }
+
+
+/* gets next item from buffer without removing it */
+char *ndomod_sink_buffer_peek(ndomod_sink_buffer *sbuf,unsigned long *len){
+	uint32_t hdr=0;
+
+	if(sbuf==NULL || sbuf->buffer==NULL)
+		return NULL;
+
+	if(sbuf->items==0)
+		return NULL;
+
+	memcpy(&hdr,sbuf->buffer+sbuf->tail,sizeof(hdr));
+	if(len!=NULL)
+		*len=(unsigned long)hdr;
+
+	return sbuf->buffer+sbuf->tail+sizeof(hdr);
+        }
 
 
 /* returns number of items buffered */
 int ndomod_sink_buffer_items(ndomod_sink_buffer *sbuf){
 
-	if(sbuf==NULL)
-		return 0;
-	else
-		return sbuf->items;
+	if(sbuf==NULL)
+		return 0;
+	else
+		return sbuf->items;
+        }
+
+
+/* returns number of bytes buffered */
+unsigned long ndomod_sink_buffer_bytes(ndomod_sink_buffer *sbuf){
+
+	if(sbuf==NULL)
+		return 0L;
+	else
+		return sbuf->used;
+        }
+
+
+/* gets the most items and bytes that have been buffered at once */
+int ndomod_sink_buffer_get_highwater(ndomod_sink_buffer *sbuf,unsigned long *items,unsigned long *bytes){
+
+	if(sbuf==NULL)
+		return NDO_ERROR;
+
+	if(items!=NULL)
+		*items=sbuf->high_items;
+	if(bytes!=NULL)
+		*bytes=sbuf->high_bytes;
+
+	return NDO_OK;
+        }
+
+
+/* gets number of items lost due to buffer overflow */
+unsigned long ndomod_sink_buffer_get_overflow(ndomod_sink_buffer *sbuf){
+
+	if(sbuf==NULL)
+		return 0;
+	else
+		return sbuf->overflow;
+        }
+
+
+/* sets number of items lost due to buffer overflow */
+int ndomod_sink_buffer_set_overflow(ndomod_sink_buffer *sbuf, unsigned long num){
+
+	if(sbuf==NULL)
+		return 0;
+	else
+		sbuf->overflow=num;
+
+	return sbuf->overflow;
+        }
+
+
+/****************************************************************************/
+/* SPILL QUEUE FUNCTIONS                                                    */
+/****************************************************************************/
+
+/* builds the path of a spill segment */
+static char *ndomod_spill_segment_name(unsigned long seq){
+	char *name=NULL;
+
+	if(asprintf(&name,"%s/%s%010lu",ndomod_spill_dir,NDOMOD_SPILL_PREFIX,seq)==-1)
+		name=NULL;
+
+	return name;
+        }
+
+
+/* picks up segments left over from a previous run */
+int ndomod_spill_init(void){
+	DIR *dir=NULL;
+	struct dirent *de=NULL;
+	struct stat st;
+	char *name=NULL;
+	unsigned long seq=0L;
+	unsigned long min_seq=0L;
+	unsigned long max_seq=0L;
+	int found=NDO_FALSE;
+	char *temp_buffer=NULL;
+
+	spillq.read_seq=0L;
+	spillq.next_seq=0L;
+	spillq.segments=0L;
+	spillq.write_fd=-1;
+	spillq.write_size=0L;
+	spillq.map=NULL;
+	spillq.map_size=0L;
+	spillq.read_offset=0L;
+	spillq.disk_bytes=0L;
+	spillq.spilled_bytes=0L;
+	spillq.replayed_bytes=0L;
+	spillq.segments_deleted=0L;
+	spillq.dropped=0L;
+
+	if(ndomod_spill_dir==NULL)
+		return NDO_OK;
+
+	if((dir=opendir(ndomod_spill_dir))==NULL){
+		asprintf(&temp_buffer,"ndomod: Could not open spill directory '%s', spilling to disk is disabled.",ndomod_spill_dir);
+		ndomod_write_to_logs(temp_buffer,NSLOG_INFO_MESSAGE);
+		free(temp_buffer);
+		my_free(ndomod_spill_dir);
+		return NDO_ERROR;
+	        }
+
+	while((de=readdir(dir))!=NULL){
+
+		if(strncmp(de->d_name,NDOMOD_SPILL_PREFIX,strlen(NDOMOD_SPILL_PREFIX)))
+			continue;
+
+		seq=strtoul(de->d_name+strlen(NDOMOD_SPILL_PREFIX),NULL,10);
+
+		if((name=ndomod_spill_segment_name(seq))==NULL)
+			continue;
+		if(stat(name,&st)==0)
+			spillq.disk_bytes+=(unsigned long long)st.st_size;
+		free(name);
+
+		if(found==NDO_FALSE || seq<min_seq)
+			min_seq=seq;
+		if(found==NDO_FALSE || seq>max_seq)
+			max_seq=seq;
+		found=NDO_TRUE;
+	        }
+
+	closedir(dir);
+
+	/* missing segments in the range are skipped during replay */
+	if(found==NDO_TRUE){
+		spillq.read_seq=min_seq;
+		spillq.next_seq=max_seq+1;
+		spillq.segments=max_seq-min_seq+1;
+
+		asprintf(&temp_buffer,"ndomod: Found %lu spilled segments (%llu bytes) to replay.",spillq.segments,spillq.disk_bytes);
+		ndomod_write_to_logs(temp_buffer,NSLOG_INFO_MESSAGE);
+		free(temp_buffer);
+	        }
+
+	return NDO_OK;
+        }
+
+
+/* closes the spill queue - segments stay on disk for the next run */
+int ndomod_spill_deinit(void){
+
+	if(spillq.write_fd>=0){
+		fsync(spillq.write_fd);
+		close(spillq.write_fd);
+		spillq.write_fd=-1;
+	        }
+
+	if(spillq.map!=NULL){
+		munmap(spillq.map,spillq.map_size);
+		spillq.map=NULL;
+	        }
+
+	return NDO_OK;
+        }
+
+
+/* is there spilled data waiting to be replayed? */
+int ndomod_spill_pending(void){
+
+	return (spillq.segments>0)?NDO_TRUE:NDO_FALSE;
+        }
+
+
+/* appends a record to the newest segment */
+int ndomod_spill_push(char *buf,unsigned long len){
+	char *name=NULL;
+	uint32_t hdr=0;
+	struct iovec iov[2];
+	ssize_t result=0;
+
+	if(ndomod_spill_dir==NULL || buf==NULL)
+		return NDO_ERROR;
+
+	/* stay within the disk quota */
+	if(spillq.disk_bytes+sizeof(hdr)+len>ndomod_spill_max_bytes || len>=NDOMOD_SINK_BUFFER_PAD){
+		spillq.dropped++;
+		return NDO_ERROR;
+	        }
+
+	/* start a new segment if needed */
+	if(spillq.write_fd<0 || (spillq.write_size>0 && spillq.write_size+sizeof(hdr)+len>ndomod_spill_segment_size)){
+
+		if(spillq.write_fd>=0){
+			/* sync the full segment for an outage, but don't stall nagios while the sink is up - it gets replayed soon */
+			if(ndomod_sink_is_open==NDO_FALSE || (ndomod_async_thread_running==NDO_TRUE && pthread_equal(pthread_self(),ndomod_async_thread)))
+				fsync(spillq.write_fd);
+			close(spillq.write_fd);
+			spillq.write_fd=-1;
+		        }
+
+		if((name=ndomod_spill_segment_name(spillq.next_seq))==NULL){
+			spillq.dropped++;
+			return NDO_ERROR;
+		        }
+		spillq.write_fd=open(name,O_WRONLY|O_CREAT|O_TRUNC|O_APPEND,S_IRUSR|S_IWUSR);
+		free(name);
+
+		if(spillq.write_fd<0){
+			spillq.dropped++;
+			return NDO_ERROR;
+		        }
+
+		if(spillq.segments==0)
+			spillq.read_seq=spillq.next_seq;
+		spillq.next_seq++;
+		spillq.segments++;
+		spillq.write_size=0L;
+	        }
+
+	hdr=(uint32_t)len;
+	iov[0].iov_base=&hdr;
+	iov[0].iov_len=sizeof(hdr);
+	iov[1].iov_base=buf;
+	iov[1].iov_len=len;
+
+	result=writev(spillq.write_fd,iov,2);
+
+	/* a short write leaves a truncated record, which replay ignores */
+	if(result>0){
+		spillq.write_size+=(unsigned long)result;
+		spillq.disk_bytes+=(unsigned long long)result;
+		}
+	if(result!=(ssize_t)(sizeof(hdr)+len)){
+		spillq.dropped++;
+		return NDO_ERROR;
+	        }
+
+	spillq.spilled_bytes+=len;
+
+	return NDO_OK;
+        }
+
+
+/* gets the next spilled record without removing it */
+char *ndomod_spill_peek(unsigned long *len){
+	char *name=NULL;
+	struct stat st;
+	uint32_t hdr=0;
+	int fd=-1;
+
+	while(spillq.segments>0){
+
+		/* map the oldest segment */
+		if(spillq.map==NULL){
+
+			/* don't read a segment that is still being written */
+			if(spillq.read_seq==spillq.next_seq-1 && spillq.write_fd>=0){
+				close(spillq.write_fd);
+				spillq.write_fd=-1;
+			        }
+
+			spillq.read_offset=0L;
+			spillq.map_size=0L;
+
+			if((name=ndomod_spill_segment_name(spillq.read_seq))==NULL)
+				return NULL;
+			if((fd=open(name,O_RDONLY))>=0){
+				if(fstat(fd,&st)==0 && st.st_size>0){
+					spillq.map=(char *)mmap(NULL,(size_t)st.st_size,PROT_READ,MAP_SHARED,fd,0);
+					if(spillq.map==MAP_FAILED)
+						spillq.map=NULL;
+					else
+						spillq.map_size=(unsigned long)st.st_size;
+				        }
+				close(fd);
+			        }
+			free(name);
+		        }
+
+		/* return the next complete record in the segment */
+		if(spillq.map!=NULL && spillq.read_offset+sizeof(hdr)<=spillq.map_size){
+			memcpy(&hdr,spillq.map+spillq.read_offset,sizeof(hdr));
+			if(spillq.read_offset+sizeof(hdr)+hdr<=spillq.map_size){
+				*len=(unsigned long)hdr;
+				return spillq.map+spillq.read_offset+sizeof(hdr);
+			        }
+		        }
+
+		/* this segment has been fully sent, so get rid of it */
+		if(spillq.map!=NULL){
+			munmap(spillq.map,spillq.map_size);
+			spillq.map=NULL;
+		        }
+		if((name=ndomod_spill_segment_name(spillq.read_seq))!=NULL){
+			if(stat(name,&st)==0)
+				spillq.disk_bytes-=((unsigned long long)st.st_size<spillq.disk_bytes)?(unsigned long long)st.st_size:spillq.disk_bytes;
+			unlink(name);
+			free(name);
+		        }
+		spillq.segments_deleted++;
+		spillq.read_seq++;
+		spillq.segments--;
+	        }
+
+	return NULL;
+        }
+
+
+/* removes the record returned by the last peek */
+int ndomod_spill_pop(unsigned long len){
+
+	if(spillq.map==NULL)
+		return NDO_ERROR;
+
+	spillq.read_offset+=sizeof(uint32_t)+len;
+	spillq.replayed_bytes+=len;
+
+	return NDO_OK;
+        }
+
+
+/* logs spill queue counters */
+void ndomod_log_spill_stats(void){
+	char *temp_buffer=NULL;
+
+	if(ndomod_spill_dir==NULL)
+		return;
+
+	asprintf(&temp_buffer,"ndomod: Spill queue: %llu bytes spilled, %llu bytes replayed, %lu segments deleted, %lu items dropped, %lu segments (%llu bytes) on disk.",spillq.spilled_bytes,spillq.replayed_bytes,spillq.segments_deleted,spillq.dropped,spillq.segments,spillq.disk_bytes);
+	ndomod_write_to_logs(temp_buffer,NSLOG_INFO_MESSAGE);
+	free(temp_buffer);
+
+	return;
+        }
+
+
+/* buffers output for later - in memory, or on disk once memory fills up */
+int ndomod_buffer_output(char *buf){
+	unsigned long len=0L;
+	unsigned long threshold=0L;
+
+	if(buf==NULL)
+		return NDO_ERROR;
+
+	if(ndomod_spill_dir!=NULL){
+
+		len=strlen(buf);
+
+		/* spill once the memory buffer passes the threshold (default is 3/4 full) */
+		threshold=(ndomod_spill_threshold>0L)?ndomod_spill_threshold:(sinkbuf.size/4)*3;
+
+		/* once something is on disk everything newer goes there too, so ordering is kept */
+		if(ndomod_spill_pending()==NDO_TRUE || sinkbuf.items>=sinkbuf.maxitems || ndomod_sink_buffer_bytes(&sinkbuf)+len>=threshold)
+			return ndomod_spill_push(buf,len);
+	        }
+
+	return ndomod_sink_buffer_push(&sinkbuf,buf);
+        }
+
+
+
+/****************************************************************************/
+/* ASYNC WRITER FUNCTIONS                                                   */
+/****************************************************************************/
+
+/* initializes async queue */
+int ndomod_async_queue_init(ndomod_async_queue *q,unsigned long size){
+
+	if(q==NULL || size<=0)
+		return NDO_ERROR;
+
+	/* every item starts on an aligned boundary, so the end of the ring must be one too */
+	size&=~7UL;
+
+	if((q->buffer=(char *)malloc(size))==NULL)
+		return NDO_ERROR;
+
+	q->size=size;
+	q->head=0L;
+	q->tail=0L;
+	q->high_water=0L;
+	q->enqueued=0L;
+	q->dequeued=0L;
+	q->dropped=0L;
+	q->waits=0L;
+	q->wait_usec=0L;
+	q->max_wait_usec=0L;
+
+	return NDO_OK;
+        }
+
+
+/* deinitializes async queue */
+int ndomod_async_queue_deinit(ndomod_async_queue *q){
+
+	if(q==NULL || q->buffer==NULL)
+		return NDO_ERROR;
+
+	free(q->buffer);
+	q->buffer=NULL;
+
+	return NDO_OK;
+        }
+
+
+/* number of items waiting in the queue */
+unsigned long ndomod_async_queue_depth(ndomod_async_queue *q){
+
+	if(q==NULL)
+		return 0L;
+
+	return q->enqueued-__atomic_load_n(&q->dequeued,__ATOMIC_RELAXED);
+        }
+
+
+/* copies an item into the queue - only ever called by the core thread */
+int ndomod_async_queue_push(ndomod_async_queue *q,char *buf,unsigned long len){
+	unsigned long need=NDOMOD_ASYNC_ITEM_SIZE(len);
+	unsigned long skip=0L;
+	unsigned long used=0L;
+	unsigned long head=0L;
+	unsigned long pos=0L;
+
+	if(q==NULL || q->buffer==NULL || buf==NULL)
+		return NDO_ERROR;
+
+	/* our own head needs no ordering, the tail is acquired so the writer is done with the space it gave back */
+	head=q->head;
+	used=head-__atomic_load_n(&q->tail,__ATOMIC_ACQUIRE);
+	pos=head%q->size;
+
+	/* items never wrap, so one that won't fit before the end of the ring starts over at the front */
+	if(pos+need>q->size)
+		skip=q->size-pos;
+
+	if(skip+need>q->size-used)
+		return NDO_ERROR;
+
+	if(skip>0L){
+		*(unsigned long *)(q->buffer+pos)=NDOMOD_ASYNC_SKIP;
+		pos=0L;
+		}
+
+	*(unsigned long *)(q->buffer+pos)=len;
+	memcpy(q->buffer+pos+sizeof(unsigned long),buf,len);
+	q->buffer[pos+sizeof(unsigned long)+len]='\x0';
+
+	/* publishing the new head releases the item to the writer */
+	__atomic_store_n(&q->head,head+skip+need,__ATOMIC_RELEASE);
+
+	if(used+skip+need>q->high_water)
+		q->high_water=used+skip+need;
+	q->enqueued++;
+
+	return NDO_OK;
+        }
+
+
+/* returns the next item, which stays in the ring until it is released - only ever called by the writer thread */
+char *ndomod_async_queue_peek(ndomod_async_queue *q){
+	unsigned long tail=0L;
+	unsigned long pos=0L;
+
+	if(q==NULL || q->buffer==NULL)
+		return NULL;
+
+	/* acquiring the head pairs with the release in push, so the item behind it is complete */
+	tail=q->tail;
+	while(__atomic_load_n(&q->head,__ATOMIC_ACQUIRE)!=tail){
+
+		pos=tail%q->size;
+
+		if(*(unsigned long *)(q->buffer+pos)!=NDOMOD_ASYNC_SKIP)
+			return q->buffer+pos+sizeof(unsigned long);
+
+		/* nothing more until the front of the ring */
+		tail+=q->size-pos;
+		__atomic_store_n(&q->tail,tail,__ATOMIC_RELEASE);
+		}
+
+	return NULL;
+        }
+
+
+/* frees the space of the item returned by ndomod_async_queue_peek() */
+int ndomod_async_queue_release(ndomod_async_queue *q){
+	unsigned long tail=0L;
+	unsigned long len=0L;
+
+	if(q==NULL || q->buffer==NULL)
+		return NDO_ERROR;
+
+	tail=q->tail;
+	if(__atomic_load_n(&q->head,__ATOMIC_ACQUIRE)==tail)
+		return NDO_ERROR;
+
+	len=*(unsigned long *)(q->buffer+(tail%q->size));
+
+	/* the release store hands the space back only after we're done reading the item */
+	__atomic_store_n(&q->tail,tail+NDOMOD_ASYNC_ITEM_SIZE(len),__ATOMIC_RELEASE);
+	__atomic_store_n(&q->dequeued,q->dequeued+1,__ATOMIC_RELAXED);
+
+	return NDO_OK;
+        }
+
+
+/* writes out log messages left by the writer thread - caller holds ndomod_async_log_lock */
+static void ndomod_flush_async_logs(void){
+	int x;
+
+	for(x=0;x<ndomod_async_log_count;x++){
+		write_to_all_logs(ndomod_async_log_msgs[x],NSLOG_INFO_MESSAGE);
+		my_free(ndomod_async_log_msgs[x]);
+		}
+	ndomod_async_log_count=0;
+
+	return;
+        }
+
+
+/* starts the async writer thread */
+int ndomod_start_async_writer(void){
+	pthread_mutexattr_t attr;
+
+	if(ndomod_async_queue_init(&asyncq,ndomod_async_queue_size)==NDO_ERROR)
+		return NDO_ERROR;
+
+	/* the hello and goodbye take the lock themselves, and can be reached with it already held */
+	pthread_mutexattr_init(&attr);
+	pthread_mutexattr_settype(&attr,PTHREAD_MUTEX_RECURSIVE);
+	pthread_mutex_init(&ndomod_sink_lock,&attr);
+	pthread_mutexattr_destroy(&attr);
+
+	ndomod_async_thread_stop=NDO_FALSE;
+	ndomod_async_last_stats=time(NULL);
+
+	/* set before the thread starts, so neither thread ever sees it running with this still unset */
+	ndomod_async_thread_running=NDO_TRUE;
+
+	if(pthread_create(&ndomod_async_thread,NULL,ndomod_async_writer_thread,NULL)!=0){
+		ndomod_async_thread_running=NDO_FALSE;
+		pthread_mutex_destroy(&ndomod_sink_lock);
+		ndomod_async_queue_deinit(&asyncq);
+		return NDO_ERROR;
+		}
+
+	return NDO_OK;
+        }
+
+
+/* drains the async queue and stops the writer thread */
+int ndomod_stop_async_writer(void){
+
+	if(ndomod_async_thread_running==NDO_FALSE)
+		return NDO_OK;
+
+	ndomod_async_thread_stop=NDO_TRUE;
+	pthread_join(ndomod_async_thread,NULL);
+	ndomod_async_thread_running=NDO_FALSE;
+
+	pthread_mutex_lock(&ndomod_async_log_lock);
+	ndomod_flush_async_logs();
+	pthread_mutex_unlock(&ndomod_async_log_lock);
+
+	ndomod_log_async_stats();
+	ndomod_async_queue_deinit(&asyncq);
+	pthread_mutex_destroy(&ndomod_sink_lock);
+
+	return NDO_OK;
+        }
+
+
+/* writer thread - moves queued items to the sink */
+void *ndomod_async_writer_thread(void *args){
+	char *buf=NULL;
+
+	ndomod_async_thread=pthread_self();
+
+	/* open data sink, say hello and flush any items read in from the buffer file */
+	pthread_mutex_lock(&ndomod_sink_lock);
+	ndomod_write_to_sink("\n",NDO_FALSE,NDO_TRUE);
+	pthread_mutex_unlock(&ndomod_sink_lock);
+
+	while(1){
+
+		if((buf=ndomod_async_queue_peek(&asyncq))==NULL){
+
+			/* only exit once everything queued has been written */
+			if(ndomod_async_thread_stop==NDO_TRUE)
+				break;
+
+			/* keep the backlog moving when things are quiet */
+			if(ndomod_sink_is_open==NDO_TRUE && ndomod_backlog_pending()==NDO_TRUE){
+				pthread_mutex_lock(&ndomod_sink_lock);
+				if(ndomod_sink_is_open==NDO_TRUE && ndomod_backlog_pending()==NDO_TRUE)
+					ndomod_drain_backlog();
+				pthread_mutex_unlock(&ndomod_sink_lock);
+				}
+
+			/* don't let batched output sit around when things are quiet */
+			if(ndomod_batch.used_size>0L && ndomod_batch_age()>=ndomod_output_batch_delay){
+				pthread_mutex_lock(&ndomod_sink_lock);
+				if(ndomod_sink_is_open==NDO_TRUE)
+					ndomod_flush_output_batch();
+				pthread_mutex_unlock(&ndomod_sink_lock);
+				}
+
+			usleep(NDOMOD_ASYNC_IDLE_USEC);
+			continue;
+			}
+
+		pthread_mutex_lock(&ndomod_sink_lock);
+		ndomod_write_to_sink(buf,NDO_TRUE,NDO_TRUE);
+		pthread_mutex_unlock(&ndomod_sink_lock);
+
+		ndomod_async_queue_release(&asyncq);
+		}
+
+	return NULL;
+        }
+
+
+/* queues data for the writer thread, waiting a bit for room if the queue is full */
+int ndomod_queue_for_sink(char *buf){
+	struct timeval start_time;
+	struct timeval now;
+	unsigned long long waited=0L;
+	unsigned long len=strlen(buf);
+
+	/* log anything the writer thread left for us */
+	if(ndomod_async_log_count>0 && pthread_mutex_trylock(&ndomod_async_log_lock)==0){
+		ndomod_flush_async_logs();
+		pthread_mutex_unlock(&ndomod_async_log_lock);
+		}
+
+	/* periodic queue stats */
+	if(ndomod_async_stats_interval>0 && (unsigned long)(time(NULL)-ndomod_async_last_stats)>=ndomod_async_stats_interval){
+		ndomod_log_async_stats();
+		ndomod_async_last_stats=time(NULL);
+		}
+
+	if(ndomod_async_queue_push(&asyncq,buf,len)==NDO_OK)
+		return NDO_OK;
+
+	/* it will never fit */
+	if(NDOMOD_ASYNC_ITEM_SIZE(len)>asyncq.size){
+		asyncq.dropped++;
+		return NDO_ERROR;
+		}
+
+	/* the queue is full - wait up to async_enqueue_timeout msec before dropping the item */
+	gettimeofday(&start_time,NULL);
+	asyncq.waits++;
+	while(1){
+		gettimeofday(&now,NULL);
+		waited=(unsigned long long)(now.tv_sec-start_time.tv_sec)*1000000L+(now.tv_usec-start_time.tv_usec);
+		if(waited>=(unsigned long long)ndomod_async_enqueue_timeout*1000L)
+			break;
+		usleep(100);
+		if(ndomod_async_queue_push(&asyncq,buf,len)==NDO_OK)
+			break;
+		}
+
+	asyncq.wait_usec+=waited;
+	if(waited>asyncq.max_wait_usec)
+		asyncq.max_wait_usec=waited;
+
+	if(waited>=(unsigned long long)ndomod_async_enqueue_timeout*1000L){
+		asyncq.dropped++;
+		return NDO_ERROR;
+		}
+
+	return NDO_OK;
+        }
+
+
+/* logs async queue counters */
+void ndomod_log_async_stats(void){
+	char temp_buffer[NDOMOD_MAX_BUFLEN];
+
+	snprintf(temp_buffer,sizeof(temp_buffer)-1,"ndomod: Async writer: %lu queued (%lu of %lu bytes, %lu high water), %lu enqueued, %lu dropped, %lu full-queue waits (%.3f ms avg, %.3f ms max).",
+		 ndomod_async_queue_depth(&asyncq),asyncq.head-__atomic_load_n(&asyncq.tail,__ATOMIC_RELAXED),asyncq.size,asyncq.high_water,asyncq.enqueued,asyncq.dropped,asyncq.waits,
+		 (asyncq.waits>0)?((double)asyncq.wait_usec/asyncq.waits/1000.0):0.0,(double)asyncq.max_wait_usec/1000.0);
+	temp_buffer[sizeof(temp_buffer)-1]='\x0';
+	ndomod_write_to_logs(temp_buffer,NSLOG_INFO_MESSAGE);
+
+	return;
+        }
+
+
+/****************************************************************************/
+/* STATUS CONFLATION FUNCTIONS                                              */
+/****************************************************************************/
+
+/* holds on to a host or service status update, replacing any older one for the same object */
+int ndomod_conflate_status(void *object, char *buf){
+	ndomod_conflated_status *temp_status=NULL;
+	unsigned long hashslot=0L;
+	unsigned long len=0L;
+	char *newdata=NULL;
+
+	if(object==NULL || buf==NULL)
+		return NDO_ERROR;
+
+	hashslot=((unsigned long)object>>4)%NDOMOD_CONFLATION_HASHSLOTS;
+	len=strlen(buf)+1;
+
+	for(temp_status=ndomod_conflation_hashlist[hashslot];temp_status!=NULL;temp_status=temp_status->hash_next){
+		if(temp_status->object==object)
+			break;
+		}
+
+	/* first update for this object in the current window */
+	if(temp_status==NULL){
+
+		if((temp_status=(ndomod_conflated_status *)calloc(1,sizeof(ndomod_conflated_status)))==NULL)
+			return ndomod_write_to_sink(buf,NDO_TRUE,NDO_TRUE);
+
+		temp_status->object=object;
+		temp_status->hash_next=ndomod_conflation_hashlist[hashslot];
+		ndomod_conflation_hashlist[hashslot]=temp_status;
+
+		if(ndomod_conflation_head==NULL){
+			ndomod_conflation_head=temp_status;
+			time(&ndomod_conflation_start);
+			}
+		else
+			ndomod_conflation_tail->next=temp_status;
+		ndomod_conflation_tail=temp_status;
+		}
+
+	/* newer data replaces the old */
+	if(temp_status->size<len){
+		if((newdata=(char *)realloc(temp_status->data,len))==NULL)
+			return NDO_ERROR;
+		temp_status->data=newdata;
+		temp_status->size=len;
+		}
+	memcpy(temp_status->data,buf,len);
+
+	/* the window is up */
+	if((unsigned long)(time(NULL)-ndomod_conflation_start)>=ndomod_status_conflation_window)
+		ndomod_flush_conflated_status();
+
+	return NDO_OK;
+        }
+
+
+/* sends the latest status of everything that was held back */
+int ndomod_flush_conflated_status(void){
+	ndomod_conflated_status *temp_status=NULL;
+	ndomod_conflated_status *next_status=NULL;
+
+	if(ndomod_conflation_head==NULL)
+		return NDO_OK;
+
+	for(temp_status=ndomod_conflation_head;temp_status!=NULL;temp_status=next_status){
+		next_status=temp_status->next;
+		if(ndomod_write_to_sink(temp_status->data,NDO_TRUE,NDO_TRUE)==NDO_OK)
+			ndomod_status_delta_sent(temp_status->object);
+		free(temp_status->data);
+		free(temp_status);
+		}
+
+	memset(ndomod_conflation_hashlist,0,sizeof(ndomod_conflation_hashlist));
+	ndomod_conflation_head=NULL;
+	ndomod_conflation_tail=NULL;
+
+	return NDO_OK;
+        }
+
+
+/* flushes held back status updates once the window is up - runs as a Nagios timed event */
+int ndomod_check_conflated_status(void *args){
+
+	if(ndomod_conflation_head!=NULL && (unsigned long)(time(NULL)-ndomod_conflation_start)>=ndomod_status_conflation_window)
+		ndomod_flush_conflated_status();
+
+	return NDO_OK;
+        }
+
+
+
+/* marks the latest status update for an object as sent, so the next delta starts from it - only called once it was written */
+int ndomod_status_delta_sent(void *object){
+	ndomod_delta_state *ds=NULL;
+
+	for(ds=ndomod_delta_hashlist[((unsigned long)object>>4)%NDOMOD_DELTA_HASHSLOTS];ds!=NULL;ds=ds->next){
+		if(ds->object==object)
+			break;
+		}
+
+	if(ds==NULL)
+		return NDO_OK;
+
+	ds->dirty=0ULL;
+	ds->customvars_dirty=NDO_FALSE;
+	ds->send_full=NDO_FALSE;
+
+	return NDO_OK;
+        }
+
+
+/* frees all status delta state */
+void ndomod_free_delta_state(void){
+	ndomod_delta_state *ds=NULL;
+	ndomod_delta_state *next_ds=NULL;
+	int x;
+
+	for(x=0;x<NDOMOD_DELTA_HASHSLOTS;x++){
+		for(ds=ndomod_delta_hashlist[x];ds!=NULL;ds=next_ds){
+			next_ds=ds->next;
+			free(ds);
+			}
+		ndomod_delta_hashlist[x]=NULL;
+		}
+
+	return;
+        }
+
+
+
+/****************************************************************************/
+/* STATISTICS FUNCTIONS                                                     */
+/****************************************************************************/
+
+
+
+/* adds a measurement to a histogram */
+static void ndomod_stats_record(ndomod_latency_histogram *hist, unsigned long long nsec){
+	unsigned long long usec=nsec/1000L;
+	int bucket=0;
+
+	while(usec>0L && bucket<NDOMOD_STATS_BUCKETS-1){
+		usec>>=1;
+		bucket++;
+		}
+
+	hist->count++;
+	hist->total_nsec+=nsec;
+	if(nsec>hist->max_nsec)
+		hist->max_nsec=nsec;
+	hist->buckets[bucket]++;
+
+	return;
+        }
+
+
+/* upper bound (in usec) of the bucket holding the given fraction of measurements */
+static unsigned long ndomod_stats_percentile(ndomod_latency_histogram *hist, double fraction){
+	unsigned long long wanted=0L;
+	unsigned long long seen=0L;
+	int x;
+
+	if(hist->count==0L)
+		return 0L;
+
+	wanted=(unsigned long long)(hist->count*fraction);
+	if(wanted<1L)
+		wanted=1L;
+
+	for(x=0;x<NDOMOD_STATS_BUCKETS-1;x++){
+		seen+=hist->buckets[x];
+		if(seen>=wanted)
+			return 1UL<<x;
+		}
+
+	return (unsigned long)(hist->max_nsec/1000L);
+        }
+
+
+/* average of a histogram in usec */
+static double ndomod_stats_average(ndomod_latency_histogram *hist){
+
+	if(hist->count==0L)
+		return 0.0;
+
+	return (double)hist->total_nsec/hist->count/1000.0;
+        }
+
+
+/* short name for a callback type */
+static const char *ndomod_event_type_name(int event_type){
+
+	switch(event_type){
+	case NEBCALLBACK_PROCESS_DATA:
+		return "process";
+	case NEBCALLBACK_TIMED_EVENT_DATA:
+		return "timed_event";
+	case NEBCALLBACK_LOG_DATA:
+		return "log";
+	case NEBCALLBACK_SYSTEM_COMMAND_DATA:
+		return "system_command";
+	case NEBCALLBACK_EVENT_HANDLER_DATA:
+		return "event_handler";
+	case NEBCALLBACK_NOTIFICATION_DATA:
+		return "notification";
+	case NEBCALLBACK_SERVICE_CHECK_DATA:
+		return "service_check";
+	case NEBCALLBACK_HOST_CHECK_DATA:
+		return "host_check";
+	case NEBCALLBACK_COMMENT_DATA:
+		return "comment";
+	case NEBCALLBACK_DOWNTIME_DATA:
+		return "downtime";
+	case NEBCALLBACK_FLAPPING_DATA:
+		return "flapping";
+	case NEBCALLBACK_PROGRAM_STATUS_DATA:
+		return "program_status";
+	case NEBCALLBACK_HOST_STATUS_DATA:
+		return "host_status";
+	case NEBCALLBACK_SERVICE_STATUS_DATA:
+		return "service_status";
+	case NEBCALLBACK_ADAPTIVE_PROGRAM_DATA:
+		return "adaptive_program";
+	case NEBCALLBACK_ADAPTIVE_HOST_DATA:
+		return "adaptive_host";
+	case NEBCALLBACK_ADAPTIVE_SERVICE_DATA:
+		return "adaptive_service";
+	case NEBCALLBACK_EXTERNAL_COMMAND_DATA:
+		return "external_command";
+	case NEBCALLBACK_AGGREGATED_STATUS_DATA:
+		return "aggregated_status";
+	case NEBCALLBACK_RETENTION_DATA:
+		return "retention";
+	case NEBCALLBACK_CONTACT_NOTIFICATION_DATA:
+		return "contact_notification";
+	case NEBCALLBACK_CONTACT_NOTIFICATION_METHOD_DATA:
+		return "contact_notification_method";
+	case NEBCALLBACK_ACKNOWLEDGEMENT_DATA:
+		return "acknowledgement";
+	case NEBCALLBACK_STATE_CHANGE_DATA:
+		return "state_change";
+#if ( defined( BUILD_NAGIOS_3X) || defined( BUILD_NAGIOS_4X))
+	case NEBCALLBACK_CONTACT_STATUS_DATA:
+		return "contact_status";
+	case NEBCALLBACK_ADAPTIVE_CONTACT_DATA:
+		return "adaptive_contact";
+#endif
+	default:
+		break;
+		}
+
+	return "unknown";
+        }
+
+
+/* finds the callback type with the given name, or returns -1 */
+int ndomod_event_type_id(const char *name){
+	int x;
+
+	for(x=0;x<NEBCALLBACK_NUMITEMS;x++){
+		if(!strcmp(ndomod_event_type_name(x),name))
+			return x;
+		}
+
+	return -1;
+        }
+
+
+/* starts counting from zero again */
+void ndomod_reset_stats(void){
+
+	memset(ndomod_stats,0,sizeof(ndomod_stats));
+	ndomod_sink_reconnects=0L;
+	ndomod_sink_items_lost=0L;
+	time(&ndomod_stats_reset_time);
+
+	return;
+        }
+
+
+/* appends the current statistics to a buffer, one line per callback type after the totals */
+int ndomod_format_stats(ndo_dbuf *dbufp){
+	char temp_buffer[NDOMOD_MAX_BUFLEN];
+	ndomod_event_stats *st=NULL;
+	unsigned long long events=0L;
+	unsigned long long bytes=0L;
+	unsigned long high_items=0L;
+	unsigned long high_bytes=0L;
+	time_t current_time;
+	int last=0;
+	int x;
+	int y;
+
+	time(&current_time);
+
+	for(x=0;x<NEBCALLBACK_NUMITEMS;x++){
+		events+=ndomod_stats[x].events;
+		bytes+=ndomod_stats[x].bytes;
+		}
+	ndomod_sink_buffer_get_highwater(&sinkbuf,&high_items,&high_bytes);
+
+	snprintf(temp_buffer,sizeof(temp_buffer)-1,"uptime=%lu events=%llu bytes=%llu shed=%lu sink_open=%d reconnects=%lu\n",
+		 (unsigned long)(current_time-ndomod_stats_reset_time),events,bytes,ndomod_events_shed(),ndomod_sink_is_open,ndomod_sink_reconnects);
+	temp_buffer[sizeof(temp_buffer)-1]='\x0';
+	ndo_dbuf_strcat(dbufp,temp_buffer);
+
+	snprintf(temp_buffer,sizeof(temp_buffer)-1,"buffer_items=%lu buffer_bytes=%lu buffer_high_items=%lu buffer_high_bytes=%lu overflow=%lu lost=%lu spill_bytes=%llu spill_dropped=%lu\n",
+		 sinkbuf.items,ndomod_sink_buffer_bytes(&sinkbuf),high_items,high_bytes,
+		 sinkbuf.overflow,ndomod_sink_items_lost+sinkbuf.overflow,spillq.disk_bytes,spillq.dropped);
+	temp_buffer[sizeof(temp_buffer)-1]='\x0';
+	ndo_dbuf_strcat(dbufp,temp_buffer);
+
+	for(x=0;x<NEBCALLBACK_NUMITEMS;x++){
+
+		st=&ndomod_stats[x];
+		if(st->total.count==0L)
+			continue;
+
+		/* times are in usec, percentiles are bucket upper bounds */
+		snprintf(temp_buffer,sizeof(temp_buffer)-1,"%s calls=%lu events=%lu filtered=%lu rate_limited=%lu sampled=%lu bytes=%llu total_avg=%.1f total_p50=%lu total_p99=%lu total_max=%.1f serialize_avg=%.1f serialize_p99=%lu escape_avg=%.1f write_avg=%.1f write_p99=%lu write_max=%.1f histogram=",
+			 ndomod_event_type_name(x),st->total.count,st->events,st->filtered,ndomod_limits[x].rate_limited,ndomod_limits[x].sampled,st->bytes,
+			 ndomod_stats_average(&st->total),ndomod_stats_percentile(&st->total,0.5),ndomod_stats_percentile(&st->total,0.99),(double)st->total.max_nsec/1000.0,
+			 ndomod_stats_average(&st->serialize),ndomod_stats_percentile(&st->serialize,0.99),
+			 ndomod_stats_average(&st->escape),
+			 ndomod_stats_average(&st->write),ndomod_stats_percentile(&st->write,0.99),(double)st->write.max_nsec/1000.0);
+		temp_buffer[sizeof(temp_buffer)-1]='\x0';
+		ndo_dbuf_strcat(dbufp,temp_buffer);
+
+		/* leave off the empty slow end of the histogram */
+		for(last=NDOMOD_STATS_BUCKETS-1;last>0 && st->total.buckets[last]==0L;last--);
+		for(y=0;y<=last;y++){
+			if(y>0)
+				ndo_dbuf_addchar(dbufp,',');
+			ndo_dbuf_append_ulong(dbufp,st->total.buckets[y],0);
+			}
+		ndo_dbuf_addchar(dbufp,'\n');
+		}
+
+	return NDO_OK;
+        }
+
+
+/* writes the statistics to the Nagios log - runs as a Nagios timed event */
+int ndomod_log_stats(void *args){
+	char temp_buffer[NDOMOD_MAX_BUFLEN];
+	ndo_dbuf dbuf;
+	char *line=NULL;
+	char *next=NULL;
+
+	if(ndomod_collect_stats==NDO_FALSE)
+		return NDO_OK;
+
+	ndo_dbuf_init(&dbuf,4096);
+	ndomod_format_stats(&dbuf);
+
+	for(line=dbuf.buf;line!=NULL && *line!='\x0';line=next){
+		if((next=strchr(line,'\n'))!=NULL)
+			*next++='\x0';
+		snprintf(temp_buffer,sizeof(temp_buffer)-1,"ndomod: Stats: %s",line);
+		temp_buffer[sizeof(temp_buffer)-1]='\x0';
+		ndomod_write_to_logs(temp_buffer,NSLOG_INFO_MESSAGE);
+		}
+
+	ndo_dbuf_free(&dbuf);
+
+	return NDO_OK;
         }
 
 
-/* gets number of items lost due to buffer overflow */
-unsigned long ndomod_sink_buffer_get_overflow(ndomod_sink_buffer *sbuf){
+#ifdef BUILD_NAGIOS_4X
+/* answers "@ndomod stats", "@ndomod reset" and "@ndomod help" on the query handler socket */
+int ndomod_stats_query_handler(int sd, char *buf, unsigned int len){
+	const char *help="stats   show event counts, callback latency histograms and buffer state\nreset   start counting from zero\n";
+	ndo_dbuf dbuf;
+	int result=0;
 
-	if(sbuf==NULL)
-		return 0;
-	else
-		return sbuf->overflow;
+	/* ignore a trailing newline */
+	while(len>0 && (buf[len-1]=='\n' || buf[len-1]=='\r' || buf[len-1]==' '))
+		buf[--len]='\x0';
+
+	if(len==0 || !strcmp(buf,"stats")){
+		ndo_dbuf_init(&dbuf,4096);
+		ndomod_format_stats(&dbuf);
+		if(dbuf.buf!=NULL)
+			result=write(sd,dbuf.buf,dbuf.used_size+1);
+		ndo_dbuf_free(&dbuf);
+		return (result<0)?QH_CLOSE:QH_OK;
+		}
+
+	if(!strcmp(buf,"reset")){
+		ndomod_reset_stats();
+		result=write(sd,"OK\n",4);
+		return (result<0)?QH_CLOSE:QH_OK;
+		}
+
+	if(!strcmp(buf,"help")){
+		result=write(sd,help,strlen(help)+1);
+		return (result<0)?QH_CLOSE:QH_OK;
+		}
+
+	return 400;
         }
 
 
-/* sets number of items lost due to buffer overflow */
-int ndomod_sink_buffer_set_overflow(ndomod_sink_buffer *sbuf, unsigned long num){
+/* the query handler socket is set up after modules are loaded, so this runs once from the event loop */
+int ndomod_register_query_handler(void *args){
+	char temp_buffer[NDOMOD_MAX_BUFLEN];
 
-	if(sbuf==NULL)
-		return 0;
-	else
-		sbuf->overflow=num;
+	if(qh_register_handler(NDOMOD_STATS_QH_NAME,"NDOUtils module statistics",0,ndomod_stats_query_handler)<0){
+		snprintf(temp_buffer,sizeof(temp_buffer)-1,"ndomod: Warning - Could not register the '%s' query handler.",NDOMOD_STATS_QH_NAME);
+		temp_buffer[sizeof(temp_buffer)-1]='\x0';
+		ndomod_write_to_logs(temp_buffer,NSLOG_INFO_MESSAGE);
+		}
 
-	return sbuf->overflow;
+	return NDO_OK;
         }
+#endif
+
 
 
 /****************************************************************************/
@@ -1240,394 +3482,1088 @@ int ndomod_register_callbacks(void){
 		asprintf(&msg,"ndomod registered for service status data\'");
 		ndomod_write_to_logs(msg,NSLOG_INFO_MESSAGE);
 		}
-	if(result==NDO_OK && (ndomod_process_options & NDOMOD_PROCESS_ADAPTIVE_PROGRAM_DATA)) {
-		result=neb_register_callback(NEBCALLBACK_ADAPTIVE_PROGRAM_DATA,ndomod_module_handle,priority,ndomod_broker_data);
-		asprintf(&msg,"ndomod registered for adaptive program data\'");
-		ndomod_write_to_logs(msg,NSLOG_INFO_MESSAGE);
+	if(result==NDO_OK && (ndomod_process_options & NDOMOD_PROCESS_ADAPTIVE_PROGRAM_DATA)) {
+		result=neb_register_callback(NEBCALLBACK_ADAPTIVE_PROGRAM_DATA,ndomod_module_handle,priority,ndomod_broker_data);
+		asprintf(&msg,"ndomod registered for adaptive program data\'");
+		ndomod_write_to_logs(msg,NSLOG_INFO_MESSAGE);
+		}
+	if(result==NDO_OK && (ndomod_process_options & NDOMOD_PROCESS_ADAPTIVE_HOST_DATA)) {
+		result=neb_register_callback(NEBCALLBACK_ADAPTIVE_HOST_DATA,ndomod_module_handle,priority,ndomod_broker_data);
+		asprintf(&msg,"ndomod registered for adaptive host data\'");
+		ndomod_write_to_logs(msg,NSLOG_INFO_MESSAGE);
+		}
+	if(result==NDO_OK && (ndomod_process_options & NDOMOD_PROCESS_ADAPTIVE_SERVICE_DATA)) {
+		result=neb_register_callback(NEBCALLBACK_ADAPTIVE_SERVICE_DATA,ndomod_module_handle,priority,ndomod_broker_data);
+		asprintf(&msg,"ndomod registered for adaptive service data\'");
+		ndomod_write_to_logs(msg,NSLOG_INFO_MESSAGE);
+		}
+	if(result==NDO_OK && (ndomod_process_options & NDOMOD_PROCESS_EXTERNAL_COMMAND_DATA)) {
+		result=neb_register_callback(NEBCALLBACK_EXTERNAL_COMMAND_DATA,ndomod_module_handle,priority,ndomod_broker_data);
+		asprintf(&msg,"ndomod registered for external command data\'");
+		ndomod_write_to_logs(msg,NSLOG_INFO_MESSAGE);
+		}
+	if(result==NDO_OK && (ndomod_process_options & NDOMOD_PROCESS_AGGREGATED_STATUS_DATA)) {
+		result=neb_register_callback(NEBCALLBACK_AGGREGATED_STATUS_DATA,ndomod_module_handle,priority,ndomod_broker_data);
+		asprintf(&msg,"ndomod registered for aggregated status data\'");
+		ndomod_write_to_logs(msg,NSLOG_INFO_MESSAGE);
+		}
+	if(result==NDO_OK && (ndomod_process_options & NDOMOD_PROCESS_RETENTION_DATA)) {
+		result=neb_register_callback(NEBCALLBACK_RETENTION_DATA,ndomod_module_handle,priority,ndomod_broker_data);
+		asprintf(&msg,"ndomod registered for retention data\'");
+		ndomod_write_to_logs(msg,NSLOG_INFO_MESSAGE);
+		}
+	if(result==NDO_OK) { //no current option for this
+		result=neb_register_callback(NEBCALLBACK_CONTACT_NOTIFICATION_DATA,ndomod_module_handle,priority,ndomod_broker_data);
+		asprintf(&msg,"ndomod registered for contact data\'");
+		ndomod_write_to_logs(msg,NSLOG_INFO_MESSAGE);
+		}
+	if(result==NDO_OK) { //no current option for this
+		result=neb_register_callback(NEBCALLBACK_CONTACT_NOTIFICATION_METHOD_DATA,ndomod_module_handle,priority,ndomod_broker_data);
+		asprintf(&msg,"ndomod registered for contact notification data\'");
+		ndomod_write_to_logs(msg,NSLOG_INFO_MESSAGE);
+		}
+	if(result==NDO_OK && (ndomod_process_options & NDOMOD_PROCESS_ACKNOWLEDGEMENT_DATA)) {
+		result=neb_register_callback(NEBCALLBACK_ACKNOWLEDGEMENT_DATA,ndomod_module_handle,priority,ndomod_broker_data);
+		asprintf(&msg,"ndomod registered for acknowledgement data\'");
+		ndomod_write_to_logs(msg,NSLOG_INFO_MESSAGE);
+		}
+	if(result==NDO_OK && (ndomod_process_options & NDOMOD_PROCESS_STATECHANGE_DATA)) {
+		result=neb_register_callback(NEBCALLBACK_STATE_CHANGE_DATA,ndomod_module_handle,priority,ndomod_broker_data);
+		asprintf(&msg,"ndomod registered for state change data\'");
+		ndomod_write_to_logs(msg,NSLOG_INFO_MESSAGE);
+		}
+#if ( defined( BUILD_NAGIOS_3X) || defined( BUILD_NAGIOS_4X))
+	if(result==NDO_OK && (ndomod_process_options & NDOMOD_PROCESS_CONTACT_STATUS_DATA)) {
+		result=neb_register_callback(NEBCALLBACK_CONTACT_STATUS_DATA,ndomod_module_handle,priority,ndomod_broker_data);
+		asprintf(&msg,"ndomod registered for contact status data\'");
+		ndomod_write_to_logs(msg,NSLOG_INFO_MESSAGE);
+		}
+	if(result==NDO_OK && (ndomod_process_options & NDOMOD_PROCESS_ADAPTIVE_CONTACT_DATA)) {
+		result=neb_register_callback(NEBCALLBACK_ADAPTIVE_CONTACT_DATA,ndomod_module_handle,priority,ndomod_broker_data);
+		asprintf(&msg,"ndomod registered for adaptive contact data\'");
+		ndomod_write_to_logs(msg,NSLOG_INFO_MESSAGE);
+		}
+#endif
+
+	free(msg);
+
+	return result;
+        }
+
+
+/* deregisters callbacks */
+int ndomod_deregister_callbacks(void){
+
+	neb_deregister_callback(NEBCALLBACK_PROCESS_DATA,ndomod_broker_data);
+	neb_deregister_callback(NEBCALLBACK_TIMED_EVENT_DATA,ndomod_broker_data);
+	neb_deregister_callback(NEBCALLBACK_LOG_DATA,ndomod_broker_data);
+	neb_deregister_callback(NEBCALLBACK_SYSTEM_COMMAND_DATA,ndomod_broker_data);
+	neb_deregister_callback(NEBCALLBACK_EVENT_HANDLER_DATA,ndomod_broker_data);
+	neb_deregister_callback(NEBCALLBACK_NOTIFICATION_DATA,ndomod_broker_data);
+	neb_deregister_callback(NEBCALLBACK_SERVICE_CHECK_DATA,ndomod_broker_data);
+	neb_deregister_callback(NEBCALLBACK_HOST_CHECK_DATA,ndomod_broker_data);
+	neb_deregister_callback(NEBCALLBACK_COMMENT_DATA,ndomod_broker_data);
+	neb_deregister_callback(NEBCALLBACK_DOWNTIME_DATA,ndomod_broker_data);
+	neb_deregister_callback(NEBCALLBACK_FLAPPING_DATA,ndomod_broker_data);
+	neb_deregister_callback(NEBCALLBACK_PROGRAM_STATUS_DATA,ndomod_broker_data);
+	neb_deregister_callback(NEBCALLBACK_HOST_STATUS_DATA,ndomod_broker_data);
+	neb_deregister_callback(NEBCALLBACK_SERVICE_STATUS_DATA,ndomod_broker_data);
+	neb_deregister_callback(NEBCALLBACK_ADAPTIVE_PROGRAM_DATA,ndomod_broker_data);
+	neb_deregister_callback(NEBCALLBACK_ADAPTIVE_HOST_DATA,ndomod_broker_data);
+	neb_deregister_callback(NEBCALLBACK_ADAPTIVE_SERVICE_DATA,ndomod_broker_data);
+	neb_deregister_callback(NEBCALLBACK_EXTERNAL_COMMAND_DATA,ndomod_broker_data);
+	neb_deregister_callback(NEBCALLBACK_AGGREGATED_STATUS_DATA,ndomod_broker_data);
+	neb_deregister_callback(NEBCALLBACK_RETENTION_DATA,ndomod_broker_data);
+	neb_deregister_callback(NEBCALLBACK_CONTACT_NOTIFICATION_DATA,ndomod_broker_data);
+	neb_deregister_callback(NEBCALLBACK_CONTACT_NOTIFICATION_METHOD_DATA,ndomod_broker_data);
+	neb_deregister_callback(NEBCALLBACK_ACKNOWLEDGEMENT_DATA,ndomod_broker_data);
+	neb_deregister_callback(NEBCALLBACK_STATE_CHANGE_DATA,ndomod_broker_data);
+#if ( defined( BUILD_NAGIOS_3X) || defined( BUILD_NAGIOS_4X))
+	neb_deregister_callback(NEBCALLBACK_CONTACT_STATUS_DATA,ndomod_broker_data);
+	neb_deregister_callback(NEBCALLBACK_ADAPTIVE_CONTACT_DATA,ndomod_broker_data);
+#endif
+
+	return NDO_OK;
+        }
+
+/* hands out the shared output buffer (or a private one for nested callbacks) */
+static void ndomod_acquire_output_buffer(ndo_dbuf *dbufp) {
+
+	/* write_to_all_logs() can re-enter us through the log data callback */
+	if(ndomod_outbuf_depth++>0) {
+		ndo_dbuf_init(dbufp,2048);
+		return;
+		}
+
+	*dbufp=ndomod_outbuf;
+	ndo_dbuf_reset(dbufp);
+	}
+
+/* gives the output buffer back, keeping its memory unless it grew unreasonably large */
+static void ndomod_release_output_buffer(ndo_dbuf *dbufp) {
+
+	if(--ndomod_outbuf_depth>0) {
+		ndo_dbuf_free(dbufp);
+		return;
+		}
+
+	if(dbufp->allocated_size>NDOMOD_MAX_OUTBUF_KEEP)
+		ndo_dbuf_free(dbufp);
+	ndomod_outbuf=*dbufp;
+	}
+
+/* adds a hash of everything in the definition being built after its timestamp, so ndo2db can tell whether it changed */
+static void ndomod_confighash_serialize(ndo_dbuf *dbufp) {
+
+	unsigned long long hash;
+	char numbuf[24];
+
+	if(ndomod_send_config_hashes==NDO_FALSE || dbufp->buf==NULL || dbufp->used_size<ndomod_config_hash_start)
+		return;
+
+	hash = ndo_content_hash(dbufp->buf + ndomod_config_hash_start, dbufp->used_size - ndomod_config_hash_start);
+
+	if(ndomod_protocol_version==NDO_API_PROTOVERSION_BINARY) {
+		ndomod_key_serialize(dbufp, NDO_DATA_CONFIGHASH, NDO_API_FIELD_UNSIGNED_LONG);
+		ndo_dbuf_append_varint(dbufp, hash);
+		return;
+		}
+
+	ndomod_key_serialize(dbufp, NDO_DATA_CONFIGHASH, 0);
+	snprintf(numbuf, sizeof(numbuf), "%llu", hash);
+	ndo_dbuf_strcat(dbufp, numbuf);
+	}
+
+#if ( defined( BUILD_NAGIOS_3X) || defined( BUILD_NAGIOS_4X))
+static void ndomod_customvars_serialize(customvariablesmember *customvars,
+	ndo_dbuf *dbufp) {
+
+	customvariablesmember *temp_customvar = NULL;
+	char modified[16];
+
+	for(temp_customvar = customvars; temp_customvar != NULL;
+			temp_customvar = temp_customvar->next) {
+
+		/* <name>:<modified>:<value> */
+		snprintf(modified, sizeof(modified), ":%d:", temp_customvar->has_been_modified);
+		ndomod_string_begin(dbufp, NDO_DATA_CUSTOMVARIABLE,
+				((NULL == temp_customvar->variable_name) ? 0 : strlen(temp_customvar->variable_name)) +
+				strlen(modified) +
+				((NULL == temp_customvar->variable_value) ? 0 : strlen(temp_customvar->variable_value)));
+		ndomod_string_append(dbufp, temp_customvar->variable_name);
+		ndo_dbuf_strcat(dbufp, modified);
+		ndomod_string_append(dbufp, temp_customvar->variable_value);
+		}
+	}
+#endif
+
+static void ndomod_contactgroups_serialize(contactgroupsmember *contactgroups,
+	ndo_dbuf *dbufp) {
+
+	contactgroupsmember *temp_contactgroupsmember = NULL;
+
+	for(temp_contactgroupsmember = contactgroups;
+			temp_contactgroupsmember != NULL;
+			temp_contactgroupsmember = temp_contactgroupsmember->next) {
+
+		ndomod_string_serialize(dbufp, NDO_DATA_CONTACTGROUP,
+				temp_contactgroupsmember->group_name, '\x0', NULL);
+		}
+	}
+
+#ifdef BUILD_NAGIOS_2X
+static void ndomod_contacts_serialize(contactgroupmember *contacts,
+	ndo_dbuf *dbufp, int varnum) {
+
+	contactgroupmember *temp_contactgroupmember = NULL;
+
+	for(temp_contactgroupmember = contacts; temp_contactgroupmember != NULL;
+			temp_contactgroupmember=temp_contactgroupmember->next) {
+
+		ndomod_string_serialize(dbufp, varnum,
+				temp_contactgroupmember->contact_name, '\x0', NULL);
+		}
+	}
+
+#else
+static void ndomod_contacts_serialize(contactsmember *contacts,
+	ndo_dbuf *dbufp, int varnum) {
+
+	contactsmember *temp_contactsmember = NULL;
+
+	for(temp_contactsmember = contacts; temp_contactsmember != NULL;
+			temp_contactsmember = temp_contactsmember->next) {
+
+		ndomod_string_serialize(dbufp, varnum,
+				temp_contactsmember->contact_name, '\x0', NULL);
+		}
+	}
+#endif
+
+#ifdef BUILD_NAGIOS_2X
+static void ndomod_hosts_serialize_2x(hostgroupmember *hosts, ndo_dbuf *dbufp,
+		int varnum) {
+
+	hostgroupmember *temp_hostgroupmember=NULL;
+
+	for(temp_hostgroupmember = hosts; temp_hostgroupmember != NULL;
+			temp_hostgroupmember = temp_hostgroupmember->next) {
+
+		ndomod_string_serialize(dbufp, varnum,
+				temp_hostgroupmember->host_name, '\x0', NULL);
+		}
+	}
+#endif
+
+static void ndomod_hosts_serialize(hostsmember *hosts, ndo_dbuf *dbufp,
+		int varnum) {
+
+	hostsmember *temp_hostsmember = NULL;
+
+	for(temp_hostsmember = hosts; temp_hostsmember != NULL;
+			temp_hostsmember = temp_hostsmember->next) {
+
+		ndomod_string_serialize(dbufp, varnum,
+				temp_hostsmember->host_name, '\x0', NULL);
+		}
+	}
+
+#ifdef BUILD_NAGIOS_2X
+static void ndomod_services_serialize(servicegroupmember *services,
+		ndo_dbuf *dbufp, int varnum) {
+
+	servicegroupmember *temp_servicegroupmember = NULL;
+
+	for(temp_servicegroupmember = services; temp_servicegroupmember != NULL;
+			temp_servicegroupmember = temp_servicegroupmember->next) {
+
+		ndomod_string_serialize(dbufp, varnum,
+				temp_servicegroupmember->host_name, ';',
+				temp_servicegroupmember->service_description);
+		}
+	}
+#else
+static void ndomod_services_serialize(servicesmember *services, ndo_dbuf *dbufp,
+		int varnum) {
+
+	servicesmember *temp_servicesmember = NULL;
+
+	for(temp_servicesmember = services; temp_servicesmember != NULL;
+			temp_servicesmember=temp_servicesmember->next) {
+
+		ndomod_string_serialize(dbufp, varnum,
+				temp_servicesmember->host_name, ';',
+				temp_servicesmember->service_description);
+		}
+	}
+#endif
+
+static void ndomod_commands_serialize(commandsmember *commands, ndo_dbuf *dbufp,
+		int varnum) {
+
+	commandsmember *temp_commandsmember = NULL;
+
+	for(temp_commandsmember = commands; temp_commandsmember != NULL;
+			temp_commandsmember=temp_commandsmember->next){
+
+		ndomod_string_serialize(dbufp, varnum,
+				temp_commandsmember->command, '\x0', NULL);
 		}
-	if(result==NDO_OK && (ndomod_process_options & NDOMOD_PROCESS_ADAPTIVE_HOST_DATA)) {
-		result=neb_register_callback(NEBCALLBACK_ADAPTIVE_HOST_DATA,ndomod_module_handle,priority,ndomod_broker_data);
-		asprintf(&msg,"ndomod registered for adaptive host data\'");
-		ndomod_write_to_logs(msg,NSLOG_INFO_MESSAGE);
+	}
+
+/* FNV-1a hash, used to tell whether a string field changed */
+static unsigned long long ndomod_hash_string(const char *str) {
+	unsigned long long hash=14695981039346656037ULL;
+
+	if(str==NULL)
+		return 0ULL;
+
+	for(;*str!='\x0';str++) {
+		hash^=(unsigned char)*str;
+		hash*=1099511628211ULL;
 		}
-	if(result==NDO_OK && (ndomod_process_options & NDOMOD_PROCESS_ADAPTIVE_SERVICE_DATA)) {
-		result=neb_register_callback(NEBCALLBACK_ADAPTIVE_SERVICE_DATA,ndomod_module_handle,priority,ndomod_broker_data);
-		asprintf(&msg,"ndomod registered for adaptive service data\'");
-		ndomod_write_to_logs(msg,NSLOG_INFO_MESSAGE);
+
+	return hash;
+	}
+
+
+/* a value we can compare against what was sent last time */
+static unsigned long long ndomod_broker_data_fingerprint(struct ndo_broker_data *bdp) {
+	union {
+		double d;
+		unsigned long long u;
+		} fbits;
+
+	switch(bdp->datatype) {
+	case BD_INT:
+		return (unsigned long long)(long long)bdp->value.integer;
+	case BD_TIMEVAL:
+		return (unsigned long long)bdp->value.timestamp.tv_sec*1000000ULL+bdp->value.timestamp.tv_usec;
+	case BD_STRING:
+	case BD_STRING_ESCAPE:
+		return ndomod_hash_string(bdp->value.string);
+	case BD_UNSIGNED_LONG:
+		return (unsigned long long)bdp->value.unsigned_long;
+	case BD_UNSIGNED_LONGLONG:
+		return bdp->value.unsigned_longlong;
+	case BD_FLOAT:
+		fbits.d = bdp->value.floating_point;
+		return fbits.u;
 		}
-	if(result==NDO_OK && (ndomod_process_options & NDOMOD_PROCESS_EXTERNAL_COMMAND_DATA)) {
-		result=neb_register_callback(NEBCALLBACK_EXTERNAL_COMMAND_DATA,ndomod_module_handle,priority,ndomod_broker_data);
-		asprintf(&msg,"ndomod registered for external command data\'");
-		ndomod_write_to_logs(msg,NSLOG_INFO_MESSAGE);
+
+	return 0ULL;
+	}
+
+
+/* finds (or creates) the delta state for a host or service */
+static ndomod_delta_state *ndomod_get_delta_state(void *object, size_t nfields) {
+	ndomod_delta_state *ds;
+	unsigned long hashslot;
+
+	hashslot=((unsigned long)object>>4)%NDOMOD_DELTA_HASHSLOTS;
+
+	for(ds=ndomod_delta_hashlist[hashslot]; ds!=NULL; ds=ds->next) {
+		if(ds->object==object)
+			return ds;
 		}
-	if(result==NDO_OK && (ndomod_process_options & NDOMOD_PROCESS_AGGREGATED_STATUS_DATA)) {
-		result=neb_register_callback(NEBCALLBACK_AGGREGATED_STATUS_DATA,ndomod_module_handle,priority,ndomod_broker_data);
-		asprintf(&msg,"ndomod registered for aggregated status data\'");
-		ndomod_write_to_logs(msg,NSLOG_INFO_MESSAGE);
+
+	if((ds=(ndomod_delta_state *)calloc(1,sizeof(ndomod_delta_state)+nfields*sizeof(unsigned long long)))==NULL)
+		return NULL;
+
+	ds->object=object;
+	ds->nfields=nfields;
+	ds->fields=(unsigned long long *)(ds+1);
+	ds->send_full=NDO_TRUE;
+	ds->next=ndomod_delta_hashlist[hashslot];
+	ndomod_delta_hashlist[hashslot]=ds;
+
+	return ds;
+	}
+
+
+/* returns the key sent with events about a host or service - object may be NULL if the event doesn't carry it */
+static unsigned long long ndomod_get_object_key(void *object, const char *host_name,
+		const char *service_description) {
+
+	ndomod_object_key *ok;
+	unsigned long hashslot;
+	int object_type;
+
+	object_type=(service_description==NULL || *service_description=='\x0') ?
+			NDO_API_OBJECTTYPE_HOST : NDO_API_OBJECTTYPE_SERVICE;
+
+	if(object==NULL)
+		return ndo_object_key(object_type, host_name, service_description);
+
+	hashslot=((unsigned long)object>>4)%NDOMOD_OBJECT_KEY_HASHSLOTS;
+	for(ok=ndomod_object_key_hashlist[hashslot]; ok!=NULL; ok=ok->next) {
+		if(ok->object==object)
+			break;
 		}
-	if(result==NDO_OK && (ndomod_process_options & NDOMOD_PROCESS_RETENTION_DATA)) {
-		result=neb_register_callback(NEBCALLBACK_RETENTION_DATA,ndomod_module_handle,priority,ndomod_broker_data);
-		asprintf(&msg,"ndomod registered for retention data\'");
-		ndomod_write_to_logs(msg,NSLOG_INFO_MESSAGE);
+
+	if(ok!=NULL && ok->name1==host_name && ok->name2==service_description)
+		return ok->key;
+
+	if(ok==NULL) {
+		if((ok=(ndomod_object_key *)malloc(sizeof(ndomod_object_key)))==NULL)
+			return ndo_object_key(object_type, host_name, service_description);
+		ok->object=object;
+		ok->exported=NDO_TRUE;
+		ok->next=ndomod_object_key_hashlist[hashslot];
+		ndomod_object_key_hashlist[hashslot]=ok;
 		}
-	if(result==NDO_OK) { //no current option for this
-		result=neb_register_callback(NEBCALLBACK_CONTACT_NOTIFICATION_DATA,ndomod_module_handle,priority,ndomod_broker_data);
-		asprintf(&msg,"ndomod registered for contact data\'");
-		ndomod_write_to_logs(msg,NSLOG_INFO_MESSAGE);
+
+	ok->name1=host_name;
+	ok->name2=service_description;
+	ok->key=ndo_object_key(object_type, host_name, service_description);
+
+	return ok->key;
+	}
+
+
+/* works out the keys of all hosts and services up front, once the config has been read */
+int ndomod_load_object_keys(void) {
+	host *temp_host=NULL;
+	service *temp_service=NULL;
+
+	for(temp_host=host_list; temp_host!=NULL; temp_host=temp_host->next)
+		ndomod_get_object_key(temp_host, temp_host->name, NULL);
+
+	for(temp_service=service_list; temp_service!=NULL; temp_service=temp_service->next)
+		ndomod_get_object_key(temp_service, temp_service->host_name, temp_service->description);
+
+	return NDO_OK;
+	}
+
+
+/* frees all cached object keys */
+void ndomod_free_object_keys(void) {
+	ndomod_object_key *ok=NULL;
+	ndomod_object_key *next_ok=NULL;
+	int x;
+
+	for(x=0;x<NDOMOD_OBJECT_KEY_HASHSLOTS;x++){
+		for(ok=ndomod_object_key_hashlist[x];ok!=NULL;ok=next_ok){
+			next_ok=ok->next;
+			free(ok);
+			}
+		ndomod_object_key_hashlist[x]=NULL;
 		}
-	if(result==NDO_OK) { //no current option for this
-		result=neb_register_callback(NEBCALLBACK_CONTACT_NOTIFICATION_METHOD_DATA,ndomod_module_handle,priority,ndomod_broker_data);
-		asprintf(&msg,"ndomod registered for contact notification data\'");
-		ndomod_write_to_logs(msg,NSLOG_INFO_MESSAGE);
+
+	return;
+	}
+
+
+/****************************************************************************/
+/* EXPORT FILTER FUNCTIONS                                                  */
+/****************************************************************************/
+
+/* adds a rule from the config file - the filters are built from all of them once the objects are read */
+int ndomod_add_export_rule(int type, char *val){
+	ndomod_export_rule *rule=NULL;
+	char temp_buffer[NDOMOD_MAX_BUFLEN];
+	char errbuf[256];
+	int result=0;
+
+	if(val==NULL || val[0]=='\x0')
+		return NDO_ERROR;
+
+	if((rule=(ndomod_export_rule *)calloc(1,sizeof(ndomod_export_rule)))==NULL)
+		return NDO_ERROR;
+	rule->type=type;
+
+	if(type==NDOMOD_EXPORT_HOST_NAME || type==NDOMOD_EXPORT_SERVICE_NAME){
+		if((result=regcomp(&rule->regex,val,REG_EXTENDED|REG_NOSUB))!=0){
+			regerror(result,&rule->regex,errbuf,sizeof(errbuf));
+			snprintf(temp_buffer,sizeof(temp_buffer)-1,"ndomod: Ignoring export filter '%s': %s",val,errbuf);
+			temp_buffer[sizeof(temp_buffer)-1]='\x0';
+			ndomod_write_to_logs(temp_buffer,NSLOG_INFO_MESSAGE);
+			free(rule);
+			return NDO_ERROR;
+			}
 		}
-	if(result==NDO_OK && (ndomod_process_options & NDOMOD_PROCESS_ACKNOWLEDGEMENT_DATA)) {
-		result=neb_register_callback(NEBCALLBACK_ACKNOWLEDGEMENT_DATA,ndomod_module_handle,priority,ndomod_broker_data);
-		asprintf(&msg,"ndomod registered for acknowledgement data\'");
-		ndomod_write_to_logs(msg,NSLOG_INFO_MESSAGE);
+	else{
+		/* custom variables can be given with or without their leading underscore */
+		if(type==NDOMOD_EXPORT_CUSTOM_VARIABLE && val[0]=='_')
+			val++;
+		if((rule->name=strdup(val))==NULL){
+			free(rule);
+			return NDO_ERROR;
+			}
 		}
-	if(result==NDO_OK && (ndomod_process_options & NDOMOD_PROCESS_STATECHANGE_DATA)) {
-		result=neb_register_callback(NEBCALLBACK_STATE_CHANGE_DATA,ndomod_module_handle,priority,ndomod_broker_data);
-		asprintf(&msg,"ndomod registered for state change data\'");
-		ndomod_write_to_logs(msg,NSLOG_INFO_MESSAGE);
+
+	if(type!=NDOMOD_EXPORT_SERVICEGROUP && type!=NDOMOD_EXPORT_SERVICE_NAME)
+		ndomod_export_host_rules++;
+	if(type!=NDOMOD_EXPORT_HOSTGROUP && type!=NDOMOD_EXPORT_HOST_NAME)
+		ndomod_export_service_rules++;
+
+	rule->next=ndomod_export_rules;
+	ndomod_export_rules=rule;
+
+	return NDO_OK;
+	}
+
+
+#if ( defined( BUILD_NAGIOS_3X) || defined( BUILD_NAGIOS_4X))
+/* an object carries an export custom variable unless it is empty or 0 */
+static int ndomod_export_customvar_set(customvariablesmember *cvm, const char *name){
+
+	for(;cvm!=NULL;cvm=cvm->next){
+		if(cvm->variable_name==NULL || strcasecmp(cvm->variable_name,name))
+			continue;
+		return (cvm->variable_value!=NULL && cvm->variable_value[0]!='\x0' && strcmp(cvm->variable_value,"0"))?NDO_TRUE:NDO_FALSE;
 		}
+
+	return NDO_FALSE;
+	}
+#endif
+
+
+/* checks a host or service against the export rules - only called while the filters are built */
+static int ndomod_export_rule_matches(host *hst, service *svc){
+	ndomod_export_rule *rule=NULL;
+	hostgroup *temp_hostgroup=NULL;
+	servicegroup *temp_servicegroup=NULL;
+
+	for(rule=ndomod_export_rules;rule!=NULL;rule=rule->next){
+
+		switch(rule->type){
+
+		case NDOMOD_EXPORT_HOSTGROUP:
+			if(hst!=NULL && (temp_hostgroup=find_hostgroup(rule->name))!=NULL && is_host_member_of_hostgroup(temp_hostgroup,hst)==TRUE)
+				return NDO_TRUE;
+			break;
+		case NDOMOD_EXPORT_SERVICEGROUP:
+			if(svc!=NULL && (temp_servicegroup=find_servicegroup(rule->name))!=NULL && is_service_member_of_servicegroup(temp_servicegroup,svc)==TRUE)
+				return NDO_TRUE;
+			break;
+		case NDOMOD_EXPORT_HOST_NAME:
+			if(hst!=NULL && hst->name!=NULL && regexec(&rule->regex,hst->name,0,NULL,0)==0)
+				return NDO_TRUE;
+			break;
+		case NDOMOD_EXPORT_SERVICE_NAME:
+			if(svc!=NULL && svc->description!=NULL && regexec(&rule->regex,svc->description,0,NULL,0)==0)
+				return NDO_TRUE;
+			break;
 #if ( defined( BUILD_NAGIOS_3X) || defined( BUILD_NAGIOS_4X))
-	if(result==NDO_OK && (ndomod_process_options & NDOMOD_PROCESS_CONTACT_STATUS_DATA)) {
-		result=neb_register_callback(NEBCALLBACK_CONTACT_STATUS_DATA,ndomod_module_handle,priority,ndomod_broker_data);
-		asprintf(&msg,"ndomod registered for contact status data\'");
-		ndomod_write_to_logs(msg,NSLOG_INFO_MESSAGE);
+		case NDOMOD_EXPORT_CUSTOM_VARIABLE:
+			if(ndomod_export_customvar_set((svc!=NULL)?svc->custom_variables:hst->custom_variables,rule->name)==NDO_TRUE)
+				return NDO_TRUE;
+			break;
+#endif
+		default:
+			break;
+			}
 		}
-	if(result==NDO_OK && (ndomod_process_options & NDOMOD_PROCESS_ADAPTIVE_CONTACT_DATA)) {
-		result=neb_register_callback(NEBCALLBACK_ADAPTIVE_CONTACT_DATA,ndomod_module_handle,priority,ndomod_broker_data);
-		asprintf(&msg,"ndomod registered for adaptive contact data\'");
-		ndomod_write_to_logs(msg,NSLOG_INFO_MESSAGE);
+
+	return NDO_FALSE;
+	}
+
+
+#ifndef BUILD_NAGIOS_4X
+/* older cores have no object ids, so the verdict lives with the object's key */
+static ndomod_object_key *ndomod_find_object_key(void *object){
+	ndomod_object_key *ok=NULL;
+
+	for(ok=ndomod_object_key_hashlist[((unsigned long)object>>4)%NDOMOD_OBJECT_KEY_HASHSLOTS]; ok!=NULL; ok=ok->next) {
+		if(ok->object==object)
+			break;
 		}
+
+	return ok;
+	}
 #endif
 
-	free(msg);
 
-	return result;
-        }
+/* tells whether the export filters let a host through */
+static int ndomod_host_exported(host *hst){
+#ifndef BUILD_NAGIOS_4X
+	ndomod_object_key *ok=NULL;
+#endif
 
+	if(ndomod_export_rules==NULL || hst==NULL)
+		return NDO_TRUE;
 
-/* deregisters callbacks */
-int ndomod_deregister_callbacks(void){
+#ifdef BUILD_NAGIOS_4X
+	if(ndomod_export_hosts==NULL)
+		return NDO_TRUE;
+	return bitmap_isset(ndomod_export_hosts,hst->id)?NDO_TRUE:NDO_FALSE;
+#else
+	ok=ndomod_find_object_key(hst);
+	return (ok==NULL)?NDO_TRUE:ok->exported;
+#endif
+	}
 
-	neb_deregister_callback(NEBCALLBACK_PROCESS_DATA,ndomod_broker_data);
-	neb_deregister_callback(NEBCALLBACK_TIMED_EVENT_DATA,ndomod_broker_data);
-	neb_deregister_callback(NEBCALLBACK_LOG_DATA,ndomod_broker_data);
-	neb_deregister_callback(NEBCALLBACK_SYSTEM_COMMAND_DATA,ndomod_broker_data);
-	neb_deregister_callback(NEBCALLBACK_EVENT_HANDLER_DATA,ndomod_broker_data);
-	neb_deregister_callback(NEBCALLBACK_NOTIFICATION_DATA,ndomod_broker_data);
-	neb_deregister_callback(NEBCALLBACK_SERVICE_CHECK_DATA,ndomod_broker_data);
-	neb_deregister_callback(NEBCALLBACK_HOST_CHECK_DATA,ndomod_broker_data);
-	neb_deregister_callback(NEBCALLBACK_COMMENT_DATA,ndomod_broker_data);
-	neb_deregister_callback(NEBCALLBACK_DOWNTIME_DATA,ndomod_broker_data);
-	neb_deregister_callback(NEBCALLBACK_FLAPPING_DATA,ndomod_broker_data);
-	neb_deregister_callback(NEBCALLBACK_PROGRAM_STATUS_DATA,ndomod_broker_data);
-	neb_deregister_callback(NEBCALLBACK_HOST_STATUS_DATA,ndomod_broker_data);
-	neb_deregister_callback(NEBCALLBACK_SERVICE_STATUS_DATA,ndomod_broker_data);
-	neb_deregister_callback(NEBCALLBACK_ADAPTIVE_PROGRAM_DATA,ndomod_broker_data);
-	neb_deregister_callback(NEBCALLBACK_ADAPTIVE_HOST_DATA,ndomod_broker_data);
-	neb_deregister_callback(NEBCALLBACK_ADAPTIVE_SERVICE_DATA,ndomod_broker_data);
-	neb_deregister_callback(NEBCALLBACK_EXTERNAL_COMMAND_DATA,ndomod_broker_data);
-	neb_deregister_callback(NEBCALLBACK_AGGREGATED_STATUS_DATA,ndomod_broker_data);
-	neb_deregister_callback(NEBCALLBACK_RETENTION_DATA,ndomod_broker_data);
-	neb_deregister_callback(NEBCALLBACK_CONTACT_NOTIFICATION_DATA,ndomod_broker_data);
-	neb_deregister_callback(NEBCALLBACK_CONTACT_NOTIFICATION_METHOD_DATA,ndomod_broker_data);
-	neb_deregister_callback(NEBCALLBACK_ACKNOWLEDGEMENT_DATA,ndomod_broker_data);
-	neb_deregister_callback(NEBCALLBACK_STATE_CHANGE_DATA,ndomod_broker_data);
-#if ( defined( BUILD_NAGIOS_3X) || defined( BUILD_NAGIOS_4X))
-	neb_deregister_callback(NEBCALLBACK_CONTACT_STATUS_DATA,ndomod_broker_data);
-	neb_deregister_callback(NEBCALLBACK_ADAPTIVE_CONTACT_DATA,ndomod_broker_data);
+
+/* tells whether the export filters let a service through */
+static int ndomod_service_exported(service *svc){
+#ifndef BUILD_NAGIOS_4X
+	ndomod_object_key *ok=NULL;
 #endif
 
-	return NDO_OK;
-        }
+	if(ndomod_export_rules==NULL || svc==NULL)
+		return NDO_TRUE;
+
+#ifdef BUILD_NAGIOS_4X
+	if(ndomod_export_services==NULL)
+		return NDO_TRUE;
+	return bitmap_isset(ndomod_export_services,svc->id)?NDO_TRUE:NDO_FALSE;
+#else
+	ok=ndomod_find_object_key(svc);
+	return (ok==NULL)?NDO_TRUE:ok->exported;
+#endif
+	}
+
+
+/* evaluates the export rules for every host and service, after the config has been (re)read */
+int ndomod_load_export_filters(void){
+	char temp_buffer[NDOMOD_MAX_BUFLEN];
+	host *temp_host=NULL;
+	service *temp_service=NULL;
+	unsigned long hosts=0L;
+	unsigned long services=0L;
+	unsigned long exported_hosts=0L;
+	unsigned long exported_services=0L;
+	int exported=NDO_FALSE;
+#ifndef BUILD_NAGIOS_4X
+	ndomod_object_key *ok=NULL;
+#endif
+
+	if(ndomod_export_rules==NULL)
+		return NDO_OK;
+
+#ifdef BUILD_NAGIOS_4X
+	if(ndomod_export_hosts!=NULL)
+		bitmap_destroy(ndomod_export_hosts);
+	if(ndomod_export_services!=NULL)
+		bitmap_destroy(ndomod_export_services);
+	ndomod_export_hosts=bitmap_create(num_objects.hosts+1);
+	ndomod_export_services=bitmap_create(num_objects.services+1);
+	if(ndomod_export_hosts==NULL || ndomod_export_services==NULL){
+		/* without both bitmaps everything goes through */
+		if(ndomod_export_hosts!=NULL)
+			bitmap_destroy(ndomod_export_hosts);
+		if(ndomod_export_services!=NULL)
+			bitmap_destroy(ndomod_export_services);
+		ndomod_export_hosts=NULL;
+		ndomod_export_services=NULL;
+		return NDO_ERROR;
+		}
+#endif
+
+	/* hosts go through if they match a host rule, or if there are only service rules */
+	for(temp_host=host_list;temp_host!=NULL;temp_host=temp_host->next){
+		hosts++;
+		exported=(ndomod_export_host_rules==0 || ndomod_export_rule_matches(temp_host,NULL)==NDO_TRUE)?NDO_TRUE:NDO_FALSE;
+		if(exported==NDO_TRUE)
+			exported_hosts++;
+#ifdef BUILD_NAGIOS_4X
+		if(exported==NDO_TRUE)
+			bitmap_set(ndomod_export_hosts,temp_host->id);
+#else
+		if((ok=ndomod_find_object_key(temp_host))!=NULL)
+			ok->exported=exported;
+#endif
+		}
 
-static void ndomod_enddata_serialize(ndo_dbuf *dbufp) {
+	/* services go through if their host matched a host rule, or they match a service rule themselves */
+	for(temp_service=service_list;temp_service!=NULL;temp_service=temp_service->next){
+		services++;
+		exported=NDO_FALSE;
+		if(ndomod_export_host_rules>0 && ndomod_host_exported(find_host(temp_service->host_name))==NDO_TRUE)
+			exported=NDO_TRUE;
+		else if(ndomod_export_service_rules>0 && ndomod_export_rule_matches(NULL,temp_service)==NDO_TRUE)
+			exported=NDO_TRUE;
+		if(exported==NDO_TRUE)
+			exported_services++;
+#ifdef BUILD_NAGIOS_4X
+		if(exported==NDO_TRUE)
+			bitmap_set(ndomod_export_services,temp_service->id);
+#else
+		if((ok=ndomod_find_object_key(temp_service))!=NULL)
+			ok->exported=exported;
+#endif
+		}
 
-	char temp[64];
+	snprintf(temp_buffer,sizeof(temp_buffer)-1,"ndomod: Export filters pass %lu of %lu hosts and %lu of %lu services.",
+		 exported_hosts,hosts,exported_services,services);
+	temp_buffer[sizeof(temp_buffer)-1]='\x0';
+	ndomod_write_to_logs(temp_buffer,NSLOG_INFO_MESSAGE);
 
-	snprintf(temp, sizeof(temp)-1, "\n%d\n\n", NDO_API_ENDDATA);
-	temp[sizeof(temp)-1] = '\x0';
-	ndo_dbuf_strcat(dbufp, temp);
+	return NDO_OK;
 	}
 
-static void ndomod_broker_data_serialize(ndo_dbuf *dbufp, int datatype,
-		struct ndo_broker_data *bd, size_t bdsize, int add_enddata) {
-
-	size_t bufused = 0;
-	char temp[64];
-	int	x;
-	struct ndo_broker_data *bdp;
-
-	/* Start everything out with the broker data type */
-	snprintf(temp, sizeof(temp)-1, "\n%d:", datatype);
-	temp[sizeof(temp)-1]='\x0';
-	ndo_dbuf_strcat(dbufp, temp);
-
-	/* Add each value */
-	for(x = 0, bdp = bd; x < bdsize; x++, bdp++) {
-		switch(bdp->datatype) {
-		case BD_INT:
-			snprintf(temp, sizeof(temp)-1, "\n%d=%d", bdp->key,
-					bdp->value.integer);
-			temp[sizeof(temp)-1]='\x0';
-			ndo_dbuf_strcat(dbufp, temp);
-			break;
-		case BD_TIMEVAL:
-			snprintf(temp, sizeof(temp)-1, "\n%d=%ld.%06ld", bdp->key,
-					bdp->value.timestamp.tv_sec, bdp->value.timestamp.tv_usec);
-			temp[sizeof(temp)-1]='\x0';
-			ndo_dbuf_strcat(dbufp, temp);
-			break;
-		case BD_STRING:
-			snprintf(temp, sizeof(temp)-1, "\n%d=", bdp->key);
-			temp[sizeof(temp)-1]='\x0';
-			ndo_dbuf_strcat(dbufp, temp);
-			ndo_dbuf_strcat(dbufp, bdp->value.string);
-			break;
-		case BD_UNSIGNED_LONG:
-			snprintf(temp, sizeof(temp)-1, "\n%d=%lu", bdp->key,
-					bdp->value.unsigned_long);
-			temp[sizeof(temp)-1]='\x0';
-			ndo_dbuf_strcat(dbufp, temp);
-			break;
-		case BD_FLOAT:
-			snprintf(temp, sizeof(temp)-1, "\n%d=%.5lf", bdp->key,
-					bdp->value.floating_point);
-			temp[sizeof(temp)-1]='\x0';
-			ndo_dbuf_strcat(dbufp, temp);
-			break;
+
+/* tells whether an event is about a host or service the export filters leave out */
+static int ndomod_event_filtered(int event_type, void *data){
+	void *object=NULL;
+	char *host_name=NULL;
+	char *service_description=NULL;
+	int is_service=NDO_FALSE;
+
+	switch(event_type){
+
+	case NEBCALLBACK_HOST_STATUS_DATA:
+		object=((nebstruct_host_status_data *)data)->object_ptr;
+		break;
+	case NEBCALLBACK_SERVICE_STATUS_DATA:
+		object=((nebstruct_service_status_data *)data)->object_ptr;
+		is_service=NDO_TRUE;
+		break;
+	case NEBCALLBACK_ADAPTIVE_HOST_DATA:
+		object=((nebstruct_adaptive_host_data *)data)->object_ptr;
+		break;
+	case NEBCALLBACK_ADAPTIVE_SERVICE_DATA:
+		object=((nebstruct_adaptive_service_data *)data)->object_ptr;
+		is_service=NDO_TRUE;
+		break;
+
+	/* the rest carry names, and on newer cores the object as well */
+	case NEBCALLBACK_HOST_CHECK_DATA:
+		host_name=((nebstruct_host_check_data *)data)->host_name;
+#if ( defined( BUILD_NAGIOS_3X) || defined( BUILD_NAGIOS_4X))
+		object=((nebstruct_host_check_data *)data)->object_ptr;
+#endif
+		break;
+	case NEBCALLBACK_SERVICE_CHECK_DATA:
+		host_name=((nebstruct_service_check_data *)data)->host_name;
+		service_description=((nebstruct_service_check_data *)data)->service_description;
+#if ( defined( BUILD_NAGIOS_3X) || defined( BUILD_NAGIOS_4X))
+		object=((nebstruct_service_check_data *)data)->object_ptr;
+#endif
+		break;
+	case NEBCALLBACK_EVENT_HANDLER_DATA:
+		host_name=((nebstruct_event_handler_data *)data)->host_name;
+		service_description=((nebstruct_event_handler_data *)data)->service_description;
+		break;
+	case NEBCALLBACK_NOTIFICATION_DATA:
+		host_name=((nebstruct_notification_data *)data)->host_name;
+		service_description=((nebstruct_notification_data *)data)->service_description;
+		break;
+	case NEBCALLBACK_CONTACT_NOTIFICATION_DATA:
+		host_name=((nebstruct_contact_notification_data *)data)->host_name;
+		service_description=((nebstruct_contact_notification_data *)data)->service_description;
+		break;
+	case NEBCALLBACK_CONTACT_NOTIFICATION_METHOD_DATA:
+		host_name=((nebstruct_contact_notification_method_data *)data)->host_name;
+		service_description=((nebstruct_contact_notification_method_data *)data)->service_description;
+		break;
+	case NEBCALLBACK_COMMENT_DATA:
+		host_name=((nebstruct_comment_data *)data)->host_name;
+		service_description=((nebstruct_comment_data *)data)->service_description;
+		break;
+	case NEBCALLBACK_DOWNTIME_DATA:
+		host_name=((nebstruct_downtime_data *)data)->host_name;
+		service_description=((nebstruct_downtime_data *)data)->service_description;
+		break;
+	case NEBCALLBACK_FLAPPING_DATA:
+		host_name=((nebstruct_flapping_data *)data)->host_name;
+		service_description=((nebstruct_flapping_data *)data)->service_description;
+		break;
+	case NEBCALLBACK_ACKNOWLEDGEMENT_DATA:
+		host_name=((nebstruct_acknowledgement_data *)data)->host_name;
+		service_description=((nebstruct_acknowledgement_data *)data)->service_description;
+		break;
+	case NEBCALLBACK_STATE_CHANGE_DATA:
+		host_name=((nebstruct_statechange_data *)data)->host_name;
+		service_description=((nebstruct_statechange_data *)data)->service_description;
+		break;
+	default:
+		return NDO_FALSE;
+		}
+
+	if(object==NULL){
+		if(host_name==NULL)
+			return NDO_FALSE;
+		if(service_description!=NULL && service_description[0]!='\x0'){
+			is_service=NDO_TRUE;
+			object=find_service(host_name,service_description);
 			}
+		else
+			object=find_host(host_name);
 		}
+	else if(service_description!=NULL && service_description[0]!='\x0')
+		is_service=NDO_TRUE;
 
-	/* Close everything out with an NDO_API_ENDDATA marker */
-	if(FALSE != add_enddata) {
-		ndomod_enddata_serialize(dbufp);
-		}
+	if(is_service==NDO_TRUE)
+		return (ndomod_service_exported((service *)object)==NDO_TRUE)?NDO_FALSE:NDO_TRUE;
 
+	return (ndomod_host_exported((host *)object)==NDO_TRUE)?NDO_FALSE:NDO_TRUE;
 	}
 
-#if ( defined( BUILD_NAGIOS_3X) || defined( BUILD_NAGIOS_4X))
-static void ndomod_customvars_serialize(customvariablesmember *customvars,
-	ndo_dbuf *dbufp) {
-
-	customvariablesmember *temp_customvar = NULL;
-	char * cvname;
-	char * cvvalue;
-	char temp_buffer[NDOMOD_MAX_BUFLEN];
-
-	for(temp_customvar = customvars; temp_customvar != NULL;
-			temp_customvar = temp_customvar->next) {
 
-		cvname = ndo_escape_buffer(temp_customvar->variable_name);
-		cvvalue = ndo_escape_buffer(temp_customvar->variable_value);
+/* frees the export rules and filters */
+void ndomod_free_export_filters(void){
+	ndomod_export_rule *rule=NULL;
+	ndomod_export_rule *next_rule=NULL;
 
-		snprintf(temp_buffer, sizeof(temp_buffer)-1, "\n%d=%s:%d:%s",
-				NDO_DATA_CUSTOMVARIABLE, (NULL == cvname) ? "" : cvname,
-				temp_customvar->has_been_modified,
-				(NULL == cvvalue ) ? "" : cvvalue);
+	for(rule=ndomod_export_rules;rule!=NULL;rule=next_rule){
+		next_rule=rule->next;
+		if(rule->type==NDOMOD_EXPORT_HOST_NAME || rule->type==NDOMOD_EXPORT_SERVICE_NAME)
+			regfree(&rule->regex);
+		my_free(rule->name);
+		free(rule);
+		}
+	ndomod_export_rules=NULL;
+	ndomod_export_host_rules=0;
+	ndomod_export_service_rules=0;
 
-		temp_buffer[sizeof(temp_buffer)-1] = '\x0';
-		ndo_dbuf_strcat(dbufp, temp_buffer);
+#ifdef BUILD_NAGIOS_4X
+	if(ndomod_export_hosts!=NULL)
+		bitmap_destroy(ndomod_export_hosts);
+	if(ndomod_export_services!=NULL)
+		bitmap_destroy(ndomod_export_services);
+	ndomod_export_hosts=NULL;
+	ndomod_export_services=NULL;
+#endif
 
-		if(NULL != cvname) free(cvname);
-		if(NULL != cvvalue) free(cvvalue);
-		}
+	return;
 	}
-#endif
 
-static void ndomod_contactgroups_serialize(contactgroupsmember *contactgroups,
-	ndo_dbuf *dbufp) {
 
-	contactgroupsmember *temp_contactgroupsmember = NULL;
-	char *groupname;
+/****************************************************************************/
+/* RATE LIMIT FUNCTIONS                                                     */
+/****************************************************************************/
+
+/* picks the NEBTYPE sub-types sent for a callback ("<type>:all", "<type>:none" or "<type>:<nebtype> <nebtype>...") */
+int ndomod_set_event_subtypes(char *val){
 	char temp_buffer[NDOMOD_MAX_BUFLEN];
+	unsigned long long enabled=0L;
+	char *name=NULL;
+	char *list=NULL;
+	char *ptr=NULL;
+	int event_type=-1;
 
-	for(temp_contactgroupsmember = contactgroups;
-			temp_contactgroupsmember != NULL;
-			temp_contactgroupsmember = temp_contactgroupsmember->next) {
+	if(val==NULL || (name=strdup(val))==NULL)
+		return NDO_ERROR;
 
-		groupname = ndo_escape_buffer(temp_contactgroupsmember->group_name);
+	if((list=strchr(name,':'))!=NULL)
+		*list++='\x0';
+	ndomod_strip(name);
 
-		snprintf(temp_buffer, sizeof(temp_buffer)-1,"\n%d=%s",
-				NDO_DATA_CONTACTGROUP ,(NULL == groupname) ? "" : groupname);
-		temp_buffer[sizeof(temp_buffer)-1] = '\x0';
-		ndo_dbuf_strcat(dbufp, temp_buffer);
+	/* process and retention events also drive the config dumps, so they always come through */
+	if(list==NULL || (event_type=ndomod_event_type_id(name))<0 || event_type==NEBCALLBACK_PROCESS_DATA || event_type==NEBCALLBACK_RETENTION_DATA){
+		snprintf(temp_buffer,sizeof(temp_buffer)-1,"ndomod: Ignoring event_subtypes '%s': expected an event type other than process or retention followed by ':'",val);
+		temp_buffer[sizeof(temp_buffer)-1]='\x0';
+		ndomod_write_to_logs(temp_buffer,NSLOG_INFO_MESSAGE);
+		free(name);
+		return NDO_ERROR;
+		}
 
-		if(NULL != groupname) free(groupname);
+	for(ptr=strtok(list," ,");ptr!=NULL;ptr=strtok(NULL," ,")){
+		if(!strcmp(ptr,"all"))
+			enabled=NDOMOD_ALL_SUBTYPES;
+		else if(strcmp(ptr,"none"))
+			enabled|=NDOMOD_SUBTYPE(atoi(ptr));
 		}
-	}
+	ndomod_skipped_subtypes[event_type]=~enabled;
 
-#ifdef BUILD_NAGIOS_2X
-static void ndomod_contacts_serialize(contactgroupmember *contacts,
-	ndo_dbuf *dbufp, int varnum) {
+	free(name);
 
-	contactgroupmember *temp_contactgroupmember = NULL;
-	char *contact_name;
-	char temp_buffer[NDOMOD_MAX_BUFLEN];
+	return NDO_OK;
+	}
 
-	for(temp_contactgroupmember = contacts; temp_contactgroupmember != NULL;
-			temp_contactgroupmember=temp_contactgroupmember->next) {
 
-		contact_name = ndo_escape_buffer(temp_contactgroupmember->contact_name);
+/* sets up a rate limit ("<type>:<events per sec>[:<burst>]") or sampling ("<type>:<n>") from the config file */
+int ndomod_set_event_limit(char *val, int sampling){
+	char temp_buffer[NDOMOD_MAX_BUFLEN];
+	ndomod_event_limit *limit=NULL;
+	char *name=NULL;
+	char *arg1=NULL;
+	char *arg2=NULL;
+	int event_type=-1;
 
-		snprintf(temp_buffer, sizeof(temp_buffer)-1, "\n%d=%s", varnum,
-				(NULL == contact_name) ? "" : contact_name);
-		temp_buffer[sizeof(temp_buffer)-1] = '\x0';
-		ndo_dbuf_strcat(dbufp, temp_buffer);
+	if(val==NULL || (name=strdup(val))==NULL)
+		return NDO_ERROR;
 
-		if(NULL != contact_name) free(contact_name);
+	if((arg1=strchr(name,':'))!=NULL){
+		*arg1++='\x0';
+		if((arg2=strchr(arg1,':'))!=NULL)
+			*arg2++='\x0';
 		}
-	}
-
-#else
-static void ndomod_contacts_serialize(contactsmember *contacts,
-	ndo_dbuf *dbufp, int varnum) {
+	ndomod_strip(name);
 
-	contactsmember *temp_contactsmember = NULL;
-	char *contact_name;
-	char temp_buffer[NDOMOD_MAX_BUFLEN];
+	if(arg1==NULL || (event_type=ndomod_event_type_id(name))<0){
+		snprintf(temp_buffer,sizeof(temp_buffer)-1,"ndomod: Ignoring %s '%s': expected an event type such as service_check followed by ':'",(sampling==NDO_TRUE)?"sample":"rate_limit",val);
+		temp_buffer[sizeof(temp_buffer)-1]='\x0';
+		ndomod_write_to_logs(temp_buffer,NSLOG_INFO_MESSAGE);
+		free(name);
+		return NDO_ERROR;
+		}
 
-	for(temp_contactsmember = contacts; temp_contactsmember != NULL;
-			temp_contactsmember = temp_contactsmember->next) {
+	limit=&ndomod_limits[event_type];
+	if(sampling==NDO_TRUE)
+		limit->sample=strtoul(arg1,NULL,0);
+	else{
+		limit->rate=strtod(arg1,NULL);
+		limit->burst=(arg2!=NULL)?strtod(arg2,NULL):limit->rate;
+		if(limit->burst<1.0)
+			limit->burst=1.0;
+		limit->tokens=limit->burst;
+		limit->last_refill=0L;
+		}
 
-		contact_name = ndo_escape_buffer(temp_contactsmember->contact_name);
+	if(limit->rate>0.0 || limit->sample>1)
+		ndomod_limits_active=NDO_TRUE;
 
-		snprintf(temp_buffer, sizeof(temp_buffer)-1, "\n%d=%s", varnum,
-				(NULL == contact_name) ? "" : contact_name);
-		temp_buffer[sizeof(temp_buffer)-1] = '\x0';
-		ndo_dbuf_strcat(dbufp, temp_buffer);
+	free(name);
 
-		if(NULL != contact_name) free(contact_name);
-		}
+	return NDO_OK;
 	}
-#endif
 
-#ifdef BUILD_NAGIOS_2X
-static void ndomod_hosts_serialize_2x(hostgroupmember *hosts, ndo_dbuf *dbufp,
-		int varnum) {
 
-	hostgroupmember *temp_hostgroupmember=NULL;
-	char *host_name;
-	char temp_buffer[NDOMOD_MAX_BUFLEN];
+/* hard state changes and notifications always go through */
+static int ndomod_event_exempt(int event_type, void *data){
+	nebstruct_service_check_data *scdata=NULL;
+	nebstruct_host_check_data *hcdata=NULL;
+	service *temp_service=NULL;
+	host *temp_host=NULL;
 
-	for(temp_hostgroupmember = hosts; temp_hostgroupmember != NULL;
-			temp_hostgroupmember = temp_hostgroupmember->next) {
+	switch(event_type){
+
+	case NEBCALLBACK_NOTIFICATION_DATA:
+	case NEBCALLBACK_CONTACT_NOTIFICATION_DATA:
+	case NEBCALLBACK_CONTACT_NOTIFICATION_METHOD_DATA:
+	case NEBCALLBACK_STATE_CHANGE_DATA:
+		return NDO_TRUE;
 
-		host_name = ndo_escape_buffer(temp_hostgroupmember->host_name);
+	/* a check result that changed the hard state has it stamped with the check time */
+	case NEBCALLBACK_SERVICE_CHECK_DATA:
+		scdata=(nebstruct_service_check_data *)data;
+		if(scdata->type!=NEBTYPE_SERVICECHECK_PROCESSED)
+			return NDO_FALSE;
+#if ( defined( BUILD_NAGIOS_3X) || defined( BUILD_NAGIOS_4X))
+		temp_service=(service *)scdata->object_ptr;
+#endif
+		if(temp_service==NULL && scdata->host_name!=NULL && scdata->service_description!=NULL)
+			temp_service=find_service(scdata->host_name,scdata->service_description);
+		if(temp_service!=NULL && temp_service->state_type==HARD_STATE && temp_service->last_hard_state_change==temp_service->last_check)
+			return NDO_TRUE;
+		break;
 
-		snprintf(temp_buffer, sizeof(temp_buffer)-1, "\n%d=%s", varnum,
-				(NULL == host_name) ? "" : host_name);
-		temp_buffer[sizeof(temp_buffer)-1] =  '\x0';
-		ndo_dbuf_strcat(dbufp, temp_buffer);
+	case NEBCALLBACK_HOST_CHECK_DATA:
+		hcdata=(nebstruct_host_check_data *)data;
+		if(hcdata->type!=NEBTYPE_HOSTCHECK_PROCESSED)
+			return NDO_FALSE;
+#if ( defined( BUILD_NAGIOS_3X) || defined( BUILD_NAGIOS_4X))
+		temp_host=(host *)hcdata->object_ptr;
+#endif
+		if(temp_host==NULL && hcdata->host_name!=NULL)
+			temp_host=find_host(hcdata->host_name);
+		if(temp_host!=NULL && temp_host->state_type==HARD_STATE && temp_host->last_hard_state_change==temp_host->last_check)
+			return NDO_TRUE;
+		break;
 
-		if(NULL != host_name) free(host_name);
+	default:
+		break;
 		}
+
+	return NDO_FALSE;
 	}
-#endif
 
-static void ndomod_hosts_serialize(hostsmember *hosts, ndo_dbuf *dbufp,
-		int varnum) {
 
-	hostsmember *temp_hostsmember = NULL;
-	char *host_name;
-	char temp_buffer[NDOMOD_MAX_BUFLEN];
+/* decides whether an event is dropped by sampling or the rate limit of its type */
+static int ndomod_shed_event(int event_type, void *data){
+	ndomod_event_limit *limit=NULL;
+	unsigned long long now=0L;
 
-	for(temp_hostsmember = hosts; temp_hostsmember != NULL;
-			temp_hostsmember = temp_hostsmember->next) {
+	if(event_type<0 || event_type>=NEBCALLBACK_NUMITEMS)
+		return NDO_FALSE;
 
-		host_name = ndo_escape_buffer(temp_hostsmember->host_name);
+	limit=&ndomod_limits[event_type];
+	if(limit->sample<=1 && limit->rate<=0.0)
+		return NDO_FALSE;
 
-		snprintf(temp_buffer, sizeof(temp_buffer)-1, "\n%d=%s", varnum,
-				(NULL == host_name) ? "" : host_name);
-		temp_buffer[sizeof(temp_buffer)-1] =  '\x0';
-		ndo_dbuf_strcat(dbufp, temp_buffer);
+	if(ndomod_event_exempt(event_type,data)==NDO_TRUE)
+		return NDO_FALSE;
 
-		if(NULL != host_name) free(host_name);
+	/* keep every nth event */
+	if(limit->sample>1){
+		if(limit->sample_count++%limit->sample!=0){
+			limit->sampled++;
+			return NDO_TRUE;
+			}
 		}
-	}
 
-#ifdef BUILD_NAGIOS_2X
-static void ndomod_services_serialize(servicegroupmember *services,
-		ndo_dbuf *dbufp, int varnum) {
+	/* token bucket, refilled at the configured rate up to the burst size */
+	if(limit->rate>0.0){
+		now=ndomod_stats_nsec();
+		if(limit->last_refill==0L)
+			limit->tokens=limit->burst;
+		else if(now>limit->last_refill){
+			limit->tokens+=limit->rate*(double)(now-limit->last_refill)/1000000000.0;
+			if(limit->tokens>limit->burst)
+				limit->tokens=limit->burst;
+			}
+		limit->last_refill=now;
 
-	servicegroupmember *temp_servicegroupmember = NULL;
-	char *host_name;
-	char *service_description;
-	char temp_buffer[NDOMOD_MAX_BUFLEN];
+		if(limit->tokens<1.0){
+			limit->rate_limited++;
+			return NDO_TRUE;
+			}
+		limit->tokens-=1.0;
+		}
 
-	for(temp_servicegroupmember = services; temp_servicegroupmember != NULL;
-			temp_servicegroupmember = temp_servicegroupmember->next) {
+	return NDO_FALSE;
+	}
 
-		host_name = ndo_escape_buffer(temp_servicegroupmember->host_name);
-		service_description = ndo_escape_buffer(temp_servicegroupmember->service_description);
 
-		snprintf(temp_buffer, sizeof(temp_buffer)-1, "\n%d=%s;%s", varnum,
-				(NULL == host_name) ? "" : host_name,
-				(NULL == service_description) ? "" : service_description);
-		temp_buffer[sizeof(temp_buffer)-1] = '\x0';
-		ndo_dbuf_strcat(dbufp, temp_buffer);
+/* events dropped by rate limits and sampling since the module was loaded */
+unsigned long ndomod_events_shed(void){
+	unsigned long shed=0L;
+	int x;
 
-		if(NULL != host_name) free(host_name);
-		if(NULL != service_description) free(service_description);
-		}
+	for(x=0;x<NEBCALLBACK_NUMITEMS;x++)
+		shed+=ndomod_limits[x].rate_limited+ndomod_limits[x].sampled;
+
+	return shed;
 	}
-#else
-static void ndomod_services_serialize(servicesmember *services, ndo_dbuf *dbufp,
-		int varnum) {
 
-	servicesmember *temp_servicesmember = NULL;
-	char *host_name;
-	char *service_description;
-	char temp_buffer[NDOMOD_MAX_BUFLEN];
 
-	for(temp_servicesmember = services; temp_servicesmember != NULL;
-			temp_servicesmember=temp_servicesmember->next) {
+/* serializes a host or service status - in delta mode fields that haven't changed since
+   the last update are left out, except for the first idfields which identify the object */
+static ndomod_delta_state *ndomod_status_serialize(ndo_dbuf *dbufp, int datatype,
+		int deltatype, void *object, struct ndo_broker_data *bd, size_t bdsize,
+		size_t idfields, unsigned long *frame_start) {
 
-		host_name = ndo_escape_buffer(temp_servicesmember->host_name);
-		service_description = ndo_escape_buffer(temp_servicesmember->service_description);
+	struct ndo_broker_data sendbd[NDOMOD_DELTA_MAX_FIELDS];
+	unsigned long long fp;
+	ndomod_delta_state *ds;
+	size_t x;
+	size_t nsend = 0;
 
-		snprintf(temp_buffer, sizeof(temp_buffer)-1, "\n%d=%s;%s", varnum,
-				(NULL == host_name) ? "" : host_name,
-				(NULL == service_description) ? "" : service_description);
-		temp_buffer[sizeof(temp_buffer)-1] = '\x0';
-		ndo_dbuf_strcat(dbufp, temp_buffer);
+	if(ndomod_status_delta_resync==0 || bdsize>NDOMOD_DELTA_MAX_FIELDS ||
+			(ds=ndomod_get_delta_state(object, bdsize))==NULL ||
+			ds->nfields!=bdsize) {
+		*frame_start = ndomod_broker_data_serialize(dbufp, datatype, bd, bdsize, FALSE);
+		return NULL;
+		}
 
-		if(NULL != host_name) free(host_name);
-		if(NULL != service_description) free(service_description);
+	/* ndo2db gets everything now and then, and after every (re)connect */
+	if(ds->generation!=ndomod_sink_generation) {
+		ds->generation=ndomod_sink_generation;
+		ds->send_full=NDO_TRUE;
+		}
+	if((ds->updates++ % ndomod_status_delta_resync)==0)
+		ds->send_full=NDO_TRUE;
+
+	for(x = 0; x < bdsize; x++) {
+		fp=ndomod_broker_data_fingerprint(&bd[x]);
+		if(fp!=ds->fields[x]) {
+			ds->fields[x]=fp;
+			ds->dirty|=(1ULL<<x);
+			}
+		if(ds->send_full==NDO_TRUE || x<idfields || (ds->dirty & (1ULL<<x)))
+			sendbd[nsend++]=bd[x];
 		}
+
+	*frame_start = ndomod_broker_data_serialize(dbufp, (ds->send_full==NDO_TRUE) ? datatype : deltatype,
+			sendbd, nsend, FALSE);
+
+	return ds;
 	}
-#endif
 
-static void ndomod_commands_serialize(commandsmember *commands, ndo_dbuf *dbufp,
-		int varnum) {
 
-	commandsmember *temp_commandsmember = NULL;
-	char *command;
-	char temp_buffer[NDOMOD_MAX_BUFLEN];
+#if ( defined( BUILD_NAGIOS_3X) || defined( BUILD_NAGIOS_4X))
+/* serializes status custom variables, leaving them out of a delta if none of them changed */
+static void ndomod_status_customvars_serialize(ndomod_delta_state *ds,
+		customvariablesmember *customvars, ndo_dbuf *dbufp) {
 
-	for(temp_commandsmember = commands; temp_commandsmember != NULL;
-			temp_commandsmember=temp_commandsmember->next){
+	unsigned long start = dbufp->used_size;
+	unsigned long long hash;
+
+	ndomod_customvars_serialize(customvars, dbufp);
 
-		command = ndo_escape_buffer(temp_commandsmember->command);
+	if(ds==NULL)
+		return;
 
-		snprintf(temp_buffer, sizeof(temp_buffer)-1, "\n%d=%s", varnum,
-				(command == NULL) ? "" : command);
-		temp_buffer[sizeof(temp_buffer)-1] = '\x0';
-		ndo_dbuf_strcat(dbufp, temp_buffer);
+	hash=ndomod_hash_string(dbufp->buf+start);
+	if(hash!=ds->customvars) {
+		ds->customvars=hash;
+		ds->customvars_dirty=NDO_TRUE;
+		}
 
-		if(NULL != command) free(command);
+	if(ds->send_full==NDO_FALSE && ds->customvars_dirty==NDO_FALSE) {
+		dbufp->used_size=start;
+		dbufp->buf[start]='\x0';
 		}
 	}
+#endif
+
 
 /* handles brokered event data */
-int ndomod_broker_data(int event_type, void *data){
+static int ndomod_handle_broker_data(int event_type, void *data){
 	char temp_buffer[NDOMOD_MAX_BUFLEN];
 	size_t tbsize = sizeof(temp_buffer);
 	ndo_dbuf dbuf;
 	int write_to_sink=NDO_TRUE;
+	unsigned long long objkey=0L;
+	ndomod_event_stats *st=NULL;
+	unsigned long long phase_start=0L;
+	unsigned long long escape_start=0L;
+	unsigned long long now=0L;
+	ndomod_delta_state *ds=NULL;
+	unsigned long frame_start=0L;
 	host *temp_host=NULL;
 	service *temp_service=NULL;
 #if ( defined( BUILD_NAGIOS_3X) || defined( BUILD_NAGIOS_4X))
@@ -1794,13 +4730,31 @@ int ndomod_broker_data(int event_type, void *data){
 		break;
 		}
 
+	/* leave out hosts and services the export filters don't pick */
+	if(ndomod_export_rules!=NULL && ndomod_event_filtered(event_type,data)==NDO_TRUE){
+		if(ndomod_collect_stats==NDO_TRUE && event_type>=0 && event_type<NEBCALLBACK_NUMITEMS)
+			ndomod_stats[event_type].filtered++;
+		return 0;
+		}
+
+	/* shed events over the configured rate or outside the sample */
+	if(ndomod_limits_active==NDO_TRUE && ndomod_shed_event(event_type,data)==NDO_TRUE)
+		return 0;
+
+
+	/* time serialization (escaping included) and the sink write separately */
+	if(ndomod_collect_stats==NDO_TRUE && event_type>=0 && event_type<NEBCALLBACK_NUMITEMS){
+		st=&ndomod_stats[event_type];
+		escape_start=ndomod_escape_nsec;
+		phase_start=ndomod_stats_nsec();
+		}
 
-	/* initialize escaped buffers */
+	/* string fields are escaped as they are serialized, so these just point at Nagios' data */
 	for(x=0;x<8;x++)
 		es[x]=NULL;
 
-	/* initialize dynamic buffer (2KB chunk size) */
-	ndo_dbuf_init(&dbuf,2048);
+	/* grab the reusable output buffer */
+	ndomod_acquire_output_buffer(&dbuf);
 
 	/* handle the event */
 	switch(event_type){
@@ -1808,8 +4762,11 @@ int ndomod_broker_data(int event_type, void *data){
 	case NEBCALLBACK_PROCESS_DATA:
 
 		procdata=(nebstruct_process_data *)data;
-		if (procdata->type == NEBTYPE_PROCESS_START)
+		if (procdata->type == NEBTYPE_PROCESS_START) {
+			ndomod_load_object_keys();
+			ndomod_load_export_filters();
 			ndomod_write_active_objects();
+		}
 
 		{
 			struct ndo_broker_data process_data[] = {
@@ -1818,10 +4775,10 @@ int ndomod_broker_data(int event_type, void *data){
 				{ NDO_DATA_ATTRIBUTES, BD_INT, { .integer = procdata->attr }},
 				{ NDO_DATA_TIMESTAMP, BD_TIMEVAL,
 						{ .timestamp = procdata->timestamp }},
-				{ NDO_DATA_PROGRAMNAME, BD_STRING, { .string = "Nagios" }},
-				{ NDO_DATA_PROGRAMVERSION, BD_STRING,
+				{ NDO_DATA_PROGRAMNAME, BD_STRING_ESCAPE, { .string = "Nagios" }},
+				{ NDO_DATA_PROGRAMVERSION, BD_STRING_ESCAPE,
 						{ .string = get_program_version() }},
-				{ NDO_DATA_PROGRAMDATE, BD_STRING,
+				{ NDO_DATA_PROGRAMDATE, BD_STRING_ESCAPE,
 						{ .string = get_program_modification_date() }},
 				{ NDO_DATA_PROCESSID, BD_UNSIGNED_LONG,
 						{ .unsigned_long = (unsigned long)getpid() }}
@@ -1843,8 +4800,8 @@ int ndomod_broker_data(int event_type, void *data){
 		case EVENT_SERVICE_CHECK:
 			temp_service=(service *)eventdata->event_data;
 
-			es[0]=ndo_escape_buffer(temp_service->host_name);
-			es[1]=ndo_escape_buffer(temp_service->description);
+			es[0]=temp_service->host_name;
+			es[1]=temp_service->description;
 
 			{
 				struct ndo_broker_data timed_event_data[] = {
@@ -1860,9 +4817,9 @@ int ndomod_broker_data(int event_type, void *data){
 							{ .integer = eventdata->recurring }},
 					{ NDO_DATA_RUNTIME, BD_UNSIGNED_LONG, { .unsigned_long =
 							(unsigned long)eventdata->run_time }},
-					{ NDO_DATA_HOST, BD_STRING,
+					{ NDO_DATA_HOST, BD_STRING_ESCAPE,
 							{ .string = (es[0]==NULL) ? "" : es[0] }},
-					{ NDO_DATA_SERVICE, BD_STRING,
+					{ NDO_DATA_SERVICE, BD_STRING_ESCAPE,
 							{ .string = (es[1]==NULL) ? "" : es[1] }}
 					};
 
@@ -1877,7 +4834,7 @@ int ndomod_broker_data(int event_type, void *data){
 		case EVENT_HOST_CHECK:
 			temp_host=(host *)eventdata->event_data;
 
-			es[0]=ndo_escape_buffer(temp_host->name);
+			es[0]=temp_host->name;
 
 			{
 				struct ndo_broker_data timed_event_data[] = {
@@ -1893,7 +4850,7 @@ int ndomod_broker_data(int event_type, void *data){
 							{ .integer = eventdata->recurring }},
 					{ NDO_DATA_RUNTIME, BD_UNSIGNED_LONG, { .unsigned_long =
 							(unsigned long)eventdata->run_time }},
-					{ NDO_DATA_HOST, BD_STRING,
+					{ NDO_DATA_HOST, BD_STRING_ESCAPE,
 							{ .string = (es[0]==NULL) ? "" : es[0] }}
 					};
 
@@ -1909,8 +4866,8 @@ int ndomod_broker_data(int event_type, void *data){
 			temp_downtime=find_downtime(ANY_DOWNTIME,(unsigned long)eventdata->event_data);
 
 			if(temp_downtime!=NULL){
-				es[0]=ndo_escape_buffer(temp_downtime->host_name);
-				es[1]=ndo_escape_buffer(temp_downtime->service_description);
+				es[0]=temp_downtime->host_name;
+				es[1]=temp_downtime->service_description;
 				}
 
 			{
@@ -1927,9 +4884,9 @@ int ndomod_broker_data(int event_type, void *data){
 							{ .integer = eventdata->recurring }},
 					{ NDO_DATA_RUNTIME, BD_UNSIGNED_LONG, { .unsigned_long =
 							(unsigned long)eventdata->run_time }},
-					{ NDO_DATA_HOST, BD_STRING,
+					{ NDO_DATA_HOST, BD_STRING_ESCAPE,
 							{ .string = (es[0]==NULL) ? "" : es[0] }},
-					{ NDO_DATA_SERVICE, BD_STRING,
+					{ NDO_DATA_SERVICE, BD_STRING_ESCAPE,
 							{ .string = (es[1]==NULL) ? "" : es[1] }}
 					};
 
@@ -1986,7 +4943,7 @@ int ndomod_broker_data(int event_type, void *data){
 						{ .unsigned_long = logdata->entry_time }},
 				{ NDO_DATA_LOGENTRYTYPE, BD_INT,
 						{ .integer = logdata->data_type }},
-				{ NDO_DATA_LOGENTRY, BD_STRING, { .string = logdata->data }}
+				{ NDO_DATA_LOGENTRY, BD_STRING_ESCAPE, { .string = logdata->data }}
 				};
 
 			ndomod_broker_data_serialize(&dbuf, NDO_API_LOGDATA, log_data,
@@ -1999,9 +4956,9 @@ int ndomod_broker_data(int event_type, void *data){
 
 		cmddata=(nebstruct_system_command_data *)data;
 
-		es[0]=ndo_escape_buffer(cmddata->command_line);
-		es[1]=ndo_escape_buffer(cmddata->output);
-		es[2]=ndo_escape_buffer(cmddata->output);
+		es[0]=cmddata->command_line;
+		es[1]=cmddata->output;
+		es[2]=cmddata->output;
 
 		{
 			struct ndo_broker_data system_command_data[] = {
@@ -2016,7 +4973,7 @@ int ndomod_broker_data(int event_type, void *data){
 				{ NDO_DATA_ENDTIME, BD_TIMEVAL,
 						{ .timestamp = cmddata->end_time }},
 				{ NDO_DATA_TIMEOUT, BD_INT, { .integer = cmddata->timeout }},
-				{ NDO_DATA_COMMANDLINE, BD_STRING,
+				{ NDO_DATA_COMMANDLINE, BD_STRING_ESCAPE,
 						{ .string = (es[0]==NULL) ? "" : es[0] }},
 				{ NDO_DATA_EARLYTIMEOUT, BD_INT,
 						{ .integer = cmddata->early_timeout }},
@@ -2024,9 +4981,9 @@ int ndomod_broker_data(int event_type, void *data){
 						{ .floating_point = cmddata->execution_time }},
 				{ NDO_DATA_RETURNCODE, BD_INT,
 						{ .integer = cmddata->return_code }},
-				{ NDO_DATA_OUTPUT, BD_STRING,
+				{ NDO_DATA_OUTPUT, BD_STRING_ESCAPE,
 						{ .string = (es[1]==NULL) ? "" : es[1] }},
-				{ NDO_DATA_LONGOUTPUT, BD_STRING,
+				{ NDO_DATA_LONGOUTPUT, BD_STRING_ESCAPE,
 						{ .string = (es[2]==NULL) ? "" : es[2] }}
 				};
 
@@ -2041,14 +4998,16 @@ int ndomod_broker_data(int event_type, void *data){
 
 		ehanddata=(nebstruct_event_handler_data *)data;
 
-		es[0]=ndo_escape_buffer(ehanddata->host_name);
-		es[1]=ndo_escape_buffer(ehanddata->service_description);
-		es[2]=ndo_escape_buffer(ehanddata->command_name);
-		es[3]=ndo_escape_buffer(ehanddata->command_args);
-		es[4]=ndo_escape_buffer(ehanddata->command_line);
-		es[5]=ndo_escape_buffer(ehanddata->output);
+		es[0]=ehanddata->host_name;
+		es[1]=ehanddata->service_description;
+		es[2]=ehanddata->command_name;
+		es[3]=ehanddata->command_args;
+		es[4]=ehanddata->command_line;
+		es[5]=ehanddata->output;
 		/* Preparing if eventhandler will have long_output in the future */
-		es[6]=ndo_escape_buffer(ehanddata->output);
+		es[6]=ehanddata->output;
+
+		objkey=ndomod_get_object_key(NULL,es[0],es[1]);
 
 		{
 			struct ndo_broker_data event_handler_data[] = {
@@ -2058,10 +5017,12 @@ int ndomod_broker_data(int event_type, void *data){
 						{ .integer = ehanddata->attr }},
 				{ NDO_DATA_TIMESTAMP, BD_TIMEVAL,
 						{ .timestamp = ehanddata->timestamp }},
-				{ NDO_DATA_HOST, BD_STRING,
+				{ NDO_DATA_HOST, BD_STRING_ESCAPE,
 						{ .string = (es[0]==NULL) ? "" : es[0] }},
-				{ NDO_DATA_SERVICE, BD_STRING,
+				{ NDO_DATA_SERVICE, BD_STRING_ESCAPE,
 						{ .string = (es[1]==NULL) ? "" : es[1] }},
+				{ NDO_DATA_OBJECTKEY, BD_UNSIGNED_LONGLONG,
+						{ .unsigned_longlong = objkey }},
 				{ NDO_DATA_STATETYPE, BD_INT,
 						{ .integer = ehanddata->state_type }},
 				{ NDO_DATA_STATE, BD_INT, { .integer = ehanddata->state }},
@@ -2070,11 +5031,11 @@ int ndomod_broker_data(int event_type, void *data){
 				{ NDO_DATA_ENDTIME, BD_TIMEVAL,
 						{ .timestamp = ehanddata->end_time }},
 				{ NDO_DATA_TIMEOUT, BD_INT, { .integer = ehanddata->timeout }},
-				{ NDO_DATA_COMMANDNAME, BD_STRING,
+				{ NDO_DATA_COMMANDNAME, BD_STRING_ESCAPE,
 						{ .string = (es[2]==NULL) ? "" : es[2] }},
-				{ NDO_DATA_COMMANDARGS, BD_STRING,
+				{ NDO_DATA_COMMANDARGS, BD_STRING_ESCAPE,
 						{ .string = (es[3]==NULL) ? "" : es[3] }},
-				{ NDO_DATA_COMMANDLINE, BD_STRING,
+				{ NDO_DATA_COMMANDLINE, BD_STRING_ESCAPE,
 						{ .string = (es[4]==NULL) ? "" : es[4] }},
 				{ NDO_DATA_EARLYTIMEOUT, BD_INT,
 						{ .integer = ehanddata->early_timeout }},
@@ -2082,9 +5043,9 @@ int ndomod_broker_data(int event_type, void *data){
 						{ .floating_point = ehanddata->execution_time }},
 				{ NDO_DATA_RETURNCODE, BD_INT,
 						{ .integer = ehanddata->return_code }},
-				{ NDO_DATA_OUTPUT, BD_STRING,
+				{ NDO_DATA_OUTPUT, BD_STRING_ESCAPE,
 						{ .string = (es[5]==NULL) ? "" : es[5] }},
-				{ NDO_DATA_LONGOUTPUT, BD_STRING,
+				{ NDO_DATA_LONGOUTPUT, BD_STRING_ESCAPE,
 						{ .string = (es[6]==NULL) ? "" : es[6] }}
 				};
 
@@ -2100,13 +5061,15 @@ int ndomod_broker_data(int event_type, void *data){
 
 		notdata=(nebstruct_notification_data *)data;
 
-		es[0]=ndo_escape_buffer(notdata->host_name);
-		es[1]=ndo_escape_buffer(notdata->service_description);
-		es[2]=ndo_escape_buffer(notdata->output);
+		es[0]=notdata->host_name;
+		es[1]=notdata->service_description;
+		es[2]=notdata->output;
 		/* Preparing if notifications will have long_output in the future */
-		es[3]=ndo_escape_buffer(notdata->output);
-		es[4]=ndo_escape_buffer(notdata->ack_author);
-		es[5]=ndo_escape_buffer(notdata->ack_data);
+		es[3]=notdata->output;
+		es[4]=notdata->ack_author;
+		es[5]=notdata->ack_data;
+
+		objkey=ndomod_get_object_key(NULL,es[0],es[1]);
 
 		{
 			struct ndo_broker_data notification_data[] = {
@@ -2122,20 +5085,22 @@ int ndomod_broker_data(int event_type, void *data){
 						{ .timestamp = notdata->start_time }},
 				{ NDO_DATA_ENDTIME, BD_TIMEVAL,
 						{ .timestamp = notdata->end_time }},
-				{ NDO_DATA_HOST, BD_STRING,
+				{ NDO_DATA_HOST, BD_STRING_ESCAPE,
 						{ .string = (es[0]==NULL) ? "" : es[0] }},
-				{ NDO_DATA_SERVICE, BD_STRING,
+				{ NDO_DATA_SERVICE, BD_STRING_ESCAPE,
 						{ .string = (es[1]==NULL) ? "" : es[1] }},
+				{ NDO_DATA_OBJECTKEY, BD_UNSIGNED_LONGLONG,
+						{ .unsigned_longlong = objkey }},
 				{ NDO_DATA_NOTIFICATIONREASON, BD_INT,
 						{ .integer = notdata->reason_type }},
 				{ NDO_DATA_STATE, BD_INT, { .integer = notdata->state }},
-				{ NDO_DATA_OUTPUT, BD_STRING,
+				{ NDO_DATA_OUTPUT, BD_STRING_ESCAPE,
 						{ .string = (es[2]==NULL) ? "" : es[2] }},
-				{ NDO_DATA_LONGOUTPUT, BD_STRING,
+				{ NDO_DATA_LONGOUTPUT, BD_STRING_ESCAPE,
 						{ .string = (es[3]==NULL) ? "" : es[3] }},
-				{ NDO_DATA_ACKAUTHOR, BD_STRING,
+				{ NDO_DATA_ACKAUTHOR, BD_STRING_ESCAPE,
 						{ .string = (es[4]==NULL) ? "" : es[4] }},
-				{ NDO_DATA_ACKDATA, BD_STRING,
+				{ NDO_DATA_ACKDATA, BD_STRING_ESCAPE,
 						{ .string = (es[5]==NULL) ? "" : es[5] }},
 				{ NDO_DATA_ESCALATED, BD_INT,
 						{ .integer = notdata->escalated }},
@@ -2155,21 +5120,22 @@ int ndomod_broker_data(int event_type, void *data){
 
 		scdata=(nebstruct_service_check_data *)data;
 
-		/* Nagios XI MOD */
-		/* send only the data we really use */
-		if(scdata->type!=NEBTYPE_SERVICECHECK_PROCESSED)
-			break;
+		es[0]=scdata->host_name;
+		es[1]=scdata->service_description;
+		es[2]=scdata->command_name;
+		es[3]=scdata->command_args;
+		es[4]=scdata->command_line;
+		es[5]=scdata->output;
+#if ( defined( BUILD_NAGIOS_3X) || defined( BUILD_NAGIOS_4X))
+		es[6]=scdata->long_output;
+#endif
+		es[7]=scdata->perf_data;
 
-		es[0]=ndo_escape_buffer(scdata->host_name);
-		es[1]=ndo_escape_buffer(scdata->service_description);
-		es[2]=ndo_escape_buffer(scdata->command_name);
-		es[3]=ndo_escape_buffer(scdata->command_args);
-		es[4]=ndo_escape_buffer(scdata->command_line);
-		es[5]=ndo_escape_buffer(scdata->output);
 #if ( defined( BUILD_NAGIOS_3X) || defined( BUILD_NAGIOS_4X))
-		es[6]=ndo_escape_buffer(scdata->long_output);
+		objkey=ndomod_get_object_key(scdata->object_ptr,es[0],es[1]);
+#else
+		objkey=ndomod_get_object_key(NULL,es[0],es[1]);
 #endif
-		es[7]=ndo_escape_buffer(scdata->perf_data);
 
 		{
 			struct ndo_broker_data service_check_data[] = {
@@ -2179,10 +5145,12 @@ int ndomod_broker_data(int event_type, void *data){
 						{ .integer = scdata->attr }},
 				{ NDO_DATA_TIMESTAMP, BD_TIMEVAL,
 						{ .timestamp = scdata->timestamp }},
-				{ NDO_DATA_HOST, BD_STRING,
+				{ NDO_DATA_HOST, BD_STRING_ESCAPE,
 						{ .string = (es[0]==NULL) ? "" : es[0] }},
-				{ NDO_DATA_SERVICE, BD_STRING,
+				{ NDO_DATA_SERVICE, BD_STRING_ESCAPE,
 						{ .string = (es[1]==NULL) ? "" : es[1] }},
+				{ NDO_DATA_OBJECTKEY, BD_UNSIGNED_LONGLONG,
+						{ .unsigned_longlong = objkey }},
 				{ NDO_DATA_CHECKTYPE, BD_INT,
 						{ .integer = scdata->check_type }},
 				{ NDO_DATA_CURRENTCHECKATTEMPT, BD_INT,
@@ -2193,11 +5161,11 @@ int ndomod_broker_data(int event_type, void *data){
 						{ .integer = scdata->state_type }},
 				{ NDO_DATA_STATE, BD_INT, { .integer = scdata->state }},
 				{ NDO_DATA_TIMEOUT, BD_INT, { .integer = scdata->timeout }},
-				{ NDO_DATA_COMMANDNAME, BD_STRING,
+				{ NDO_DATA_COMMANDNAME, BD_STRING_ESCAPE,
 						{ .string = (es[2]==NULL) ? "" : es[2] }},
-				{ NDO_DATA_COMMANDARGS, BD_STRING,
+				{ NDO_DATA_COMMANDARGS, BD_STRING_ESCAPE,
 						{ .string = (es[3]==NULL) ? "" : es[3] }},
-				{ NDO_DATA_COMMANDLINE, BD_STRING,
+				{ NDO_DATA_COMMANDLINE, BD_STRING_ESCAPE,
 						{ .string = (es[4]==NULL) ? "" : es[4] }},
 				{ NDO_DATA_STARTTIME, BD_TIMEVAL,
 						{ .timestamp = scdata->start_time }},
@@ -2211,11 +5179,11 @@ int ndomod_broker_data(int event_type, void *data){
 						{ .floating_point = scdata->latency }},
 				{ NDO_DATA_RETURNCODE, BD_INT,
 						{ .integer = scdata->return_code }},
-				{ NDO_DATA_OUTPUT, BD_STRING,
+				{ NDO_DATA_OUTPUT, BD_STRING_ESCAPE,
 						{ .string = (es[5]==NULL) ? "" : es[5] }},
-				{ NDO_DATA_LONGOUTPUT, BD_STRING,
+				{ NDO_DATA_LONGOUTPUT, BD_STRING_ESCAPE,
 						{ .string = (es[6]==NULL) ? "" : es[6] }},
-				{ NDO_DATA_PERFDATA, BD_STRING,
+				{ NDO_DATA_PERFDATA, BD_STRING_ESCAPE,
 						{ .string = (es[7]==NULL) ? "" : es[7] }}
 				};
 
@@ -2231,20 +5199,21 @@ int ndomod_broker_data(int event_type, void *data){
 
 		hcdata=(nebstruct_host_check_data *)data;
 
-		/* Nagios XI MOD */
-		/* send only the data we really use */
-		if(hcdata->type!=NEBTYPE_HOSTCHECK_PROCESSED)
-			break;
+		es[0]=hcdata->host_name;
+		es[1]=hcdata->command_name;
+		es[2]=hcdata->command_args;
+		es[3]=hcdata->command_line;
+		es[4]=hcdata->output;
+#if ( defined( BUILD_NAGIOS_3X) || defined( BUILD_NAGIOS_4X))
+		es[5]=hcdata->long_output;
+#endif
+		es[6]=hcdata->perf_data;
 
-		es[0]=ndo_escape_buffer(hcdata->host_name);
-		es[1]=ndo_escape_buffer(hcdata->command_name);
-		es[2]=ndo_escape_buffer(hcdata->command_args);
-		es[3]=ndo_escape_buffer(hcdata->command_line);
-		es[4]=ndo_escape_buffer(hcdata->output);
 #if ( defined( BUILD_NAGIOS_3X) || defined( BUILD_NAGIOS_4X))
-		es[5]=ndo_escape_buffer(hcdata->long_output);
+		objkey=ndomod_get_object_key(hcdata->object_ptr,es[0],NULL);
+#else
+		objkey=ndomod_get_object_key(NULL,es[0],NULL);
 #endif
-		es[6]=ndo_escape_buffer(hcdata->perf_data);
 
 		{
 			struct ndo_broker_data host_check_data[] = {
@@ -2254,8 +5223,10 @@ int ndomod_broker_data(int event_type, void *data){
 						{ .integer = hcdata->attr }},
 				{ NDO_DATA_TIMESTAMP, BD_TIMEVAL,
 						{ .timestamp = hcdata->timestamp }},
-				{ NDO_DATA_HOST, BD_STRING,
+				{ NDO_DATA_HOST, BD_STRING_ESCAPE,
 						{ .string = (es[0]==NULL) ? "" : es[0] }},
+				{ NDO_DATA_OBJECTKEY, BD_UNSIGNED_LONGLONG,
+						{ .unsigned_longlong = objkey }},
 				{ NDO_DATA_CHECKTYPE, BD_INT,
 						{ .integer = hcdata->check_type }},
 				{ NDO_DATA_CURRENTCHECKATTEMPT, BD_INT,
@@ -2266,11 +5237,11 @@ int ndomod_broker_data(int event_type, void *data){
 						{ .integer = hcdata->state_type }},
 				{ NDO_DATA_STATE, BD_INT, { .integer = hcdata->state }},
 				{ NDO_DATA_TIMEOUT, BD_INT, { .integer = hcdata->timeout }},
-				{ NDO_DATA_COMMANDNAME, BD_STRING,
+				{ NDO_DATA_COMMANDNAME, BD_STRING_ESCAPE,
 						{ .string = (es[1]==NULL) ? "" : es[1] }},
-				{ NDO_DATA_COMMANDARGS, BD_STRING,
+				{ NDO_DATA_COMMANDARGS, BD_STRING_ESCAPE,
 						{ .string = (es[2]==NULL) ? "" : es[2] }},
-				{ NDO_DATA_COMMANDLINE, BD_STRING,
+				{ NDO_DATA_COMMANDLINE, BD_STRING_ESCAPE,
 						{ .string = (es[3]==NULL) ? "" : es[3] }},
 				{ NDO_DATA_STARTTIME, BD_TIMEVAL,
 						{ .timestamp = hcdata->start_time }},
@@ -2284,11 +5255,11 @@ int ndomod_broker_data(int event_type, void *data){
 						{ .floating_point = hcdata->latency }},
 				{ NDO_DATA_RETURNCODE, BD_INT,
 						{ .integer = hcdata->return_code }},
-				{ NDO_DATA_OUTPUT, BD_STRING,
+				{ NDO_DATA_OUTPUT, BD_STRING_ESCAPE,
 						{ .string = (es[4]==NULL) ? "" : es[4] }},
-				{ NDO_DATA_LONGOUTPUT, BD_STRING,
+				{ NDO_DATA_LONGOUTPUT, BD_STRING_ESCAPE,
 						{ .string = (es[5]==NULL) ? "" : es[5] }},
-				{ NDO_DATA_PERFDATA, BD_STRING,
+				{ NDO_DATA_PERFDATA, BD_STRING_ESCAPE,
 						{ .string = (es[6]==NULL) ? "" : es[6] }}
 				};
 
@@ -2304,10 +5275,12 @@ int ndomod_broker_data(int event_type, void *data){
 
 		comdata=(nebstruct_comment_data *)data;
 
-		es[0]=ndo_escape_buffer(comdata->host_name);
-		es[1]=ndo_escape_buffer(comdata->service_description);
-		es[2]=ndo_escape_buffer(comdata->author_name);
-		es[3]=ndo_escape_buffer(comdata->comment_data);
+		es[0]=comdata->host_name;
+		es[1]=comdata->service_description;
+		es[2]=comdata->author_name;
+		es[3]=comdata->comment_data;
+
+		objkey=ndomod_get_object_key(NULL,es[0],es[1]);
 
 		{
 			struct ndo_broker_data comment_data[] = {
@@ -2319,15 +5292,17 @@ int ndomod_broker_data(int event_type, void *data){
 						{ .timestamp = comdata->timestamp }},
 				{ NDO_DATA_COMMENTTYPE, BD_INT,
 						{ .integer = comdata->comment_type }},
-				{ NDO_DATA_HOST, BD_STRING,
+				{ NDO_DATA_HOST, BD_STRING_ESCAPE,
 						{ .string = (es[0]==NULL) ? "" : es[0] }},
-				{ NDO_DATA_SERVICE, BD_STRING,
+				{ NDO_DATA_SERVICE, BD_STRING_ESCAPE,
 						{ .string = (es[1]==NULL) ? "" : es[1] }},
+				{ NDO_DATA_OBJECTKEY, BD_UNSIGNED_LONGLONG,
+						{ .unsigned_longlong = objkey }},
 				{ NDO_DATA_ENTRYTIME, BD_UNSIGNED_LONG, { .unsigned_long =
 						(unsigned long)comdata->entry_time }},
-				{ NDO_DATA_AUTHORNAME, BD_STRING,
+				{ NDO_DATA_AUTHORNAME, BD_STRING_ESCAPE,
 						{ .string = (es[2]==NULL) ? "" : es[2] }},
-				{ NDO_DATA_COMMENT, BD_STRING,
+				{ NDO_DATA_COMMENT, BD_STRING_ESCAPE,
 						{ .string = (es[3]==NULL) ? "" : es[3] }},
 				{ NDO_DATA_PERSISTENT, BD_INT,
 						{ .integer = comdata->persistent }},
@@ -2354,10 +5329,12 @@ int ndomod_broker_data(int event_type, void *data){
 
 		downdata=(nebstruct_downtime_data *)data;
 
-		es[0]=ndo_escape_buffer(downdata->host_name);
-		es[1]=ndo_escape_buffer(downdata->service_description);
-		es[2]=ndo_escape_buffer(downdata->author_name);
-		es[3]=ndo_escape_buffer(downdata->comment_data);
+		es[0]=downdata->host_name;
+		es[1]=downdata->service_description;
+		es[2]=downdata->author_name;
+		es[3]=downdata->comment_data;
+
+		objkey=ndomod_get_object_key(NULL,es[0],es[1]);
 
 		{
 			struct ndo_broker_data downtime_data[] = {
@@ -2369,15 +5346,17 @@ int ndomod_broker_data(int event_type, void *data){
 						{ .timestamp = downdata->timestamp }},
 				{ NDO_DATA_DOWNTIMETYPE, BD_INT,
 						{ .integer = downdata->downtime_type }},
-				{ NDO_DATA_HOST, BD_STRING,
+				{ NDO_DATA_HOST, BD_STRING_ESCAPE,
 						{ .string = (es[0]==NULL) ? "" : es[0] }},
-				{ NDO_DATA_SERVICE, BD_STRING,
+				{ NDO_DATA_SERVICE, BD_STRING_ESCAPE,
 						{ .string = (es[1]==NULL) ? "" : es[1] }},
+				{ NDO_DATA_OBJECTKEY, BD_UNSIGNED_LONGLONG,
+						{ .unsigned_longlong = objkey }},
 				{ NDO_DATA_ENTRYTIME, BD_UNSIGNED_LONG, { .unsigned_long =
 						(unsigned long)downdata->entry_time }},
-				{ NDO_DATA_AUTHORNAME, BD_STRING,
+				{ NDO_DATA_AUTHORNAME, BD_STRING_ESCAPE,
 						{ .string = (es[2]==NULL) ? "" : es[2] }},
-				{ NDO_DATA_COMMENT, BD_STRING,
+				{ NDO_DATA_COMMENT, BD_STRING_ESCAPE,
 						{ .string = (es[3]==NULL) ? "" : es[3] }},
 				{ NDO_DATA_STARTTIME, BD_UNSIGNED_LONG, { .unsigned_long =
 						(unsigned long)downdata->start_time }},
@@ -2403,14 +5382,16 @@ int ndomod_broker_data(int event_type, void *data){
 
 		flapdata=(nebstruct_flapping_data *)data;
 
-		es[0]=ndo_escape_buffer(flapdata->host_name);
-		es[1]=ndo_escape_buffer(flapdata->service_description);
+		es[0]=flapdata->host_name;
+		es[1]=flapdata->service_description;
 
 		if(flapdata->flapping_type==HOST_FLAPPING)
 			temp_comment=find_host_comment(flapdata->comment_id);
 		else
 			temp_comment=find_service_comment(flapdata->comment_id);
 
+		objkey=ndomod_get_object_key(NULL,es[0],es[1]);
+
 		{
 			struct ndo_broker_data flapping_data[] = {
 				{ NDO_DATA_TYPE, BD_INT, { .integer = flapdata->type }},
@@ -2421,10 +5402,12 @@ int ndomod_broker_data(int event_type, void *data){
 						{ .timestamp = flapdata->timestamp }},
 				{ NDO_DATA_FLAPPINGTYPE, BD_INT,
 						{ .integer = flapdata->flapping_type }},
-				{ NDO_DATA_HOST, BD_STRING,
+				{ NDO_DATA_HOST, BD_STRING_ESCAPE,
 						{ .string = (es[0]==NULL) ? "" : es[0] }},
-				{ NDO_DATA_SERVICE, BD_STRING,
+				{ NDO_DATA_SERVICE, BD_STRING_ESCAPE,
 						{ .string = (es[1]==NULL) ? "" : es[1] }},
+				{ NDO_DATA_OBJECTKEY, BD_UNSIGNED_LONGLONG,
+						{ .unsigned_longlong = objkey }},
 				{ NDO_DATA_PERCENTSTATECHANGE, BD_FLOAT,
 						{ .floating_point = flapdata->percent_change }},
 				{ NDO_DATA_HIGHTHRESHOLD, BD_FLOAT,
@@ -2449,8 +5432,8 @@ int ndomod_broker_data(int event_type, void *data){
 
 		psdata=(nebstruct_program_status_data *)data;
 
-		es[0]=ndo_escape_buffer(psdata->global_host_event_handler);
-		es[1]=ndo_escape_buffer(psdata->global_service_event_handler);
+		es[0]=psdata->global_host_event_handler;
+		es[1]=psdata->global_service_event_handler;
 
 		{
 			struct ndo_broker_data program_status_data[] = {
@@ -2509,10 +5492,12 @@ int ndomod_broker_data(int event_type, void *data){
 				{ NDO_DATA_MODIFIEDSERVICEATTRIBUTES, BD_UNSIGNED_LONG,
 						{ .unsigned_long =
 						psdata->modified_service_attributes }},
-				{ NDO_DATA_GLOBALHOSTEVENTHANDLER, BD_STRING,
+				{ NDO_DATA_GLOBALHOSTEVENTHANDLER, BD_STRING_ESCAPE,
 						{ .string = (es[0]==NULL) ? "" : es[0] }},
-				{ NDO_DATA_GLOBALSERVICEEVENTHANDLER, BD_STRING,
+				{ NDO_DATA_GLOBALSERVICEEVENTHANDLER, BD_STRING_ESCAPE,
 						{ .string = (es[1]==NULL) ? "" : es[1] }},
+				{ NDO_DATA_EVENTSSHED, BD_UNSIGNED_LONG,
+						{ .unsigned_long = ndomod_events_shed() }},
 				};
 
 			ndomod_broker_data_serialize(&dbuf, NDO_API_PROGRAMSTATUSDATA,
@@ -2528,23 +5513,23 @@ int ndomod_broker_data(int event_type, void *data){
 		hsdata=(nebstruct_host_status_data *)data;
 
 		if((temp_host=(host *)hsdata->object_ptr)==NULL){
-			ndo_dbuf_free(&dbuf);
+			ndomod_release_output_buffer(&dbuf);
 			return 0;
 			}
 
-		es[0]=ndo_escape_buffer(temp_host->name);
-		es[1]=ndo_escape_buffer(temp_host->plugin_output);
+		es[0]=temp_host->name;
+		es[1]=temp_host->plugin_output;
 #if ( defined( BUILD_NAGIOS_3X) || defined( BUILD_NAGIOS_4X))
-		es[2]=ndo_escape_buffer(temp_host->long_plugin_output);
+		es[2]=temp_host->long_plugin_output;
 #endif
-		es[3]=ndo_escape_buffer(temp_host->perf_data);
-		es[4]=ndo_escape_buffer(temp_host->event_handler);
+		es[3]=temp_host->perf_data;
+		es[4]=temp_host->event_handler;
 #ifdef BUILD_NAGIOS_4X
-		es[5]=ndo_escape_buffer(temp_host->check_command);
+		es[5]=temp_host->check_command;
 #else
-		es[5]=ndo_escape_buffer(temp_host->host_check_command);
+		es[5]=temp_host->host_check_command;
 #endif
-		es[6]=ndo_escape_buffer(temp_host->check_period);
+		es[6]=temp_host->check_period;
 
 #if ( defined( BUILD_NAGIOS_3X) || defined( BUILD_NAGIOS_4X))
 		retry_interval=temp_host->retry_interval;
@@ -2553,6 +5538,8 @@ int ndomod_broker_data(int event_type, void *data){
 		retry_interval=0.0;
 #endif
 
+		objkey=ndomod_get_object_key(temp_host,es[0],NULL);
+
 		{
 			struct ndo_broker_data host_status_data[] = {
 				{ NDO_DATA_TYPE, BD_INT, { .integer = hsdata->type }},
@@ -2561,13 +5548,15 @@ int ndomod_broker_data(int event_type, void *data){
 						{ .integer = hsdata->attr }},
 				{ NDO_DATA_TIMESTAMP, BD_TIMEVAL,
 						{ .timestamp = hsdata->timestamp }},
-				{ NDO_DATA_HOST, BD_STRING,
+				{ NDO_DATA_HOST, BD_STRING_ESCAPE,
 						{ .string = (es[0]==NULL) ? "" : es[0] }},
-				{ NDO_DATA_OUTPUT, BD_STRING,
+				{ NDO_DATA_OBJECTKEY, BD_UNSIGNED_LONGLONG,
+						{ .unsigned_longlong = objkey }},
+				{ NDO_DATA_OUTPUT, BD_STRING_ESCAPE,
 						{ .string = (es[1]==NULL) ? "" : es[1] }},
-				{ NDO_DATA_LONGOUTPUT, BD_STRING,
+				{ NDO_DATA_LONGOUTPUT, BD_STRING_ESCAPE,
 						{ .string = (es[2]==NULL) ? "" : es[2] }},
-				{ NDO_DATA_PERFDATA, BD_STRING,
+				{ NDO_DATA_PERFDATA, BD_STRING_ESCAPE,
 						{ .string = (es[3]==NULL) ? "" : es[3] }},
 				{ NDO_DATA_CURRENTSTATE, BD_INT,
 						{ .integer = temp_host->current_state }},
@@ -2675,30 +5664,29 @@ int ndomod_broker_data(int event_type, void *data){
 						}},
 				{ NDO_DATA_MODIFIEDHOSTATTRIBUTES, BD_UNSIGNED_LONG,
 						{ .unsigned_long = temp_host->modified_attributes }},
-				{ NDO_DATA_EVENTHANDLER, BD_STRING,
+				{ NDO_DATA_EVENTHANDLER, BD_STRING_ESCAPE,
 						{ .string = (es[4]==NULL) ? "" : es[4] }},
-				{ NDO_DATA_CHECKCOMMAND, BD_STRING,
+				{ NDO_DATA_CHECKCOMMAND, BD_STRING_ESCAPE,
 						{ .string = (es[5]==NULL) ? "" : es[5] }},
 				{ NDO_DATA_NORMALCHECKINTERVAL, BD_FLOAT,
 						{ .floating_point =
 						(double)temp_host->check_interval }},
 				{ NDO_DATA_RETRYCHECKINTERVAL, BD_FLOAT,
 						{ .floating_point = (double)retry_interval }},
-				{ NDO_DATA_HOSTCHECKPERIOD, BD_STRING,
+				{ NDO_DATA_HOSTCHECKPERIOD, BD_STRING_ESCAPE,
 						{ .string = (es[6]==NULL) ? "" : es[6] }}
 				};
 
-			ndomod_broker_data_serialize(&dbuf, NDO_API_HOSTSTATUSDATA,
-					host_status_data,
-					sizeof(host_status_data) / sizeof(host_status_data[ 0]),
-					FALSE);
+			ds=ndomod_status_serialize(&dbuf, NDO_API_HOSTSTATUSDATA,
+					NDO_API_HOSTSTATUSDELTADATA, temp_host, host_status_data,
+					sizeof(host_status_data) / sizeof(host_status_data[ 0]), 6, &frame_start);
 		}
 
 #if ( defined( BUILD_NAGIOS_3X) || defined( BUILD_NAGIOS_4X))
-		ndomod_customvars_serialize(temp_host->custom_variables, &dbuf);
+		ndomod_status_customvars_serialize(ds, temp_host->custom_variables, &dbuf);
 #endif
 
-		ndomod_enddata_serialize(&dbuf);
+		ndomod_enddata_serialize(&dbuf, frame_start);
 
 		break;
 
@@ -2707,24 +5695,26 @@ int ndomod_broker_data(int event_type, void *data){
 		ssdata=(nebstruct_service_status_data *)data;
 
 		if((temp_service=(service *)ssdata->object_ptr)==NULL){
-			ndo_dbuf_free(&dbuf);
+			ndomod_release_output_buffer(&dbuf);
 			return 0;
 			}
 
-		es[0]=ndo_escape_buffer(temp_service->host_name);
-		es[1]=ndo_escape_buffer(temp_service->description);
-		es[2]=ndo_escape_buffer(temp_service->plugin_output);
+		es[0]=temp_service->host_name;
+		es[1]=temp_service->description;
+		es[2]=temp_service->plugin_output;
 #if ( defined( BUILD_NAGIOS_3X) || defined( BUILD_NAGIOS_4X))
-		es[3]=ndo_escape_buffer(temp_service->long_plugin_output);
+		es[3]=temp_service->long_plugin_output;
 #endif
-		es[4]=ndo_escape_buffer(temp_service->perf_data);
-		es[5]=ndo_escape_buffer(temp_service->event_handler);
+		es[4]=temp_service->perf_data;
+		es[5]=temp_service->event_handler;
 #ifdef BUILD_NAGIOS_4X
-		es[6]=ndo_escape_buffer(temp_service->check_command);
+		es[6]=temp_service->check_command;
 #else
-		es[6]=ndo_escape_buffer(temp_service->service_check_command);
+		es[6]=temp_service->service_check_command;
 #endif
-		es[7]=ndo_escape_buffer(temp_service->check_period);
+		es[7]=temp_service->check_period;
+
+		objkey=ndomod_get_object_key(temp_service,es[0],es[1]);
 
 		{
 			struct ndo_broker_data service_status_data[] = {
@@ -2734,15 +5724,17 @@ int ndomod_broker_data(int event_type, void *data){
 						{ .integer = ssdata->attr }},
 				{ NDO_DATA_TIMESTAMP, BD_TIMEVAL,
 						{ .timestamp = ssdata->timestamp }},
-				{ NDO_DATA_HOST, BD_STRING,
+				{ NDO_DATA_HOST, BD_STRING_ESCAPE,
 						{ .string = (es[0]==NULL) ? "" : es[0] }},
-				{ NDO_DATA_SERVICE, BD_STRING,
+				{ NDO_DATA_SERVICE, BD_STRING_ESCAPE,
 						{ .string = (es[1]==NULL) ? "" : es[1] }},
-				{ NDO_DATA_OUTPUT, BD_STRING,
+				{ NDO_DATA_OBJECTKEY, BD_UNSIGNED_LONGLONG,
+						{ .unsigned_longlong = objkey }},
+				{ NDO_DATA_OUTPUT, BD_STRING_ESCAPE,
 						{ .string = (es[2]==NULL) ? "" : es[2] }},
-				{ NDO_DATA_LONGOUTPUT, BD_STRING,
+				{ NDO_DATA_LONGOUTPUT, BD_STRING_ESCAPE,
 						{ .string = (es[3]==NULL) ? "" : es[3] }},
-				{ NDO_DATA_PERFDATA, BD_STRING,
+				{ NDO_DATA_PERFDATA, BD_STRING_ESCAPE,
 						{ .string = (es[4]==NULL) ? "" : es[4] }},
 				{ NDO_DATA_CURRENTSTATE, BD_INT,
 						{ .integer = temp_service->current_state }},
@@ -2847,9 +5839,9 @@ int ndomod_broker_data(int event_type, void *data){
 						}},
 				{ NDO_DATA_MODIFIEDSERVICEATTRIBUTES, BD_UNSIGNED_LONG,
 						{ .unsigned_long = temp_service->modified_attributes }},
-				{ NDO_DATA_EVENTHANDLER, BD_STRING,
+				{ NDO_DATA_EVENTHANDLER, BD_STRING_ESCAPE,
 						{ .string = (es[5]==NULL) ? "" : es[5] }},
-				{ NDO_DATA_CHECKCOMMAND, BD_STRING,
+				{ NDO_DATA_CHECKCOMMAND, BD_STRING_ESCAPE,
 						{ .string = (es[6]==NULL) ? "" : es[6] }},
 				{ NDO_DATA_NORMALCHECKINTERVAL, BD_FLOAT,
 						{ .floating_point =
@@ -2857,20 +5849,20 @@ int ndomod_broker_data(int event_type, void *data){
 				{ NDO_DATA_RETRYCHECKINTERVAL, BD_FLOAT,
 						{ .floating_point =
 						(double)temp_service->retry_interval }},
-				{ NDO_DATA_SERVICECHECKPERIOD, BD_STRING,
+				{ NDO_DATA_SERVICECHECKPERIOD, BD_STRING_ESCAPE,
 						{ .string = (es[7]==NULL) ? "" : es[7] }}
 				};
 
-			ndomod_broker_data_serialize(&dbuf, NDO_API_SERVICESTATUSDATA,
-					service_status_data, sizeof(service_status_data) /
-					sizeof(service_status_data[ 0]), FALSE);
+			ds=ndomod_status_serialize(&dbuf, NDO_API_SERVICESTATUSDATA,
+					NDO_API_SERVICESTATUSDELTADATA, temp_service, service_status_data,
+					sizeof(service_status_data) / sizeof(service_status_data[ 0]), 7, &frame_start);
 		}
 
 #if ( defined( BUILD_NAGIOS_3X) || defined( BUILD_NAGIOS_4X))
-		ndomod_customvars_serialize(temp_service->custom_variables, &dbuf);
+		ndomod_status_customvars_serialize(ds, temp_service->custom_variables, &dbuf);
 #endif
 
-		ndomod_enddata_serialize(&dbuf);
+		ndomod_enddata_serialize(&dbuf, frame_start);
 
 		break;
 
@@ -2880,11 +5872,11 @@ int ndomod_broker_data(int event_type, void *data){
 		csdata=(nebstruct_contact_status_data *)data;
 
 		if((temp_contact=(contact *)csdata->object_ptr)==NULL){
-			ndo_dbuf_free(&dbuf);
+			ndomod_release_output_buffer(&dbuf);
 			return 0;
 			}
 
-		es[0]=ndo_escape_buffer(temp_contact->name);
+		es[0]=temp_contact->name;
 
 		{
 			struct ndo_broker_data contact_status_data[] = {
@@ -2894,7 +5886,7 @@ int ndomod_broker_data(int event_type, void *data){
 						{ .integer = csdata->attr }},
 				{ NDO_DATA_TIMESTAMP, BD_TIMEVAL,
 						{ .timestamp = csdata->timestamp }},
-				{ NDO_DATA_CONTACTNAME, BD_STRING,
+				{ NDO_DATA_CONTACTNAME, BD_STRING_ESCAPE,
 						{ .string = (es[0]==NULL) ? "" : es[0] }},
 				{ NDO_DATA_HOSTNOTIFICATIONSENABLED, BD_INT,
 						{ .integer =
@@ -2918,7 +5910,7 @@ int ndomod_broker_data(int event_type, void *data){
 						temp_contact->modified_service_attributes }}
 				};
 
-			ndomod_broker_data_serialize(&dbuf, NDO_API_CONTACTSTATUSDATA,
+			frame_start=ndomod_broker_data_serialize(&dbuf, NDO_API_CONTACTSTATUSDATA,
 					contact_status_data, sizeof(contact_status_data) /
 					sizeof(contact_status_data[ 0]), FALSE);
 		}
@@ -2926,7 +5918,7 @@ int ndomod_broker_data(int event_type, void *data){
 		/* dump customvars */
 		ndomod_customvars_serialize(temp_contact->custom_variables, &dbuf);
 
-		ndomod_enddata_serialize(&dbuf);
+		ndomod_enddata_serialize(&dbuf, frame_start);
 
 		break;
 #endif
@@ -2935,8 +5927,8 @@ int ndomod_broker_data(int event_type, void *data){
 
 		apdata=(nebstruct_adaptive_program_data *)data;
 
-		es[0]=ndo_escape_buffer(global_host_event_handler);
-		es[1]=ndo_escape_buffer(global_service_event_handler);
+		es[0]=global_host_event_handler;
+		es[1]=global_service_event_handler;
 
 		{
 			struct ndo_broker_data adaptive_program_data[] = {
@@ -2958,9 +5950,9 @@ int ndomod_broker_data(int event_type, void *data){
 				{ NDO_DATA_MODIFIEDSERVICEATTRIBUTES, BD_UNSIGNED_LONG,
 						{ .unsigned_long =
 						apdata->modified_service_attributes }},
-				{ NDO_DATA_GLOBALHOSTEVENTHANDLER, BD_STRING,
+				{ NDO_DATA_GLOBALHOSTEVENTHANDLER, BD_STRING_ESCAPE,
 						{ .string = (es[0]==NULL) ? "" : es[0] }},
-				{ NDO_DATA_GLOBALSERVICEEVENTHANDLER, BD_STRING,
+				{ NDO_DATA_GLOBALSERVICEEVENTHANDLER, BD_STRING_ESCAPE,
 						{ .string = (es[1]==NULL) ? "" : es[1] }},
 				};
 
@@ -2976,7 +5968,7 @@ int ndomod_broker_data(int event_type, void *data){
 		ahdata=(nebstruct_adaptive_host_data *)data;
 
 		if((temp_host=(host *)ahdata->object_ptr)==NULL){
-			ndo_dbuf_free(&dbuf);
+			ndomod_release_output_buffer(&dbuf);
 			return 0;
 			}
 
@@ -2987,12 +5979,12 @@ int ndomod_broker_data(int event_type, void *data){
 		retry_interval=temp_host->retry_interval;
 #endif
 
-		es[0]=ndo_escape_buffer(temp_host->name);
-		es[1]=ndo_escape_buffer(temp_host->event_handler);
+		es[0]=temp_host->name;
+		es[1]=temp_host->event_handler;
 #ifdef BUILD_NAGIOS_4X
-		es[2]=ndo_escape_buffer(temp_host->check_command);
+		es[2]=temp_host->check_command;
 #else
-		es[2]=ndo_escape_buffer(temp_host->host_check_command);
+		es[2]=temp_host->host_check_command;
 #endif
 
 		{
@@ -3009,11 +6001,11 @@ int ndomod_broker_data(int event_type, void *data){
 						{ .unsigned_long = ahdata->modified_attribute }},
 				{ NDO_DATA_MODIFIEDHOSTATTRIBUTES, BD_UNSIGNED_LONG,
 						{ .unsigned_long = ahdata->modified_attributes }},
-				{ NDO_DATA_HOST, BD_STRING,
+				{ NDO_DATA_HOST, BD_STRING_ESCAPE,
 						{ .string = (es[0]==NULL) ? "" : es[0] }},
-				{ NDO_DATA_EVENTHANDLER, BD_STRING,
+				{ NDO_DATA_EVENTHANDLER, BD_STRING_ESCAPE,
 						{ .string = (es[1]==NULL) ? "" : es[1] }},
-				{ NDO_DATA_CHECKCOMMAND, BD_STRING,
+				{ NDO_DATA_CHECKCOMMAND, BD_STRING_ESCAPE,
 						{ .string = (es[2]==NULL) ? "" : es[2] }},
 				{ NDO_DATA_NORMALCHECKINTERVAL, BD_FLOAT,
 						{ .floating_point = temp_host->check_interval }},
@@ -3036,17 +6028,17 @@ int ndomod_broker_data(int event_type, void *data){
 		asdata=(nebstruct_adaptive_service_data *)data;
 
 		if((temp_service=(service *)asdata->object_ptr)==NULL){
-			ndo_dbuf_free(&dbuf);
+			ndomod_release_output_buffer(&dbuf);
 			return 0;
 			}
 
-		es[0]=ndo_escape_buffer(temp_service->host_name);
-		es[1]=ndo_escape_buffer(temp_service->description);
-		es[2]=ndo_escape_buffer(temp_service->event_handler);
+		es[0]=temp_service->host_name;
+		es[1]=temp_service->description;
+		es[2]=temp_service->event_handler;
 #ifdef BUILD_NAGIOS_4X
-		es[3]=ndo_escape_buffer(temp_service->check_command);
+		es[3]=temp_service->check_command;
 #else
-		es[3]=ndo_escape_buffer(temp_service->service_check_command);
+		es[3]=temp_service->service_check_command;
 #endif
 
 		{
@@ -3063,13 +6055,13 @@ int ndomod_broker_data(int event_type, void *data){
 						{ .unsigned_long = asdata->modified_attribute }},
 				{ NDO_DATA_MODIFIEDSERVICEATTRIBUTES, BD_UNSIGNED_LONG,
 						{ .unsigned_long = asdata->modified_attributes }},
-				{ NDO_DATA_HOST, BD_STRING,
+				{ NDO_DATA_HOST, BD_STRING_ESCAPE,
 						{ .string = (es[0]==NULL) ? "" : es[0] }},
-				{ NDO_DATA_SERVICE, BD_STRING,
+				{ NDO_DATA_SERVICE, BD_STRING_ESCAPE,
 						{ .string = (es[1]==NULL) ? "" : es[1] }},
-				{ NDO_DATA_EVENTHANDLER, BD_STRING,
+				{ NDO_DATA_EVENTHANDLER, BD_STRING_ESCAPE,
 						{ .string = (es[2]==NULL) ? "" : es[2] }},
-				{ NDO_DATA_CHECKCOMMAND, BD_STRING,
+				{ NDO_DATA_CHECKCOMMAND, BD_STRING_ESCAPE,
 						{ .string = (es[3]==NULL) ? "" : es[3] }},
 				{ NDO_DATA_NORMALCHECKINTERVAL, BD_FLOAT,
 						{ .floating_point =
@@ -3094,11 +6086,11 @@ int ndomod_broker_data(int event_type, void *data){
 		acdata=(nebstruct_adaptive_contact_data *)data;
 
 		if((temp_contact=(contact *)acdata->object_ptr)==NULL){
-			ndo_dbuf_free(&dbuf);
+			ndomod_release_output_buffer(&dbuf);
 			return 0;
 			}
 
-		es[0]=ndo_escape_buffer(temp_contact->name);
+		es[0]=temp_contact->name;
 
 		{
 			struct ndo_broker_data adaptive_contact_data[] = {
@@ -3124,7 +6116,7 @@ int ndomod_broker_data(int event_type, void *data){
 				{ NDO_DATA_MODIFIEDSERVICEATTRIBUTES, BD_UNSIGNED_LONG,
 						{ .unsigned_long =
 						acdata->modified_service_attributes }},
-				{ NDO_DATA_CONTACTNAME, BD_STRING,
+				{ NDO_DATA_CONTACTNAME, BD_STRING_ESCAPE,
 						{ .string = (es[0]==NULL) ? "" : es[0] }},
 				{ NDO_DATA_HOSTNOTIFICATIONSENABLED, BD_INT,
 						{ .integer =
@@ -3146,8 +6138,8 @@ int ndomod_broker_data(int event_type, void *data){
 
 		ecdata=(nebstruct_external_command_data *)data;
 
-		es[0]=ndo_escape_buffer(ecdata->command_string);
-		es[1]=ndo_escape_buffer(ecdata->command_args);
+		es[0]=ecdata->command_string;
+		es[1]=ecdata->command_args;
 
 		{
 			struct ndo_broker_data external_command_data[] = {
@@ -3161,9 +6153,9 @@ int ndomod_broker_data(int event_type, void *data){
 						{ .integer = ecdata->command_type }},
 				{ NDO_DATA_ENTRYTIME, BD_UNSIGNED_LONG,
 						{ .unsigned_long = (unsigned long)ecdata->entry_time }},
-				{ NDO_DATA_COMMANDSTRING, BD_STRING,
+				{ NDO_DATA_COMMANDSTRING, BD_STRING_ESCAPE,
 						{ .string = (es[0]==NULL) ? "" : es[0] }},
-				{ NDO_DATA_COMMANDARGS, BD_STRING,
+				{ NDO_DATA_COMMANDARGS, BD_STRING_ESCAPE,
 						{ .string = (es[1]==NULL) ? "" : es[1] }},
 				};
 
@@ -3220,16 +6212,16 @@ int ndomod_broker_data(int event_type, void *data){
 
 		cnotdata=(nebstruct_contact_notification_data *)data;
 
-		es[0]=ndo_escape_buffer(cnotdata->host_name);
-		es[1]=ndo_escape_buffer(cnotdata->service_description);
-		es[2]=ndo_escape_buffer(cnotdata->output);
+		es[0]=cnotdata->host_name;
+		es[1]=cnotdata->service_description;
+		es[2]=cnotdata->output;
 		/* Preparing long output for the future */
-		es[3]=ndo_escape_buffer(cnotdata->output);
+		es[3]=cnotdata->output;
 		/* Preparing for long_output in the future */
-		es[4]=ndo_escape_buffer(cnotdata->output);
-		es[5]=ndo_escape_buffer(cnotdata->ack_author);
-		es[6]=ndo_escape_buffer(cnotdata->ack_data);
-		es[7]=ndo_escape_buffer(cnotdata->contact_name);
+		es[4]=cnotdata->output;
+		es[5]=cnotdata->ack_author;
+		es[6]=cnotdata->ack_data;
+		es[7]=cnotdata->contact_name;
 
 		{
 			struct ndo_broker_data contact_notification_data[] = {
@@ -3245,24 +6237,24 @@ int ndomod_broker_data(int event_type, void *data){
 						{ .timestamp = cnotdata->start_time }},
 				{ NDO_DATA_ENDTIME, BD_TIMEVAL,
 						{ .timestamp = cnotdata->end_time }},
-				{ NDO_DATA_HOST, BD_STRING,
+				{ NDO_DATA_HOST, BD_STRING_ESCAPE,
 						{ .string = (es[0]==NULL) ? "" : es[0] }},
-				{ NDO_DATA_SERVICE, BD_STRING,
+				{ NDO_DATA_SERVICE, BD_STRING_ESCAPE,
 						{ .string = (es[1]==NULL) ? "" : es[1] }},
-				{ NDO_DATA_CONTACTNAME, BD_STRING,
+				{ NDO_DATA_CONTACTNAME, BD_STRING_ESCAPE,
 						{ .string = (es[7]==NULL) ? "" : es[7] }},
 				{ NDO_DATA_NOTIFICATIONREASON, BD_INT,
 						{ .integer = cnotdata->reason_type }},
 				{ NDO_DATA_STATE, BD_INT, { .integer = cnotdata->state }},
-				{ NDO_DATA_OUTPUT, BD_STRING,
+				{ NDO_DATA_OUTPUT, BD_STRING_ESCAPE,
 						{ .string = (es[2]==NULL) ? "" : es[2] }},
-				{ NDO_DATA_LONGOUTPUT, BD_STRING,
+				{ NDO_DATA_LONGOUTPUT, BD_STRING_ESCAPE,
 						{ .string = (es[3]==NULL) ? "" : es[3] }},
-				{ NDO_DATA_OUTPUT, BD_STRING,
+				{ NDO_DATA_OUTPUT, BD_STRING_ESCAPE,
 						{ .string = (es[4]==NULL) ? "" : es[4] }},
-				{ NDO_DATA_ACKAUTHOR, BD_STRING,
+				{ NDO_DATA_ACKAUTHOR, BD_STRING_ESCAPE,
 						{ .string = (es[5]==NULL) ? "" : es[5] }},
-				{ NDO_DATA_ACKDATA, BD_STRING,
+				{ NDO_DATA_ACKDATA, BD_STRING_ESCAPE,
 						{ .string = (es[6]==NULL) ? "" : es[6] }},
 				};
 
@@ -3278,14 +6270,14 @@ int ndomod_broker_data(int event_type, void *data){
 
 		cnotmdata=(nebstruct_contact_notification_method_data *)data;
 
-		es[0]=ndo_escape_buffer(cnotmdata->host_name);
-		es[1]=ndo_escape_buffer(cnotmdata->service_description);
-		es[2]=ndo_escape_buffer(cnotmdata->output);
-		es[3]=ndo_escape_buffer(cnotmdata->ack_author);
-		es[4]=ndo_escape_buffer(cnotmdata->ack_data);
-		es[5]=ndo_escape_buffer(cnotmdata->contact_name);
-		es[6]=ndo_escape_buffer(cnotmdata->command_name);
-		es[7]=ndo_escape_buffer(cnotmdata->command_args);
+		es[0]=cnotmdata->host_name;
+		es[1]=cnotmdata->service_description;
+		es[2]=cnotmdata->output;
+		es[3]=cnotmdata->ack_author;
+		es[4]=cnotmdata->ack_data;
+		es[5]=cnotmdata->contact_name;
+		es[6]=cnotmdata->command_name;
+		es[7]=cnotmdata->command_args;
 
 		{
 			struct ndo_broker_data contact_notification_method_data[] = {
@@ -3301,24 +6293,24 @@ int ndomod_broker_data(int event_type, void *data){
 						{ .timestamp = cnotmdata->start_time }},
 				{ NDO_DATA_ENDTIME, BD_TIMEVAL,
 						{ .timestamp = cnotmdata->end_time }},
-				{ NDO_DATA_HOST, BD_STRING,
+				{ NDO_DATA_HOST, BD_STRING_ESCAPE,
 						{ .string = (es[0]==NULL) ? "" : es[0] }},
-				{ NDO_DATA_SERVICE, BD_STRING,
+				{ NDO_DATA_SERVICE, BD_STRING_ESCAPE,
 						{ .string = (es[1]==NULL) ? "" : es[1] }},
-				{ NDO_DATA_CONTACTNAME, BD_STRING,
+				{ NDO_DATA_CONTACTNAME, BD_STRING_ESCAPE,
 						{ .string = (es[5]==NULL) ? "" : es[5] }},
-				{ NDO_DATA_COMMANDNAME, BD_STRING,
+				{ NDO_DATA_COMMANDNAME, BD_STRING_ESCAPE,
 						{ .string = (es[6]==NULL) ? "" : es[6] }},
-				{ NDO_DATA_COMMANDARGS, BD_STRING,
+				{ NDO_DATA_COMMANDARGS, BD_STRING_ESCAPE,
 						{ .string = (es[7]==NULL) ? "" : es[7] }},
 				{ NDO_DATA_NOTIFICATIONREASON, BD_INT,
 						{ .integer = cnotmdata->reason_type }},
 				{ NDO_DATA_STATE, BD_INT, { .integer = cnotmdata->state }},
-				{ NDO_DATA_OUTPUT, BD_STRING,
+				{ NDO_DATA_OUTPUT, BD_STRING_ESCAPE,
 						{ .string = (es[2]==NULL) ? "" : es[2] }},
-				{ NDO_DATA_ACKAUTHOR, BD_STRING,
+				{ NDO_DATA_ACKAUTHOR, BD_STRING_ESCAPE,
 						{ .string = (es[3]==NULL) ? "" : es[3] }},
-				{ NDO_DATA_ACKDATA, BD_STRING,
+				{ NDO_DATA_ACKDATA, BD_STRING_ESCAPE,
 						{ .string = (es[4]==NULL) ? "" : es[4] }},
 				};
 
@@ -3335,10 +6327,12 @@ int ndomod_broker_data(int event_type, void *data){
 
 		ackdata=(nebstruct_acknowledgement_data *)data;
 
-		es[0]=ndo_escape_buffer(ackdata->host_name);
-		es[1]=ndo_escape_buffer(ackdata->service_description);
-		es[2]=ndo_escape_buffer(ackdata->author_name);
-		es[3]=ndo_escape_buffer(ackdata->comment_data);
+		es[0]=ackdata->host_name;
+		es[1]=ackdata->service_description;
+		es[2]=ackdata->author_name;
+		es[3]=ackdata->comment_data;
+
+		objkey=ndomod_get_object_key(NULL,es[0],es[1]);
 
 		{
 			struct ndo_broker_data acknowledgement_data[] = {
@@ -3350,13 +6344,15 @@ int ndomod_broker_data(int event_type, void *data){
 						{ .timestamp = ackdata->timestamp }},
 				{ NDO_DATA_ACKNOWLEDGEMENTTYPE, BD_INT,
 						{ .integer = ackdata->acknowledgement_type }},
-				{ NDO_DATA_HOST, BD_STRING,
+				{ NDO_DATA_HOST, BD_STRING_ESCAPE,
 						{ .string = (es[0]==NULL) ? "" : es[0] }},
-				{ NDO_DATA_SERVICE, BD_STRING,
+				{ NDO_DATA_SERVICE, BD_STRING_ESCAPE,
 						{ .string = (es[1]==NULL) ? "" : es[1] }},
-				{ NDO_DATA_AUTHORNAME, BD_STRING,
+				{ NDO_DATA_OBJECTKEY, BD_UNSIGNED_LONGLONG,
+						{ .unsigned_longlong = objkey }},
+				{ NDO_DATA_AUTHORNAME, BD_STRING_ESCAPE,
 						{ .string = (es[2]==NULL) ? "" : es[2] }},
-				{ NDO_DATA_COMMENT, BD_STRING,
+				{ NDO_DATA_COMMENT, BD_STRING_ESCAPE,
 						{ .string = (es[3]==NULL) ? "" : es[3] }},
 				{ NDO_DATA_STATE, BD_INT, { .integer = ackdata->state }},
 				{ NDO_DATA_STICKY, BD_INT, { .integer = ackdata->is_sticky }},
@@ -3381,13 +6377,13 @@ int ndomod_broker_data(int event_type, void *data){
 		/* find host/service and get last state info */
 		if(schangedata->service_description==NULL){
 			if((temp_host=find_host(schangedata->host_name))==NULL){
-				ndo_dbuf_free(&dbuf);
+				ndomod_release_output_buffer(&dbuf);
 				return 0;
 				}
 			}
 		else{
 			if((temp_service=find_service(schangedata->host_name,schangedata->service_description))==NULL){
-				ndo_dbuf_free(&dbuf);
+				ndomod_release_output_buffer(&dbuf);
 				return 0;
 				}
 			last_state=temp_service->last_state;
@@ -3397,7 +6393,7 @@ int ndomod_broker_data(int event_type, void *data){
 		/* get the last state info */
 		if(schangedata->service_description==NULL){
 			if((temp_host=(host *)schangedata->object_ptr)==NULL){
-				ndo_dbuf_free(&dbuf);
+				ndomod_release_output_buffer(&dbuf);
 				return 0;
 				}
 			last_state=temp_host->last_state;
@@ -3405,7 +6401,7 @@ int ndomod_broker_data(int event_type, void *data){
 			}
 		else{
 			if((temp_service=(service *)schangedata->object_ptr)==NULL){
-				ndo_dbuf_free(&dbuf);
+				ndomod_release_output_buffer(&dbuf);
 				return 0;
 				}
 			last_state=temp_service->last_state;
@@ -3413,18 +6409,20 @@ int ndomod_broker_data(int event_type, void *data){
 			}
 #endif
 
-		es[0]=ndo_escape_buffer(schangedata->host_name);
-		es[1]=ndo_escape_buffer(schangedata->service_description);
-		es[2]=ndo_escape_buffer(schangedata->output);
+		es[0]=schangedata->host_name;
+		es[1]=schangedata->service_description;
+		es[2]=schangedata->output;
 #ifdef BUILD_NAGIOS_4X
 		if (CURRENT_OBJECT_STRUCTURE_VERSION >= 403 && has_ver403_long_output)
-			es[3]=ndo_escape_buffer(schangedata->longoutput);
+			es[3]=schangedata->longoutput;
 		else
-			es[3]=ndo_escape_buffer(schangedata->output);
+			es[3]=schangedata->output;
 #else
-		es[3]=ndo_escape_buffer(schangedata->output);
+		es[3]=schangedata->output;
 #endif
 
+		objkey=ndomod_get_object_key((temp_service!=NULL)?(void *)temp_service:(void *)temp_host,es[0],es[1]);
+
 		{
 			struct ndo_broker_data state_change_data[] = {
 				{ NDO_DATA_TYPE, BD_INT, { .integer = schangedata->type }},
@@ -3435,10 +6433,12 @@ int ndomod_broker_data(int event_type, void *data){
 						{ .timestamp = schangedata->timestamp }},
 				{ NDO_DATA_STATECHANGETYPE, BD_INT,
 						{ .integer = schangedata->statechange_type }},
-				{ NDO_DATA_HOST, BD_STRING,
+				{ NDO_DATA_HOST, BD_STRING_ESCAPE,
 						{ .string = (es[0]==NULL) ? "" : es[0] }},
-				{ NDO_DATA_SERVICE, BD_STRING,
+				{ NDO_DATA_SERVICE, BD_STRING_ESCAPE,
 						{ .string = (es[1]==NULL) ? "" : es[1] }},
+				{ NDO_DATA_OBJECTKEY, BD_UNSIGNED_LONGLONG,
+						{ .unsigned_longlong = objkey }},
 				{ NDO_DATA_STATECHANGE, BD_INT, { .integer = TRUE }},
 				{ NDO_DATA_STATE, BD_INT, { .integer = schangedata->state }},
 				{ NDO_DATA_STATETYPE, BD_INT,
@@ -3450,9 +6450,9 @@ int ndomod_broker_data(int event_type, void *data){
 				{ NDO_DATA_LASTSTATE, BD_INT, { .integer = last_state }},
 				{ NDO_DATA_LASTHARDSTATE, BD_INT,
 						{ .integer = last_hard_state }},
-				{ NDO_DATA_OUTPUT, BD_STRING,
+				{ NDO_DATA_OUTPUT, BD_STRING_ESCAPE,
 						{ .string = (es[2]==NULL) ? "" : es[2] }},
-				{ NDO_DATA_LONGOUTPUT, BD_STRING,
+				{ NDO_DATA_LONGOUTPUT, BD_STRING_ESCAPE,
 						{ .string = (es[3]==NULL) ? "" : es[3] }},
 				};
 
@@ -3465,23 +6465,36 @@ int ndomod_broker_data(int event_type, void *data){
 		break;
 
 	default:
-		ndo_dbuf_free(&dbuf);
+		ndomod_release_output_buffer(&dbuf);
 		return 0;
 		break;
 	        }
 
-	/* free escaped buffers */
-	for(x=0;x<8;x++){
-		free(es[x]);
-		es[x]=NULL;
-	        }
+	if(st!=NULL){
+		now=ndomod_stats_nsec();
+		ndomod_stats_record(&st->serialize,now-phase_start);
+		ndomod_stats_record(&st->escape,ndomod_escape_nsec-escape_start);
+		phase_start=now;
+		}
 
-	/* write data to sink */
-	if(write_to_sink==NDO_TRUE)
-		ndomod_write_to_sink(dbuf.buf,NDO_TRUE,NDO_TRUE);
+	/* write data to sink - status updates may be held back so only the latest one per object goes out */
+	if(write_to_sink==NDO_TRUE){
+		if(ndomod_status_conflation_window>0 && event_type==NEBCALLBACK_HOST_STATUS_DATA)
+			ndomod_conflate_status(temp_host,dbuf.buf);
+		else if(ndomod_status_conflation_window>0 && event_type==NEBCALLBACK_SERVICE_STATUS_DATA)
+			ndomod_conflate_status(temp_service,dbuf.buf);
+		else if(ndomod_write_to_sink(dbuf.buf,NDO_TRUE,NDO_TRUE)==NDO_OK && ds!=NULL)
+			ndomod_status_delta_sent(ds->object);
+
+		if(st!=NULL){
+			ndomod_stats_record(&st->write,ndomod_stats_nsec()-phase_start);
+			st->events++;
+			st->bytes+=dbuf.used_size;
+			}
+		}
 
-	/* free dynamic buffer */
-	ndo_dbuf_free(&dbuf);
+	/* give the output buffer back */
+	ndomod_release_output_buffer(&dbuf);
 
 
 
@@ -3524,6 +6537,29 @@ int ndomod_broker_data(int event_type, void *data){
         }
 
 
+/* callback for all the event types we registered for - times ndomod_handle_broker_data() */
+int ndomod_broker_data(int event_type, void *data){
+	unsigned long long start=0L;
+	int result=0;
+
+	if(event_type<0 || event_type>=NEBCALLBACK_NUMITEMS)
+		return ndomod_handle_broker_data(event_type,data);
+
+	/* every nebstruct starts with its sub-type */
+	if(data!=NULL && (ndomod_skipped_subtypes[event_type] & NDOMOD_SUBTYPE(*(int *)data)))
+		return 0;
+
+	if(ndomod_collect_stats==NDO_FALSE)
+		return ndomod_handle_broker_data(event_type,data);
+
+	start=ndomod_stats_nsec();
+	result=ndomod_handle_broker_data(event_type,data);
+	ndomod_stats_record(&ndomod_stats[event_type].total,ndomod_stats_nsec()-start);
+
+	return result;
+        }
+
+
 
 /****************************************************************************/
 /* CONFIG OUTPUT FUNCTIONS                                                  */
@@ -3607,17 +6643,15 @@ void ndomod_write_active_objects()
 	active_objects[0].value.integer = NDO_API_COMMANDDEFINITION;
 	obj_count = 1;
 	for (temp_command = command_list; temp_command != NULL; temp_command = temp_command->next) {
-		name1 = ndo_escape_buffer(temp_command->name);
+		name1 = temp_command->name;
 		active_objects[obj_count].key = obj_count;
-		active_objects[obj_count].datatype = BD_STRING;
+		active_objects[obj_count].datatype = BD_STRING_ESCAPE;
 		active_objects[obj_count].value.string = (name1 == NULL) ? "" : name1;
 		if (++obj_count > 250) {
 			ndomod_broker_data_serialize(&dbuf, NDO_API_ACTIVEOBJECTSLIST,
 					active_objects, obj_count, TRUE);
 			ndomod_write_to_sink(dbuf.buf,NDO_TRUE,NDO_TRUE);
 			ndo_dbuf_free(&dbuf);
-			while (--obj_count)
-				free(active_objects[obj_count].value.string);
 			obj_count = 1;
 		}
 	}
@@ -3626,25 +6660,21 @@ void ndomod_write_active_objects()
 				active_objects, obj_count, TRUE);
 		ndomod_write_to_sink(dbuf.buf,NDO_TRUE,NDO_TRUE);
 		ndo_dbuf_free(&dbuf);
-		while (--obj_count)
-			free(active_objects[obj_count].value.string);
 	}
 
 
 	active_objects[0].value.integer = NDO_API_TIMEPERIODDEFINITION;
 	obj_count = 1;
 	for (temp_timeperiod = timeperiod_list; temp_timeperiod != NULL; temp_timeperiod = temp_timeperiod->next) {
-		name1 = ndo_escape_buffer(temp_timeperiod->name);
+		name1 = temp_timeperiod->name;
 		active_objects[obj_count].key = obj_count;
-		active_objects[obj_count].datatype = BD_STRING;
+		active_objects[obj_count].datatype = BD_STRING_ESCAPE;
 		active_objects[obj_count].value.string = (name1 == NULL) ? "" : name1;
 		if (++obj_count > 250) {
 			ndomod_broker_data_serialize(&dbuf, NDO_API_ACTIVEOBJECTSLIST,
 					active_objects, obj_count, TRUE);
 			ndomod_write_to_sink(dbuf.buf,NDO_TRUE,NDO_TRUE);
 			ndo_dbuf_free(&dbuf);
-			while (--obj_count)
-				free(active_objects[obj_count].value.string);
 			obj_count = 1;
 		}
 	}
@@ -3653,25 +6683,21 @@ void ndomod_write_active_objects()
 				active_objects, obj_count, TRUE);
 		ndomod_write_to_sink(dbuf.buf,NDO_TRUE,NDO_TRUE);
 		ndo_dbuf_free(&dbuf);
-		while (--obj_count)
-			free(active_objects[obj_count].value.string);
 	}
 
 
 	active_objects[0].value.integer = NDO_API_CONTACTDEFINITION;
 	obj_count = 1;
 	for (temp_contact = contact_list; temp_contact != NULL; temp_contact = temp_contact->next) {
-		name1 = ndo_escape_buffer(temp_contact->name);
+		name1 = temp_contact->name;
 		active_objects[obj_count].key = obj_count;
-		active_objects[obj_count].datatype = BD_STRING;
+		active_objects[obj_count].datatype = BD_STRING_ESCAPE;
 		active_objects[obj_count].value.string = (name1 == NULL) ? "" : name1;
 		if (++obj_count > 250) {
 			ndomod_broker_data_serialize(&dbuf, NDO_API_ACTIVEOBJECTSLIST,
 					active_objects, obj_count, TRUE);
 			ndomod_write_to_sink(dbuf.buf,NDO_TRUE,NDO_TRUE);
 			ndo_dbuf_free(&dbuf);
-			while (--obj_count)
-				free(active_objects[obj_count].value.string);
 			obj_count = 1;
 		}
 	}
@@ -3680,25 +6706,21 @@ void ndomod_write_active_objects()
 				active_objects, obj_count, TRUE);
 		ndomod_write_to_sink(dbuf.buf,NDO_TRUE,NDO_TRUE);
 		ndo_dbuf_free(&dbuf);
-		while (--obj_count)
-			free(active_objects[obj_count].value.string);
 	}
 
 
 	active_objects[0].value.integer = NDO_API_CONTACTGROUPDEFINITION;
 	obj_count = 1;
 	for (temp_contactgroup = contactgroup_list; temp_contactgroup != NULL; temp_contactgroup = temp_contactgroup->next) {
-		name1 = ndo_escape_buffer(temp_contactgroup->group_name);
+		name1 = temp_contactgroup->group_name;
 		active_objects[obj_count].key = obj_count;
-		active_objects[obj_count].datatype = BD_STRING;
+		active_objects[obj_count].datatype = BD_STRING_ESCAPE;
 		active_objects[obj_count].value.string = (name1 == NULL) ? "" : name1;
 		if (++obj_count > 250) {
 			ndomod_broker_data_serialize(&dbuf, NDO_API_ACTIVEOBJECTSLIST,
 					active_objects, obj_count, TRUE);
 			ndomod_write_to_sink(dbuf.buf,NDO_TRUE,NDO_TRUE);
 			ndo_dbuf_free(&dbuf);
-			while (--obj_count)
-				free(active_objects[obj_count].value.string);
 			obj_count = 1;
 		}
 	}
@@ -3707,25 +6729,23 @@ void ndomod_write_active_objects()
 				active_objects, obj_count, TRUE);
 		ndomod_write_to_sink(dbuf.buf,NDO_TRUE,NDO_TRUE);
 		ndo_dbuf_free(&dbuf);
-		while (--obj_count)
-			free(active_objects[obj_count].value.string);
 	}
 
 
 	active_objects[0].value.integer = NDO_API_HOSTDEFINITION;
 	obj_count = 1;
 	for (temp_host = host_list; temp_host != NULL; temp_host = temp_host->next) {
-		name1 = ndo_escape_buffer(temp_host->name);
+		if (ndomod_host_exported(temp_host) == NDO_FALSE)
+			continue;
+		name1 = temp_host->name;
 		active_objects[obj_count].key = obj_count;
-		active_objects[obj_count].datatype = BD_STRING;
+		active_objects[obj_count].datatype = BD_STRING_ESCAPE;
 		active_objects[obj_count].value.string = (name1 == NULL) ? "" : name1;
 		if (++obj_count > 250) {
 			ndomod_broker_data_serialize(&dbuf, NDO_API_ACTIVEOBJECTSLIST,
 					active_objects, obj_count, TRUE);
 			ndomod_write_to_sink(dbuf.buf,NDO_TRUE,NDO_TRUE);
 			ndo_dbuf_free(&dbuf);
-			while (--obj_count)
-				free(active_objects[obj_count].value.string);
 			obj_count = 1;
 		}
 	}
@@ -3734,25 +6754,21 @@ void ndomod_write_active_objects()
 				active_objects, obj_count, TRUE);
 		ndomod_write_to_sink(dbuf.buf,NDO_TRUE,NDO_TRUE);
 		ndo_dbuf_free(&dbuf);
-		while (--obj_count)
-			free(active_objects[obj_count].value.string);
 	}
 
 
 	active_objects[0].value.integer = NDO_API_HOSTGROUPDEFINITION;
 	obj_count = 1;
 	for (temp_hostgroup = hostgroup_list; temp_hostgroup != NULL; temp_hostgroup = temp_hostgroup->next) {
-		name1 = ndo_escape_buffer(temp_hostgroup->group_name);
+		name1 = temp_hostgroup->group_name;
 		active_objects[obj_count].key = obj_count;
-		active_objects[obj_count].datatype = BD_STRING;
+		active_objects[obj_count].datatype = BD_STRING_ESCAPE;
 		active_objects[obj_count].value.string = (name1 == NULL) ? "" : name1;
 		if (++obj_count > 250) {
 			ndomod_broker_data_serialize(&dbuf, NDO_API_ACTIVEOBJECTSLIST,
 					active_objects, obj_count, TRUE);
 			ndomod_write_to_sink(dbuf.buf,NDO_TRUE,NDO_TRUE);
 			ndo_dbuf_free(&dbuf);
-			while (--obj_count)
-				free(active_objects[obj_count].value.string);
 			obj_count = 1;
 		}
 	}
@@ -3761,30 +6777,28 @@ void ndomod_write_active_objects()
 				active_objects, obj_count, TRUE);
 		ndomod_write_to_sink(dbuf.buf,NDO_TRUE,NDO_TRUE);
 		ndo_dbuf_free(&dbuf);
-		while (--obj_count)
-			free(active_objects[obj_count].value.string);
 	}
 
 
 	active_objects[0].value.integer = NDO_API_SERVICEDEFINITION;
 	obj_count = 1;
 	for (temp_service = service_list; temp_service != NULL; temp_service = temp_service->next) {
-		name1 = ndo_escape_buffer(temp_service->host_name);
-		name2 = ndo_escape_buffer(temp_service->description);
+		if (ndomod_service_exported(temp_service) == NDO_FALSE)
+			continue;
+		name1 = temp_service->host_name;
+		name2 = temp_service->description;
 		active_objects[obj_count].key = obj_count;
-		active_objects[obj_count].datatype = BD_STRING;
+		active_objects[obj_count].datatype = BD_STRING_ESCAPE;
 		active_objects[obj_count].value.string = (name1 == NULL) ? "" : name1;
 		++obj_count;
 		active_objects[obj_count].key = obj_count;
-		active_objects[obj_count].datatype = BD_STRING;
+		active_objects[obj_count].datatype = BD_STRING_ESCAPE;
 		active_objects[obj_count].value.string = (name2 == NULL) ? "" : name2;
 		if (++obj_count > 250) {
 			ndomod_broker_data_serialize(&dbuf, NDO_API_ACTIVEOBJECTSLIST,
 					active_objects, obj_count, TRUE);
 			ndomod_write_to_sink(dbuf.buf,NDO_TRUE,NDO_TRUE);
 			ndo_dbuf_free(&dbuf);
-			while (--obj_count)
-				free(active_objects[obj_count].value.string);
 			obj_count = 1;
 		}
 	}
@@ -3793,25 +6807,21 @@ void ndomod_write_active_objects()
 				active_objects, obj_count, TRUE);
 		ndomod_write_to_sink(dbuf.buf,NDO_TRUE,NDO_TRUE);
 		ndo_dbuf_free(&dbuf);
-		while (--obj_count)
-			free(active_objects[obj_count].value.string);
 	}
 
 
 	active_objects[0].value.integer = NDO_API_SERVICEGROUPDEFINITION;
 	obj_count = 1;
 	for (temp_servicegroup = servicegroup_list; temp_servicegroup !=NULL ; temp_servicegroup = temp_servicegroup->next) {
-		name1 = ndo_escape_buffer(temp_servicegroup->group_name);
+		name1 = temp_servicegroup->group_name;
 		active_objects[obj_count].key = obj_count;
-		active_objects[obj_count].datatype = BD_STRING;
+		active_objects[obj_count].datatype = BD_STRING_ESCAPE;
 		active_objects[obj_count].value.string = (name1 == NULL) ? "" : name1;
 		if (++obj_count > 250) {
 			ndomod_broker_data_serialize(&dbuf, NDO_API_ACTIVEOBJECTSLIST,
 					active_objects, obj_count, TRUE);
 			ndomod_write_to_sink(dbuf.buf,NDO_TRUE,NDO_TRUE);
 			ndo_dbuf_free(&dbuf);
-			while (--obj_count)
-				free(active_objects[obj_count].value.string);
 			obj_count = 1;
 		}
 	}
@@ -3820,8 +6830,6 @@ void ndomod_write_active_objects()
 				active_objects, obj_count, TRUE);
 		ndomod_write_to_sink(dbuf.buf,NDO_TRUE,NDO_TRUE);
 		ndo_dbuf_free(&dbuf);
-		while (--obj_count)
-			free(active_objects[obj_count].value.string);
 	}
 }
 
@@ -3836,6 +6844,7 @@ int ndomod_write_object_config(int config_type){
 	struct timeval now;
 	int x=0;
 	char *es[OBJECTCONFIG_ES_ITEMS];
+	int es_allocated[OBJECTCONFIG_ES_ITEMS];
 	command *temp_command=NULL;
 	timeperiod *temp_timeperiod=NULL;
 	timerange *temp_timerange=NULL;
@@ -3880,6 +6889,7 @@ int ndomod_write_object_config(int config_type){
 	int flap_detection_on_warning=0;
 	int flap_detection_on_unknown=0;
 	int flap_detection_on_critical=0;
+	unsigned long frame_start=0L;
 #if ( defined( BUILD_NAGIOS_3X) || defined( BUILD_NAGIOS_4X))
 	customvariablesmember *temp_customvar=NULL;
 	contactsmember *temp_contactsmember=NULL;
@@ -3900,14 +6910,16 @@ int ndomod_write_object_config(int config_type){
 	ndo_dbuf_init(&dbuf,2048);
 
 	/* initialize buffers */
-	for(x=0;x<OBJECTCONFIG_ES_ITEMS;x++)
+	for(x=0;x<OBJECTCONFIG_ES_ITEMS;x++){
 		es[x]=NULL;
+		es_allocated[x]=NDO_FALSE;
+	        }
 
 	/****** dump command config ******/
 	for(temp_command=command_list;temp_command!=NULL;temp_command=temp_command->next){
 
-		es[0]=ndo_escape_buffer(temp_command->name);
-		es[1]=ndo_escape_buffer(temp_command->command_line);
+		es[0]=ndomod_escape_string(temp_command->name,&es_allocated[0]);
+		es[1]=ndomod_escape_string(temp_command->command_line,&es_allocated[1]);
 
 		{
 			struct ndo_broker_data command_definition[] = {
@@ -3919,14 +6931,17 @@ int ndomod_write_object_config(int config_type){
 						{ .string = (es[1]==NULL) ? "" : es[1] }},
 				};
 
-			ndomod_broker_data_serialize(&dbuf, NDO_API_COMMANDDEFINITION,
+			frame_start=ndomod_broker_data_serialize(&dbuf, NDO_API_COMMANDDEFINITION,
 					command_definition,
 					sizeof(command_definition) / sizeof(command_definition[ 0]),
-					TRUE);
+					FALSE);
 		}
 
+		ndomod_confighash_serialize(&dbuf);
+		ndomod_enddata_serialize(&dbuf, frame_start);
+
 		/* free buffers */
-		NDOMOD_FREE_ESC_BUFFERS(es, 2);
+		NDOMOD_FREE_ESC_BUFFERS(es, es_allocated, 2);
 
 		/* write data to sink */
 		ndomod_write_to_sink(dbuf.buf,NDO_TRUE,NDO_TRUE);
@@ -3936,8 +6951,8 @@ int ndomod_write_object_config(int config_type){
 	/****** dump timeperiod config ******/
 	for(temp_timeperiod=timeperiod_list;temp_timeperiod!=NULL;temp_timeperiod=temp_timeperiod->next){
 
-		es[0]=ndo_escape_buffer(temp_timeperiod->name);
-		es[1]=ndo_escape_buffer(temp_timeperiod->alias);
+		es[0]=ndomod_escape_string(temp_timeperiod->name,&es_allocated[0]);
+		es[1]=ndomod_escape_string(temp_timeperiod->alias,&es_allocated[1]);
 
 		{
 			struct ndo_broker_data timeperiod_definition[] = {
@@ -3949,30 +6964,30 @@ int ndomod_write_object_config(int config_type){
 						{ .string = (es[1]==NULL) ? "" : es[1] }},
 				};
 
-			ndomod_broker_data_serialize(&dbuf, NDO_API_TIMEPERIODDEFINITION,
+			frame_start=ndomod_broker_data_serialize(&dbuf, NDO_API_TIMEPERIODDEFINITION,
 					timeperiod_definition, sizeof(timeperiod_definition) /
 					sizeof(timeperiod_definition[ 0]), FALSE);
 		}
 
-		NDOMOD_FREE_ESC_BUFFERS(es, 2);
+		NDOMOD_FREE_ESC_BUFFERS(es, es_allocated, 2);
 
 		/* dump timeranges for each day */
 		for(x=0;x<7;x++){
 			for(temp_timerange=temp_timeperiod->days[x];temp_timerange!=NULL;temp_timerange=temp_timerange->next){
 
 				snprintf(temp_buffer,sizeof(temp_buffer)-1
-					 ,"\n%d=%d:%lu-%lu"
-					 ,NDO_DATA_TIMERANGE
+					 ,"%d:%lu-%lu"
 					 ,x
 					 ,temp_timerange->range_start
 					 ,temp_timerange->range_end
 					);
 				temp_buffer[sizeof(temp_buffer)-1]='\x0';
-				ndo_dbuf_strcat(&dbuf,temp_buffer);
+				ndomod_string_serialize(&dbuf,NDO_DATA_TIMERANGE,temp_buffer,'\x0',NULL);
 			        }
 		        }
 
-		ndomod_enddata_serialize(&dbuf);
+		ndomod_confighash_serialize(&dbuf);
+		ndomod_enddata_serialize(&dbuf, frame_start);
 
 		ndomod_write_to_sink(dbuf.buf,NDO_TRUE,NDO_TRUE);
 
@@ -3981,20 +6996,17 @@ int ndomod_write_object_config(int config_type){
 
 
 	/* free buffers */
-	for(x=0;x<OBJECTCONFIG_ES_ITEMS;x++){
-		free(es[x]);
-		es[x]=NULL;
-	        }
+	NDOMOD_FREE_ESC_BUFFERS(es, es_allocated, OBJECTCONFIG_ES_ITEMS);
 
 	/****** dump contact config ******/
 	for(temp_contact=contact_list;temp_contact!=NULL;temp_contact=temp_contact->next){
 
-		es[0]=ndo_escape_buffer(temp_contact->name);
-		es[1]=ndo_escape_buffer(temp_contact->alias);
-		es[2]=ndo_escape_buffer(temp_contact->email);
-		es[3]=ndo_escape_buffer(temp_contact->pager);
-		es[4]=ndo_escape_buffer(temp_contact->host_notification_period);
-		es[5]=ndo_escape_buffer(temp_contact->service_notification_period);
+		es[0]=ndomod_escape_string(temp_contact->name,&es_allocated[0]);
+		es[1]=ndomod_escape_string(temp_contact->alias,&es_allocated[1]);
+		es[2]=ndomod_escape_string(temp_contact->email,&es_allocated[2]);
+		es[3]=ndomod_escape_string(temp_contact->pager,&es_allocated[3]);
+		es[4]=ndomod_escape_string(temp_contact->host_notification_period,&es_allocated[4]);
+		es[5]=ndomod_escape_string(temp_contact->service_notification_period,&es_allocated[5]);
 
 #ifdef BUILD_NAGIOS_4X
 		notify_on_service_downtime=flag_isset(temp_contact->service_notification_options,OPT_DOWNTIME);
@@ -4126,28 +7138,19 @@ int ndomod_write_object_config(int config_type){
 #endif
 				};
 
-			ndomod_broker_data_serialize(&dbuf, NDO_API_CONTACTDEFINITION,
+			frame_start=ndomod_broker_data_serialize(&dbuf, NDO_API_CONTACTDEFINITION,
 					contact_definition, sizeof(contact_definition) /
 					sizeof(contact_definition[ 0]), FALSE);
 		}
 
-		NDOMOD_FREE_ESC_BUFFERS(es, 6);
+		NDOMOD_FREE_ESC_BUFFERS(es, es_allocated, 6);
 
 		/* dump addresses for each contact */
 		for(x=0;x<MAX_CONTACT_ADDRESSES;x++){
 
-			es[0]=ndo_escape_buffer(temp_contact->address[x]);
-
-			snprintf(temp_buffer,sizeof(temp_buffer)-1
-				 ,"\n%d=%d:%s"
-				 ,NDO_DATA_CONTACTADDRESS
-				 ,x+1
-				 ,(es[0]==NULL)?"":es[0]
-				);
+			snprintf(temp_buffer,sizeof(temp_buffer)-1,"%d",x+1);
 			temp_buffer[sizeof(temp_buffer)-1]='\x0';
-			ndo_dbuf_strcat(&dbuf,temp_buffer);
-
-			NDOMOD_FREE_ESC_BUFFERS(es, 1);
+			ndomod_string_serialize(&dbuf,NDO_DATA_CONTACTADDRESS,temp_buffer,':',temp_contact->address[x]);
 		        }
 
 		/* dump host notification commands for each contact */
@@ -4163,7 +7166,8 @@ int ndomod_write_object_config(int config_type){
 		ndomod_customvars_serialize(temp_contact->custom_variables, &dbuf);
 #endif
 
-		ndomod_enddata_serialize(&dbuf);
+		ndomod_confighash_serialize(&dbuf);
+		ndomod_enddata_serialize(&dbuf, frame_start);
 
 		ndomod_write_to_sink(dbuf.buf,NDO_TRUE,NDO_TRUE);
 
@@ -4172,13 +7176,13 @@ int ndomod_write_object_config(int config_type){
 
 
 	/* free buffers */
-	NDOMOD_FREE_ESC_BUFFERS(es, OBJECTCONFIG_ES_ITEMS);
+	NDOMOD_FREE_ESC_BUFFERS(es, es_allocated, OBJECTCONFIG_ES_ITEMS);
 
 	/****** dump contactgroup config ******/
 	for(temp_contactgroup=contactgroup_list;temp_contactgroup!=NULL;temp_contactgroup=temp_contactgroup->next){
 
-		es[0]=ndo_escape_buffer(temp_contactgroup->group_name);
-		es[1]=ndo_escape_buffer(temp_contactgroup->alias);
+		es[0]=ndomod_escape_string(temp_contactgroup->group_name,&es_allocated[0]);
+		es[1]=ndomod_escape_string(temp_contactgroup->alias,&es_allocated[1]);
 
 		{
 			struct ndo_broker_data contactgroup_definition[] = {
@@ -4190,18 +7194,19 @@ int ndomod_write_object_config(int config_type){
 						{ .string = (es[1]==NULL) ? "" : es[1] }},
 				};
 
-			ndomod_broker_data_serialize(&dbuf, NDO_API_CONTACTGROUPDEFINITION,
+			frame_start=ndomod_broker_data_serialize(&dbuf, NDO_API_CONTACTGROUPDEFINITION,
 					contactgroup_definition, sizeof(contactgroup_definition) /
 					sizeof(contactgroup_definition[ 0]), FALSE);
 		}
 
-		NDOMOD_FREE_ESC_BUFFERS(es, 2);
+		NDOMOD_FREE_ESC_BUFFERS(es, es_allocated, 2);
 
 		/* dump members for each contactgroup */
 		ndomod_contacts_serialize(temp_contactgroup->members, &dbuf,
 				NDO_DATA_CONTACTGROUPMEMBER);
 
-		ndomod_enddata_serialize(&dbuf);
+		ndomod_confighash_serialize(&dbuf);
+		ndomod_enddata_serialize(&dbuf, frame_start);
 
 		ndomod_write_to_sink(dbuf.buf,NDO_TRUE,NDO_TRUE);
 
@@ -4210,36 +7215,39 @@ int ndomod_write_object_config(int config_type){
 
 
 	/* free buffers */
-	NDOMOD_FREE_ESC_BUFFERS(es, OBJECTCONFIG_ES_ITEMS);
+	NDOMOD_FREE_ESC_BUFFERS(es, es_allocated, OBJECTCONFIG_ES_ITEMS);
 
 	/****** dump host config ******/
 	for(temp_host=host_list;temp_host!=NULL;temp_host=temp_host->next){
 
-		es[0]=ndo_escape_buffer(temp_host->name);
-		es[1]=ndo_escape_buffer(temp_host->alias);
-		es[2]=ndo_escape_buffer(temp_host->address);
+		if(ndomod_host_exported(temp_host)==NDO_FALSE)
+			continue;
+
+		es[0]=ndomod_escape_string(temp_host->name,&es_allocated[0]);
+		es[1]=ndomod_escape_string(temp_host->alias,&es_allocated[1]);
+		es[2]=ndomod_escape_string(temp_host->address,&es_allocated[2]);
 #ifdef BUILD_NAGIOS_4X
-		es[3]=ndo_escape_buffer(temp_host->check_command);
+		es[3]=ndomod_escape_string(temp_host->check_command,&es_allocated[3]);
 #else
-		es[3]=ndo_escape_buffer(temp_host->host_check_command);
+		es[3]=ndomod_escape_string(temp_host->host_check_command,&es_allocated[3]);
 #endif
-		es[4]=ndo_escape_buffer(temp_host->event_handler);
-		es[5]=ndo_escape_buffer(temp_host->notification_period);
-		es[6]=ndo_escape_buffer(temp_host->check_period);
+		es[4]=ndomod_escape_string(temp_host->event_handler,&es_allocated[4]);
+		es[5]=ndomod_escape_string(temp_host->notification_period,&es_allocated[5]);
+		es[6]=ndomod_escape_string(temp_host->check_period,&es_allocated[6]);
 #ifdef BUILD_NAGIOS_4X
-		es[7]=ndo_escape_buffer("");
+		es[7]=ndomod_escape_string("",&es_allocated[7]);
 #else
-		es[7]=ndo_escape_buffer(temp_host->failure_prediction_options);
+		es[7]=ndomod_escape_string(temp_host->failure_prediction_options,&es_allocated[7]);
 #endif
 
 #if ( defined( BUILD_NAGIOS_3X) || defined( BUILD_NAGIOS_4X))
-		es[8]=ndo_escape_buffer(temp_host->notes);
-		es[9]=ndo_escape_buffer(temp_host->notes_url);
-		es[10]=ndo_escape_buffer(temp_host->action_url);
-		es[11]=ndo_escape_buffer(temp_host->icon_image);
-		es[12]=ndo_escape_buffer(temp_host->icon_image_alt);
-		es[13]=ndo_escape_buffer(temp_host->vrml_image);
-		es[14]=ndo_escape_buffer(temp_host->statusmap_image);
+		es[8]=ndomod_escape_string(temp_host->notes,&es_allocated[8]);
+		es[9]=ndomod_escape_string(temp_host->notes_url,&es_allocated[9]);
+		es[10]=ndomod_escape_string(temp_host->action_url,&es_allocated[10]);
+		es[11]=ndomod_escape_string(temp_host->icon_image,&es_allocated[11]);
+		es[12]=ndomod_escape_string(temp_host->icon_image_alt,&es_allocated[12]);
+		es[13]=ndomod_escape_string(temp_host->vrml_image,&es_allocated[13]);
+		es[14]=ndomod_escape_string(temp_host->statusmap_image,&es_allocated[14]);
 		have_2d_coords=temp_host->have_2d_coords;
 		x_2d=temp_host->x_2d;
 		y_2d=temp_host->y_2d;
@@ -4261,17 +7269,17 @@ int ndomod_write_object_config(int config_type){
 		flap_detection_on_down=temp_host->flap_detection_on_down;
 		flap_detection_on_unreachable=temp_host->flap_detection_on_unreachable;
 #endif
-		es[15]=ndo_escape_buffer(temp_host->display_name);
+		es[15]=ndomod_escape_string(temp_host->display_name,&es_allocated[15]);
 #endif
 #ifdef BUILD_NAGIOS_2X
 		if((temp_hostextinfo=find_hostextinfo(temp_host->name))!=NULL){
-			es[8]=ndo_escape_buffer(temp_hostextinfo->notes);
-			es[9]=ndo_escape_buffer(temp_hostextinfo->notes_url);
-			es[10]=ndo_escape_buffer(temp_hostextinfo->action_url);
-			es[11]=ndo_escape_buffer(temp_hostextinfo->icon_image);
-			es[12]=ndo_escape_buffer(temp_hostextinfo->icon_image_alt);
-			es[13]=ndo_escape_buffer(temp_hostextinfo->vrml_image);
-			es[14]=ndo_escape_buffer(temp_hostextinfo->statusmap_image);
+			es[8]=ndomod_escape_string(temp_hostextinfo->notes,&es_allocated[8]);
+			es[9]=ndomod_escape_string(temp_hostextinfo->notes_url,&es_allocated[9]);
+			es[10]=ndomod_escape_string(temp_hostextinfo->action_url,&es_allocated[10]);
+			es[11]=ndomod_escape_string(temp_hostextinfo->icon_image,&es_allocated[11]);
+			es[12]=ndomod_escape_string(temp_hostextinfo->icon_image_alt,&es_allocated[12]);
+			es[13]=ndomod_escape_string(temp_hostextinfo->vrml_image,&es_allocated[13]);
+			es[14]=ndomod_escape_string(temp_hostextinfo->statusmap_image,&es_allocated[14]);
 			have_2d_coords=temp_hostextinfo->have_2d_coords;
 			x_2d=temp_hostextinfo->x_2d;
 			y_2d=temp_hostextinfo->y_2d;
@@ -4303,7 +7311,7 @@ int ndomod_write_object_config(int config_type){
 		flap_detection_on_up=1;
 		flap_detection_on_down=1;
 		flap_detection_on_unreachable=1;
-		es[15]=ndo_escape_buffer(temp_host->name);
+		es[15]=ndomod_escape_string(temp_host->name,&es_allocated[15]);
 #endif
 
 		{
@@ -4484,12 +7492,12 @@ int ndomod_write_object_config(int config_type){
 #endif
 				};
 
-			ndomod_broker_data_serialize(&dbuf, NDO_API_HOSTDEFINITION,
+			frame_start=ndomod_broker_data_serialize(&dbuf, NDO_API_HOSTDEFINITION,
 					host_definition, sizeof(host_definition) /
 					sizeof(host_definition[ 0]), FALSE);
 		}
 
-		NDOMOD_FREE_ESC_BUFFERS(es, OBJECTCONFIG_ES_ITEMS);
+		NDOMOD_FREE_ESC_BUFFERS(es, es_allocated, OBJECTCONFIG_ES_ITEMS);
 
 		/* dump parent hosts */
 		ndomod_hosts_serialize(temp_host->parent_hosts, &dbuf,
@@ -4508,7 +7516,8 @@ int ndomod_write_object_config(int config_type){
 		ndomod_customvars_serialize(temp_host->custom_variables, &dbuf);
 #endif
 
-		ndomod_enddata_serialize(&dbuf);
+		ndomod_confighash_serialize(&dbuf);
+		ndomod_enddata_serialize(&dbuf, frame_start);
 
 		ndomod_write_to_sink(dbuf.buf,NDO_TRUE,NDO_TRUE);
 
@@ -4517,13 +7526,13 @@ int ndomod_write_object_config(int config_type){
 
 
 	/* free buffers */
-	NDOMOD_FREE_ESC_BUFFERS(es, OBJECTCONFIG_ES_ITEMS);
+	NDOMOD_FREE_ESC_BUFFERS(es, es_allocated, OBJECTCONFIG_ES_ITEMS);
 
 	/****** dump hostgroup config ******/
 	for(temp_hostgroup=hostgroup_list;temp_hostgroup!=NULL;temp_hostgroup=temp_hostgroup->next){
 
-		es[0]=ndo_escape_buffer(temp_hostgroup->group_name);
-		es[1]=ndo_escape_buffer(temp_hostgroup->alias);
+		es[0]=ndomod_escape_string(temp_hostgroup->group_name,&es_allocated[0]);
+		es[1]=ndomod_escape_string(temp_hostgroup->alias,&es_allocated[1]);
 
 		{
 			struct ndo_broker_data hostgroup_definition[] = {
@@ -4535,12 +7544,12 @@ int ndomod_write_object_config(int config_type){
 						{ .string = (es[1]==NULL) ? "" : es[1] }},
 				};
 
-			ndomod_broker_data_serialize(&dbuf, NDO_API_HOSTGROUPDEFINITION,
+			frame_start=ndomod_broker_data_serialize(&dbuf, NDO_API_HOSTGROUPDEFINITION,
 					hostgroup_definition, sizeof(hostgroup_definition) /
 					sizeof(hostgroup_definition[ 0]), FALSE);
 		}
 
-		NDOMOD_FREE_ESC_BUFFERS(es, 2);
+		NDOMOD_FREE_ESC_BUFFERS(es, es_allocated, 2);
 
 		/* dump members for each hostgroup */
 #ifdef BUILD_NAGIOS_2X
@@ -4551,7 +7560,8 @@ int ndomod_write_object_config(int config_type){
 				NDO_DATA_HOSTGROUPMEMBER);
 #endif
 
-		ndomod_enddata_serialize(&dbuf);
+		ndomod_confighash_serialize(&dbuf);
+		ndomod_enddata_serialize(&dbuf, frame_start);
 
 		ndomod_write_to_sink(dbuf.buf,NDO_TRUE,NDO_TRUE);
 
@@ -4561,27 +7571,30 @@ int ndomod_write_object_config(int config_type){
 	/****** dump service config ******/
 	for(temp_service=service_list;temp_service!=NULL;temp_service=temp_service->next){
 
-		es[0]=ndo_escape_buffer(temp_service->host_name);
-		es[1]=ndo_escape_buffer(temp_service->description);
+		if(ndomod_service_exported(temp_service)==NDO_FALSE)
+			continue;
+
+		es[0]=ndomod_escape_string(temp_service->host_name,&es_allocated[0]);
+		es[1]=ndomod_escape_string(temp_service->description,&es_allocated[1]);
 #ifdef BUILD_NAGIOS_4X
-		es[2]=ndo_escape_buffer(temp_service->check_command);
+		es[2]=ndomod_escape_string(temp_service->check_command,&es_allocated[2]);
 #else
-		es[2]=ndo_escape_buffer(temp_service->service_check_command);
+		es[2]=ndomod_escape_string(temp_service->service_check_command,&es_allocated[2]);
 #endif
-		es[3]=ndo_escape_buffer(temp_service->event_handler);
-		es[4]=ndo_escape_buffer(temp_service->notification_period);
-		es[5]=ndo_escape_buffer(temp_service->check_period);
+		es[3]=ndomod_escape_string(temp_service->event_handler,&es_allocated[3]);
+		es[4]=ndomod_escape_string(temp_service->notification_period,&es_allocated[4]);
+		es[5]=ndomod_escape_string(temp_service->check_period,&es_allocated[5]);
 #ifdef BUILD_NAGIOS_4X
-		es[6]=ndo_escape_buffer("");
+		es[6]=ndomod_escape_string("",&es_allocated[6]);
 #else
-		es[6]=ndo_escape_buffer(temp_service->failure_prediction_options);
+		es[6]=ndomod_escape_string(temp_service->failure_prediction_options,&es_allocated[6]);
 #endif
 #if ( defined( BUILD_NAGIOS_3X) || defined( BUILD_NAGIOS_4X))
-		es[7]=ndo_escape_buffer(temp_service->notes);
-		es[8]=ndo_escape_buffer(temp_service->notes_url);
-		es[9]=ndo_escape_buffer(temp_service->action_url);
-		es[10]=ndo_escape_buffer(temp_service->icon_image);
-		es[11]=ndo_escape_buffer(temp_service->icon_image_alt);
+		es[7]=ndomod_escape_string(temp_service->notes,&es_allocated[7]);
+		es[8]=ndomod_escape_string(temp_service->notes_url,&es_allocated[8]);
+		es[9]=ndomod_escape_string(temp_service->action_url,&es_allocated[9]);
+		es[10]=ndomod_escape_string(temp_service->icon_image,&es_allocated[10]);
+		es[11]=ndomod_escape_string(temp_service->icon_image_alt,&es_allocated[11]);
 
 		first_notification_delay=temp_service->first_notification_delay;
 #ifdef BUILD_NAGIOS_4X
@@ -4597,15 +7610,15 @@ int ndomod_write_object_config(int config_type){
 		flap_detection_on_unknown=temp_service->flap_detection_on_unknown;
 		flap_detection_on_critical=temp_service->flap_detection_on_critical;
 #endif
-		es[12]=ndo_escape_buffer(temp_service->display_name);
+		es[12]=ndomod_escape_string(temp_service->display_name,&es_allocated[12]);
 #endif
 #ifdef BUILD_NAGIOS_2X
 		if((temp_serviceextinfo=find_serviceextinfo(temp_service->host_name,temp_service->description))!=NULL){
-			es[7]=ndo_escape_buffer(temp_serviceextinfo->notes);
-			es[8]=ndo_escape_buffer(temp_serviceextinfo->notes_url);
-			es[9]=ndo_escape_buffer(temp_serviceextinfo->action_url);
-			es[10]=ndo_escape_buffer(temp_serviceextinfo->icon_image);
-			es[11]=ndo_escape_buffer(temp_serviceextinfo->icon_image_alt);
+			es[7]=ndomod_escape_string(temp_serviceextinfo->notes,&es_allocated[7]);
+			es[8]=ndomod_escape_string(temp_serviceextinfo->notes_url,&es_allocated[8]);
+			es[9]=ndomod_escape_string(temp_serviceextinfo->action_url,&es_allocated[9]);
+			es[10]=ndomod_escape_string(temp_serviceextinfo->icon_image,&es_allocated[10]);
+			es[11]=ndomod_escape_string(temp_serviceextinfo->icon_image_alt,&es_allocated[11]);
 			}
 		else{
 			es[7]=NULL;
@@ -4621,7 +7634,7 @@ int ndomod_write_object_config(int config_type){
 		flap_detection_on_warning=1;
 		flap_detection_on_unknown=1;
 		flap_detection_on_critical=1;
-		es[12]=ndo_escape_buffer(temp_service->description);
+		es[12]=ndomod_escape_string(temp_service->description,&es_allocated[12]);
 #endif
 
 		{
@@ -4814,12 +7827,12 @@ int ndomod_write_object_config(int config_type){
 #endif
 				};
 
-			ndomod_broker_data_serialize(&dbuf, NDO_API_SERVICEDEFINITION,
+			frame_start=ndomod_broker_data_serialize(&dbuf, NDO_API_SERVICEDEFINITION,
 					service_definition, sizeof(service_definition) /
 					sizeof(service_definition[ 0]), FALSE);
 		}
 
-		NDOMOD_FREE_ESC_BUFFERS(es, OBJECTCONFIG_ES_ITEMS);
+		NDOMOD_FREE_ESC_BUFFERS(es, es_allocated, OBJECTCONFIG_ES_ITEMS);
 
 #ifdef BUILD_NAGIOS_4X
 		/* dump parent services */
@@ -4841,7 +7854,8 @@ int ndomod_write_object_config(int config_type){
 		ndomod_customvars_serialize(temp_service->custom_variables, &dbuf);
 #endif
 
-		ndomod_enddata_serialize(&dbuf);
+		ndomod_confighash_serialize(&dbuf);
+		ndomod_enddata_serialize(&dbuf, frame_start);
 
 		ndomod_write_to_sink(dbuf.buf,NDO_TRUE,NDO_TRUE);
 
@@ -4852,8 +7866,8 @@ int ndomod_write_object_config(int config_type){
 	/****** dump servicegroup config ******/
 	for(temp_servicegroup=servicegroup_list;temp_servicegroup!=NULL;temp_servicegroup=temp_servicegroup->next){
 
-		es[0]=ndo_escape_buffer(temp_servicegroup->group_name);
-		es[1]=ndo_escape_buffer(temp_servicegroup->alias);
+		es[0]=ndomod_escape_string(temp_servicegroup->group_name,&es_allocated[0]);
+		es[1]=ndomod_escape_string(temp_servicegroup->alias,&es_allocated[1]);
 
 		{
 			struct ndo_broker_data servicegroup_definition[] = {
@@ -4865,18 +7879,19 @@ int ndomod_write_object_config(int config_type){
 						{ .string = (es[1]==NULL) ? "" : es[1] }},
 				};
 
-			ndomod_broker_data_serialize(&dbuf, NDO_API_SERVICEGROUPDEFINITION,
+			frame_start=ndomod_broker_data_serialize(&dbuf, NDO_API_SERVICEGROUPDEFINITION,
 					servicegroup_definition, sizeof(servicegroup_definition) /
 					sizeof(servicegroup_definition[ 0]), FALSE);
 		}
 
-		NDOMOD_FREE_ESC_BUFFERS(es, 2);
+		NDOMOD_FREE_ESC_BUFFERS(es, es_allocated, 2);
 
 		/* dump members for each servicegroup */
 		ndomod_services_serialize(temp_servicegroup->members, &dbuf,
 				NDO_DATA_SERVICEGROUPMEMBER);
 
-		ndomod_enddata_serialize(&dbuf);
+		ndomod_confighash_serialize(&dbuf);
+		ndomod_enddata_serialize(&dbuf, frame_start);
 
 		ndomod_write_to_sink(dbuf.buf,NDO_TRUE,NDO_TRUE);
 
@@ -4891,8 +7906,8 @@ int ndomod_write_object_config(int config_type){
 #else
 	for(temp_hostescalation=hostescalation_list;temp_hostescalation!=NULL;temp_hostescalation=temp_hostescalation->next){
 #endif
-		es[0]=ndo_escape_buffer(temp_hostescalation->host_name);
-		es[1]=ndo_escape_buffer(temp_hostescalation->escalation_period);
+		es[0]=ndomod_escape_string(temp_hostescalation->host_name,&es_allocated[0]);
+		es[1]=ndomod_escape_string(temp_hostescalation->escalation_period,&es_allocated[1]);
 
 		{
 			struct ndo_broker_data hostescalation_definition[] = {
@@ -4938,14 +7953,14 @@ int ndomod_write_object_config(int config_type){
 						}},
 				};
 
-			ndomod_broker_data_serialize(&dbuf,
+			frame_start=ndomod_broker_data_serialize(&dbuf,
 					NDO_API_HOSTESCALATIONDEFINITION,
 					hostescalation_definition,
 					sizeof(hostescalation_definition) /
 					sizeof(hostescalation_definition[ 0]), FALSE);
 		}
 
-		NDOMOD_FREE_ESC_BUFFERS(es, 2);
+		NDOMOD_FREE_ESC_BUFFERS(es, es_allocated, 2);
 
 		/* dump contactgroups */
 		ndomod_contactgroups_serialize(temp_hostescalation->contact_groups,
@@ -4957,7 +7972,7 @@ int ndomod_write_object_config(int config_type){
 				NDO_DATA_CONTACT);
 #endif
 
-		ndomod_enddata_serialize(&dbuf);
+		ndomod_enddata_serialize(&dbuf, frame_start);
 
 		ndomod_write_to_sink(dbuf.buf,NDO_TRUE,NDO_TRUE);
 
@@ -4973,9 +7988,9 @@ int ndomod_write_object_config(int config_type){
 	for(temp_serviceescalation=serviceescalation_list;temp_serviceescalation!=NULL;temp_serviceescalation=temp_serviceescalation->next){
 #endif
 
-		es[0]=ndo_escape_buffer(temp_serviceescalation->host_name);
-		es[1]=ndo_escape_buffer(temp_serviceescalation->description);
-		es[2]=ndo_escape_buffer(temp_serviceescalation->escalation_period);
+		es[0]=ndomod_escape_string(temp_serviceescalation->host_name,&es_allocated[0]);
+		es[1]=ndomod_escape_string(temp_serviceescalation->description,&es_allocated[1]);
+		es[2]=ndomod_escape_string(temp_serviceescalation->escalation_period,&es_allocated[2]);
 
 		{
 			struct ndo_broker_data serviceescalation_definition[] = {
@@ -5035,17 +8050,16 @@ int ndomod_write_object_config(int config_type){
 						}},
 				};
 
-			NDOMOD_FREE_ESC_BUFFERS(es, 3);
+			NDOMOD_FREE_ESC_BUFFERS(es, es_allocated, 3);
 
-			ndomod_broker_data_serialize(&dbuf,
+			frame_start=ndomod_broker_data_serialize(&dbuf,
 					NDO_API_SERVICEESCALATIONDEFINITION,
 					serviceescalation_definition,
 					sizeof(serviceescalation_definition) /
 					sizeof(serviceescalation_definition[ 0]), FALSE);
 		}
 
-		free(es[0]);
-		es[0]=NULL;
+		NDOMOD_FREE_ESC_BUFFERS(es, es_allocated, 1);
 
 		/* dump contactgroups */
 		ndomod_contactgroups_serialize(temp_serviceescalation->contact_groups,
@@ -5057,7 +8071,7 @@ int ndomod_write_object_config(int config_type){
 				NDO_DATA_CONTACT);
 #endif
 
-		ndomod_enddata_serialize(&dbuf);
+		ndomod_enddata_serialize(&dbuf, frame_start);
 
 		ndomod_write_to_sink(dbuf.buf,NDO_TRUE,NDO_TRUE);
 
@@ -5073,11 +8087,11 @@ int ndomod_write_object_config(int config_type){
 	for(temp_hostdependency=hostdependency_list;temp_hostdependency!=NULL;temp_hostdependency=temp_hostdependency->next){
 #endif
 
-		es[0]=ndo_escape_buffer(temp_hostdependency->host_name);
-		es[1]=ndo_escape_buffer(temp_hostdependency->dependent_host_name);
+		es[0]=ndomod_escape_string(temp_hostdependency->host_name,&es_allocated[0]);
+		es[1]=ndomod_escape_string(temp_hostdependency->dependent_host_name,&es_allocated[1]);
 
 #if ( defined( BUILD_NAGIOS_3X) || defined( BUILD_NAGIOS_4X))
-		es[2]=ndo_escape_buffer(temp_hostdependency->dependency_period);
+		es[2]=ndomod_escape_string(temp_hostdependency->dependency_period,&es_allocated[2]);
 #endif
 #ifdef BUILD_NAGIOS_2X
 		es[2]=NULL;
@@ -5126,7 +8140,7 @@ int ndomod_write_object_config(int config_type){
 						}},
 				};
 
-		NDOMOD_FREE_ESC_BUFFERS(es, 3);
+		NDOMOD_FREE_ESC_BUFFERS(es, es_allocated, 3);
 
 			ndomod_broker_data_serialize(&dbuf,
 					NDO_API_HOSTDEPENDENCYDEFINITION,
@@ -5149,13 +8163,13 @@ int ndomod_write_object_config(int config_type){
 	for(temp_servicedependency=servicedependency_list;temp_servicedependency!=NULL;temp_servicedependency=temp_servicedependency->next){
 #endif
 
-		es[0]=ndo_escape_buffer(temp_servicedependency->host_name);
-		es[1]=ndo_escape_buffer(temp_servicedependency->service_description);
-		es[2]=ndo_escape_buffer(temp_servicedependency->dependent_host_name);
-		es[3]=ndo_escape_buffer(temp_servicedependency->dependent_service_description);
+		es[0]=ndomod_escape_string(temp_servicedependency->host_name,&es_allocated[0]);
+		es[1]=ndomod_escape_string(temp_servicedependency->service_description,&es_allocated[1]);
+		es[2]=ndomod_escape_string(temp_servicedependency->dependent_host_name,&es_allocated[2]);
+		es[3]=ndomod_escape_string(temp_servicedependency->dependent_service_description,&es_allocated[3]);
 
 #if ( defined( BUILD_NAGIOS_3X) || defined( BUILD_NAGIOS_4X))
-		es[4]=ndo_escape_buffer(temp_servicedependency->dependency_period);
+		es[4]=ndomod_escape_string(temp_servicedependency->dependency_period,&es_allocated[4]);
 #endif
 #ifdef BUILD_NAGIOS_2X
 		es[4]=NULL;
@@ -5217,7 +8231,7 @@ int ndomod_write_object_config(int config_type){
 						}},
 				};
 
-			NDOMOD_FREE_ESC_BUFFERS(es, 5);
+			NDOMOD_FREE_ESC_BUFFERS(es, es_allocated, 5);
 
 			ndomod_broker_data_serialize(&dbuf,
 					NDO_API_SERVICEDEPENDENCYDEFINITION,
@@ -0,0 +1,266 @@
+/**
+ * @file serialize.c Serialization of ndomod broker data into the NDO protocols
+ */
+/*
+ * Copyright 2009-2014 Nagios Core Development Team and Community Contributors
+ * Copyright 2005-2009 Ethan Galstad
+ *
+ * This file is part of NDOUtils.
+ *
+ * NDOUtils is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * NDOUtils is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with NDOUtils. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "../include/config.h"
+#include "../include/common.h"
+#include "../include/io.h"
+#include "../include/utils.h"
+#include "../include/protoapi.h"
+#include "../include/serialize.h"
+
+
+int ndomod_protocol_version=NDO_API_PROTOVERSION;
+int ndomod_collect_stats=NDO_TRUE;
+unsigned long ndomod_config_hash_start=0L;	/* offset of the first item after the timestamp */
+unsigned long long ndomod_escape_nsec=0L;	/* running total, callers look at how much it grew */
+
+
+/* monotonic time in nsec - only differences between two readings mean anything */
+unsigned long long ndomod_stats_nsec(void){
+	struct timeval tv;
+#ifdef CLOCK_MONOTONIC
+	struct timespec ts;
+
+	if(clock_gettime(CLOCK_MONOTONIC,&ts)==0)
+		return (unsigned long long)ts.tv_sec*1000000000L+ts.tv_nsec;
+#endif
+	gettimeofday(&tv,NULL);
+	return (unsigned long long)tv.tv_sec*1000000000L+tv.tv_usec*1000L;
+        }
+
+
+/* escapes a string into an output buffer, adding up the time it takes */
+void ndomod_append_escaped(ndo_dbuf *dbufp, const char *str){
+	unsigned long long start=0L;
+
+	if(ndomod_collect_stats==NDO_FALSE){
+		ndo_dbuf_append_escaped(dbufp,str);
+		return;
+		}
+
+	start=ndomod_stats_nsec();
+	ndo_dbuf_append_escaped(dbufp,str);
+	ndomod_escape_nsec+=ndomod_stats_nsec()-start;
+
+	return;
+        }
+
+
+/* escapes a string for a BD_STRING item - protocol 3 sends strings as they are, so there it is a no-op */
+char *ndomod_escape_string(char *buffer, int *allocated){
+
+	if(ndomod_protocol_version==NDO_API_PROTOVERSION_BINARY){
+		*allocated=NDO_FALSE;
+		return buffer;
+		}
+
+	return ndo_escape_buffer(buffer,allocated);
+        }
+
+
+/* starts a data item of the given binary field type (protocol 3) or a "\n<key>=" line (protocol 2) */
+void ndomod_key_serialize(ndo_dbuf *dbufp, int key, int fieldtype) {
+
+	if(ndomod_protocol_version==NDO_API_PROTOVERSION_BINARY) {
+		ndo_dbuf_append_varint(dbufp, key);
+		ndo_dbuf_addchar(dbufp, fieldtype);
+		return;
+		}
+
+	ndo_dbuf_addchar(dbufp, '\n');
+	ndo_dbuf_append_long(dbufp, key);
+	ndo_dbuf_addchar(dbufp, '=');
+	}
+
+/* starts a string item made of len unescaped bytes - the parts follow with ndomod_string_append() */
+void ndomod_string_begin(ndo_dbuf *dbufp, int key, unsigned long len) {
+
+	ndomod_key_serialize(dbufp, key, NDO_API_FIELD_STRING);
+	if(ndomod_protocol_version==NDO_API_PROTOVERSION_BINARY)
+		ndo_dbuf_append_varint(dbufp, len);
+	}
+
+/* appends part of a string item, escaping it if the protocol needs that */
+void ndomod_string_append(ndo_dbuf *dbufp, const char *str) {
+
+	if(NULL == str)
+		return;
+
+	if(ndomod_protocol_version==NDO_API_PROTOVERSION_BINARY)
+		ndo_dbuf_strcat(dbufp, (char *)str);
+	else
+		ndomod_append_escaped(dbufp, str);
+	}
+
+/* appends a complete "<str1><sep><str2>" string item (str2 and sep are optional) */
+void ndomod_string_serialize(ndo_dbuf *dbufp, int key, const char *str1,
+		char sep, const char *str2) {
+
+	unsigned long len = 0L;
+
+	if(NULL != str1)
+		len += strlen(str1);
+	if('\x0' != sep)
+		len++;
+	if(NULL != str2)
+		len += strlen(str2);
+
+	ndomod_string_begin(dbufp, key, len);
+	ndomod_string_append(dbufp, str1);
+	if('\x0' != sep)
+		ndo_dbuf_addchar(dbufp, sep);
+	ndomod_string_append(dbufp, str2);
+	}
+
+/* opens a frame: marker, fixed-size length (patched when the frame is closed) and data type - returns where it starts */
+unsigned long ndomod_frame_begin(ndo_dbuf *dbufp, int datatype) {
+	unsigned long frame_start = dbufp->used_size;
+
+	ndo_dbuf_addchar(dbufp, NDO_API_FRAME_MARKER);
+	if(ndo_dbuf_reserve(dbufp, NDO_API_FRAME_LENGTH_SIZE) == NDO_OK) {
+		ndo_encode_varint_fixed(dbufp->buf + dbufp->used_size, 0L, NDO_API_FRAME_LENGTH_SIZE);
+		dbufp->used_size += NDO_API_FRAME_LENGTH_SIZE;
+		dbufp->buf[dbufp->used_size] = '\x0';
+		}
+	ndo_dbuf_append_varint(dbufp, datatype);
+
+	return frame_start;
+	}
+
+/* frame_start is what ndomod_broker_data_serialize() returned for this item */
+void ndomod_enddata_serialize(ndo_dbuf *dbufp, unsigned long frame_start) {
+
+	/* protocol 3 frames end where their length says they do */
+	if(ndomod_protocol_version==NDO_API_PROTOVERSION_BINARY) {
+		if(dbufp->buf != NULL && dbufp->used_size >= frame_start + NDO_API_FRAME_HEADER_SIZE)
+			ndo_encode_varint_fixed(dbufp->buf + frame_start + 1,
+					dbufp->used_size - frame_start - NDO_API_FRAME_HEADER_SIZE,
+					NDO_API_FRAME_LENGTH_SIZE);
+		return;
+		}
+
+	ndo_dbuf_addchar(dbufp, '\n');
+	ndo_dbuf_append_long(dbufp, NDO_API_ENDDATA);
+	ndo_dbuf_strncat(dbufp, "\n\n", 2);
+	}
+
+unsigned long ndomod_broker_data_serialize(ndo_dbuf *dbufp, int datatype,
+		struct ndo_broker_data *bd, size_t bdsize, int add_enddata) {
+
+	size_t x;
+	struct ndo_broker_data *bdp;
+	unsigned long frame_start = dbufp->used_size;
+	char numbuf[24];
+	union {
+		double d;
+		unsigned long long u;
+		} fbits;
+
+	/* Start everything out with the broker data type */
+	if(ndomod_protocol_version==NDO_API_PROTOVERSION_BINARY)
+		frame_start = ndomod_frame_begin(dbufp, datatype);
+	else {
+		ndo_dbuf_addchar(dbufp, '\n');
+		ndo_dbuf_append_long(dbufp, datatype);
+		ndo_dbuf_addchar(dbufp, ':');
+		}
+
+	/* Add each value - everything is written straight into the output buffer */
+	for(x = 0, bdp = bd; x < bdsize; x++, bdp++) {
+
+		if(ndomod_protocol_version==NDO_API_PROTOVERSION_BINARY) {
+			switch(bdp->datatype) {
+			case BD_INT:
+				ndomod_key_serialize(dbufp, bdp->key, NDO_API_FIELD_INT);
+				ndo_dbuf_append_varint(dbufp, NDO_ZIGZAG(bdp->value.integer));
+				break;
+			case BD_TIMEVAL:
+				ndomod_key_serialize(dbufp, bdp->key, NDO_API_FIELD_TIMEVAL);
+				ndo_dbuf_append_varint(dbufp, NDO_ZIGZAG(bdp->value.timestamp.tv_sec));
+				ndo_dbuf_append_varint(dbufp, bdp->value.timestamp.tv_usec);
+				break;
+			case BD_STRING:
+				/* from ndomod_escape_string(), which leaves it as it is for this protocol */
+				ndomod_key_serialize(dbufp, bdp->key, NDO_API_FIELD_STRING);
+				ndo_dbuf_append_varint(dbufp, strlen(bdp->value.string));
+				ndo_dbuf_strcat(dbufp, bdp->value.string);
+				break;
+			case BD_STRING_ESCAPE:
+				ndomod_string_serialize(dbufp, bdp->key, bdp->value.string, '\x0', NULL);
+				break;
+			case BD_UNSIGNED_LONG:
+				ndomod_key_serialize(dbufp, bdp->key, NDO_API_FIELD_UNSIGNED_LONG);
+				ndo_dbuf_append_varint(dbufp, bdp->value.unsigned_long);
+				break;
+			case BD_UNSIGNED_LONGLONG:
+				ndomod_key_serialize(dbufp, bdp->key, NDO_API_FIELD_UNSIGNED_LONG);
+				ndo_dbuf_append_varint(dbufp, bdp->value.unsigned_longlong);
+				break;
+			case BD_FLOAT:
+				ndomod_key_serialize(dbufp, bdp->key, NDO_API_FIELD_DOUBLE);
+				fbits.d = bdp->value.floating_point;
+				ndo_dbuf_append_varint(dbufp, fbits.u);
+				break;
+				}
+			if(x==0)
+				ndomod_config_hash_start = dbufp->used_size;
+			continue;
+			}
+
+		ndomod_key_serialize(dbufp, bdp->key, 0);
+		switch(bdp->datatype) {
+		case BD_INT:
+			ndo_dbuf_append_long(dbufp, bdp->value.integer);
+			break;
+		case BD_TIMEVAL:
+			ndo_dbuf_append_long(dbufp, bdp->value.timestamp.tv_sec);
+			ndo_dbuf_addchar(dbufp, '.');
+			ndo_dbuf_append_ulong(dbufp, bdp->value.timestamp.tv_usec, 6);
+			break;
+		case BD_STRING:
+			ndo_dbuf_strcat(dbufp, bdp->value.string);
+			break;
+		case BD_STRING_ESCAPE:
+			ndomod_append_escaped(dbufp, bdp->value.string);
+			break;
+		case BD_UNSIGNED_LONG:
+			ndo_dbuf_append_ulong(dbufp, bdp->value.unsigned_long, 0);
+			break;
+		case BD_UNSIGNED_LONGLONG:
+			snprintf(numbuf, sizeof(numbuf), "%llu", bdp->value.unsigned_longlong);
+			ndo_dbuf_strcat(dbufp, numbuf);
+			break;
+		case BD_FLOAT:
+			ndo_dbuf_append_double(dbufp, bdp->value.floating_point, 5);
+			break;
+			}
+		if(x==0)
+			ndomod_config_hash_start = dbufp->used_size;
+		}
+
+	/* Close everything out with an NDO_API_ENDDATA marker */
+	if(NDO_FALSE != add_enddata) {
+		ndomod_enddata_serialize(dbufp, frame_start);
+		}
+
+	return frame_start;
+	}
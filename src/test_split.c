@@ -0,0 +1,271 @@
+/**
+ * @file test_split.c Checks that ndo2db puts client input split across reads back together
+ */
+/*
+ * Copyright 2009-2014 Nagios Core Development Team and Community Contributors
+ *
+ * This file is part of NDOUtils.
+ *
+ * NDOUtils is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * NDOUtils is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with NDOUtils. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* the splitter is private to the daemon, so the daemon is built right into the test */
+#define main ndo2db_main
+#include "ndo2db.c"
+#undef main
+
+#define TEST_SPLIT_UNKNOWN_TYPE         999	/* frames of an unknown type are counted and thrown out, so no database is needed */
+
+
+int test_failures=0;
+
+
+/* appends one frame with a body of the given size */
+static void test_split_add_frame(ndo_dbuf *out, unsigned long body){
+	ndo_dbuf payload;
+	char header[NDO_API_FRAME_HEADER_SIZE];
+	unsigned long x;
+
+	ndo_dbuf_init(&payload,256);
+	ndo_dbuf_append_varint(&payload,TEST_SPLIT_UNKNOWN_TYPE);
+	for(x=0;x<body;x++)
+		ndo_dbuf_strncat(&payload,"x",1);
+
+	header[0]=NDO_API_FRAME_MARKER;
+	ndo_encode_varint_fixed(header+1,payload.used_size,NDO_API_FRAME_LENGTH_SIZE);
+
+	ndo_dbuf_strncat(out,header,NDO_API_FRAME_HEADER_SIZE);
+	ndo_dbuf_strncat(out,payload.buf,payload.used_size);
+
+	ndo_dbuf_free(&payload);
+        }
+
+
+/* appends one line of text with the given length */
+static void test_split_add_line(ndo_dbuf *out, unsigned long length){
+	unsigned long x;
+
+	for(x=0;x<length;x++)
+		ndo_dbuf_strncat(out,(x%2)?"y":"z",1);
+	ndo_dbuf_strncat(out,"\n",1);
+        }
+
+
+/* feeds the stream to the splitter in the given chunks and checks every byte was handled - lines cut short still leave least bytes handled */
+static void test_split_run(const char *name, ndo_dbuf *stream, int protocol_version, unsigned long lines, unsigned long least, unsigned long *cuts, int ncuts){
+	ndo2db_idi idi;
+	ndo_dbuf carry;
+	char *copy=NULL;
+	unsigned long start=0L;
+	unsigned long end=0L;
+	unsigned long limit=0L;
+	int exact=NDO_FALSE;
+	int x;
+
+	ndo2db_idi_init(&idi);
+	idi.protocol_version=protocol_version;
+	idi.current_input_section=NDO2DB_INPUT_SECTION_DATA;
+	ndo_dbuf_init(&carry,2048);
+
+	/* text lines are only counted, not parsed */
+	if(protocol_version!=NDO_API_PROTOVERSION_BINARY)
+		idi.ignore_client_data=NDO_TRUE;
+	limit=(protocol_version==NDO_API_PROTOVERSION_BINARY)?ndo2db_max_frame_size:ndo2db_max_line_length+1;
+	exact=(least==stream->used_size)?NDO_TRUE:NDO_FALSE;
+
+	if((copy=(char *)malloc(stream->used_size+1))==NULL){
+		printf("FAIL: %s: out of memory\n",name);
+		test_failures++;
+		return;
+		}
+	memcpy(copy,stream->buf,stream->used_size);
+
+	for(x=0;x<=ncuts;x++){
+		end=(x<ncuts)?cuts[x]:stream->used_size;
+		if(end>start)
+			ndo2db_split_input(&idi,&carry,copy+start,end-start);
+		start=end;
+
+		if(carry.used_size>limit){
+			printf("FAIL: %s: %lu bytes carried over\n",name,carry.used_size);
+			test_failures++;
+			break;
+			}
+
+		/* whatever is carried over has to be exactly the input that hasn't been handled yet */
+		if(exact==NDO_TRUE && (idi.bytes_processed+carry.used_size!=end || memcmp(carry.buf,stream->buf+idi.bytes_processed,carry.used_size))){
+			printf("FAIL: %s: carry of %lu bytes doesn't match the input after %lu bytes\n",name,carry.used_size,idi.bytes_processed);
+			test_failures++;
+			break;
+			}
+		}
+
+	if(idi.bytes_processed<least || idi.bytes_processed>stream->used_size || carry.used_size!=0L || idi.frame_skip!=0L){
+		printf("FAIL: %s: %lu of %lu bytes handled, %lu left over\n",name,idi.bytes_processed,stream->used_size,carry.used_size);
+		test_failures++;
+		}
+
+	if(idi.lines_processed!=lines){
+		printf("FAIL: %s: %lu of %lu lines handled\n",name,idi.lines_processed,lines);
+		test_failures++;
+		}
+
+	free(copy);
+	ndo_dbuf_free(&carry);
+	ndo2db_free_input_memory(&idi);
+	ndo2db_free_connection_memory(&idi);
+        }
+
+
+/* a frame over max_frame_size is consumed as it arrives instead of being held until it is complete */
+static void test_split_reject(ndo_dbuf *stream, unsigned long frame_size){
+	ndo2db_idi idi;
+	unsigned long used=0L;
+	unsigned long pending=0L;
+	unsigned long part=NDO_API_FRAME_HEADER_SIZE+100;
+
+	ndo2db_idi_init(&idi);
+	idi.protocol_version=NDO_API_PROTOVERSION_BINARY;
+	idi.current_input_section=NDO2DB_INPUT_SECTION_DATA;
+
+	used=ndo2db_process_client_data(&idi,stream->buf,part,&pending);
+	if(used!=part || idi.frame_skip!=frame_size-part || pending!=0L){
+		printf("FAIL: oversized frame: %lu of %lu bytes used, %lu left to skip\n",used,part,idi.frame_skip);
+		test_failures++;
+		}
+
+	used=ndo2db_process_client_data(&idi,stream->buf+part,frame_size-part,&pending);
+	if(used!=frame_size-part || idi.frame_skip!=0L || idi.bytes_processed!=frame_size){
+		printf("FAIL: oversized frame: %lu of %lu bytes skipped\n",idi.bytes_processed,frame_size);
+		test_failures++;
+		}
+
+	ndo2db_free_input_memory(&idi);
+	ndo2db_free_connection_memory(&idi);
+        }
+
+
+int main(int argc, char **argv){
+	ndo_dbuf stream;
+	ndo_dbuf text;
+	ndo_dbuf big;
+	unsigned long bodies[]={0,1,4,5,6,120,121,5000,300};
+	unsigned long lengths[]={0,1,20,1023,1024,1025,3000,0,5,2000};
+	unsigned long nlines=sizeof(lengths)/sizeof(lengths[0]);
+	unsigned long shortest=0L;
+	unsigned long *cuts=NULL;
+	unsigned long frame_end=0L;
+	unsigned long x;
+	unsigned long y;
+	int ncuts=0;
+	char name[128];
+
+	ndo_dbuf_init(&stream,8192);
+	for(x=0;x<sizeof(bodies)/sizeof(bodies[0]);x++)
+		test_split_add_frame(&stream,bodies[x]);
+
+	ndo_dbuf_init(&text,8192);
+	for(x=0;x<nlines;x++)
+		test_split_add_line(&text,lengths[x]);
+
+	if((cuts=(unsigned long *)malloc(sizeof(unsigned long)*(stream.used_size+text.used_size)))==NULL){
+		printf("Out of memory\n");
+		return 1;
+		}
+
+	/* every single split point */
+	for(x=1;x<stream.used_size;x++){
+		cuts[0]=x;
+		snprintf(name,sizeof(name),"split at %lu",x);
+		test_split_run(name,&stream,NDO_API_PROTOVERSION_BINARY,0L,stream.used_size,cuts,1);
+		}
+
+	/* every pair of split points inside the first frame header and the start of the next frame */
+	frame_end=NDO_API_FRAME_HEADER_SIZE+2;
+	for(x=1;x<frame_end+NDO_API_FRAME_HEADER_SIZE+2;x++){
+		for(y=x+1;y<frame_end+NDO_API_FRAME_HEADER_SIZE+4;y++){
+			cuts[0]=x;
+			cuts[1]=y;
+			snprintf(name,sizeof(name),"split at %lu and %lu",x,y);
+			test_split_run(name,&stream,NDO_API_PROTOVERSION_BINARY,0L,stream.used_size,cuts,2);
+			}
+		}
+
+	/* small reads that keep landing inside headers */
+	for(x=1;x<=2*NDO_API_FRAME_HEADER_SIZE;x++){
+		for(ncuts=0,y=x;y<stream.used_size;y+=x)
+			cuts[ncuts++]=y;
+		snprintf(name,sizeof(name),"reads of %lu bytes",x);
+		test_split_run(name,&stream,NDO_API_PROTOVERSION_BINARY,0L,stream.used_size,cuts,ncuts);
+		}
+
+	/* frames over max_frame_size are skipped without being collected, and the ones after them still get through */
+	ndo2db_max_frame_size=1024;
+	for(x=1;x<stream.used_size;x+=7){
+		cuts[0]=x;
+		snprintf(name,sizeof(name),"oversized frame, split at %lu",x);
+		test_split_run(name,&stream,NDO_API_PROTOVERSION_BINARY,0L,stream.used_size,cuts,1);
+		}
+
+	/* a frame over max_frame_size is thrown away piece by piece */
+	ndo_dbuf_init(&big,8192);
+	test_split_add_frame(&big,5000);
+	test_split_reject(&big,big.used_size);
+	ndo_dbuf_free(&big);
+	ndo2db_max_frame_size=NDO2DB_DEFAULT_MAX_FRAME_SIZE;
+
+	/* text lines split at every point come back together */
+	for(x=1;x<text.used_size;x++){
+		cuts[0]=x;
+		snprintf(name,sizeof(name),"text split at %lu",x);
+		test_split_run(name,&text,NDO_API_PROTOVERSION,nlines,text.used_size,cuts,1);
+		}
+
+	/* small text reads, so that most lines span several of them */
+	for(x=1;x<=64;x+=9){
+		for(ncuts=0,y=x;y<text.used_size;y+=x)
+			cuts[ncuts++]=y;
+		snprintf(name,sizeof(name),"text reads of %lu bytes",x);
+		test_split_run(name,&text,NDO_API_PROTOVERSION,nlines,text.used_size,cuts,ncuts);
+		}
+
+	/* lines split past max_line_length are cut short, but still handled one for one */
+	ndo2db_max_line_length=NDO2DB_MIN_LINE_LENGTH;
+	for(x=0;x<nlines;x++)
+		shortest+=((lengths[x]<ndo2db_max_line_length)?lengths[x]:ndo2db_max_line_length)+1;
+	for(x=1;x<text.used_size;x+=7){
+		cuts[0]=x;
+		snprintf(name,sizeof(name),"long text lines, split at %lu",x);
+		test_split_run(name,&text,NDO_API_PROTOVERSION,nlines,shortest,cuts,1);
+		}
+	for(x=100;x<=1000;x+=300){
+		for(ncuts=0,y=x;y<text.used_size;y+=x)
+			cuts[ncuts++]=y;
+		snprintf(name,sizeof(name),"long text lines, reads of %lu bytes",x);
+		test_split_run(name,&text,NDO_API_PROTOVERSION,nlines,shortest,cuts,ncuts);
+		}
+	ndo2db_max_line_length=NDO2DB_MAX_LINE_LENGTH;
+
+	free(cuts);
+	ndo_dbuf_free(&stream);
+	ndo_dbuf_free(&text);
+
+	if(test_failures>0){
+		printf("%d split input tests failed\n",test_failures);
+		return 1;
+		}
+
+	printf("All split input tests passed\n");
+
+	return 0;
+        }
@@ -24,6 +24,316 @@
 #include "../include/common.h"
 #include "../include/utils.h"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/* gcc can build an AVX2 kernel without -mavx2 and pick it at runtime */
+#if defined(__SSE2__) && defined(__x86_64__) && !defined(__clang__) && defined(__GNUC__) && (__GNUC__>4 || (__GNUC__==4 && __GNUC_MINOR__>=9))
+#define NDO_ESCAPE_AVX2
+#include <immintrin.h>
+#endif
+
+
+
+
+/****************************************************************************/
+/* ESCAPING FUNCTIONS                                                       */
+/****************************************************************************/
+
+/*
+ * Protocol 2 escapes tabs, carriage returns, newlines and backslashes.  Almost
+ * no host names or plugin outputs contain any of them, so the escaping code
+ * first looks for the next one 16 or 32 bytes at a time and copies everything
+ * before it in one go.
+ */
+
+static unsigned long ndo_escape_span_scalar(const char *buf, unsigned long len){
+	unsigned long x;
+
+	for(x=0;x<len;x++){
+		if(buf[x]=='\t' || buf[x]=='\r' || buf[x]=='\n' || buf[x]=='\\')
+			break;
+		}
+
+	return x;
+        }
+
+
+#if defined(__SSE2__)
+static unsigned long ndo_escape_span_sse2(const char *buf, unsigned long len){
+	const __m128i tab=_mm_set1_epi8('\t');
+	const __m128i cr=_mm_set1_epi8('\r');
+	const __m128i nl=_mm_set1_epi8('\n');
+	const __m128i bs=_mm_set1_epi8('\\');
+	__m128i v;
+	unsigned int mask;
+	unsigned long x;
+
+	for(x=0;x+16<=len;x+=16){
+		v=_mm_loadu_si128((const __m128i *)(buf+x));
+		mask=(unsigned int)_mm_movemask_epi8(_mm_or_si128(
+			_mm_or_si128(_mm_cmpeq_epi8(v,tab),_mm_cmpeq_epi8(v,cr)),
+			_mm_or_si128(_mm_cmpeq_epi8(v,nl),_mm_cmpeq_epi8(v,bs))));
+		if(mask!=0)
+			return x+__builtin_ctz(mask);
+		}
+
+	return x+ndo_escape_span_scalar(buf+x,len-x);
+        }
+#endif
+
+
+#ifdef NDO_ESCAPE_AVX2
+__attribute__((target("avx2")))
+static unsigned long ndo_escape_span_avx2(const char *buf, unsigned long len){
+	const __m256i tab=_mm256_set1_epi8('\t');
+	const __m256i cr=_mm256_set1_epi8('\r');
+	const __m256i nl=_mm256_set1_epi8('\n');
+	const __m256i bs=_mm256_set1_epi8('\\');
+	__m256i v;
+	unsigned int mask=0;
+	unsigned long x;
+
+	for(x=0;x+32<=len;x+=32){
+		v=_mm256_loadu_si256((const __m256i *)(buf+x));
+		mask=(unsigned int)_mm256_movemask_epi8(_mm256_or_si256(
+			_mm256_or_si256(_mm256_cmpeq_epi8(v,tab),_mm256_cmpeq_epi8(v,cr)),
+			_mm256_or_si256(_mm256_cmpeq_epi8(v,nl),_mm256_cmpeq_epi8(v,bs))));
+		if(mask!=0)
+			break;
+		}
+
+	/* gcc doesn't always do this before the call, and mixing in SSE code with it undone is slow */
+	_mm256_zeroupper();
+
+	if(x+32<=len)
+		return x+__builtin_ctz(mask);
+
+	return x+ndo_escape_span_sse2(buf+x,len-x);
+        }
+#endif
+
+
+static unsigned long (*ndo_escape_span_func)(const char *,unsigned long)=NULL;
+
+/* returns how many bytes at the start of buf[0..len) need no escaping */
+unsigned long ndo_escape_span(const char *buf, unsigned long len){
+
+	/* pick the widest kernel this CPU can run the first time through */
+	if(ndo_escape_span_func==NULL){
+#if defined(NDO_ESCAPE_AVX2)
+		__builtin_cpu_init();
+		if(__builtin_cpu_supports("avx2"))
+			ndo_escape_span_func=ndo_escape_span_avx2;
+		else
+			ndo_escape_span_func=ndo_escape_span_sse2;
+#elif defined(__SSE2__)
+		ndo_escape_span_func=ndo_escape_span_sse2;
+#else
+		ndo_escape_span_func=ndo_escape_span_scalar;
+#endif
+		}
+
+	return ndo_escape_span_func(buf,len);
+        }
+
+
+/*
+ * ndo2db escapes ' " * \ $ ? . ^ + [ ] ( ) for SQL.  Apart from four of them
+ * they come in two runs, 0x27-0x2b and 0x5b-0x5e, so the SQL kernels make six
+ * tests per block rather than thirteen.
+ */
+
+static unsigned long ndo_sql_escape_span_scalar(const char *buf, unsigned long len){
+	unsigned long x;
+	unsigned char c;
+
+	for(x=0;x<len;x++){
+		c=(unsigned char)buf[x];
+		if(c=='"' || c=='$' || c=='.' || c=='?' || (c>='\'' && c<='+') || (c>='[' && c<='^'))
+			break;
+		}
+
+	return x;
+        }
+
+
+#if defined(__SSE2__)
+static unsigned long ndo_sql_escape_span_sse2(const char *buf, unsigned long len){
+	const __m128i dq=_mm_set1_epi8('"');
+	const __m128i dollar=_mm_set1_epi8('$');
+	const __m128i dot=_mm_set1_epi8('.');
+	const __m128i qm=_mm_set1_epi8('?');
+	const __m128i lo1=_mm_set1_epi8('\'');
+	const __m128i w1=_mm_set1_epi8('+'-'\'');
+	const __m128i lo2=_mm_set1_epi8('[');
+	const __m128i w2=_mm_set1_epi8('^'-'[');
+	__m128i v;
+	__m128i t1;
+	__m128i t2;
+	unsigned int mask;
+	unsigned long x;
+
+	for(x=0;x+16<=len;x+=16){
+		v=_mm_loadu_si128((const __m128i *)(buf+x));
+		t1=_mm_sub_epi8(v,lo1);
+		t2=_mm_sub_epi8(v,lo2);
+		mask=(unsigned int)_mm_movemask_epi8(_mm_or_si128(
+			_mm_or_si128(
+				_mm_or_si128(_mm_cmpeq_epi8(v,dq),_mm_cmpeq_epi8(v,dollar)),
+				_mm_or_si128(_mm_cmpeq_epi8(v,dot),_mm_cmpeq_epi8(v,qm))),
+			_mm_or_si128(_mm_cmpeq_epi8(_mm_min_epu8(t1,w1),t1),_mm_cmpeq_epi8(_mm_min_epu8(t2,w2),t2))));
+		if(mask!=0)
+			return x+__builtin_ctz(mask);
+		}
+
+	return x+ndo_sql_escape_span_scalar(buf+x,len-x);
+        }
+#endif
+
+
+#ifdef NDO_ESCAPE_AVX2
+__attribute__((target("avx2")))
+static unsigned long ndo_sql_escape_span_avx2(const char *buf, unsigned long len){
+	const __m256i dq=_mm256_set1_epi8('"');
+	const __m256i dollar=_mm256_set1_epi8('$');
+	const __m256i dot=_mm256_set1_epi8('.');
+	const __m256i qm=_mm256_set1_epi8('?');
+	const __m256i lo1=_mm256_set1_epi8('\'');
+	const __m256i w1=_mm256_set1_epi8('+'-'\'');
+	const __m256i lo2=_mm256_set1_epi8('[');
+	const __m256i w2=_mm256_set1_epi8('^'-'[');
+	__m256i v;
+	__m256i t1;
+	__m256i t2;
+	unsigned int mask=0;
+	unsigned long x;
+
+	for(x=0;x+32<=len;x+=32){
+		v=_mm256_loadu_si256((const __m256i *)(buf+x));
+		t1=_mm256_sub_epi8(v,lo1);
+		t2=_mm256_sub_epi8(v,lo2);
+		mask=(unsigned int)_mm256_movemask_epi8(_mm256_or_si256(
+			_mm256_or_si256(
+				_mm256_or_si256(_mm256_cmpeq_epi8(v,dq),_mm256_cmpeq_epi8(v,dollar)),
+				_mm256_or_si256(_mm256_cmpeq_epi8(v,dot),_mm256_cmpeq_epi8(v,qm))),
+			_mm256_or_si256(_mm256_cmpeq_epi8(_mm256_min_epu8(t1,w1),t1),_mm256_cmpeq_epi8(_mm256_min_epu8(t2,w2),t2))));
+		if(mask!=0)
+			break;
+		}
+
+	_mm256_zeroupper();
+
+	if(x+32<=len)
+		return x+__builtin_ctz(mask);
+
+	return x+ndo_sql_escape_span_sse2(buf+x,len-x);
+        }
+#endif
+
+
+static unsigned long (*ndo_sql_escape_span_func)(const char *,unsigned long)=NULL;
+
+/* returns how many bytes at the start of buf[0..len) need no escaping for SQL */
+static unsigned long ndo_sql_escape_span(const char *buf, unsigned long len){
+
+	if(ndo_sql_escape_span_func==NULL){
+#if defined(NDO_ESCAPE_AVX2)
+		__builtin_cpu_init();
+		if(__builtin_cpu_supports("avx2"))
+			ndo_sql_escape_span_func=ndo_sql_escape_span_avx2;
+		else
+			ndo_sql_escape_span_func=ndo_sql_escape_span_sse2;
+#elif defined(__SSE2__)
+		ndo_sql_escape_span_func=ndo_sql_escape_span_sse2;
+#else
+		ndo_sql_escape_span_func=ndo_sql_escape_span_scalar;
+#endif
+		}
+
+	return ndo_sql_escape_span_func(buf,len);
+        }
+
+
+/* escapes a string for ndo2db's SQL statements - allocated says whether the result has to be freed, a string with nothing to escape is handed back as is */
+char *ndo_sql_escape_buffer(char *buf, int *allocated){
+	char *newbuf=NULL;
+	unsigned long span=0L;
+	unsigned long x=0L;
+	unsigned long y=0L;
+	unsigned long len=0L;
+
+	*allocated=NDO_FALSE;
+
+	if(buf==NULL)
+		return NULL;
+
+	len=strlen(buf);
+	span=ndo_sql_escape_span(buf,len);
+
+	/* nothing to escape */
+	if(span==len)
+		return buf;
+
+	if((newbuf=(char *)malloc(span+((len-span)*2)+1))==NULL)
+		return NULL;
+
+	/* copy the runs between special characters in one go */
+	for(x=0,y=0;x<len;){
+		memcpy(newbuf+y,buf+x,span);
+		x+=span;
+		y+=span;
+		if(x>=len)
+			break;
+		newbuf[y++]='\\';
+		newbuf[y++]=buf[x++];
+		span=ndo_sql_escape_span(buf+x,len-x);
+		}
+
+	newbuf[y]='\x0';
+	*allocated=NDO_TRUE;
+
+	return newbuf;
+        }
+
+
+/* escapes buf[0..len) into out, which needs room for 2*len+1 bytes - returns the escaped length */
+unsigned long ndo_escape_into(char *out, const char *buf, unsigned long len){
+	unsigned long x=0L;
+	unsigned long y=0L;
+	unsigned long span=0L;
+
+	while(x<len){
+
+		span=ndo_escape_span(buf+x,len-x);
+		memcpy(out+y,buf+x,span);
+		x+=span;
+		y+=span;
+		if(x>=len)
+			break;
+
+		out[y++]='\\';
+		switch(buf[x++]){
+		case '\t':
+			out[y++]='t';
+			break;
+		case '\r':
+			out[y++]='r';
+			break;
+		case '\n':
+			out[y++]='n';
+			break;
+		default:
+			out[y++]='\\';
+			break;
+			}
+		}
+
+	out[y]='\x0';
+
+	return y;
+        }
 
 
 
@@ -62,49 +372,332 @@ int ndo_dbuf_free(ndo_dbuf *db){
         }
 
 
-/* dynamically expands a string */
-int ndo_dbuf_strcat(ndo_dbuf *db, char *buf){
+/* empties a dynamic buffer but keeps its memory for reuse */
+int ndo_dbuf_reset(ndo_dbuf *db){
+
+	if(db==NULL)
+		return NDO_ERROR;
+
+	db->used_size=0L;
+	if(db->buf!=NULL)
+		db->buf[0]='\x0';
+
+	return NDO_OK;
+        }
+
+
+/* makes sure there is room for len more bytes (plus terminator) */
+int ndo_dbuf_reserve(ndo_dbuf *db, unsigned long len){
 	char *newbuf=NULL;
-	unsigned long buflen=0L;
 	unsigned long new_size=0L;
 	unsigned long memory_needed=0L;
 
+	if(db==NULL)
+		return NDO_ERROR;
+
+	new_size=db->used_size+len+1;
+
+	/* we have enough memory already */
+	if(db->allocated_size>=new_size)
+		return NDO_OK;
+
+	/* round up to the chunk size, but at least double so big messages don't realloc per field */
+	memory_needed=((new_size/db->chunk_size)+1)*db->chunk_size;
+	if(memory_needed<db->allocated_size*2)
+		memory_needed=db->allocated_size*2;
+
+	/* allocate memory to store old and new string */
+	if((newbuf=(char *)realloc((void *)db->buf,(size_t)memory_needed))==NULL)
+		return NDO_ERROR;
+
+	/* update buffer pointer */
+	db->buf=newbuf;
+
+	/* update allocated size */
+	db->allocated_size=memory_needed;
+
+	/* terminate buffer */
+	db->buf[db->used_size]='\x0';
+
+	return NDO_OK;
+        }
+
+
+/* appends len bytes to a dynamic buffer */
+int ndo_dbuf_strncat(ndo_dbuf *db, const char *buf, unsigned long len){
+
 	if(db==NULL || buf==NULL)
 		return NDO_ERROR;
 
-	/* how much memory should we allocate (if any)? */
-	buflen=strlen(buf);
-	new_size=db->used_size+buflen+1;
+	if(ndo_dbuf_reserve(db,len)==NDO_ERROR)
+		return NDO_ERROR;
 
-	/* we need more memory */
-	if(db->allocated_size<new_size){
+	/* append at the end we already know about instead of searching for it */
+	memcpy(db->buf+db->used_size,buf,len);
+	db->used_size+=len;
+	db->buf[db->used_size]='\x0';
 
-		memory_needed=((ceil(new_size/db->chunk_size)+1)*db->chunk_size);
+	return NDO_OK;
+        }
 
-		/* allocate memory to store old and new string */
-		if((newbuf=(char *)realloc((void *)db->buf,(size_t)memory_needed))==NULL)
-			return NDO_ERROR;
 
-		/* update buffer pointer */
-		db->buf=newbuf;
+/* dynamically expands a string */
+int ndo_dbuf_strcat(ndo_dbuf *db, char *buf){
+
+	if(db==NULL || buf==NULL)
+		return NDO_ERROR;
 
-		/* update allocated size */
-		db->allocated_size=memory_needed;
+	return ndo_dbuf_strncat(db,buf,strlen(buf));
+        }
 
-		/* terminate buffer */
-		db->buf[db->used_size]='\x0';
-	        }
 
-	/* append the new string */
-	strcat(db->buf,buf);
+/* appends a single character */
+int ndo_dbuf_addchar(ndo_dbuf *db, char c){
 
-	/* update size allocated */
-	db->used_size+=buflen;
+	if(db==NULL)
+		return NDO_ERROR;
+
+	if(ndo_dbuf_reserve(db,1)==NDO_ERROR)
+		return NDO_ERROR;
+
+	db->buf[db->used_size++]=c;
+	db->buf[db->used_size]='\x0';
 
 	return NDO_OK;
         }
 
 
+/* appends an unsigned long in decimal, zero padded to at least width digits */
+int ndo_dbuf_append_ulong(ndo_dbuf *db, unsigned long val, int width){
+	char digits[32];
+	int x=sizeof(digits);
+
+	if(db==NULL)
+		return NDO_ERROR;
+
+	/* build the digits backwards */
+	do{
+		digits[--x]='0'+(val%10);
+		val/=10;
+		}while(val>0 && x>0);
+
+	while(x>0 && (int)(sizeof(digits)-x)<width)
+		digits[--x]='0';
+
+	return ndo_dbuf_strncat(db,digits+x,sizeof(digits)-x);
+        }
+
+
+/* appends a signed long in decimal */
+int ndo_dbuf_append_long(ndo_dbuf *db, long val){
+
+	if(db==NULL)
+		return NDO_ERROR;
+
+	if(val<0){
+		ndo_dbuf_addchar(db,'-');
+		return ndo_dbuf_append_ulong(db,(unsigned long)(-(val+1))+1,0);
+		}
+
+	return ndo_dbuf_append_ulong(db,(unsigned long)val,0);
+        }
+
+
+/* appends a floating point value with the given number of decimals */
+int ndo_dbuf_append_double(ndo_dbuf *db, double val, int decimals){
+	int len=0;
+
+	if(db==NULL)
+		return NDO_ERROR;
+
+	/* doubles are rare enough that we let snprintf() do the rounding, straight into the buffer */
+	if(ndo_dbuf_reserve(db,64)==NDO_ERROR)
+		return NDO_ERROR;
+
+	len=snprintf(db->buf+db->used_size,64,"%.*f",decimals,val);
+	if(len<0)
+		len=0;
+	else if(len>63)
+		len=63;
+	db->used_size+=len;
+	db->buf[db->used_size]='\x0';
+
+	return NDO_OK;
+        }
+
+
+/* appends a string, escaping special characters the same way ndo_escape_buffer() does */
+int ndo_dbuf_append_escaped(ndo_dbuf *db, const char *buf){
+	unsigned long len=0L;
+	unsigned long span=0L;
+
+	if(db==NULL || buf==NULL)
+		return NDO_ERROR;
+
+	len=strlen(buf);
+	span=ndo_escape_span(buf,len);
+
+	/* nothing to escape */
+	if(span==len)
+		return ndo_dbuf_strncat(db,buf,len);
+
+	if(ndo_dbuf_reserve(db,span+(len-span)*2)==NDO_ERROR)
+		return NDO_ERROR;
+
+	memcpy(db->buf+db->used_size,buf,span);
+	db->used_size+=span;
+	db->used_size+=ndo_escape_into(db->buf+db->used_size,buf+span,len-span);
+
+	return NDO_OK;
+        }
+
+
+
+/*
+ * Varints used by the binary protocol never contain a NUL byte, so encoded
+ * frames can still travel through code that treats them as C strings.
+ * Each byte holds a base-127 digit plus one (least significant first), with
+ * the high bit set on every byte except the last.
+ */
+
+/* encodes a varint into exactly size bytes (zero padded) - used for lengths we patch in later */
+int ndo_encode_varint_fixed(char *buf, unsigned long long val, int size){
+	int x;
+
+	if(buf==NULL || size<=0)
+		return NDO_ERROR;
+
+	for(x=0;x<size;x++){
+		buf[x]=(char)((val%127)+1);
+		val/=127;
+		if(x<size-1)
+			buf[x]|=0x80;
+		}
+
+	/* value didn't fit */
+	if(val>0)
+		return NDO_ERROR;
+
+	return NDO_OK;
+        }
+
+
+/* appends a varint */
+int ndo_dbuf_append_varint(ndo_dbuf *db, unsigned long long val){
+	char digits[16];
+	int x=0;
+
+	if(db==NULL)
+		return NDO_ERROR;
+
+	do{
+		digits[x]=(char)((val%127)+1);
+		val/=127;
+		if(val>0)
+			digits[x]|=0x80;
+		x++;
+		}while(val>0);
+
+	return ndo_dbuf_strncat(db,digits,x);
+        }
+
+
+/* decodes a varint, advancing *buf - returns NDO_ERROR if it is incomplete or invalid */
+int ndo_decode_varint(const char **buf, const char *end, unsigned long long *val){
+	const unsigned char *p=NULL;
+	unsigned long long result=0L;
+	unsigned long long mult=1L;
+	int x;
+
+	if(buf==NULL || *buf==NULL || val==NULL)
+		return NDO_ERROR;
+
+	p=(const unsigned char *)*buf;
+	for(x=0;x<10;x++){
+
+		if((const char *)p>=end || ((*p)&0x7f)=='\x0')
+			return NDO_ERROR;
+
+		result+=(unsigned long long)(((*p)&0x7f)-1)*mult;
+		mult*=127;
+
+		if(!((*p++)&0x80)){
+			*buf=(const char *)p;
+			*val=result;
+			return NDO_OK;
+			}
+		}
+
+	return NDO_ERROR;
+        }
+
+
+
+/******************************************************************/
+/************************** OBJECT KEYS ***************************/
+/******************************************************************/
+
+/*
+ * An object key is a 64-bit hash of an object's type and names, so ndomod and
+ * ndo2db agree on it without talking to each other.  NULL and empty names are
+ * the same thing, as they are in the objects table.  Zero is never a key.
+ */
+
+/* adds a string (and a terminator, so "ab","c" and "a","bc" differ) to an FNV-1a hash */
+static unsigned long long ndo_object_key_add(unsigned long long hash, const char *str){
+
+	if(str!=NULL){
+		for(;*str!='\x0';str++){
+			hash^=(unsigned char)*str;
+			hash*=1099511628211ULL;
+			}
+		}
+
+	hash^=0xff;
+	hash*=1099511628211ULL;
+
+	return hash;
+        }
+
+
+/* FNV leaves the low bits weak, so mix them (MurmurHash3 finalizer) */
+static unsigned long long ndo_hash_finalize(unsigned long long hash){
+
+	hash^=hash>>33;
+	hash*=0xff51afd7ed558ccdULL;
+	hash^=hash>>33;
+	hash*=0xc4ceb9fe1a85ec53ULL;
+	hash^=hash>>33;
+
+	return (hash==0L)?1L:hash;
+        }
+
+
+/* returns the key for an object of the given type (an NDO_API_OBJECTTYPE_* value) */
+unsigned long long ndo_object_key(int object_type, const char *name1, const char *name2){
+	unsigned long long hash=14695981039346656037ULL;
+
+	hash^=(unsigned char)object_type;
+	hash*=1099511628211ULL;
+	hash=ndo_object_key_add(hash,name1);
+	hash=ndo_object_key_add(hash,name2);
+
+	return ndo_hash_finalize(hash);
+        }
+
+
+/* returns a hash of len bytes, used to tell whether an object definition changed */
+unsigned long long ndo_content_hash(const char *buf, unsigned long len){
+	unsigned long long hash=14695981039346656037ULL;
+	unsigned long x;
+
+	for(x=0;x<len;x++){
+		hash^=(unsigned char)buf[x];
+		hash*=1099511628211ULL;
+		}
+
+	return ndo_hash_finalize(hash);
+        }
 
 /******************************************************************/
 /************************* FILE FUNCTIONS *************************/